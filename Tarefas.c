@@ -71,8 +71,7 @@ void SetaComando(void){
 	char* argPtr;
 	char* args[3];
 
-	args[0] = malloc(80);
-	args[1] = malloc(80);
+	// args[0] e args[1] apontam para dentro de "buffer" (strtok), nao precisam ser alocados
 	args[2] = NULL;
 
 	for(;;){
@@ -0,0 +1,156 @@
+/**
+ * \file
+ * \brief Comandos agendados e periodicos em uma roda de tempo
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "agenda.h"
+#include "console.h"
+#include "travas.h"
+
+#if (configUSE_TIMERS != 1)
+#  error "agenda.c usa um software timer: defina configUSE_TIMERS 1 no FreeRTOSConfig.h"
+#endif
+
+#define AGENDA_PASSO_TICKS pdMS_TO_TICKS(CONF_AGENDA_RESOLUCAO_MS)
+
+static struct roda agenda_roda;
+static agenda_executa_t agenda_executa;
+static TickType_t agenda_base;      // Tick do ultimo avanco feito (com a trava)
+static uint32_t agenda_adiados;     // Disparos do timer que acharam a trava ocupada, para o "jobs"
+
+static struct trava agenda_trava;
+static TimerHandle_t agenda_timer;
+static StaticTimer_t agenda_timer_buffer;
+
+//! Avancos vencidos desde o ultimo feito (com a trava tomada); as contas em ticks aceitam a volta do contador
+static uint32_t agenda_atrasados(void)
+{
+	return (uint32_t)((TickType_t)(xTaskGetTickCount() - agenda_base) / AGENDA_PASSO_TICKS);
+}
+
+/**
+ * \brief Avanca a roda ate o tick atual e dispara os jobs vencidos (tarefa dos timers)
+ *
+ * Nao espera pela trava: ocupada, os avancos ficam para o proximo disparo do timer, que faz
+ * todos os vencidos de uma vez.
+ */
+static void agenda_avanca(TimerHandle_t timer)
+{
+	uint32_t passos;
+
+	if (!trava_tenta(&agenda_trava)) {
+		agenda_adiados++;
+		return;
+	}
+
+	for (passos = agenda_atrasados(); passos != 0; passos--) {
+		agenda_base += AGENDA_PASSO_TICKS;
+		roda_avanca(&agenda_roda, agenda_executa);
+	}
+
+	// Sem jobs o timer para, e o nucleo pode dormir ate o proximo comando
+	if (roda_vazia(&agenda_roda)) {
+		xTimerStop(timer, 0);
+	}
+
+	trava_libera(&agenda_trava);
+}
+
+/**
+ * \brief Cria o timer da roda e a trava dos jobs
+ *
+ * \param executa Recebe cada job que dispara
+ */
+void agenda_init(agenda_executa_t executa)
+{
+	agenda_executa = executa;
+	roda_init(&agenda_roda, CONF_AGENDA_RESOLUCAO_MS);
+
+	trava_init(&agenda_trava, "agenda");
+	agenda_timer = xTimerCreateStatic("agenda", pdMS_TO_TICKS(CONF_AGENDA_RESOLUCAO_MS), pdTRUE,
+			NULL, agenda_avanca, &agenda_timer_buffer);
+}
+
+/**
+ * \brief Agenda um comando
+ *
+ * \param cmd       Comando a executar (sem o prefixo at/every)
+ * \param ms        Atraso ate o disparo, ou periodo
+ * \param periodico Repete a cada "ms" ate ser cancelado
+ *
+ * \return Id do job, ou -1 se todos os jobs estao em uso
+ */
+int agenda_insere(const Comando *cmd, uint32_t ms, bool periodico)
+{
+	bool primeiro;
+	int id;
+
+	trava_toma(&agenda_trava);
+
+	// Primeiro job: a roda parada comeca a contar de agora
+	primeiro = roda_vazia(&agenda_roda);
+	if (primeiro) {
+		agenda_base = xTaskGetTickCount();
+	}
+	id = roda_insere(&agenda_roda, cmd, ms, periodico, agenda_atrasados());
+	if (id > 0 && primeiro) {
+		xTimerStart(agenda_timer, 0);
+	}
+
+	trava_libera(&agenda_trava);
+	return id;
+}
+
+/**
+ * \brief Cancela um job
+ *
+ * \return false se nao ha job com esse id (ja disparou ou foi cancelado)
+ */
+bool agenda_cancela(int id)
+{
+	bool cancelado;
+
+	trava_toma(&agenda_trava);
+	cancelado = roda_cancela(&agenda_roda, id);
+	trava_libera(&agenda_trava);
+	return cancelado;
+}
+
+/**
+ * \brief Lista os jobs
+ *
+ *   id modo ms faltam_ms disparos comando
+ *   <id> <at|every> <ms> <faltam> <disparos> <comando>
+ *   perdidos <n>   (disparos descartados com a fila de comandos cheia)
+ *   adiados <n>    (disparos do timer que acharam a trava ocupada e deixaram o avanco para o seguinte)
+ *
+ * A trava e tomada job a job, para nao segurar a roda durante a impressao.
+ */
+void agenda_imprime(void)
+{
+	struct roda_job job;
+	Comando cmd;
+	char texto[COMANDO_TAM];
+	uint32_t faltam;
+	int16_t j;
+
+	console_puts("id modo ms faltam_ms disparos comando\n");
+	for (j = 0; j < CONF_AGENDA_MAX; j++) {
+		trava_toma(&agenda_trava);
+		job = agenda_roda.jobs[j];
+		faltam = roda_faltam_ms(&agenda_roda, &job);
+		trava_libera(&agenda_trava);
+
+		if (job.id == 0) {
+			continue;
+		}
+		roda_comando(&job, &cmd);
+		FormataComando(&cmd, texto, sizeof(texto));
+		console_printf("%d %s %lu %lu %lu %s\n", job.id, job.periodico ? "every" : "at", job.ms,
+				faltam, job.disparos, texto);
+	}
+	console_printf("perdidos %lu\n", agenda_roda.perdidos);
+	console_printf("adiados %lu\n", agenda_adiados);
+}
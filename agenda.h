@@ -0,0 +1,39 @@
+/**
+ * \file
+ * \brief Comandos agendados ("at <ms> <comando>") e periodicos ("every <ms> <comando>")
+ *
+ * Os jobs ficam em uma roda de tempo (roda.h), avancada por um unico software timer do FreeRTOS
+ * a cada CONF_AGENDA_RESOLUCAO_MS. O timer fica parado enquanto nao ha jobs, para nao acordar o
+ * nucleo a toa. Precisa de configUSE_TIMERS 1 no FreeRTOSConfig.h. A capacidade
+ * (CONF_AGENDA_MAX) e o custo em RAM estao em roda.h.
+ *
+ * O callback do timer roda na tarefa dos timers e nao pode bloquear: se a trava dos jobs esta
+ * com outra tarefa (insere, cancela ou "jobs"), o avanco fica para o proximo disparo do timer.
+ * Cada disparo avanca a roda ate o tick atual, e um job inserido nesse meio tempo conta os
+ * avancos que faltam, para nao disparar cedo.
+ *
+ * Ao disparar, o job e entregue a funcao passada para agenda_init(), que o executa pelo
+ * mesmo caminho dos comandos recebidos pela serial.
+ */
+
+#ifndef AGENDA_H
+#define AGENDA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "comandos.h"
+#include "roda.h"
+
+#ifndef CONF_AGENDA_RESOLUCAO_MS
+#  define CONF_AGENDA_RESOLUCAO_MS 10 // Avanco da roda a cada disparo do timer
+#endif
+
+//! Entrega um job que disparou; retorna false se ele nao pode ser executado agora (fila cheia)
+typedef roda_executa_t agenda_executa_t;
+
+void agenda_init(agenda_executa_t executa);
+int agenda_insere(const Comando *cmd, uint32_t ms, bool periodico);
+bool agenda_cancela(int id);
+void agenda_imprime(void);
+
+#endif // AGENDA_H
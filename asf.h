@@ -98,6 +98,10 @@
 // From module: Part identification macros
 #include <parts.h>
 
+// From module: RTC - Real Time Counter in Count Mode (Callback APIs)
+#include <rtc_count.h>
+#include <rtc_count_interrupt.h>
+
 // From module: SERCOM Callback API
 #include <sercom.h>
 #include <sercom_interrupt.h>
@@ -128,6 +132,9 @@
 // From module: Standard serial I/O (stdio)
 #include <stdio_serial.h>
 
+// From module: TC - Timer Counter (Polled APIs)
+#include <tc.h>
+
 // From module: TCC - Timer Counter for Control Applications (Callback APIs)
 #include <tcc.h>
 #include <tcc_callback.h>
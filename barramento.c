@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief Filtro de enderecos do console em barramento compartilhado
+ */
+
+#include "barramento.h"
+
+// Estados do filtro
+enum {
+	BARRAMENTO_INICIO,    // Inicio de linha
+	BARRAMENTO_ENDERECO,  // Lendo o endereco depois do '@'
+	BARRAMENTO_DIFUNDIDO, // Leu "@*", falta o espaco
+	BARRAMENTO_ACEITA,    // Linha para este no: repassa ate o '\n'
+	BARRAMENTO_DESCARTA,  // Linha de outro no: ignora ate o '\n'
+};
+
+void barramento_filtro_init(struct barramento_filtro *filtro, uint8_t endereco)
+{
+	filtro->endereco = endereco;
+	filtro->estado = BARRAMENTO_INICIO;
+	filtro->lido = 0;
+	filtro->aceitos = 0;
+	filtro->descartados = 0;
+}
+
+bool barramento_filtra(struct barramento_filtro *filtro, uint8_t c, uint8_t *saida)
+{
+	*saida = c;
+
+	if (filtro->endereco == 0) {
+		return true;
+	}
+
+	switch (filtro->estado) {
+	case BARRAMENTO_ACEITA:
+		if (c == '\n') {
+			filtro->estado = BARRAMENTO_INICIO;
+		}
+		return true;
+
+	case BARRAMENTO_DESCARTA:
+		if (c == '\n') {
+			filtro->estado = BARRAMENTO_INICIO;
+		}
+		return false;
+
+	case BARRAMENTO_INICIO:
+		if (c == '@') {
+			filtro->estado = BARRAMENTO_ENDERECO;
+			filtro->lido = 0;
+		} else if (c != '\n' && c != '\r') {
+			filtro->estado = BARRAMENTO_DESCARTA; // Sem endereco (ou resposta de outro no)
+			filtro->descartados++;
+		}
+		return false;
+
+	case BARRAMENTO_ENDERECO:
+		if (c >= '0' && c <= '9') {
+			filtro->lido = (uint16_t)(filtro->lido * 10 + (c - '0'));
+			if (filtro->lido > BARRAMENTO_ENDERECO_MAX) {
+				filtro->estado = BARRAMENTO_DESCARTA;
+				filtro->descartados++;
+			}
+			return false;
+		}
+		if (c == '*' && filtro->lido == 0) {
+			filtro->estado = BARRAMENTO_DIFUNDIDO;
+			return false;
+		}
+		if (c == ' ' && filtro->lido == filtro->endereco) {
+			filtro->estado = BARRAMENTO_ACEITA;
+			filtro->aceitos++;
+			return false;
+		}
+		break;
+
+	case BARRAMENTO_DIFUNDIDO:
+		if (c == ' ') {
+			filtro->estado = BARRAMENTO_ACEITA;
+			filtro->aceitos++;
+			*saida = BARRAMENTO_DIFUSAO;
+			return true;
+		}
+		break;
+	}
+
+	// Endereco de outro no ou mal formado
+	filtro->estado = (c == '\n') ? BARRAMENTO_INICIO : BARRAMENTO_DESCARTA;
+	filtro->descartados++;
+	return false;
+}
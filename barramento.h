@@ -0,0 +1,63 @@
+/**
+ * \file
+ * \brief Enderecamento do console em um barramento compartilhado (RS-485 half-duplex)
+ *
+ * Com um endereco de no definido, o console so aceita linhas "@<endereco> <comando>" com o
+ * seu endereco ou "@* <comando>" (difusao). As demais sao descartadas pela interrupcao de
+ * recepcao, caractere a caractere, sem passar pelo buffer nem acordar tarefas: um no ocioso
+ * so paga algumas comparacoes por byte.
+ *
+ * O prefixo nao chega ao interpretador. Uma linha de difusao chega precedida de
+ * BARRAMENTO_DIFUSAO, para que a resposta (so o ack de uma linha "#<id>") saia na janela
+ * do no: BARRAMENTO_ATRASO_US(endereco) depois da recepcao, sem colisao entre os nos.
+ *
+ * O filtro nao depende do ASF, para que o simulador do host (tools/bench_barramento.cpp)
+ * use o mesmo codigo da interrupcao.
+ */
+
+#ifndef BARRAMENTO_H
+#define BARRAMENTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BARRAMENTO_ENDERECO_MAX 247 // Enderecos de no 1..247; 0 desliga o enderecamento
+
+// Janela de resposta de cada no a uma difusao. Deve caber um ack "=<end> err <id> <cod>\n" no
+// baud do console (24 bytes a 9600 baud sao 25 ms) e a execucao do comando mais demorado
+#ifndef CONF_BARRAMENTO_SLOT_US
+#  define CONF_BARRAMENTO_SLOT_US 30000
+#endif
+#define BARRAMENTO_ATRASO_US(endereco) ((uint32_t)(endereco) * CONF_BARRAMENTO_SLOT_US)
+
+#define BARRAMENTO_DIFUSAO 0x1E // Entregue antes do comando de uma linha "@*"
+
+//! Estado do filtro de enderecos de um no
+struct barramento_filtro {
+	uint8_t endereco;     // Endereco do no; 0 aceita tudo (console sem enderecamento)
+	uint8_t estado;
+	uint16_t lido;        // Endereco do quadro sendo lido
+	uint32_t aceitos;     // Quadros para este no ou de difusao
+	uint32_t descartados; // Quadros para outros nos ou sem endereco
+};
+
+void barramento_filtro_init(struct barramento_filtro *filtro, uint8_t endereco);
+
+/**
+ * \brief Passa um byte recebido pelo filtro
+ *
+ * \param saida Byte a entregar ao console (o proprio byte, ou BARRAMENTO_DIFUSAO)
+ *
+ * \return true se "saida" deve ser entregue
+ */
+bool barramento_filtra(struct barramento_filtro *filtro, uint8_t c, uint8_t *saida);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BARRAMENTO_H
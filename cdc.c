@@ -0,0 +1,515 @@
+/**
+ * \file
+ * \brief Classe CDC-ACM para o console na USB nativa
+ */
+
+#include <string.h>
+#include "cdc.h"
+
+// Requisicoes padrao
+#define REQ_GET_STATUS        0x00
+#define REQ_CLEAR_FEATURE     0x01
+#define REQ_SET_FEATURE       0x03
+#define REQ_SET_ADDRESS       0x05
+#define REQ_GET_DESCRIPTOR    0x06
+#define REQ_GET_CONFIGURATION 0x08
+#define REQ_SET_CONFIGURATION 0x09
+#define REQ_GET_INTERFACE     0x0A
+#define REQ_SET_INTERFACE     0x0B
+
+// Requisicoes da classe CDC (PSTN)
+#define REQ_SET_LINE_CODING        0x20
+#define REQ_GET_LINE_CODING        0x21
+#define REQ_SET_CONTROL_LINE_STATE 0x22
+#define REQ_SEND_BREAK             0x23
+
+#define TIPO_MASCARA 0x60
+#define TIPO_PADRAO  0x00
+#define TIPO_CLASSE  0x20
+
+#define DESC_DEVICE        1
+#define DESC_CONFIGURATION 2
+#define DESC_STRING        3
+
+#define LINHA_TAM 7 // Line coding no fio: baud (4), parada, paridade, bits
+
+static const uint8_t desc_device[18] = {
+	18, DESC_DEVICE, 0x00, 0x02,   // USB 2.0
+	0x02, 0x00, 0x00,              // Classe CDC no dispositivo
+	CDC_EP0_TAM,
+	CONF_CDC_VID & 0xFF, CONF_CDC_VID >> 8,
+	CONF_CDC_PID & 0xFF, CONF_CDC_PID >> 8,
+	0x00, 0x01,                    // Versao 1.00
+	1, 2, 3,                       // Strings: fabricante, produto, serie
+	1                              // Uma configuracao
+};
+
+static const uint8_t desc_config[67] = {
+	9, DESC_CONFIGURATION, 67, 0, 2, 1, 0, 0x80, 50,     // 2 interfaces, alimentado pelo barramento, 100 mA
+	// Interface 0: comunicacao (ACM)
+	9, 4, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+	5, 0x24, 0x00, 0x10, 0x01,                           // Header, CDC 1.10
+	5, 0x24, 0x01, 0x00, 1,                              // Call management: dados na interface 1
+	4, 0x24, 0x02, 0x02,                                 // ACM: line coding e control line state
+	5, 0x24, 0x06, 0, 1,                                 // Union: mestre 0, escrava 1
+	7, 5, 0x80 | CDC_EP_NOTIF, 0x03, 8, 0, 16,           // Interrupt IN, 8 bytes, 16 ms
+	// Interface 1: dados
+	9, 4, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+	7, 5, CDC_EP_OUT, 0x02, CDC_EP_TAM, 0, 0,            // Bulk OUT
+	7, 5, 0x80 | CDC_EP_IN, 0x02, CDC_EP_TAM, 0, 0       // Bulk IN
+};
+
+static const char *const strings[] = {
+	NULL,                // 0: idiomas, montado a parte
+	"Embarcados",
+	"Console LED",
+	"0001"
+};
+
+static cdc_recebe_t cdc_recebe;
+static struct cdc_linha cdc_linha = { 9600, 0, 0, 8 };
+static struct cdc_estatisticas cdc_est;
+static uint8_t configuracao;
+static bool dtr;
+
+// Endpoint 0. O DMA da USB so le a RAM: os descritores sao copiados pacote a pacote
+static uint8_t ep0_rx[CDC_EP0_TAM];
+static uint8_t ep0_tx[CDC_EP0_TAM];
+static uint8_t ep0_string[CDC_EP0_TAM];
+static const uint8_t *ep0_dados;
+static uint16_t ep0_resta;
+static bool ep0_zlp;               // Resposta menor que o pedido e multipla do pacote: termina com ZLP
+static bool ep0_espera_linha;      // Estagio de dados de SET_LINE_CODING
+static uint8_t endereco_pendente;  // SET_ADDRESS vale depois do estagio de status
+
+// Recepcao bulk: os dois bancos e o proximo a entregar
+static uint8_t rx_area[2][CDC_EP_TAM];
+static uint16_t rx_tam[2];
+static uint16_t rx_pos[2];
+static bool rx_cheio[2];
+static uint8_t rx_proximo;
+static bool rx_retido;
+
+// Transmissao bulk: buffer circular (indices livres, mascarados no acesso) e os dois bancos
+static uint8_t tx_buf[CDC_TX_TAM];
+static uint16_t tx_ini;
+static uint16_t tx_fim;
+static uint8_t tx_area[2][CDC_EP_TAM];
+static bool tx_ocupado[2];
+static uint8_t tx_proximo;
+static bool tx_zlp;                // Ultimo pacote cheio: se o buffer esvaziar, manda um ZLP
+
+//! Estado default: endereco 0, nao configurado, nada em transito
+static void estado_inicial(void)
+{
+	configuracao = 0;
+	dtr = false;
+	endereco_pendente = 0;
+	ep0_espera_linha = false;
+	ep0_resta = 0;
+	ep0_zlp = false;
+	tx_ini = tx_fim = 0;
+}
+
+/**
+ * \brief Inicializa a classe (antes de ligar a USB)
+ *
+ * \param recebe Destino dos bytes recebidos do host
+ */
+void cdc_init(cdc_recebe_t recebe)
+{
+	cdc_recebe = recebe;
+	memset(&cdc_est, 0, sizeof(cdc_est));
+	estado_inicial();
+}
+
+//! Configurado pelo host e com a porta aberta (DTR) por um terminal
+bool cdc_get_conectado(void)
+{
+	return configuracao != 0 && dtr;
+}
+
+void cdc_get_linha(struct cdc_linha *linha)
+{
+	*linha = cdc_linha;
+}
+
+void cdc_get_estatisticas(struct cdc_estatisticas *est)
+{
+	*est = cdc_est;
+}
+
+//! Proximo pacote da resposta do endpoint 0 (ou o ZLP final)
+static void ep0_continua(void)
+{
+	uint16_t n = (ep0_resta > CDC_EP0_TAM) ? CDC_EP0_TAM : ep0_resta;
+
+	memcpy(ep0_tx, ep0_dados, n);
+	ep0_dados += n;
+	ep0_resta -= n;
+	if (n < CDC_EP0_TAM) {
+		ep0_zlp = false; // Pacote curto ja termina a transferencia
+	}
+	usbdev_envia(0, 1, ep0_tx, n);
+}
+
+//! Inicia o estagio de dados IN de uma requisicao, limitado ao tamanho pedido pelo host
+static void ep0_responde(const uint8_t *dados, uint16_t tam, uint16_t pedido)
+{
+	if (tam > pedido) {
+		tam = pedido;
+	}
+	ep0_dados = dados;
+	ep0_resta = tam;
+	ep0_zlp = (tam < pedido) && (tam % CDC_EP0_TAM == 0);
+	ep0_continua();
+}
+
+//! Estagio de status de uma requisicao sem dados
+static void ep0_status(void)
+{
+	ep0_resta = 0;
+	ep0_zlp = false;
+	usbdev_envia(0, 1, ep0_tx, 0);
+}
+
+//! Descritor de string em UTF-16 (so ASCII)
+static uint16_t monta_string(uint8_t indice)
+{
+	const char *texto;
+	uint16_t i;
+
+	if (indice == 0) {
+		ep0_string[0] = 4;
+		ep0_string[1] = DESC_STRING;
+		ep0_string[2] = 0x09; // Ingles (EUA)
+		ep0_string[3] = 0x04;
+		return 4;
+	}
+	if (indice >= sizeof(strings) / sizeof(strings[0])) {
+		return 0;
+	}
+
+	texto = strings[indice];
+	for (i = 0; texto[i] != '\0' && 2 + 2 * (i + 1) <= CDC_EP0_TAM; i++) {
+		ep0_string[2 + 2 * i] = (uint8_t)texto[i];
+		ep0_string[3 + 2 * i] = 0;
+	}
+	ep0_string[0] = (uint8_t)(2 + 2 * i);
+	ep0_string[1] = DESC_STRING;
+	return ep0_string[0];
+}
+
+//! Zera o trafego bulk e arma os dois bancos de recepcao
+static void bulk_inicia(void)
+{
+	memset(rx_cheio, 0, sizeof(rx_cheio));
+	memset(tx_ocupado, 0, sizeof(tx_ocupado));
+	rx_proximo = 0;
+	rx_retido = false;
+	tx_proximo = 0;
+	tx_zlp = false;
+	tx_ini = tx_fim = 0;
+	usbdev_recebe(CDC_EP_OUT, 0, rx_area[0], CDC_EP_TAM);
+	usbdev_recebe(CDC_EP_OUT, 1, rx_area[1], CDC_EP_TAM);
+}
+
+//! Reset do barramento: volta ao estado default (endereco 0, nao configurado)
+void cdc_reset(void)
+{
+	estado_inicial();
+	cdc_est.resets++;
+	usbdev_recebe(0, 0, ep0_rx, CDC_EP0_TAM);
+}
+
+static bool setup_padrao(const uint8_t *p, uint16_t valor, uint16_t tam)
+{
+	static uint8_t resposta[2];
+	uint16_t n;
+
+	switch (p[1]) {
+	case REQ_GET_DESCRIPTOR:
+		switch (valor >> 8) {
+		case DESC_DEVICE:
+			ep0_responde(desc_device, sizeof(desc_device), tam);
+			return true;
+		case DESC_CONFIGURATION:
+			ep0_responde(desc_config, sizeof(desc_config), tam);
+			return true;
+		case DESC_STRING:
+			n = monta_string(valor & 0xFF);
+			if (n == 0) {
+				return false;
+			}
+			ep0_responde(ep0_string, n, tam);
+			return true;
+		}
+		return false; // Device qualifier e outros: so full-speed
+
+	case REQ_SET_ADDRESS:
+		endereco_pendente = valor & 0x7F;
+		ep0_status();
+		return true;
+
+	case REQ_SET_CONFIGURATION:
+		if (valor > 1) {
+			return false;
+		}
+		configuracao = (uint8_t)valor;
+		if (configuracao != 0) {
+			usbdev_configura();
+			bulk_inicia();
+		}
+		ep0_status();
+		return true;
+
+	case REQ_GET_CONFIGURATION:
+		resposta[0] = configuracao;
+		ep0_responde(resposta, 1, tam);
+		return true;
+
+	case REQ_GET_INTERFACE:
+		resposta[0] = 0;
+		ep0_responde(resposta, 1, tam);
+		return true;
+
+	case REQ_GET_STATUS:
+		resposta[0] = 0;
+		resposta[1] = 0;
+		ep0_responde(resposta, 2, tam);
+		return true;
+
+	case REQ_CLEAR_FEATURE:
+	case REQ_SET_FEATURE:
+	case REQ_SET_INTERFACE:
+		ep0_status();
+		return true;
+	}
+	return false;
+}
+
+static bool setup_classe(const uint8_t *p, uint16_t valor, uint16_t tam)
+{
+	static uint8_t resposta[LINHA_TAM];
+
+	switch (p[1]) {
+	case REQ_SET_LINE_CODING:
+		ep0_espera_linha = true; // Dados chegam pelo endpoint 0 OUT, ja armado
+		return true;
+
+	case REQ_GET_LINE_CODING:
+		resposta[0] = (uint8_t)cdc_linha.baud;
+		resposta[1] = (uint8_t)(cdc_linha.baud >> 8);
+		resposta[2] = (uint8_t)(cdc_linha.baud >> 16);
+		resposta[3] = (uint8_t)(cdc_linha.baud >> 24);
+		resposta[4] = cdc_linha.parada;
+		resposta[5] = cdc_linha.paridade;
+		resposta[6] = cdc_linha.bits;
+		ep0_responde(resposta, LINHA_TAM, tam);
+		return true;
+
+	case REQ_SET_CONTROL_LINE_STATE:
+		dtr = (valor & 0x01) != 0;
+		if (!dtr) {
+			tx_ini = tx_fim; // Terminal fechado: descarta o que nao saiu
+		}
+		ep0_status();
+		return true;
+
+	case REQ_SEND_BREAK:
+		ep0_status();
+		return true;
+	}
+	return false;
+}
+
+/**
+ * \brief Pacote SETUP recebido no endpoint 0
+ *
+ * \param pacote Os 8 bytes do pacote
+ */
+void cdc_setup(const uint8_t *pacote)
+{
+	uint16_t valor = (uint16_t)(pacote[2] | (pacote[3] << 8));
+	uint16_t tam = (uint16_t)(pacote[6] | (pacote[7] << 8));
+	bool aceito = false;
+
+	ep0_espera_linha = false;
+
+	// O endpoint 0 OUT fica armado para o estagio de dados OUT ou o status de uma leitura
+	usbdev_recebe(0, 0, ep0_rx, CDC_EP0_TAM);
+
+	if ((pacote[0] & TIPO_MASCARA) == TIPO_PADRAO) {
+		aceito = setup_padrao(pacote, valor, tam);
+	} else if ((pacote[0] & TIPO_MASCARA) == TIPO_CLASSE) {
+		aceito = setup_classe(pacote, valor, tam);
+	}
+
+	if (!aceito) {
+		usbdev_stall(0);
+	}
+}
+
+//! Entrega os bancos recebidos em ordem; um banco nao aceito inteiro fica retido
+static void rx_entrega(void)
+{
+	uint8_t b;
+	size_t n;
+
+	while (rx_cheio[rx_proximo]) {
+		b = rx_proximo;
+		n = cdc_recebe(rx_area[b] + rx_pos[b], rx_tam[b] - rx_pos[b]);
+		rx_pos[b] += (uint16_t)n;
+		if (rx_pos[b] < rx_tam[b]) {
+			if (!rx_retido) {
+				rx_retido = true;
+				cdc_est.retencoes++;
+			}
+			return;
+		}
+		rx_retido = false;
+		rx_cheio[b] = false;
+		rx_proximo ^= 1;
+		usbdev_recebe(CDC_EP_OUT, b, rx_area[b], CDC_EP_TAM);
+	}
+}
+
+/**
+ * \brief Transferencia OUT completa em um banco
+ *
+ * \param tam Bytes recebidos
+ */
+void cdc_out_completo(uint8_t ep, uint8_t banco, uint16_t tam)
+{
+	if (ep == 0) {
+		if (ep0_espera_linha && tam >= LINHA_TAM) {
+			cdc_linha.baud = (uint32_t)ep0_rx[0] | ((uint32_t)ep0_rx[1] << 8)
+					| ((uint32_t)ep0_rx[2] << 16) | ((uint32_t)ep0_rx[3] << 24);
+			cdc_linha.parada = ep0_rx[4];
+			cdc_linha.paridade = ep0_rx[5];
+			cdc_linha.bits = ep0_rx[6];
+			ep0_espera_linha = false;
+			ep0_status();
+		}
+		// Status de uma leitura (ZLP) ou dados: o endpoint continua armado
+		usbdev_recebe(0, 0, ep0_rx, CDC_EP0_TAM);
+		return;
+	}
+
+	if (ep != CDC_EP_OUT || configuracao == 0) {
+		return;
+	}
+	rx_tam[banco] = tam;
+	rx_pos[banco] = 0;
+	rx_cheio[banco] = true;
+	cdc_est.pacotes_rx++;
+	rx_entrega();
+}
+
+//! Tenta de novo entregar um banco retido, depois que o destino abriu espaco
+void cdc_retoma_rx(void)
+{
+	if (rx_retido) {
+		rx_entrega();
+	}
+}
+
+//! Ha um banco retido (host recebendo NAK)
+bool cdc_get_retido(void)
+{
+	return rx_retido;
+}
+
+/**
+ * \brief Transferencia IN completa em um banco
+ */
+void cdc_in_completo(uint8_t ep, uint8_t banco)
+{
+	if (ep == 0) {
+		if (endereco_pendente != 0) {
+			usbdev_endereco(endereco_pendente);
+			endereco_pendente = 0;
+		}
+		if (ep0_resta > 0 || ep0_zlp) {
+			if (ep0_resta == 0) {
+				ep0_zlp = false;
+			}
+			ep0_continua();
+		}
+		return;
+	}
+
+	if (ep == CDC_EP_IN) {
+		tx_ocupado[banco] = false;
+		cdc_descarrega();
+	}
+}
+
+//! Espaco livre no buffer de transmissao
+size_t cdc_livre(void)
+{
+	return CDC_TX_TAM - (uint16_t)(tx_fim - tx_ini);
+}
+
+/**
+ * \brief Copia bytes para o buffer de transmissao
+ *
+ * Sem terminal conectado a saida e descartada (devolve tam), para o console nunca esperar
+ * um host que nao le.
+ *
+ * \return Bytes aceitos; menos que tam se o buffer encheu
+ */
+size_t cdc_escreve(const uint8_t *dados, size_t tam)
+{
+	size_t i;
+	size_t livre;
+
+	if (!cdc_get_conectado()) {
+		return tam;
+	}
+
+	livre = cdc_livre();
+	if (tam > livre) {
+		tam = livre;
+	}
+	for (i = 0; i < tam; i++) {
+		tx_buf[(tx_fim + i) & (CDC_TX_TAM - 1)] = dados[i];
+	}
+	tx_fim += (uint16_t)tam;
+	return tam;
+}
+
+//! Arma os bancos IN livres, em ordem, com o que houver no buffer de transmissao
+void cdc_descarrega(void)
+{
+	uint16_t n, i;
+	uint8_t b;
+
+	if (configuracao == 0) {
+		return;
+	}
+
+	while (!tx_ocupado[tx_proximo]) {
+		b = tx_proximo;
+		n = (uint16_t)(tx_fim - tx_ini);
+		if (n == 0 && !tx_zlp) {
+			return;
+		}
+		if (n > CDC_EP_TAM) {
+			n = CDC_EP_TAM;
+		}
+		for (i = 0; i < n; i++) {
+			tx_area[b][i] = tx_buf[(tx_ini + i) & (CDC_TX_TAM - 1)];
+		}
+		tx_ini += n;
+		if (n == 0) {
+			cdc_est.zlps++;
+		} else {
+			cdc_est.pacotes_tx++;
+		}
+		tx_zlp = (n == CDC_EP_TAM);
+		tx_ocupado[b] = true;
+		tx_proximo ^= 1;
+		usbdev_envia(CDC_EP_IN, b, tx_area[b], n);
+	}
+}
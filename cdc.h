@@ -0,0 +1,97 @@
+/**
+ * \file
+ * \brief Classe CDC-ACM (porta serial virtual) para o console na USB nativa
+ *
+ * Implementa a enumeracao (requisicoes padrao do endpoint 0), as requisicoes da classe
+ * (line coding, DTR) e o trafego dos endpoints bulk. Os endpoints bulk usam os dois bancos
+ * do SAMD21 (ping-pong): enquanto um banco esta no barramento o firmware enche ou esvazia
+ * o outro, entao a transferencia nao para entre pacotes.
+ *
+ * Recepcao: cada pacote recebido e entregue a funcao passada em cdc_init(). O que ela nao
+ * aceitar fica no banco, que nao e rearmado: o host recebe NAK ate cdc_retoma_rx(), e o
+ * controle de fluxo e o proprio protocolo da USB (sem XON/XOFF).
+ *
+ * Transmissao: cdc_escreve() copia para um buffer circular e cdc_descarrega() arma os bancos
+ * livres com ate CDC_EP_TAM bytes. Um pacote cheio seguido de buffer vazio leva um pacote de
+ * tamanho zero, para o host entregar os dados sem esperar mais.
+ *
+ * A classe nao depende do ASF nem do hardware: chama as funcoes da camada de endpoints
+ * (usbdev_*, em usbdev.c no firmware), para que o teste do host (tools/bench_cdc.cpp) rode
+ * o mesmo codigo sobre endpoints simulados. As funcoes sao chamadas pela interrupcao da
+ * USB; fora dela, quem chama desabilita as interrupcoes.
+ */
+
+#ifndef CDC_H
+#define CDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CDC_EP0_TAM    64  // Pacote do endpoint de controle
+#define CDC_EP_TAM     64  // Pacote dos endpoints bulk (maximo em full-speed)
+#define CDC_EP_IN      1   // Bulk IN (dispositivo -> host), dois bancos
+#define CDC_EP_OUT     2   // Bulk OUT (host -> dispositivo), dois bancos
+#define CDC_EP_NOTIF   3   // Interrupt IN de notificacoes (configurado, nunca usado)
+#define CDC_TX_TAM     512 // Buffer circular de transmissao (potencia de 2)
+
+#ifndef CONF_CDC_VID
+#  define CONF_CDC_VID 0x03EB // Atmel
+#endif
+#ifndef CONF_CDC_PID
+#  define CONF_CDC_PID 0x2404 // CDC das demos do ASF
+#endif
+
+//! Entrega de bytes recebidos; devolve quantos foram aceitos (o resto espera cdc_retoma_rx())
+typedef size_t (*cdc_recebe_t)(const uint8_t *dados, size_t tam);
+
+//! Line coding (SET/GET_LINE_CODING); so informativo, a USB nao tem baud
+struct cdc_linha {
+	uint32_t baud;
+	uint8_t parada;
+	uint8_t paridade;
+	uint8_t bits;
+};
+
+//! Estatisticas do trafego
+struct cdc_estatisticas {
+	uint32_t pacotes_rx;
+	uint32_t pacotes_tx;
+	uint32_t zlps;        // Pacotes de tamanho zero depois de um pacote cheio
+	uint32_t retencoes;   // Vezes que um banco de recepcao ficou retido (host recebendo NAK)
+	uint32_t resets;      // Resets do barramento
+};
+
+void cdc_init(cdc_recebe_t recebe);
+bool cdc_get_conectado(void);
+void cdc_get_linha(struct cdc_linha *linha);
+void cdc_get_estatisticas(struct cdc_estatisticas *est);
+size_t cdc_escreve(const uint8_t *dados, size_t tam);
+size_t cdc_livre(void);
+void cdc_descarrega(void);
+void cdc_retoma_rx(void);
+bool cdc_get_retido(void);
+
+// Eventos, chamados pela camada de endpoints (interrupcao da USB)
+void cdc_reset(void);
+void cdc_setup(const uint8_t *pacote);
+void cdc_out_completo(uint8_t ep, uint8_t banco, uint16_t tam);
+void cdc_in_completo(uint8_t ep, uint8_t banco);
+
+// Camada de endpoints, implementada por usbdev.c (ou pelo teste do host). Banco 0 e banco 1
+// de um endpoint bulk sao os dois bancos do ping-pong; no endpoint 0, banco 0 e OUT e 1 e IN
+void usbdev_endereco(uint8_t endereco);
+void usbdev_configura(void);
+void usbdev_recebe(uint8_t ep, uint8_t banco, uint8_t *area, uint16_t tam);
+void usbdev_envia(uint8_t ep, uint8_t banco, const uint8_t *dados, uint16_t tam);
+void usbdev_stall(uint8_t ep);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CDC_H
@@ -0,0 +1,577 @@
+/**
+ * \file
+ * \brief Interpretacao dos comandos recebidos pela serial
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "comandos.h"
+#include "console.h"
+#include "formata.h"
+#include "barramento.h"
+
+// Interpreta o alvo dos comandos print/reset
+static enum alvo_comando InterpretaAlvo(const char *arg){
+
+	if(arg == NULL){
+		return ALVO_NENHUM;
+	}
+
+	if( strcmp(arg, "brightness") == 0 || strcmp(arg, "brilho") == 0 ){
+		return ALVO_BRILHO;
+	} else if( strcmp(arg, "freq") == 0 ){
+		return ALVO_FREQ;
+	} else if( strcmp(arg, "log") == 0 ){
+		return ALVO_LOG;
+	} else if( strcmp(arg, "mailbox") == 0 ){
+		return ALVO_MAILBOX;
+	} else if( strcmp(arg, "console") == 0 ){
+		return ALVO_CONSOLE;
+	} else if( strcmp(arg, "boot") == 0 ){
+		return ALVO_BOOT;
+	}
+
+	return ALVO_NENHUM;
+}
+
+// Interpreta a velocidade do replay ("2", "0.5", "max") em centesimos. Retorna -1 se invalida
+static int InterpretaVelocidade(const char *arg){
+
+	unsigned long inteiro, fracao = 0;
+	char *fim;
+
+	if(strcmp(arg, "max") == 0){
+		return 0;
+	}
+	inteiro = strtoul(arg, &fim, 10);
+	if(*fim == '.' && fim[1] >= '0' && fim[1] <= '9'){
+		fracao = (unsigned long)(fim[1] - '0') * 10;
+		fim += 2;
+		if(*fim >= '0' && *fim <= '9'){
+			fracao += (unsigned long)(*fim - '0');
+			fim++;
+		}
+	}
+	if(*fim != '\0' || fim == arg || inteiro > 100 || inteiro * 100 + fracao == 0){
+		return -1;
+	}
+	return (int)(inteiro * 100 + fracao);
+}
+
+// Interpreta um comando (ja em minusculas) sem executa-lo. "texto" e modificado (separacao dos argumentos)
+enum erro_comando InterpretaComando(char *texto, Comando *cmd){
+
+	char *args[4];
+	char *resto;
+	char *fim;
+
+	enum erro_comando erro;
+	uint32_t ms;
+
+	cmd->alvo = ALVO_NENHUM;
+	cmd->arg[0] = 0;
+	cmd->arg[1] = 0;
+	cmd->agenda = AGENDA_NENHUMA;
+	cmd->agenda_ms = 0;
+
+	// Set arguments (finds ' ' between command and its arguments)
+	args[0] = strtok_r(texto, " ", &resto);
+	args[1] = strtok_r(NULL, " ", &resto);
+
+	if( args[0] == NULL ){
+		return ERRO_VAZIO;
+	}
+
+	// at <ms> <comando> / every <ms> <comando>: o resto da linha e o comando agendado
+	if( strcmp(args[0], "at") == 0 || strcmp(args[0], "every") == 0 ){
+		if(args[1] == NULL){
+			return ERRO_ARGUMENTO;
+		}
+		ms = strtoul(args[1], &fim, 10);
+		if(*fim != '\0' || (ms == 0 && strcmp(args[0], "every") == 0)){
+			return ERRO_ARGUMENTO;
+		}
+		erro = InterpretaComando(resto, cmd);
+		if(erro == ERRO_VAZIO){
+			return ERRO_ARGUMENTO;
+		} else if(erro != ERRO_OK){
+			return erro;
+		}
+		// Sem agendamento aninhado nem comandos de lote
+		if(cmd->agenda != AGENDA_NENHUMA || cmd->tipo == CMD_BEGIN || cmd->tipo == CMD_COMMIT || cmd->tipo == CMD_ABORT){
+			return ERRO_ARGUMENTO;
+		}
+		cmd->agenda = (strcmp(args[0], "at") == 0) ? AGENDA_UMA_VEZ : AGENDA_PERIODICA;
+		cmd->agenda_ms = ms;
+		return ERRO_OK;
+	}
+
+	args[2] = strtok_r(NULL, " ", &resto);
+	args[3] = strtok_r(NULL, " ", &resto);
+
+	// Compare args[0] with specific command literals to determine which command it is
+	if( strcmp(args[0], "blink") == 0 || strcmp(args[0], "pisca") == 0 ){
+		cmd->tipo = CMD_PISCA;
+		if(args[1] == NULL || args[2] == NULL){
+			return ERRO_ARGUMENTO;
+		}
+		cmd->arg[0] = atoi(args[1]);
+		cmd->arg[1] = atoi(args[2]);
+		if(cmd->arg[0] <= 0 || cmd->arg[1] < 0){
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "brightness") == 0 || strcmp(args[0], "brilho") == 0 || strcmp(args[0], "brilha") == 0){
+		cmd->tipo = CMD_BRILHO;
+		if(args[1] == NULL){
+			return ERRO_ARGUMENTO;
+		}
+		// LED brightness value must be between 0 and 100
+		cmd->arg[0] = atoi(args[1]);
+		if(cmd->arg[0] > 100 || cmd->arg[0] <= 0){
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "print") == 0 || strcmp(args[0], "mostrar") == 0 ){
+		cmd->tipo = CMD_PRINT;
+		cmd->alvo = InterpretaAlvo(args[1]);
+		if(cmd->alvo == ALVO_NENHUM){
+			return ERRO_ARGUMENTO;
+		}
+		
+		// print log [last <n> | since <seq>]
+		if(cmd->alvo == ALVO_LOG && args[2] != NULL){
+			if(strcmp(args[2], "last") == 0 || strcmp(args[2], "ultimos") == 0){
+				cmd->arg[0] = LOG_CONSULTA_ULTIMOS;
+			} else if(strcmp(args[2], "since") == 0 || strcmp(args[2], "desde") == 0){
+				cmd->arg[0] = LOG_CONSULTA_DESDE;
+			} else {
+				return ERRO_ARGUMENTO;
+			}
+			if(args[3] == NULL){
+				return ERRO_ARGUMENTO;
+			}
+			cmd->arg[1] = (int) strtoul(args[3], &fim, 10);
+			if(*fim != '\0' || (cmd->arg[0] == LOG_CONSULTA_ULTIMOS && cmd->arg[1] < 0)){
+				return ERRO_ARGUMENTO;
+			}
+		}
+	}
+
+	else if( strcmp(args[0], "reset") == 0 ){
+		cmd->tipo = CMD_RESET;
+		cmd->alvo = InterpretaAlvo(args[1]);
+		if(cmd->alvo == ALVO_NENHUM || cmd->alvo == ALVO_MAILBOX || cmd->alvo == ALVO_CONSOLE || cmd->alvo == ALVO_BOOT){
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "exit") == 0 || strcmp(args[0], "sair") == 0 ){
+		cmd->tipo = CMD_SAIR;
+	}
+
+	else if( strcmp(args[0], "help") == 0 || strcmp(args[0], "ajuda") == 0 ){
+		cmd->tipo = CMD_AJUDA;
+	}
+
+	else if( strcmp(args[0], "stats") == 0 || strcmp(args[0], "estatisticas") == 0 ){
+		cmd->tipo = CMD_STATS;
+	}
+
+	else if( strcmp(args[0], "trace") == 0 ){
+		cmd->tipo = CMD_TRACE;
+		if(args[1] != NULL && strcmp(args[1], "on") == 0){
+			cmd->arg[0] = TRACE_OP_LIGA;
+		} else if(args[1] != NULL && strcmp(args[1], "off") == 0){
+			cmd->arg[0] = TRACE_OP_DESLIGA;
+		} else if(args[1] != NULL && strcmp(args[1], "dump") == 0){
+			cmd->arg[0] = TRACE_OP_DUMP;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "latency") == 0 || strcmp(args[0], "latencia") == 0 ){
+		cmd->tipo = CMD_LATENCIA;
+		if(args[1] == NULL){
+			cmd->arg[0] = 0;
+		} else if(strcmp(args[1], "reset") == 0){
+			cmd->arg[0] = 1;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "locks") == 0 || strcmp(args[0], "travas") == 0 ){
+		cmd->tipo = CMD_TRAVAS;
+		if(args[1] == NULL){
+			cmd->arg[0] = 0;
+		} else if(strcmp(args[1], "reset") == 0){
+			cmd->arg[0] = 1;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "time") == 0 || strcmp(args[0], "hora") == 0 ){
+		cmd->tipo = CMD_RELOGIO;
+		if(args[1] == NULL){
+			cmd->arg[0] = RELOGIO_OP_MOSTRA;
+		} else if(strcmp(args[1], "set") == 0 && args[2] != NULL){
+			cmd->arg[0] = RELOGIO_OP_ACERTA;
+			cmd->arg[1] = (int) strtoul(args[2], &fim, 10);
+			if(*fim != '\0'){
+				return ERRO_ARGUMENTO;
+			}
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "power") == 0 || strcmp(args[0], "energia") == 0 ){
+		cmd->tipo = CMD_ENERGIA;
+		if(args[1] == NULL){
+			cmd->arg[0] = ENERGIA_OP_RELATORIO;
+		} else if(strcmp(args[1], "standby") == 0 && args[2] != NULL && strcmp(args[2], "on") == 0){
+			cmd->arg[0] = ENERGIA_OP_STANDBY_LIGA;
+		} else if(strcmp(args[1], "standby") == 0 && args[2] != NULL && strcmp(args[2], "off") == 0){
+			cmd->arg[0] = ENERGIA_OP_STANDBY_DESLIGA;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "jobs") == 0 ){
+		cmd->tipo = CMD_JOBS;
+	}
+
+	else if( strcmp(args[0], "cancel") == 0 || strcmp(args[0], "cancela") == 0 ){
+		cmd->tipo = CMD_CANCELA;
+		if(args[1] == NULL){
+			return ERRO_ARGUMENTO;
+		}
+		cmd->arg[0] = (int) strtoul(args[1], &fim, 10);
+		if(*fim != '\0' || cmd->arg[0] <= 0){
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "record") == 0 || strcmp(args[0], "grava") == 0 ){
+		cmd->tipo = CMD_GRAVACAO;
+		if(args[1] == NULL){
+			cmd->arg[0] = GRAVACAO_OP_ESTADO;
+		} else if(strcmp(args[1], "start") == 0){
+			cmd->arg[0] = GRAVACAO_OP_INICIA;
+		} else if(strcmp(args[1], "stop") == 0){
+			cmd->arg[0] = GRAVACAO_OP_PARA;
+		} else if(strcmp(args[1], "dump") == 0){
+			cmd->arg[0] = GRAVACAO_OP_LISTA;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "replay") == 0 || strcmp(args[0], "reproduz") == 0 ){
+		cmd->tipo = CMD_REPRODUZ;
+		cmd->arg[1] = 100;
+		if(args[1] == NULL){
+			cmd->arg[0] = REPRODUZ_OP_INICIA;
+		} else if(strcmp(args[1], "stop") == 0){
+			cmd->arg[0] = REPRODUZ_OP_PARA;
+		} else {
+			cmd->arg[0] = REPRODUZ_OP_INICIA;
+			cmd->arg[1] = InterpretaVelocidade(args[1]);
+			if(cmd->arg[1] < 0){
+				return ERRO_ARGUMENTO;
+			}
+		}
+	}
+
+	else if( strcmp(args[0], "address") == 0 || strcmp(args[0], "endereco") == 0 ){
+		cmd->tipo = CMD_ENDERECO;
+		if(args[1] == NULL){
+			cmd->arg[0] = ENDERECO_OP_MOSTRA;
+		} else if(strcmp(args[1], "off") == 0){
+			cmd->arg[0] = ENDERECO_OP_DEFINE;
+			cmd->arg[1] = 0;
+		} else {
+			cmd->arg[0] = ENDERECO_OP_DEFINE;
+			cmd->arg[1] = (int) strtoul(args[1], &fim, 10);
+			if(*fim != '\0' || cmd->arg[1] < 1 || cmd->arg[1] > BARRAMENTO_ENDERECO_MAX){
+				return ERRO_ARGUMENTO;
+			}
+		}
+	}
+
+	else if( strcmp(args[0], "sync") == 0 || strcmp(args[0], "sincronia") == 0 ){
+		cmd->tipo = CMD_SINCRONIA;
+		if(args[1] == NULL){
+			cmd->arg[0] = SINCRONIA_OP_MOSTRA;
+		} else if(strcmp(args[1], "off") == 0){
+			cmd->arg[0] = SINCRONIA_OP_DESLIGA;
+		} else {
+			cmd->arg[0] = SINCRONIA_OP_QUADRO;
+			cmd->arg[1] = (int) strtoul(args[1], &fim, 10);
+			if(*fim != '\0'){
+				return ERRO_ARGUMENTO;
+			}
+		}
+	}
+
+	else if( strcmp(args[0], "begin") == 0 ){
+		cmd->tipo = CMD_BEGIN;
+	}
+
+	else if( strcmp(args[0], "commit") == 0 ){
+		cmd->tipo = CMD_COMMIT;
+	}
+
+	else if( strcmp(args[0], "abort") == 0 ){
+		cmd->tipo = CMD_ABORT;
+	}
+
+	else if( strcmp(args[0], "ack") == 0 || strcmp(args[0], "logbin") == 0 ){
+		cmd->tipo = (strcmp(args[0], "ack") == 0) ? CMD_ACK : CMD_LOGBIN;
+		if(args[1] != NULL && strcmp(args[1], "on") == 0){
+			cmd->arg[0] = 1;
+		} else if(args[1] != NULL && strcmp(args[1], "off") == 0){
+			cmd->arg[0] = 0;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else if( strcmp(args[0], "flow") == 0 || strcmp(args[0], "fluxo") == 0 ){
+		cmd->tipo = CMD_FLUXO;
+		if(args[1] == NULL){
+			return ERRO_ARGUMENTO;
+		} else if( strcmp(args[1], "none") == 0 || strcmp(args[1], "nenhum") == 0 ){
+			cmd->arg[0] = CONSOLE_FLUXO_NENHUM;
+		} else if( strcmp(args[1], "xonxoff") == 0 ){
+			cmd->arg[0] = CONSOLE_FLUXO_XONXOFF;
+		} else if( strcmp(args[1], "rtscts") == 0 ){
+			cmd->arg[0] = CONSOLE_FLUXO_RTSCTS;
+		} else {
+			return ERRO_ARGUMENTO;
+		}
+	}
+
+	else {
+		return ERRO_DESCONHECIDO;
+	}
+
+	return ERRO_OK;
+}
+
+// Gera o texto canonico de um comando, usado no log
+void FormataComando(const Comando *cmd, char *texto, int tam){
+
+	static const char *alvos[] = { "", "brilho", "freq", "log", "mailbox", "console", "boot" };
+	static const char *fluxos[] = { "none", "xonxoff", "rtscts" };
+	static const char *operacoes[] = { "off", "on", "dump" };
+	static const char *energias[] = { "power", "power standby off", "power standby on" };
+	static const char *gravacoes[] = { "record", "record start", "record stop", "record dump" };
+	Comando simples;
+	int n;
+
+	// Comando agendado: prefixo at/every seguido do proprio comando
+	if(cmd->agenda != AGENDA_NENHUMA){
+		n = formata_snprintf(texto, tam, "%s %lu ", (cmd->agenda == AGENDA_UMA_VEZ) ? "at" : "every", (unsigned long) cmd->agenda_ms);
+		if(n < tam){
+			simples = *cmd;
+			simples.agenda = AGENDA_NENHUMA;
+			FormataComando(&simples, texto + n, tam - n);
+		}
+		return;
+	}
+
+	switch(cmd->tipo){
+	case CMD_PISCA:
+		formata_snprintf(texto, tam, "pisca %d %d", cmd->arg[0], cmd->arg[1]);
+		break;
+	case CMD_BRILHO:
+		formata_snprintf(texto, tam, "brilho %d", cmd->arg[0]);
+		break;
+	case CMD_PRINT:
+		if(cmd->alvo == ALVO_LOG && cmd->arg[0] != LOG_CONSULTA_TUDO){
+			formata_snprintf(texto, tam, "print log %s %u", (cmd->arg[0] == LOG_CONSULTA_ULTIMOS) ? "last" : "since", (unsigned int) cmd->arg[1]);
+		} else {
+			formata_snprintf(texto, tam, "print %s", alvos[cmd->alvo]);
+		}
+		break;
+	case CMD_RESET:
+		formata_snprintf(texto, tam, "reset %s", alvos[cmd->alvo]);
+		break;
+	case CMD_SAIR:
+		formata_snprintf(texto, tam, "sair");
+		break;
+	case CMD_AJUDA:
+		formata_snprintf(texto, tam, "ajuda");
+		break;
+	case CMD_STATS:
+		formata_snprintf(texto, tam, "stats");
+		break;
+	case CMD_TRACE:
+		formata_snprintf(texto, tam, "trace %s", operacoes[cmd->arg[0]]);
+		break;
+	case CMD_LATENCIA:
+		formata_snprintf(texto, tam, cmd->arg[0] ? "latency reset" : "latency");
+		break;
+	case CMD_TRAVAS:
+		formata_snprintf(texto, tam, cmd->arg[0] ? "locks reset" : "locks");
+		break;
+	case CMD_RELOGIO:
+		if(cmd->arg[0] == RELOGIO_OP_ACERTA){
+			formata_snprintf(texto, tam, "time set %lu", (unsigned long)(uint32_t) cmd->arg[1]);
+		} else {
+			formata_snprintf(texto, tam, "time");
+		}
+		break;
+	case CMD_ENERGIA:
+		formata_snprintf(texto, tam, "%s", energias[cmd->arg[0]]);
+		break;
+	case CMD_JOBS:
+		formata_snprintf(texto, tam, "jobs");
+		break;
+	case CMD_CANCELA:
+		formata_snprintf(texto, tam, "cancel %d", cmd->arg[0]);
+		break;
+	case CMD_ENDERECO:
+		if(cmd->arg[0] == ENDERECO_OP_MOSTRA){
+			formata_snprintf(texto, tam, "address");
+		} else if(cmd->arg[1] == 0){
+			formata_snprintf(texto, tam, "address off");
+		} else {
+			formata_snprintf(texto, tam, "address %d", cmd->arg[1]);
+		}
+		break;
+	case CMD_SINCRONIA:
+		if(cmd->arg[0] == SINCRONIA_OP_QUADRO){
+			formata_snprintf(texto, tam, "sync %lu", (unsigned long)(uint32_t) cmd->arg[1]);
+		} else {
+			formata_snprintf(texto, tam, (cmd->arg[0] == SINCRONIA_OP_DESLIGA) ? "sync off" : "sync");
+		}
+		break;
+	case CMD_GRAVACAO:
+		formata_snprintf(texto, tam, "%s", gravacoes[cmd->arg[0]]);
+		break;
+	case CMD_REPRODUZ:
+		if(cmd->arg[0] == REPRODUZ_OP_PARA){
+			formata_snprintf(texto, tam, "replay stop");
+		} else if(cmd->arg[1] == 0){
+			formata_snprintf(texto, tam, "replay max");
+		} else {
+			// formata_snprintf nao tem largura: o zero da casa dos decimos vai no texto
+			formata_snprintf(texto, tam, (cmd->arg[1] % 100 < 10) ? "replay %d.0%d" : "replay %d.%d", cmd->arg[1] / 100, cmd->arg[1] % 100);
+		}
+		break;
+	case CMD_BEGIN:
+		formata_snprintf(texto, tam, "begin");
+		break;
+	case CMD_COMMIT:
+		formata_snprintf(texto, tam, "commit");
+		break;
+	case CMD_ABORT:
+		formata_snprintf(texto, tam, "abort");
+		break;
+	case CMD_ACK:
+		formata_snprintf(texto, tam, "ack %s", cmd->arg[0] ? "on" : "off");
+		break;
+	case CMD_LOGBIN:
+		formata_snprintf(texto, tam, "logbin %s", cmd->arg[0] ? "on" : "off");
+		break;
+	case CMD_FLUXO:
+		formata_snprintf(texto, tam, "flow %s", fluxos[cmd->arg[0]]);
+		break;
+	default:
+		formata_snprintf(texto, tam, "?");
+		break;
+	}
+}
+
+// Escreve um varint (7 bits por byte, o bit 7 indica que ha mais bytes); retorna os bytes usados
+static int CodificaVarint(uint32_t valor, uint8_t *dados){
+
+	int n = 0;
+
+	while(valor >= 0x80){
+		dados[n++] = (uint8_t)(valor | 0x80);
+		valor >>= 7;
+	}
+	dados[n++] = (uint8_t) valor;
+	return n;
+}
+
+// Le um varint de no maximo 5 bytes; retorna os bytes lidos ou 0 se o varint nao termina em "tam"
+static int DecodificaVarint(const uint8_t *dados, int tam, uint32_t *valor){
+
+	int n;
+
+	*valor = 0;
+	for(n = 0 ; n < tam && n < 5 ; n++){
+		*valor |= (uint32_t)(dados[n] & 0x7F) << (7 * n);
+		if((dados[n] & 0x80) == 0){
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+// Codifica um comando para o log. Campos nulos no fim nao sao gravados, entao "brilho 50"
+// ocupa 1 byte de opcode, 1 de argumento e 1 a 3 de tempo. Retorna os bytes escritos
+int CodificaComando(const Comando *cmd, uint32_t tempo, int absoluto, uint8_t *dados){
+
+	uint32_t campos[3];
+	int qtd, i, n;
+
+	campos[0] = (uint32_t) cmd->arg[0];
+	campos[1] = (uint32_t) cmd->arg[1];
+	campos[2] = (uint32_t) cmd->alvo;
+	for(qtd = 3 ; qtd > 0 && campos[qtd - 1] == 0 ; qtd--);
+
+	dados[0] = (uint8_t)(cmd->tipo | (qtd << 5) | (absoluto ? COMANDO_COD_ABSOLUTO : 0));
+	n = 1 + CodificaVarint(tempo, &dados[1]);
+	for(i = 0 ; i < qtd ; i++){
+		n += CodificaVarint(campos[i], &dados[n]);
+	}
+	return n;
+}
+
+// Decodifica um registro do log. Retorna os bytes lidos, ou 0 no fim dos registros ou se os dados
+// estao incompletos ou invalidos
+int DecodificaComando(const uint8_t *dados, int tam, Comando *cmd, uint32_t *tempo, int *absoluto){
+
+	uint32_t campos[3] = { 0, 0, 0 };
+	int qtd, i, n, lidos;
+
+	if(tam < 2 || dados[0] == COMANDO_COD_FIM || (dados[0] & 0x1F) >= NUM_CMD){
+		return 0;
+	}
+	qtd = (dados[0] >> 5) & 0x03;
+	*absoluto = (dados[0] & COMANDO_COD_ABSOLUTO) != 0;
+
+	n = 1;
+	lidos = DecodificaVarint(&dados[n], tam - n, tempo);
+	for(i = 0 ; i < qtd && lidos != 0 ; i++){
+		n += lidos;
+		lidos = DecodificaVarint(&dados[n], tam - n, &campos[i]);
+	}
+	if(lidos == 0){
+		return 0;
+	}
+	n += lidos;
+	if(campos[2] >= NUM_ALVOS){
+		return 0;
+	}
+
+	cmd->tipo = (enum tipo_comando)(dados[0] & 0x1F);
+	cmd->arg[0] = (int) campos[0];
+	cmd->arg[1] = (int) campos[1];
+	cmd->alvo = (enum alvo_comando) campos[2];
+	cmd->agenda = AGENDA_NENHUMA; // So comandos executados vao para o log
+	cmd->agenda_ms = 0;
+	return n;
+}
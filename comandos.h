@@ -0,0 +1,155 @@
+/**
+ * \file
+ * \brief Interpretacao dos comandos recebidos pela serial
+ *
+ * Separa a interpretacao (texto -> \ref Comando) da execucao, feita em main.c, para que
+ * lotes de comandos (begin ... commit) possam ser validados por inteiro antes de alterar o LED.
+ */
+
+#ifndef COMANDOS_H
+#define COMANDOS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMANDO_TAM 55 // Tamanho maximo de uma linha de comando
+
+// Comandos reconhecidos
+enum tipo_comando {
+	CMD_PISCA,
+	CMD_BRILHO,
+	CMD_PRINT,
+	CMD_RESET,
+	CMD_SAIR,
+	CMD_AJUDA,
+	CMD_BEGIN,
+	CMD_COMMIT,
+	CMD_ABORT,
+	CMD_ACK,
+	CMD_FLUXO,
+	CMD_LOGBIN,
+	CMD_STATS,
+	CMD_TRACE,
+	CMD_LATENCIA,
+	CMD_ENERGIA,
+	CMD_TRAVAS,
+	CMD_RELOGIO,
+	CMD_JOBS,
+	CMD_CANCELA,
+	CMD_GRAVACAO,
+	CMD_REPRODUZ,
+	CMD_ENDERECO,
+	CMD_SINCRONIA,
+	NUM_CMD // Ate 31: o tipo ocupa 5 bits na codificacao do log
+};
+
+// Argumento do comando trace
+enum op_trace {
+	TRACE_OP_DESLIGA,
+	TRACE_OP_LIGA,
+	TRACE_OP_DUMP,
+};
+
+// Argumento do comando power
+enum op_energia {
+	ENERGIA_OP_RELATORIO,
+	ENERGIA_OP_STANDBY_DESLIGA,
+	ENERGIA_OP_STANDBY_LIGA,
+};
+
+// Argumento do comando time (arg[1] e a hora Unix do "time set")
+enum op_relogio {
+	RELOGIO_OP_MOSTRA,
+	RELOGIO_OP_ACERTA,
+};
+
+// Argumento do comando record
+enum op_gravacao {
+	GRAVACAO_OP_ESTADO,
+	GRAVACAO_OP_INICIA,
+	GRAVACAO_OP_PARA,
+	GRAVACAO_OP_LISTA,  // record dump
+};
+
+// Argumento do comando replay (arg[1] e a velocidade em centesimos; 0 sem esperas)
+enum op_reproduz {
+	REPRODUZ_OP_INICIA,
+	REPRODUZ_OP_PARA,
+};
+
+// Argumento do comando address (arg[1] e o endereco; 0 desliga o enderecamento)
+enum op_endereco {
+	ENDERECO_OP_MOSTRA,
+	ENDERECO_OP_DEFINE,
+};
+
+// Argumento do comando sync (arg[1] e o tempo do mestre em ms)
+enum op_sincronia {
+	SINCRONIA_OP_MOSTRA,
+	SINCRONIA_OP_QUADRO,
+	SINCRONIA_OP_DESLIGA,
+};
+
+// Consulta do "print log" (arg[0]); arg[1] e a quantidade ou a sequencia
+enum consulta_log {
+	LOG_CONSULTA_TUDO,
+	LOG_CONSULTA_ULTIMOS, // print log last <n>
+	LOG_CONSULTA_DESDE,   // print log since <seq>
+};
+
+// Alvos dos comandos print/reset
+enum alvo_comando {
+	ALVO_NENHUM,
+	ALVO_BRILHO,
+	ALVO_FREQ,
+	ALVO_LOG,
+	ALVO_MAILBOX,
+	ALVO_CONSOLE,
+	ALVO_BOOT,
+	NUM_ALVOS
+};
+
+// Prefixo at/every: o comando e agendado em vez de executado (agenda.h)
+enum agenda_comando {
+	AGENDA_NENHUMA,
+	AGENDA_UMA_VEZ,   // at <ms> <comando>
+	AGENDA_PERIODICA, // every <ms> <comando>
+};
+
+// Resultado da interpretacao de um comando
+enum erro_comando {
+	ERRO_OK = 0,
+	ERRO_VAZIO,        // Nenhum comando no texto
+	ERRO_DESCONHECIDO, // Comando nao reconhecido
+	ERRO_ARGUMENTO,    // Argumento ausente ou fora da faixa
+	ERRO_LOTE,         // Commit sem begin, ou lote descartado por conter comando invalido
+};
+
+// Comando ja interpretado, pronto para ser executado
+typedef struct {
+	enum tipo_comando tipo;
+	enum alvo_comando alvo;
+	int arg[2];
+	uint8_t agenda;     // enum agenda_comando; nao vai para o log
+	uint32_t agenda_ms; // Atraso ou periodo do at/every
+} Comando;
+
+// Codificacao binaria de um comando no log: opcode (tipo, quantidade de campos e marca de tempo absoluto)
+// seguido de varints com o tempo e os campos arg[0], arg[1] e alvo
+#define COMANDO_COD_MAX      21   // 1 byte de opcode + 4 varints de ate 5 bytes
+#define COMANDO_COD_FIM      0xFF // Opcode invalido que marca o fim dos registros de uma pagina
+#define COMANDO_COD_ABSOLUTO 0x80 // O tempo e a hora em segundos; sem a marca, sao ms desde o registro anterior
+
+enum erro_comando InterpretaComando(char *texto, Comando *cmd);
+void FormataComando(const Comando *cmd, char *texto, int tam);
+int CodificaComando(const Comando *cmd, uint32_t tempo, int absoluto, uint8_t *dados);
+int DecodificaComando(const uint8_t *dados, int tam, Comando *cmd, uint32_t *tempo, int *absoluto);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMANDOS_H
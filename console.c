@@ -0,0 +1,654 @@
+/**
+ * \file
+ * \brief Console serial com recepcao por interrupcao e controle de fluxo
+ */
+
+#include <asf.h>
+#include <stdarg.h>
+#include <string.h>
+#include "console.h"
+#include "logbin.h"
+#include "trace.h"
+#include "formata.h"
+#include "barramento.h"
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+#include "cdc.h"
+#include "usbdev.h"
+#endif
+
+//! Buffer de recepcao, escrito pela interrupcao e lido por console_getc()
+static StreamBufferHandle_t console_rx;
+static StaticStreamBuffer_t console_rx_buffer;
+static uint8_t console_rx_area[CONSOLE_RX_TAM + 1]; // O stream buffer usa um byte a mais que a capacidade
+
+//! Modulo da USART do console
+static SercomUsart *console_hw;
+
+//! Modo de controle de fluxo atual
+static volatile int console_fluxo = CONF_CONSOLE_FLUXO;
+
+//! Sinaliza que o host foi pausado e ainda nao foi liberado
+static volatile bool console_rx_pausado;
+
+//! Sinaliza que o host pediu pausa na transmissao (XOFF recebido)
+static volatile bool console_tx_pausado;
+
+//! Dado pela interrupcao ao receber XON: a tarefa pausada espera nele em vez de girar com o mutex
+static SemaphoreHandle_t console_xon;
+static StaticSemaphore_t console_xon_buffer;
+
+//! XON/XOFF a enviar pela interrupcao de DRE, na frente da saida normal (0: nenhum)
+static volatile uint8_t console_controle;
+
+//! Tarefa cuja saida e descartada (linha do barramento que este no nao responde), ou NULL
+static volatile TaskHandle_t console_mudo;
+
+//! Sinaliza que ja houve perda de bytes desde o ultimo byte guardado
+static bool console_perdendo;
+
+static struct console_estatisticas console_est;
+
+//! Filtro de enderecos do barramento, aplicado pela interrupcao (endereco 0: tudo passa)
+static struct barramento_filtro console_filtro;
+
+//! Garante que cada mensagem saia inteira, sem depender do mutex da aplicacao
+static SemaphoreHandle_t console_tx_mutex;
+static StaticSemaphore_t console_tx_mutex_buffer;
+
+static void console_rx_handler(uint8_t instance);
+static void console_de_liga(void);
+static void console_de_desliga(void);
+static void console_rx_trata(void);
+static int console_putchar(void volatile *usart, char c);
+static void console_getchar(void volatile *usart, char *c);
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+static size_t console_usb_recebe(const uint8_t *dados, size_t tam);
+#endif
+
+/**
+ * \brief Escreve um byte na USART
+ *
+ * A verificacao de DRE e a escrita sao feitas sem interrupcoes, para que um XON/XOFF
+ * enviado pela interrupcao de recepcao nao se perca entre as duas.
+ */
+static void console_envia_byte(uint8_t c)
+{
+	bool enviado = false;
+
+	while (!enviado) {
+		system_interrupt_enter_critical_section();
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+		// Buffer cheio: arma os bancos livres e espera a interrupcao da USB esvazia-lo
+		enviado = (cdc_escreve(&c, 1) == 1);
+		if (!enviado || c == '\n') {
+			cdc_descarrega();
+		}
+#else
+		// XON/XOFF pendente sai primeiro
+		if ((console_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_DRE) && console_controle != 0) {
+			console_hw->DATA.reg = console_controle;
+			console_controle = 0;
+			console_hw->INTENCLR.reg = SERCOM_USART_INTFLAG_DRE;
+		}
+		if (console_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_DRE) {
+			console_hw->DATA.reg = c;
+			enviado = true;
+		}
+#endif
+		system_interrupt_leave_critical_section();
+	}
+}
+
+//! Fim de uma mensagem: na USB, manda o pacote incompleto sem esperar encher
+static void console_descarrega(void)
+{
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	system_interrupt_enter_critical_section();
+	cdc_descarrega();
+	system_interrupt_leave_critical_section();
+#endif
+}
+
+/**
+ * \brief Deixa um XON/XOFF para a interrupcao de DRE (chamar com interrupcoes desabilitadas)
+ *
+ * O byte sai assim que o registrador de dados esvaziar, sem esperar na interrupcao de
+ * recepcao nem na tarefa. Um XON pedido antes do XOFF pendente sair o substitui.
+ */
+static void console_envia_controle(uint8_t c)
+{
+	console_controle = c;
+	console_hw->INTENSET.reg = SERCOM_USART_INTFLAG_DRE;
+}
+
+//! Pausa o host (chamar com interrupcoes desabilitadas ou na interrupcao)
+static void console_pausa_host(void)
+{
+	if (console_rx_pausado) {
+		return;
+	}
+
+	if (console_fluxo == CONSOLE_FLUXO_XONXOFF) {
+		console_envia_controle(CONSOLE_XOFF);
+#ifdef CONF_CONSOLE_RTS_PIN
+	} else if (console_fluxo == CONSOLE_FLUXO_RTSCTS) {
+		port_pin_set_output_level(CONF_CONSOLE_RTS_PIN, true);
+#endif
+	} else {
+		return;
+	}
+
+	console_rx_pausado = true;
+	console_est.pausas++;
+}
+
+//! Libera o host pausado (chamar com interrupcoes desabilitadas)
+static void console_libera_host(void)
+{
+	if (!console_rx_pausado) {
+		return;
+	}
+
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	// Na USB a pausa e o banco OUT retido (NAK): a entrega retomada pode pausar de novo
+	console_rx_pausado = false;
+	cdc_retoma_rx();
+#else
+	if (console_fluxo == CONSOLE_FLUXO_XONXOFF) {
+		console_envia_controle(CONSOLE_XON);
+#ifdef CONF_CONSOLE_RTS_PIN
+	} else if (console_fluxo == CONSOLE_FLUXO_RTSCTS) {
+		port_pin_set_output_level(CONF_CONSOLE_RTS_PIN, false);
+#endif
+	}
+
+	console_rx_pausado = false;
+#endif
+}
+
+/**
+ * \brief Inicializa a recepcao por interrupcao do console
+ *
+ * Deve ser chamada depois de usart_init(). A saida do firmware usa console_printf() e
+ * console_puts(); o getchar()/putchar() do stdio tambem sao redirecionados para o buffer de
+ * recepcao e para o envio com controle de fluxo, caso algum codigo ainda os use.
+ *
+ * Com o console na USB (CONSOLE_BACKEND_USB) a USART nao e usada: a USB nativa e ligada aqui.
+ *
+ * \param usart Instancia da USART ja configurada para o console (NULL na USB)
+ */
+void console_init(struct usart_module *const usart)
+{
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USART
+	uint8_t instance_index;
+#endif
+#if defined(CONF_CONSOLE_RTS_PIN) || defined(CONF_CONSOLE_DE_PIN)
+	struct port_config config_pin;
+#endif
+
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	// A USB tem controle de fluxo proprio; XON/XOFF e RTS/CTS nao se aplicam
+	console_fluxo = CONSOLE_FLUXO_NENHUM;
+#endif
+
+#ifdef CONF_CONSOLE_RTS_PIN
+	port_get_config_defaults(&config_pin);
+	config_pin.direction = PORT_PIN_DIR_OUTPUT;
+	port_pin_set_config(CONF_CONSOLE_RTS_PIN, &config_pin);
+	port_pin_set_output_level(CONF_CONSOLE_RTS_PIN, false);
+
+	config_pin.direction = PORT_PIN_DIR_INPUT;
+	config_pin.input_pull = PORT_PIN_PULL_UP;
+	port_pin_set_config(CONF_CONSOLE_CTS_PIN, &config_pin);
+#else
+	if (console_fluxo == CONSOLE_FLUXO_RTSCTS) {
+		console_fluxo = CONSOLE_FLUXO_NENHUM;
+	}
+#endif
+#ifdef CONF_CONSOLE_DE_PIN
+	// Transceptor half-duplex comeca recebendo
+	port_get_config_defaults(&config_pin);
+	config_pin.direction = PORT_PIN_DIR_OUTPUT;
+	port_pin_set_config(CONF_CONSOLE_DE_PIN, &config_pin);
+	port_pin_set_output_level(CONF_CONSOLE_DE_PIN, false);
+#endif
+
+	barramento_filtro_init(&console_filtro, 0);
+
+	console_rx = xStreamBufferCreateStatic(CONSOLE_RX_TAM, 1, console_rx_area, &console_rx_buffer);
+	console_tx_mutex = xSemaphoreCreateMutexStatic(&console_tx_mutex_buffer);
+	console_xon = xSemaphoreCreateBinaryStatic(&console_xon_buffer);
+
+	// Redireciona o stdio
+	ptr_put = console_putchar;
+	ptr_get = console_getchar;
+
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	cdc_init(console_usb_recebe);
+	usbdev_init();
+#else
+	console_hw = &(usart->hw->USART);
+
+	// Injeta o tratador de interrupcao e habilita a interrupcao de recepcao
+	instance_index = _sercom_get_sercom_inst_index(usart->hw);
+	_sercom_set_handler(instance_index, console_rx_handler);
+	console_hw->INTENSET.reg = SERCOM_USART_INTFLAG_RXC;
+	system_interrupt_enable(_sercom_get_interrupt_vector(usart->hw));
+#endif
+}
+
+/**
+ * \brief Troca o modo de controle de fluxo
+ *
+ * \retval true  modo alterado
+ * \retval false modo indisponivel (RTS/CTS sem pinos definidos)
+ */
+bool console_set_fluxo(int modo)
+{
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	if (modo != CONSOLE_FLUXO_NENHUM) {
+		return false;
+	}
+#endif
+#ifndef CONF_CONSOLE_RTS_PIN
+	if (modo == CONSOLE_FLUXO_RTSCTS) {
+		return false;
+	}
+#endif
+
+	// Libera o host no modo antigo antes de trocar
+	system_interrupt_enter_critical_section();
+	console_libera_host();
+	console_tx_pausado = false;
+	console_fluxo = modo;
+	system_interrupt_leave_critical_section();
+	xSemaphoreGive(console_xon);
+
+	return true;
+}
+
+int console_get_fluxo(void)
+{
+	return console_fluxo;
+}
+
+/**
+ * \brief Liga o enderecamento do barramento
+ *
+ * Em barramento o host nao pode ser pausado nem receber eco: o controle de fluxo e
+ * desligado. A linha sendo recebida no momento da troca e descartada.
+ *
+ * \param endereco Endereco do no (1 a BARRAMENTO_ENDERECO_MAX), ou 0 para o console comum
+ */
+void console_set_endereco(uint8_t endereco)
+{
+	uint32_t aceitos, descartados;
+
+	if (endereco != 0) {
+		console_set_fluxo(CONSOLE_FLUXO_NENHUM);
+	}
+
+	system_interrupt_enter_critical_section();
+	aceitos = console_filtro.aceitos;
+	descartados = console_filtro.descartados;
+	barramento_filtro_init(&console_filtro, endereco);
+	console_filtro.aceitos = aceitos;
+	console_filtro.descartados = descartados;
+	system_interrupt_leave_critical_section();
+}
+
+uint8_t console_get_endereco(void)
+{
+	return console_filtro.endereco;
+}
+
+/**
+ * \brief Descarta (true) ou volta a enviar a saida da tarefa que chama
+ *
+ * So a saida dessa tarefa e descartada: a resposta de um no a uma difusao sai por outra tarefa,
+ * na janela dele, enquanto a que executa os comandos continua muda. Uma tarefa muda por vez.
+ */
+void console_set_mudo(bool mudo)
+{
+	console_mudo = mudo ? xTaskGetCurrentTaskHandle() : NULL;
+}
+
+//! Saida da tarefa atual descartada por console_set_mudo()
+static bool console_calado(void)
+{
+	TaskHandle_t mudo = console_mudo;
+
+	return mudo != NULL && mudo == xTaskGetCurrentTaskHandle();
+}
+
+void console_get_estatisticas(struct console_estatisticas *est)
+{
+	system_interrupt_enter_critical_section();
+	*est = console_est;
+	est->quadros_aceitos = console_filtro.aceitos;
+	est->quadros_descartados = console_filtro.descartados;
+	system_interrupt_leave_critical_section();
+}
+
+//! Assume o barramento antes de transmitir (chamar com o mutex de transmissao)
+static void console_de_liga(void)
+{
+#ifdef CONF_CONSOLE_DE_PIN
+	if (console_filtro.endereco != 0) {
+		console_hw->INTFLAG.reg = SERCOM_USART_INTFLAG_TXC;
+		port_pin_set_output_level(CONF_CONSOLE_DE_PIN, true);
+	}
+#endif
+}
+
+//! Solta o barramento quando o ultimo bit sai do registrador de deslocamento
+static void console_de_desliga(void)
+{
+#ifdef CONF_CONSOLE_DE_PIN
+	if (console_filtro.endereco != 0) {
+		while (!(console_hw->INTFLAG.reg & SERCOM_USART_INTFLAG_TXC)) {
+		}
+		port_pin_set_output_level(CONF_CONSOLE_DE_PIN, false);
+	}
+#endif
+}
+
+/**
+ * \brief Espera o host liberar a transmissao (XON ou CTS)
+ *
+ * A tarefa fica bloqueada, sem girar com o mutex de transmissao, e desiste depois de
+ * CONF_CONSOLE_PAUSA_MAX_MS: um host que sumiu pausado nao prende o console para sempre.
+ * Antes do escalonador nao ha como esperar e a pausa e ignorada.
+ */
+static void console_espera_host(void)
+{
+	TickType_t inicio;
+	TickType_t limite = pdMS_TO_TICKS(CONF_CONSOLE_PAUSA_MAX_MS);
+
+	// XOFF recebido do host: o XON chega pela interrupcao de recepcao
+	if (console_fluxo == CONSOLE_FLUXO_XONXOFF && console_tx_pausado
+			&& xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		inicio = xTaskGetTickCount();
+		while (console_fluxo == CONSOLE_FLUXO_XONXOFF && console_tx_pausado) {
+			if (xSemaphoreTake(console_xon, limite) == pdFALSE
+					|| xTaskGetTickCount() - inicio >= limite) {
+				console_tx_pausado = false;
+				console_est.pausas_expiradas++;
+				break;
+			}
+		}
+	}
+
+#ifdef CONF_CONSOLE_CTS_PIN
+	// CTS desativado (nivel alto) pelo host: o pino nao interrompe, entao e lido a cada tick
+	if (console_fluxo == CONSOLE_FLUXO_RTSCTS && port_pin_get_input_level(CONF_CONSOLE_CTS_PIN)
+			&& xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) {
+		inicio = xTaskGetTickCount();
+		while (console_fluxo == CONSOLE_FLUXO_RTSCTS
+				&& port_pin_get_input_level(CONF_CONSOLE_CTS_PIN)) {
+			if (xTaskGetTickCount() - inicio >= limite) {
+				console_est.pausas_expiradas++;
+				break;
+			}
+			vTaskDelay(1);
+		}
+	}
+#endif
+}
+
+//! Envio de um caractere pelo stdio, respeitando pausas pedidas pelo host
+static int console_putchar(void volatile *usart, char c)
+{
+	console_espera_host();
+	console_envia_byte((uint8_t)c);
+
+	return 1;
+}
+
+//! Antes do escalonador so existe um fluxo de execucao e o mutex nao e necessario
+//! (xTaskGetSchedulerState exige INCLUDE_xTaskGetSchedulerState ou configUSE_TIMERS)
+static bool console_trava(void)
+{
+	if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+		return false;
+	}
+	xSemaphoreTake(console_tx_mutex, portMAX_DELAY);
+	return true;
+}
+
+static void console_destrava(bool travado)
+{
+	if (travado) {
+		xSemaphoreGive(console_tx_mutex);
+	}
+}
+
+static void console_emite(void *contexto, const char *texto, size_t tam)
+{
+	while (tam--) {
+		console_putchar(NULL, *texto++);
+	}
+}
+
+//! Envia um bloco de bytes sem ser intercalado com a saida de outras tarefas
+void console_escreve(const void *dados, size_t tam)
+{
+	const char *p = dados;
+	bool travado;
+
+	if (console_calado()) {
+		return;
+	}
+	travado = console_trava();
+	console_de_liga();
+	while (tam--) {
+		console_putchar(NULL, *p++);
+	}
+	console_descarrega();
+	console_de_desliga();
+	console_destrava(travado);
+}
+
+//! Envia um texto constante, sem passar pelo formatador (nao acrescenta '\\n')
+void console_puts(const char *texto)
+{
+	console_escreve(texto, strlen(texto));
+}
+
+void console_putc(char c)
+{
+	console_escreve(&c, 1);
+}
+
+//! Texto formatado, com as conversoes aceitas por formata_v()
+int console_printf(const char *formato, ...)
+{
+	va_list args;
+	int qtd;
+	bool travado;
+
+	if (console_calado()) {
+		return 0;
+	}
+	travado = console_trava();
+	console_de_liga();
+	va_start(args, formato);
+	qtd = formata_v(console_emite, NULL, formato, args);
+	va_end(args);
+	console_descarrega();
+	console_de_desliga();
+
+	console_destrava(travado);
+	return qtd;
+}
+
+//! Le um caractere do console, bloqueando a tarefa ate haver dados
+char console_getc(void)
+{
+	char c;
+
+	console_getchar(NULL, &c);
+	return c;
+}
+
+//! Recepcao de um caractere pelo stdio: bloqueia a tarefa ate haver dados no buffer
+static void console_getchar(void volatile *usart, char *c)
+{
+	xStreamBufferReceive(console_rx, c, 1, portMAX_DELAY);
+
+	// Buffer drenado ate a marca baixa: libera o host
+	if (console_rx_pausado
+			&& xStreamBufferBytesAvailable(console_rx) <= CONSOLE_RX_MARCA_BAIXA) {
+		system_interrupt_enter_critical_section();
+		console_libera_host();
+		system_interrupt_leave_critical_section();
+	}
+}
+
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+/**
+ * \internal
+ * \brief Bytes de um pacote recebido pela USB (chamada pela interrupcao da USB)
+ *
+ * Passa cada byte pelo filtro do barramento para o buffer de recepcao, como a interrupcao
+ * da USART. Com o buffer cheio para no meio do pacote: o resto fica no banco, o host recebe
+ * NAK e console_getchar() retoma a entrega ao drenar o buffer ate a marca baixa.
+ *
+ * \return Bytes consumidos do pacote
+ */
+static size_t console_usb_recebe(const uint8_t *dados, size_t tam)
+{
+	size_t i;
+	size_t ocupacao;
+	uint8_t data;
+	BaseType_t acordou_tarefa = pdFALSE;
+
+	for (i = 0; i < tam; i++) {
+		if (xStreamBufferSpacesAvailable(console_rx) == 0) {
+			if (!console_rx_pausado) {
+				console_rx_pausado = true;
+				console_est.pausas++;
+			}
+			break;
+		}
+		if (!barramento_filtra(&console_filtro, dados[i], &data)) {
+			continue;
+		}
+		xStreamBufferSendFromISR(console_rx, &data, 1, &acordou_tarefa);
+		console_est.recebidos++;
+	}
+
+	ocupacao = xStreamBufferBytesAvailable(console_rx);
+	if (ocupacao > console_est.ocupacao_max) {
+		console_est.ocupacao_max = ocupacao;
+	}
+
+	portYIELD_FROM_ISR(acordou_tarefa);
+	return i;
+}
+#endif
+
+/**
+ * \internal
+ * \brief Tratador de interrupcao da USART do console
+ *
+ * Baseado no \ref cdc_rx_handler() da demo: trata a recepcao, guardando o byte no
+ * buffer de recepcao e pausando o host quando a ocupacao chega a marca alta, e o envio
+ * do XON/XOFF pendente quando o registrador de dados esvazia.
+ *
+ * \param instance Instancia do SERCOM que gerou a interrupcao
+ */
+static void console_rx_handler(uint8_t instance)
+{
+	TRACE_ISR_ENTRA_EM(TRACE_ISR_CONSOLE);
+	console_rx_trata();
+	TRACE_ISR_SAI_DE(TRACE_ISR_CONSOLE);
+}
+
+//! Corpo do tratador de interrupcao, separado para que toda saida passe pelo trace
+static void console_rx_trata(void)
+{
+	uint16_t interrupt_status;
+	uint8_t error_code;
+	uint8_t data;
+	size_t ocupacao;
+	BaseType_t acordou_tarefa = pdFALSE;
+
+	// Wait for synch to complete
+#if defined(FEATURE_SERCOM_SYNCBUSY_SCHEME_VERSION_1)
+	while (console_hw->STATUS.reg & SERCOM_USART_STATUS_SYNCBUSY) {
+	}
+#elif defined(FEATURE_SERCOM_SYNCBUSY_SCHEME_VERSION_2)
+	while (console_hw->SYNCBUSY.reg) {
+	}
+#endif
+
+	interrupt_status = console_hw->INTFLAG.reg;
+
+	// XON/XOFF pendente: sai aqui, sem a recepcao ou a tarefa esperarem pelo DRE
+	if ((interrupt_status & SERCOM_USART_INTFLAG_DRE)
+			&& (console_hw->INTENSET.reg & SERCOM_USART_INTFLAG_DRE)) {
+		if (console_controle != 0) {
+			console_hw->DATA.reg = console_controle;
+			console_controle = 0;
+		}
+		console_hw->INTENCLR.reg = SERCOM_USART_INTFLAG_DRE;
+	}
+
+	if (!(interrupt_status & SERCOM_USART_INTFLAG_RXC)) {
+		return;
+	}
+
+	error_code = (uint8_t)(console_hw->STATUS.reg & SERCOM_USART_STATUS_MASK);
+	data = (uint8_t)(console_hw->DATA.reg & SERCOM_USART_DATA_MASK);
+
+	if (error_code) {
+		console_hw->STATUS.reg = SERCOM_USART_STATUS_FERR | SERCOM_USART_STATUS_BUFOVF;
+		if (error_code & SERCOM_USART_STATUS_BUFOVF) {
+			console_est.overflows++;
+			LOGBIN1_ISR(LOG_CONSOLE_OVERFLOW, console_est.overflows);
+		}
+		// Com erro de quadro o byte nao e valido
+		if (error_code & SERCOM_USART_STATUS_FERR) {
+			return;
+		}
+	}
+
+	// XON/XOFF vindos do host controlam a nossa transmissao e nao sao guardados
+	if (console_fluxo == CONSOLE_FLUXO_XONXOFF
+			&& (data == CONSOLE_XON || data == CONSOLE_XOFF)) {
+		console_tx_pausado = (data == CONSOLE_XOFF);
+		if (data == CONSOLE_XON) {
+			xSemaphoreGiveFromISR(console_xon, &acordou_tarefa);
+			portYIELD_FROM_ISR(acordou_tarefa);
+		}
+		return;
+	}
+
+	// Linhas de outros nos do barramento param aqui, sem ocupar o buffer nem acordar tarefas
+	if (!barramento_filtra(&console_filtro, data, &data)) {
+		return;
+	}
+
+	if (xStreamBufferSendFromISR(console_rx, &data, 1, &acordou_tarefa) == 1) {
+		console_est.recebidos++;
+		console_perdendo = false;
+	} else {
+		// Registra so a primeira perda de cada rajada
+		if (!console_perdendo) {
+			LOGBIN1_ISR(LOG_CONSOLE_PERDIDO, console_est.perdidos + 1);
+			console_perdendo = true;
+		}
+		console_est.perdidos++;
+	}
+
+	ocupacao = xStreamBufferBytesAvailable(console_rx);
+	if (ocupacao > console_est.ocupacao_max) {
+		console_est.ocupacao_max = ocupacao;
+	}
+	if (ocupacao >= CONSOLE_RX_MARCA_ALTA) {
+		console_pausa_host();
+	}
+
+	portYIELD_FROM_ISR(acordou_tarefa);
+}
@@ -0,0 +1,89 @@
+/**
+ * \file
+ * \brief Console serial com recepcao por interrupcao e controle de fluxo
+ *
+ * Os caracteres recebidos pela USART do console sao guardados por interrupcao em um
+ * stream buffer, lido por console_getc(). Quando o buffer passa da marca alta o host
+ * e pausado (XOFF ou RTS desativado) e so e liberado quando o buffer volta a marca baixa.
+ *
+ * O console pode usar, em vez da USART ligada a porta virtual do EDBG, a USB nativa do SAMD21
+ * como porta serial CDC-ACM (CONF_CONSOLE_BACKEND, cdc.h): a mesma interface de linhas, a
+ * 12 Mbit/s, com o controle de fluxo feito pela propria USB (NAK enquanto o buffer esta cheio).
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct usart_module;
+
+// Meio fisico do console, escolhido na compilacao
+#define CONSOLE_BACKEND_USART  0 // USART do EDBG (9600 baud)
+#define CONSOLE_BACKEND_USB    1 // USB nativa, CDC-ACM full-speed (conector "TARGET USB")
+
+#ifndef CONF_CONSOLE_BACKEND
+#  define CONF_CONSOLE_BACKEND CONSOLE_BACKEND_USART
+#endif
+
+// Modos de controle de fluxo
+#define CONSOLE_FLUXO_NENHUM   0
+#define CONSOLE_FLUXO_XONXOFF  1
+#define CONSOLE_FLUXO_RTSCTS   2
+
+// Modo usado na inicializacao
+#ifndef CONF_CONSOLE_FLUXO
+#  define CONF_CONSOLE_FLUXO   CONSOLE_FLUXO_XONXOFF
+#endif
+
+// Pinos de RTS (saida) e CTS (entrada) para controle de fluxo por hardware. A porta virtual do
+// EDBG nao tem esses sinais, entao RTS/CTS so fica disponivel se os pinos forem definidos
+//#define CONF_CONSOLE_RTS_PIN  PIN_PA20
+//#define CONF_CONSOLE_CTS_PIN  PIN_PA21
+
+// Saida de habilitacao do driver (DE) de um transceptor RS-485 half-duplex. So e acionada com
+// um endereco de no definido (barramento.h): em nivel alto enquanto o console transmite
+//#define CONF_CONSOLE_DE_PIN   PIN_PA22
+
+// Tempo maximo que uma tarefa espera o host liberar a transmissao (XON ou CTS) antes de seguir
+#ifndef CONF_CONSOLE_PAUSA_MAX_MS
+#  define CONF_CONSOLE_PAUSA_MAX_MS 2000
+#endif
+
+#define CONSOLE_RX_TAM         256 // Tamanho do buffer de recepcao
+#define CONSOLE_RX_MARCA_ALTA  192 // Pausa o host a partir desta ocupacao
+#define CONSOLE_RX_MARCA_BAIXA 64  // Libera o host quando a ocupacao cai ate aqui
+
+#define CONSOLE_XON  0x11
+#define CONSOLE_XOFF 0x13
+
+// Estatisticas da recepcao
+struct console_estatisticas {
+	uint32_t recebidos;   // Bytes guardados no buffer
+	uint32_t perdidos;    // Bytes descartados por buffer cheio
+	uint32_t overflows;   // Overflows da USART (interrupcao atendida tarde demais)
+	uint32_t pausas;      // Vezes que o host foi pausado (na USB: recepcao retida com NAK)
+	uint32_t pausas_expiradas; // Pausas pedidas pelo host (XOFF ou CTS) abandonadas por tempo
+	uint16_t ocupacao_max; // Maior ocupacao do buffer
+	uint32_t quadros_aceitos;     // Linhas para este no no barramento
+	uint32_t quadros_descartados; // Linhas para outros nos, descartadas na interrupcao
+};
+
+void console_init(struct usart_module *const usart);
+bool console_set_fluxo(int modo);
+int console_get_fluxo(void);
+void console_set_endereco(uint8_t endereco);
+uint8_t console_get_endereco(void);
+void console_set_mudo(bool mudo);
+void console_get_estatisticas(struct console_estatisticas *est);
+
+// Saida e entrada de texto, seguras entre tarefas (cada chamada sai inteira)
+int console_printf(const char *formato, ...) __attribute__((format(printf, 1, 2)));
+void console_puts(const char *texto);
+void console_putc(char c);
+void console_escreve(const void *dados, size_t tam);
+char console_getc(void);
+
+#endif // CONSOLE_H
@@ -32,8 +32,10 @@
  */
 
 #include <asf.h>
+#include <limits.h>
 #include <conf_demo.h>
 #include "demotasks.h"
+#include "glifo.h"
 
 /**
  * \addtogroup freertos_sam0_demo_tasks_group
@@ -48,7 +50,6 @@
 #define UART_TASK_DELAY         (10 / portTICK_RATE_MS)
 
 #define MAIN_TASK_PRIORITY      (tskIDLE_PRIORITY + 2)
-#define MAIN_TASK_DELAY         (100 / portTICK_RATE_MS)
 
 #define GRAPH_TASK_PRIORITY     (tskIDLE_PRIORITY + 1)
 #define GRAPH_TASK_DELAY        (50 / portTICK_RATE_MS)
@@ -62,6 +63,73 @@
 //@}
 
 
+//! \name Button configuration
+//@{
+
+/**
+ * \brief Time a button must be stable before its state is accepted
+ *
+ * Every edge on a button restarts the debounce timer, so a bouncing contact
+ * is only sampled once it has been quiet for this long.
+ */
+#define BUTTON_DEBOUNCE_DELAY   (20 / portTICK_RATE_MS)
+
+/*
+ * External interrupt lines of the OLED1 Xplained Pro buttons (pins 9, 3 and 4
+ * of the extension header), picked from OLED1_EXT_HEADER so the buttons follow
+ * the display. The table is for the SAM D21 Xplained Pro; for another board
+ * define all of them in conf_demo.h.
+ */
+#define OLED1_HEADER_EXT1 1
+#define OLED1_HEADER_EXT2 2
+#define OLED1_HEADER_EXT3 3
+#define OLED1_HEADER_NUM_(header) OLED1_HEADER_##header
+#define OLED1_HEADER_NUM(header)  OLED1_HEADER_NUM_(header)
+
+#ifndef OLED1_BUTTON1_EIC_PIN
+#  if OLED1_HEADER_NUM(OLED1_EXT_HEADER) == 1
+#    define OLED1_BUTTON1_EIC_PIN   PIN_PB04A_EIC_EXTINT4
+#    define OLED1_BUTTON1_EIC_MUX   MUX_PB04A_EIC_EXTINT4
+#    define OLED1_BUTTON1_EIC_LINE  4
+#    define OLED1_BUTTON2_EIC_PIN   PIN_PB00A_EIC_EXTINT0
+#    define OLED1_BUTTON2_EIC_MUX   MUX_PB00A_EIC_EXTINT0
+#    define OLED1_BUTTON2_EIC_LINE  0
+#    define OLED1_BUTTON3_EIC_PIN   PIN_PB01A_EIC_EXTINT1
+#    define OLED1_BUTTON3_EIC_MUX   MUX_PB01A_EIC_EXTINT1
+#    define OLED1_BUTTON3_EIC_LINE  1
+#  elif OLED1_HEADER_NUM(OLED1_EXT_HEADER) == 2
+#    define OLED1_BUTTON1_EIC_PIN   PIN_PB14A_EIC_EXTINT14
+#    define OLED1_BUTTON1_EIC_MUX   MUX_PB14A_EIC_EXTINT14
+#    define OLED1_BUTTON1_EIC_LINE  14
+#    define OLED1_BUTTON2_EIC_PIN   PIN_PA10A_EIC_EXTINT10
+#    define OLED1_BUTTON2_EIC_MUX   MUX_PA10A_EIC_EXTINT10
+#    define OLED1_BUTTON2_EIC_LINE  10
+#    define OLED1_BUTTON3_EIC_PIN   PIN_PA11A_EIC_EXTINT11
+#    define OLED1_BUTTON3_EIC_MUX   MUX_PA11A_EIC_EXTINT11
+#    define OLED1_BUTTON3_EIC_LINE  11
+#  elif OLED1_HEADER_NUM(OLED1_EXT_HEADER) == 3
+#    define OLED1_BUTTON1_EIC_PIN   PIN_PA28A_EIC_EXTINT8
+#    define OLED1_BUTTON1_EIC_MUX   MUX_PA28A_EIC_EXTINT8
+#    define OLED1_BUTTON1_EIC_LINE  8
+#    define OLED1_BUTTON2_EIC_PIN   PIN_PA02A_EIC_EXTINT2
+#    define OLED1_BUTTON2_EIC_MUX   MUX_PA02A_EIC_EXTINT2
+#    define OLED1_BUTTON2_EIC_LINE  2
+#    define OLED1_BUTTON3_EIC_PIN   PIN_PA03A_EIC_EXTINT3
+#    define OLED1_BUTTON3_EIC_MUX   MUX_PA03A_EIC_EXTINT3
+#    define OLED1_BUTTON3_EIC_LINE  3
+#  else
+#    error "No button table for OLED1_EXT_HEADER: define OLED1_BUTTON1..3_EIC_PIN/_MUX/_LINE in conf_demo.h"
+#  endif
+#endif
+
+//! Notification bit sent to the main task for a press of each button
+#define BUTTON1_PRESSED  (1UL << 0)
+#define BUTTON2_PRESSED  (1UL << 1)
+#define BUTTON3_PRESSED  (1UL << 2)
+
+//@}
+
+
 //! \name Menu and display configuration
 //@{
 
@@ -103,6 +171,20 @@ enum menu_items {
 //! Character columns in terminal buffer
 #define TERMINAL_BUFFER_COLUMNS  (1 + TERMINAL_COLUMNS)
 
+//! Steps of the zooming animation on the about screen
+#define ABOUT_MAX_SHIFT  8
+
+//! Character lines of the about text
+#define ABOUT_LINES  \
+	((sizeof(about_text) - 1 + TERMINAL_COLUMNS - 1) / TERMINAL_COLUMNS)
+
+//! Pixel lines per display page
+#define PAGE_HEIGHT  8
+
+#if (SYSFONT_HEIGHT + 1) != PAGE_HEIGHT
+#  error "Terminal lines must be exactly one display page high"
+#endif
+
 //@}
 
 
@@ -135,6 +217,15 @@ static struct usart_module cdc_usart;
 //! Pseudo-random noise for graph task
 static uint8_t graph_noise = 128;
 
+//! System font rotated into display page format, for \ref glifo.h
+static uint8_t text_font_columns[GLIFO_TAM_FONTE(SYSFONT_WIDTH,
+		SYSFONT_FIRSTCHAR, SYSFONT_LASTCHAR)];
+static struct glifo_fonte text_font;
+
+//! Character positions of the about text for each step of the animation
+static gfx_coord_t about_x[ABOUT_MAX_SHIFT + 1][TERMINAL_COLUMNS];
+static gfx_coord_t about_y[ABOUT_MAX_SHIFT + 1][ABOUT_LINES];
+
 //! Buffer for terminal text
 static uint8_t terminal_buffer[TERMINAL_BUFFER_LINES][TERMINAL_BUFFER_COLUMNS];
 
@@ -156,6 +247,15 @@ static xTaskHandle terminal_task_handle;
 //! Handle for about screen task
 static xTaskHandle about_task_handle;
 
+//! Handle for main task, notified of button presses
+static xTaskHandle main_task_handle;
+
+//! One-shot timer that samples the buttons once they stop bouncing
+static TimerHandle_t button_debounce_timer;
+
+//! Buttons seen pressed at the last stable sample
+static uint32_t button_state;
+
 //@}
 
 
@@ -173,6 +273,18 @@ static void uart_task(void *params);
 //! Interrupt handler for reception from EDBG Virtual COM Port
 static void cdc_rx_handler(uint8_t instance);
 
+//! Draw one character at any pixel position, as \ref gfx_mono_draw_char()
+static void text_draw_char(char c, gfx_coord_t x, gfx_coord_t y);
+
+//! \name Button input
+//@{
+
+static void button_init(void);
+static void button_edge_handler(void);
+static void button_debounce_callback(TimerHandle_t timer);
+
+//@}
+
 
 /**
  * \brief Initialize tasks and resources for demo
@@ -189,9 +301,16 @@ void demotasks_init(void)
 	// Configure SERCOM USART for reception from EDBG Virtual COM Port
 	cdc_rx_init(&cdc_usart, &cdc_rx_handler);
 
+	// Rotate the font once, so text is drawn a byte per glyph column
+	glifo_rotaciona(&text_font, text_font_columns, sysfont.data.progmem,
+			sysfont.width, sysfont.height, sysfont.first_char,
+			sysfont.last_char);
+
 	display_mutex  = xSemaphoreCreateMutex();
 	terminal_mutex = xSemaphoreCreateMutex();
 	terminal_in_queue = xQueueCreate(64, sizeof(uint8_t));
+	button_debounce_timer = xTimerCreate((const char *)"Debounce",
+			BUTTON_DEBOUNCE_DELAY, pdFALSE, NULL, button_debounce_callback);
 
 	xTaskCreate(about_task,
 			(const char *)"About",
@@ -212,7 +331,7 @@ void demotasks_init(void)
 			configMINIMAL_STACK_SIZE,
 			NULL,
 			MAIN_TASK_PRIORITY,
-			NULL);
+			&main_task_handle);
 
 	xTaskCreate(terminal_task,
 			(const char *)"Term.",
@@ -231,6 +350,94 @@ void demotasks_init(void)
 	// Suspend these since the main task will control their execution
 	vTaskSuspend(about_task_handle);
 	vTaskSuspend(terminal_task_handle);
+
+	// Buttons are enabled last, since their interrupts notify the main task
+	button_init();
+}
+
+
+/**
+ * \brief Enable interrupts on both edges of the OLED1 buttons
+ *
+ * The buttons are active low with internal pull-ups. The interrupts only
+ * restart the debounce timer; the state is read when the timer expires.
+ */
+static void button_init(void)
+{
+	static const struct {
+		uint32_t pin;
+		uint32_t mux;
+		uint8_t line;
+	} buttons[] = {
+		{ OLED1_BUTTON1_EIC_PIN, OLED1_BUTTON1_EIC_MUX, OLED1_BUTTON1_EIC_LINE },
+		{ OLED1_BUTTON2_EIC_PIN, OLED1_BUTTON2_EIC_MUX, OLED1_BUTTON2_EIC_LINE },
+		{ OLED1_BUTTON3_EIC_PIN, OLED1_BUTTON3_EIC_MUX, OLED1_BUTTON3_EIC_LINE },
+	};
+	struct extint_chan_conf config_extint;
+	uint8_t i;
+
+	extint_chan_get_config_defaults(&config_extint);
+	config_extint.gpio_pin_pull = EXTINT_PULL_UP;
+	config_extint.detection_criteria = EXTINT_DETECT_BOTH;
+
+	for (i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+		config_extint.gpio_pin = buttons[i].pin;
+		config_extint.gpio_pin_mux = buttons[i].mux;
+		extint_chan_set_config(buttons[i].line, &config_extint);
+		extint_register_callback(button_edge_handler, buttons[i].line,
+				EXTINT_CALLBACK_TYPE_DETECT);
+		extint_chan_enable_callback(buttons[i].line,
+				EXTINT_CALLBACK_TYPE_DETECT);
+	}
+}
+
+
+/**
+ * \internal
+ * \brief Edge on any of the buttons
+ *
+ * Restarts the debounce timer, so the buttons are sampled only after the
+ * contacts have been quiet for \ref BUTTON_DEBOUNCE_DELAY.
+ */
+static void button_edge_handler(void)
+{
+	BaseType_t higher_priority_task_woken = pdFALSE;
+
+	xTimerResetFromISR(button_debounce_timer, &higher_priority_task_woken);
+	portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+
+/**
+ * \internal
+ * \brief Debounce timer expired: sample the buttons
+ *
+ * Notifies the main task of each button that went from released to pressed
+ * since the last stable sample. Releases are only recorded.
+ *
+ * \param timer Handle of the debounce timer. (Not used.)
+ */
+static void button_debounce_callback(TimerHandle_t timer)
+{
+	uint32_t state = 0;
+	uint32_t pressed;
+
+	if (oled1_get_button_state(&oled1, OLED1_BUTTON1_ID)) {
+		state |= BUTTON1_PRESSED;
+	}
+	if (oled1_get_button_state(&oled1, OLED1_BUTTON2_ID)) {
+		state |= BUTTON2_PRESSED;
+	}
+	if (oled1_get_button_state(&oled1, OLED1_BUTTON3_ID)) {
+		state |= BUTTON3_PRESSED;
+	}
+
+	pressed = state & ~button_state;
+	button_state = state;
+
+	if (pressed) {
+		xTaskNotify(main_task_handle, pressed, eSetBits);
+	}
 }
 
 
@@ -246,6 +453,9 @@ void demotasks_init(void)
  * - \ref terminal_task() "term."
  * - \ref about_task() "about"
  *
+ * The task blocks until the debounce timer notifies it of a button press,
+ * so it does not wake up at all while the buttons are idle.
+ *
  * \param params Parameters for the task. (Not used.)
  */
 static void main_task(void *params)
@@ -256,25 +466,32 @@ static void main_task(void *params)
 	enum menu_items current_selection = MENU_ITEM_GRAPH;
 	gfx_coord_t x, y, display_y_offset;
 	xTaskHandle temp_task_handle = NULL;
+	uint32_t pressed = 0;
 
 	for(;;) {
+		// Wait for button presses, except for the initial draw
+		if (!selection_changed) {
+			xTaskNotifyWait(0, ULONG_MAX, &pressed, portMAX_DELAY);
+		}
+
 		// Show that task is executing
 		oled1_set_led_state(&oled1, OLED1_LED3_ID, true);
 
 		// Check buttons to see if user changed the selection
-		if (oled1_get_button_state(&oled1, OLED1_BUTTON1_ID)
+		if ((pressed & BUTTON1_PRESSED)
 					&& (current_selection != MENU_ITEM_GRAPH)) {
 			current_selection = MENU_ITEM_GRAPH;
 			selection_changed = true;
-		} else if (oled1_get_button_state(&oled1, OLED1_BUTTON2_ID)
+		} else if ((pressed & BUTTON2_PRESSED)
 					&& (current_selection != MENU_ITEM_TERMINAL)) {
 			current_selection = MENU_ITEM_TERMINAL;
 			selection_changed = true;
-		} else if (oled1_get_button_state(&oled1, OLED1_BUTTON3_ID)
+		} else if ((pressed & BUTTON3_PRESSED)
 					&& (current_selection != MENU_ITEM_ABOUT)) {
 			current_selection = MENU_ITEM_ABOUT;
 			selection_changed = true;
 		}
+		pressed = 0;
 
 		// If selection changed, handle the selection
 		if (selection_changed) {
@@ -361,8 +578,6 @@ static void main_task(void *params)
 
 		// Show that task is done
 		oled1_set_led_state(&oled1, OLED1_LED3_ID, false);
-
-		vTaskDelay(MAIN_TASK_DELAY);
 	}
 }
 
@@ -423,18 +638,56 @@ static void graph_task(void *params)
 }
 
 
+/**
+ * \brief Draw one character at any pixel position
+ *
+ * The glyph is merged into the one or two display pages it covers and each
+ * page is written back as a single run of bytes, instead of pixel by pixel.
+ * The character cell is opaque, like with \ref gfx_mono_draw_char().
+ *
+ * \param c Character to draw.
+ * \param x Column of the left edge.
+ * \param y Pixel line of the top edge.
+ */
+static void text_draw_char(char c, gfx_coord_t x, gfx_coord_t y)
+{
+	uint8_t upper[SYSFONT_WIDTH];
+	uint8_t lower[SYSFONT_WIDTH];
+	gfx_coord_t page = y / PAGE_HEIGHT;
+	uint8_t offset = y % PAGE_HEIGHT;
+	bool two_pages = (offset + SYSFONT_HEIGHT) > PAGE_HEIGHT;
+	uint8_t i;
+
+	for (i = 0; i < SYSFONT_WIDTH; i++) {
+		upper[i] = gfx_mono_get_byte(page, x + i);
+		if (two_pages) {
+			lower[i] = gfx_mono_get_byte(page + 1, x + i);
+		}
+	}
+
+	glifo_desenha(&text_font, c, offset, upper, lower);
+
+	gfx_mono_put_page(upper, page, x, SYSFONT_WIDTH);
+	if (two_pages) {
+		gfx_mono_put_page(lower, page + 1, x, SYSFONT_WIDTH);
+	}
+}
+
+
 /**
  * \brief Terminal task
  *
  * This task prints the terminal text buffer to the display.
  *
+ * Each terminal line is exactly one display page, so a whole line is
+ * rendered into a page buffer and written to the display in one go.
+ *
  * \param params Parameters for the task. (Not used.)
  */
 static void terminal_task(void *params)
 {
-	gfx_coord_t x, y;
-	char current_char;
-	uint8_t current_column;
+	uint8_t page_buffer[CANVAS_WIDTH];
+	gfx_coord_t x, page;
 	uint8_t current_line;
 	uint8_t printed_lines;
 
@@ -445,34 +698,23 @@ static void terminal_task(void *params)
 		xSemaphoreTake(display_mutex, portMAX_DELAY);
 		xSemaphoreTake(terminal_mutex, portMAX_DELAY);
 
-		y = (TERMINAL_LINES - 1) * (SYSFONT_HEIGHT + 1);
+		page = TERMINAL_LINES - 1;
 		current_line = terminal_line_offset;
 
 		for (printed_lines = 0; printed_lines < TERMINAL_LINES; printed_lines++)
 				{
-			x = 0;
-			current_column = 0;
-
-			// Print characters of string until zero terminator is encountered
-			current_char = terminal_buffer[current_line][current_column];
-			while (current_char != '\0') {
-				gfx_mono_draw_char(current_char, x, y, &sysfont);
-
-				// Move to next character on display and in buffer
-				x += SYSFONT_WIDTH;
-				current_column++;
-				current_char = terminal_buffer[current_line][current_column];
+			// Keep the pixel line below the text, which may hold the menu
+			for (x = 0; x < CANVAS_WIDTH; x++) {
+				page_buffer[x] = gfx_mono_get_byte(page, x);
 			}
 
-			// Erase remaining part of line on display
-			if (current_column < TERMINAL_COLUMNS) {
-				gfx_mono_draw_filled_rect(x, y,
-						CANVAS_WIDTH - (current_column * SYSFONT_WIDTH),
-						SYSFONT_HEIGHT, GFX_PIXEL_CLR);
-			}
+			// Print the string and erase the remaining part of the line
+			glifo_linha(&text_font, (const char *)terminal_buffer[current_line],
+					page_buffer, CANVAS_WIDTH);
+			gfx_mono_put_page(page_buffer, page, 0, CANVAS_WIDTH);
 
 			// Move to previous line on display and in buffer
-			y -= 1 + SYSFONT_HEIGHT;
+			page--;
 			current_line += TERMINAL_BUFFER_LINES - 1;
 			current_line %= TERMINAL_BUFFER_LINES;
 		}
@@ -493,15 +735,29 @@ static void terminal_task(void *params)
  * This task prints a short text about the demo, with a simple zooming
  * animation.
  *
+ * The character positions of every animation step are computed once, when
+ * the task starts, so each frame only looks them up.
+ *
  * \param params Parameters for the task. (Not used.)
  */
 static void about_task(void *params)
 {
-	char c;
-	gfx_coord_t x, y;
-	uint8_t i, shift;
+	uint8_t i, column, line, shift;
+
+	const uint8_t max_shift = ABOUT_MAX_SHIFT;
 
-	const uint8_t max_shift = 8;
+	for (shift = 0; shift <= max_shift; shift++) {
+		for (column = 0; column < TERMINAL_COLUMNS; column++) {
+			about_x[shift][column] = ((column * SYSFONT_WIDTH) * shift
+					+ (CANVAS_WIDTH / 2) * (max_shift - shift))
+					/ max_shift;
+		}
+		for (line = 0; line < ABOUT_LINES; line++) {
+			about_y[shift][line] = ((line * SYSFONT_HEIGHT) * shift
+					+ (CANVAS_HEIGHT / 2) * (max_shift - shift))
+					/ max_shift;
+		}
+	}
 	shift = 1;
 
 	for (;;) {
@@ -510,15 +766,15 @@ static void about_task(void *params)
 		xSemaphoreTake(display_mutex, portMAX_DELAY);
 
 		// Print the about text in an expanding area
+		column = 0;
+		line = 0;
 		for (i = 0; i < (sizeof(about_text) - 1); i++) {
-			c = about_text[i];
-			x = (((i % TERMINAL_COLUMNS) * SYSFONT_WIDTH) * shift
-					+ (CANVAS_WIDTH / 2) * (max_shift - shift))
-					/ max_shift;
-			y = (((i / TERMINAL_COLUMNS) * SYSFONT_HEIGHT) * shift
-					+ (CANVAS_HEIGHT / 2) * (max_shift - shift))
-					/ max_shift;
-			gfx_mono_draw_char(c, x, y, &sysfont);
+			text_draw_char(about_text[i], about_x[shift][column],
+					about_y[shift][line]);
+			if (++column == TERMINAL_COLUMNS) {
+				column = 0;
+				line++;
+			}
 		}
 
 		xSemaphoreGive(display_mutex);
@@ -0,0 +1,217 @@
+/**
+ * \file
+ * \brief Sono entre comandos (tickless idle) com o RTC e modo standby opcional
+ */
+
+#include <asf.h>
+#include "energia.h"
+#include "console.h"
+
+//! Menor distancia da comparacao ao contador: mais perto, a escrita sincronizada pode chegar tarde
+#define ENERGIA_MIN_CONTAGENS 4
+
+//! RTC livre em 32 bits, base de tempo durante o sono
+static struct rtc_module energia_rtc;
+
+//! Dorme em standby em vez de idle (opcional, comando "power standby on")
+static volatile bool energia_standby;
+
+//! Vezes que o nucleo acordou de um sono
+static volatile uint32_t energia_acordadas;
+
+//! Contagens do RTC passadas dormindo
+static volatile uint32_t energia_sono;
+
+/**
+ * Contagens do RTC ainda nao convertidas em ticks, multiplicadas por configTICK_RATE_HZ para a
+ * conversao ser exata (um tick vale exatamente ENERGIA_RTC_HZ nessa escala). Fica abaixo de
+ * (CONF_ENERGIA_MAX_TICKS + 2) ticks, cerca de 2 x 10^9, e cabe em 32 bits.
+ */
+static uint32_t energia_resto;
+
+//! Valores no ultimo relatorio, para calcular as taxas do intervalo
+static uint32_t energia_ult_rtc;
+static uint32_t energia_ult_acordadas;
+static uint32_t energia_ult_sono;
+
+//! Voltas do contador do RTC (uma a cada ~36 horas), parte alta de energia_get_rtc64
+static volatile uint32_t energia_voltas;
+
+//! A comparacao so serve para acordar o nucleo; o tempo e medido lendo o contador
+static void energia_rtc_callback(void)
+{
+}
+
+static void energia_rtc_overflow(void)
+{
+	energia_voltas++;
+}
+
+/**
+ * \brief Inicia o RTC livre e a interrupcao de comparacao usada para acordar
+ */
+void energia_init(void)
+{
+	struct rtc_count_config config_rtc;
+
+	rtc_count_get_config_defaults(&config_rtc);
+	config_rtc.prescaler           = RTC_COUNT_PRESCALER_DIV_1;
+	config_rtc.mode                = RTC_COUNT_MODE_32BIT;
+	config_rtc.clear_on_match      = false;
+	config_rtc.continuously_update = true;
+	rtc_count_init(&energia_rtc, RTC, &config_rtc);
+
+	rtc_count_register_callback(&energia_rtc, energia_rtc_callback,
+			RTC_COUNT_CALLBACK_COMPARE_0);
+	rtc_count_enable_callback(&energia_rtc, RTC_COUNT_CALLBACK_COMPARE_0);
+	rtc_count_register_callback(&energia_rtc, energia_rtc_overflow,
+			RTC_COUNT_CALLBACK_OVERFLOW);
+	rtc_count_enable_callback(&energia_rtc, RTC_COUNT_CALLBACK_OVERFLOW);
+	rtc_count_enable(&energia_rtc);
+}
+
+//! Contador do RTC (32,768 kHz, nao para em standby)
+uint32_t energia_get_rtc(void)
+{
+	return rtc_count_get_count(&energia_rtc);
+}
+
+/**
+ * \brief Contador do RTC estendido para 64 bits com as voltas contadas na interrupcao
+ *
+ * Le de novo se a volta mudou durante a leitura. Uma volta ainda nao atendida (interrupcoes
+ * desligadas, ou leitura feita em outra interrupcao) e contada pelo flag de overflow, se a
+ * contagem lida ja e da volta nova; assim a funcao serve tambem em secoes criticas e ISRs.
+ */
+uint64_t energia_get_rtc64(void)
+{
+	uint32_t voltas, lidas, contagem;
+
+	do {
+		lidas = energia_voltas;
+		contagem = rtc_count_get_count(&energia_rtc);
+		voltas = lidas;
+		if ((energia_rtc.hw->MODE0.INTFLAG.reg & RTC_MODE0_INTFLAG_OVF) && contagem < 0x80000000UL) {
+			voltas++;
+		}
+	} while (lidas != energia_voltas);
+
+	return ((uint64_t)voltas << 32) | contagem;
+}
+
+void energia_set_standby(bool standby)
+{
+	energia_standby = standby;
+}
+
+bool energia_get_standby(void)
+{
+	return energia_standby;
+}
+
+/**
+ * \brief Suprime o tick e dorme ate o proximo timeout ou ate uma interrupcao
+ *
+ * Chamada pelo kernel na tarefa IDLE (portSUPPRESS_TICKS_AND_SLEEP), com o escalonador suspenso.
+ *
+ * \param esperado Ticks ate a proxima tarefa com timeout
+ */
+void energia_dorme(uint32_t esperado)
+{
+	uint32_t inicio, decorrido, ticks, alvo, contagens;
+	uint32_t carga, atual;
+
+	if (esperado > CONF_ENERGIA_MAX_TICKS) {
+		esperado = CONF_ENERGIA_MAX_TICKS;
+	}
+
+	// Para o SysTick e guarda quanto do tick atual ja passou
+	carga = SysTick->LOAD;
+	SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+	atual = SysTick->VAL;
+
+	__disable_irq();
+	__DSB();
+	__ISB();
+
+	// Uma tarefa ficou pronta entre a decisao do kernel e aqui: nao dorme
+	if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+		SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+		__enable_irq();
+		return;
+	}
+
+	energia_resto += (uint32_t)(((uint64_t)(carga - atual) * ENERGIA_RTC_HZ) / (carga + 1));
+
+	// Acorda quando o resto somado ao sono completar os ticks esperados (arredondado para cima)
+	alvo = esperado * ENERGIA_RTC_HZ;
+	contagens = ENERGIA_MIN_CONTAGENS;
+	if (energia_resto + ENERGIA_MIN_CONTAGENS * configTICK_RATE_HZ < alvo) {
+		contagens = (alvo - energia_resto + configTICK_RATE_HZ - 1) / configTICK_RATE_HZ;
+	}
+	inicio = rtc_count_get_count(&energia_rtc);
+	rtc_count_set_compare(&energia_rtc, inicio + contagens, RTC_COUNT_COMPARE_0);
+
+	system_set_sleepmode(energia_standby ? SYSTEM_SLEEPMODE_STANDBY : SYSTEM_SLEEPMODE_IDLE_2);
+	__DSB();
+	__WFI();
+	energia_acordadas++;
+
+	// Deixa a interrupcao que acordou o nucleo ser atendida antes de corrigir o tick
+	__enable_irq();
+	__ISB();
+	__disable_irq();
+
+	decorrido = rtc_count_get_count(&energia_rtc) - inicio;
+	energia_sono += decorrido;
+	energia_resto += decorrido * configTICK_RATE_HZ;
+
+	ticks = energia_resto / ENERGIA_RTC_HZ;
+	if (ticks > esperado) {
+		// O kernel nao aceita avancar alem do esperado; o excesso fica no resto para o proximo sono
+		ticks = esperado;
+	}
+	energia_resto -= ticks * ENERGIA_RTC_HZ;
+	vTaskStepTick(ticks);
+
+	// Recomeca o SysTick com um periodo inteiro
+	SysTick->VAL = 0;
+	SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+	__enable_irq();
+}
+
+/**
+ * \brief Imprime o modo de sono e as taxas desde o relatorio anterior
+ *
+ *   modo <idle|standby>
+ *   intervalo_ms <n>
+ *   acordadas <n>
+ *   acordadas_por_s <n>
+ *   residencia_permil <n>   (fracao do intervalo passada dormindo)
+ */
+void energia_imprime(void)
+{
+	uint32_t agora, intervalo, acordadas, sono;
+
+	taskENTER_CRITICAL();
+	agora = rtc_count_get_count(&energia_rtc);
+	acordadas = energia_acordadas;
+	sono = energia_sono;
+	taskEXIT_CRITICAL();
+
+	intervalo = agora - energia_ult_rtc;
+	console_printf("modo %s\n", energia_standby ? "standby" : "idle");
+	console_printf("intervalo_ms %lu\n",
+			(uint32_t)(((uint64_t)intervalo * 1000) / ENERGIA_RTC_HZ));
+	console_printf("acordadas %lu\n", acordadas - energia_ult_acordadas);
+	if (intervalo != 0) {
+		console_printf("acordadas_por_s %lu\n", (uint32_t)(((uint64_t)
+				(acordadas - energia_ult_acordadas) * ENERGIA_RTC_HZ) / intervalo));
+		console_printf("residencia_permil %lu\n", (uint32_t)(((uint64_t)
+				(sono - energia_ult_sono) * 1000) / intervalo));
+	}
+
+	energia_ult_rtc = agora;
+	energia_ult_acordadas = acordadas;
+	energia_ult_sono = sono;
+}
@@ -0,0 +1,40 @@
+/**
+ * \file
+ * \brief Sono entre comandos (tickless idle) com o RTC e modo standby opcional
+ *
+ * Quando todas as tarefas estao bloqueadas o kernel chama energia_dorme(): o SysTick e parado,
+ * o RTC (32,768 kHz, continua contando em standby) e programado para acordar o nucleo no proximo
+ * timeout e o tick do kernel e corrigido com o tempo medido pelo RTC ao acordar. Qualquer
+ * interrupcao (USART, BOD) acorda antes. O FreeRTOSConfig.h precisa de:
+ *
+ *   #define configUSE_TICKLESS_IDLE             2
+ *   void energia_dorme(uint32_t esperado);
+ *   #define portSUPPRESS_TICKS_AND_SLEEP(x)     energia_dorme(x)
+ *
+ * O RTC usa o GCLK_GENERATOR_2 (fixo no driver do ASF), que no conf_clocks.h deve vir de um
+ * oscilador de 32,768 kHz com run-in-standby. No modo standby o LED so mantem o brilho se o
+ * gerador do TCC tambem rodar em standby, e a USART so acorda com o inicio de um byte se o
+ * gerador do SERCOM puder ser ligado sob demanda (start-of-frame detection).
+ */
+
+#ifndef ENERGIA_H
+#define ENERGIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ENERGIA_RTC_HZ 32768
+
+#ifndef CONF_ENERGIA_MAX_TICKS
+#  define CONF_ENERGIA_MAX_TICKS 60000 // Maior sono de uma vez, em ticks
+#endif
+
+void energia_init(void);
+void energia_dorme(uint32_t esperado);
+void energia_set_standby(bool standby);
+bool energia_get_standby(void);
+uint32_t energia_get_rtc(void);
+uint64_t energia_get_rtc64(void);
+void energia_imprime(void);
+
+#endif // ENERGIA_H
@@ -0,0 +1,100 @@
+/**
+ * \file
+ * \brief Estatisticas de execucao das tarefas (tempo de CPU, pilha e heap)
+ */
+
+#include <asf.h>
+#include "console.h"
+#include "estatisticas.h"
+
+#if (configUSE_TRACE_FACILITY != 1) || (configGENERATE_RUN_TIME_STATS != 1)
+#  error "estatisticas.c precisa de configUSE_TRACE_FACILITY e configGENERATE_RUN_TIME_STATS (ver estatisticas.h)"
+#endif
+
+//! Contador de tempo de execucao, livre, em 32 bits
+static struct tc_module estatisticas_tc;
+
+//! Listagem das tarefas; estatica para nao depender do heap nem da pilha de quem chama
+static TaskStatus_t estatisticas_tarefas[ESTATISTICAS_MAX_TAREFAS];
+
+//! Letras do estado de cada tarefa, na ordem de eTaskState
+static const char estatisticas_estados[] = "XRBSD";
+
+/**
+ * \brief Inicializa o TC que conta o tempo de execucao das tarefas
+ *
+ * Chamado pelo kernel (portCONFIGURE_TIMER_FOR_RUN_TIME_STATS) ao iniciar o escalonador. O main()
+ * ja o inicia logo apos o system_init() para medir o boot, entao a segunda chamada e ignorada.
+ */
+void estatisticas_init_contador(void)
+{
+	struct tc_config config_tc;
+	static bool iniciado = false;
+
+	if (iniciado) {
+		return;
+	}
+	iniciado = true;
+
+	tc_get_config_defaults(&config_tc);
+	config_tc.counter_size    = TC_COUNTER_SIZE_32BIT;
+	config_tc.clock_source    = CONF_ESTATISTICAS_GCLK;
+	config_tc.clock_prescaler = CONF_ESTATISTICAS_PRESCALER;
+
+	tc_init(&estatisticas_tc, CONF_ESTATISTICAS_TC, &config_tc);
+	tc_enable(&estatisticas_tc);
+}
+
+//! Valor atual do contador de tempo de execucao (portGET_RUN_TIME_COUNTER_VALUE)
+uint32_t estatisticas_get_contador(void)
+{
+	return tc_get_count_value(&estatisticas_tc);
+}
+
+//! Frequencia do contador de tempo de execucao, em Hz
+uint32_t estatisticas_get_freq_contador(void)
+{
+	return system_gclk_gen_get_hz(CONF_ESTATISTICAS_GCLK) / CONF_ESTATISTICAS_DIVISOR;
+}
+
+/**
+ * \brief Imprime tempo de CPU e pilha livre de cada tarefa, e o uso do heap
+ *
+ * Uma linha por tarefa com campos separados por espaco, precedidas por um cabecalho:
+ *   tarefa estado prio cpu_contagens cpu_permil pilha_livre
+ * A pilha livre e o menor valor ja visto (high-water mark), em palavras de StackType_t.
+ * O cpu_permil e a fracao do tempo total em milesimos, sem usar ponto flutuante.
+ */
+void estatisticas_imprime(void)
+{
+	UBaseType_t qtd;
+	UBaseType_t i;
+	uint32_t total;
+	uint32_t permil;
+
+	qtd = uxTaskGetSystemState(estatisticas_tarefas, ESTATISTICAS_MAX_TAREFAS, &total);
+	if (qtd == 0) {
+		console_printf("stats erro tarefas %lu max %u\n", (uint32_t)uxTaskGetNumberOfTasks(),
+				ESTATISTICAS_MAX_TAREFAS);
+	}
+
+	console_puts("tarefa estado prio cpu_contagens cpu_permil pilha_livre\n");
+	for (i = 0; i < qtd; i++) {
+		TaskStatus_t *t = &estatisticas_tarefas[i];
+
+		// Divide o total antes para nao estourar 32 bits em contagens grandes
+		permil = (total / 1000) ? t->ulRunTimeCounter / (total / 1000) : 0;
+		console_printf("%s %c %lu %lu %lu %u\n", t->pcTaskName,
+				estatisticas_estados[t->eCurrentState], (uint32_t)t->uxCurrentPriority,
+				t->ulRunTimeCounter, permil, t->usStackHighWaterMark);
+	}
+
+	console_printf("cpu_total %lu\n", total);
+#if (configSUPPORT_DYNAMIC_ALLOCATION == 1)
+	console_printf("heap_livre %lu\n", (uint32_t)xPortGetFreeHeapSize());
+	console_printf("heap_minimo %lu\n", (uint32_t)xPortGetMinimumEverFreeHeapSize());
+	console_printf("heap_total %lu\n", (uint32_t)configTOTAL_HEAP_SIZE);
+#else
+	console_puts("heap_total 0\n"); // Tudo alocado estaticamente, sem heap do FreeRTOS
+#endif
+}
@@ -0,0 +1,37 @@
+/**
+ * \file
+ * \brief Estatisticas de execucao das tarefas (tempo de CPU, pilha e heap)
+ *
+ * O tempo de CPU de cada tarefa e medido pelo FreeRTOS com um contador de alta resolucao
+ * feito com um TC livre. O FreeRTOSConfig.h precisa de:
+ *
+ *   #define configUSE_TRACE_FACILITY                 1
+ *   #define configGENERATE_RUN_TIME_STATS            1
+ *   #define INCLUDE_uxTaskGetStackHighWaterMark      1
+ *   #define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() estatisticas_init_contador()
+ *   #define portGET_RUN_TIME_COUNTER_VALUE()         estatisticas_get_contador()
+ *
+ * e de um prototipo das duas funcoes antes das macros (ou incluir este arquivo).
+ */
+
+#ifndef ESTATISTICAS_H
+#define ESTATISTICAS_H
+
+#include <stdint.h>
+
+// TC usado como contador de tempo de execucao. Em 32 bits o TC4 usa tambem o TC5
+#ifndef CONF_ESTATISTICAS_TC
+#  define CONF_ESTATISTICAS_TC         TC4
+#endif
+#define CONF_ESTATISTICAS_GCLK         GCLK_GENERATOR_0
+#define CONF_ESTATISTICAS_PRESCALER    TC_CLOCK_PRESCALER_DIV256
+#define CONF_ESTATISTICAS_DIVISOR      256 // Deve corresponder ao prescaler acima
+
+#define ESTATISTICAS_MAX_TAREFAS 10 // Tarefas listadas pelo comando stats (inclui IDLE e as do kernel)
+
+void estatisticas_init_contador(void);
+uint32_t estatisticas_get_contador(void);
+uint32_t estatisticas_get_freq_contador(void);
+void estatisticas_imprime(void);
+
+#endif // ESTATISTICAS_H
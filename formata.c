@@ -0,0 +1,160 @@
+/**
+ * \file
+ * \brief Formatador de texto pequeno e reentrante, substituto do printf da newlib
+ */
+
+#include <limits.h>
+#include <string.h>
+#include "formata.h"
+
+//! Destino de formata_snprintf()
+struct formata_buffer {
+	char *destino;
+	size_t tam;
+	size_t usado;
+};
+
+/**
+ * \brief Emite um numero sem sinal na base pedida, com o sinal na frente se \a negativo
+ *
+ * Os digitos sao escritos do fim para o comeco de um buffer local e entregues de uma vez.
+ *
+ * \return Quantidade de caracteres produzidos
+ */
+static int formata_numero(formata_emite_t emite, void *contexto, unsigned long valor,
+		unsigned base, int negativo)
+{
+	char digitos[sizeof(unsigned long) * CHAR_BIT / 3 + 2]; // Sinal e os digitos de ULONG_MAX: bits/3 + 1 cobre bits * log10(2)
+	char *p = digitos + sizeof(digitos);
+
+	do {
+		unsigned d = (unsigned)(valor % base);
+		*--p = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+		valor /= base;
+	} while (valor != 0);
+	if (negativo) {
+		*--p = '-';
+	}
+
+	emite(contexto, p, (size_t)(digitos + sizeof(digitos) - p));
+	return (int)(digitos + sizeof(digitos) - p);
+}
+
+/**
+ * \brief Formata o texto entregando-o em trechos para \a emite
+ *
+ * Cada trecho de texto literal entre conversoes, cada numero e cada %s sai em uma so
+ * chamada de \a emite, em vez de uma chamada por caractere.
+ *
+ * \return Quantidade de caracteres produzidos
+ */
+int formata_v(formata_emite_t emite, void *contexto, const char *formato, va_list args)
+{
+	int qtd = 0;
+	int longo;
+	const char *s;
+	size_t tam;
+	long valor;
+	char c;
+
+	for (; *formato != '\0'; formato++) {
+		if (*formato != '%') {
+			for (s = formato; *s != '\0' && *s != '%'; s++) {
+			}
+			emite(contexto, formato, (size_t)(s - formato));
+			qtd += (int)(s - formato);
+			formato = s - 1;
+			continue;
+		}
+
+		formato++;
+		longo = 0;
+		if (*formato == 'l') {
+			longo = 1;
+			formato++;
+		}
+
+		switch (*formato) {
+		case 'd':
+		case 'i':
+			valor = longo ? va_arg(args, long) : va_arg(args, int);
+			if (valor < 0) {
+				qtd += formata_numero(emite, contexto, 0UL - (unsigned long)valor, 10, 1);
+			} else {
+				qtd += formata_numero(emite, contexto, (unsigned long)valor, 10, 0);
+			}
+			break;
+		case 'u':
+		case 'x':
+			qtd += formata_numero(emite, contexto,
+					longo ? va_arg(args, unsigned long) : va_arg(args, unsigned),
+					(*formato == 'x') ? 16 : 10, 0);
+			break;
+		case 's':
+			s = va_arg(args, const char *);
+			if (s == NULL) {
+				s = "(null)";
+			}
+			tam = strlen(s);
+			emite(contexto, s, tam);
+			qtd += (int)tam;
+			break;
+		case 'c':
+			c = (char)va_arg(args, int);
+			emite(contexto, &c, 1);
+			qtd++;
+			break;
+		case '%':
+			emite(contexto, formato, 1);
+			qtd++;
+			break;
+		case '\0':
+			// '%' no fim do formato
+			return qtd;
+		default:
+			// Conversao nao suportada: mostra como veio, para ficar visivel na saida
+			emite(contexto, formato - 1 - longo, 2 + longo);
+			qtd += 2 + longo;
+			break;
+		}
+	}
+
+	return qtd;
+}
+
+static void formata_emite_buffer(void *contexto, const char *texto, size_t tam)
+{
+	struct formata_buffer *b = contexto;
+	size_t cabe = 0;
+
+	// Sempre sobra lugar para o '\0'
+	if (b->usado + 1 < b->tam) {
+		cabe = b->tam - 1 - b->usado;
+		if (cabe > tam) {
+			cabe = tam;
+		}
+		memcpy(b->destino + b->usado, texto, cabe);
+	}
+	b->usado += tam;
+}
+
+/**
+ * \brief Equivalente ao snprintf(): sempre termina o texto com '\\0' se \a tam > 0
+ *
+ * \return Tamanho que o texto teria sem truncamento
+ */
+int formata_snprintf(char *destino, size_t tam, const char *formato, ...)
+{
+	struct formata_buffer b = { destino, tam, 0 };
+	va_list args;
+	int qtd;
+
+	va_start(args, formato);
+	qtd = formata_v(formata_emite_buffer, &b, formato, args);
+	va_end(args);
+
+	if (tam > 0) {
+		destino[(b.usado < tam) ? b.usado : tam - 1] = '\0';
+	}
+	return qtd;
+}
@@ -0,0 +1,31 @@
+/**
+ * \file
+ * \brief Formatador de texto pequeno e reentrante, substituto do printf da newlib
+ *
+ * Aceita apenas as conversoes usadas pelo firmware: %d, %i, %u, %x, %s, %c e %%, com o
+ * modificador 'l' opcional. Largura, precisao e ponto flutuante nao sao suportados.
+ * Nao usa heap nem variaveis estaticas: cada chamada so usa a pilha de quem chama.
+ */
+
+#ifndef FORMATA_H
+#define FORMATA_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Recebe cada trecho produzido pelo formatador (texto literal, numero ou %s), sem '\0' no fim
+typedef void (*formata_emite_t)(void *contexto, const char *texto, size_t tam);
+
+int formata_v(formata_emite_t emite, void *contexto, const char *formato, va_list args);
+int formata_snprintf(char *destino, size_t tam, const char *formato, ...)
+		__attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FORMATA_H
@@ -0,0 +1,108 @@
+/**
+ * \file
+ * \brief Desenho de texto direto no formato de paginas do SSD1306
+ */
+
+#include <string.h>
+#include "glifo.h"
+
+/**
+ * \brief Gira uma fonte de linhas (formato do gfx_mono) para colunas
+ *
+ * \param fonte    Fonte girada, apontando para "colunas"
+ * \param colunas  Area de GLIFO_TAM_FONTE(largura, primeiro, ultimo) bytes
+ * \param linhas   Glifos do gfx_mono: altura linhas de (largura + 7) / 8 bytes, pixel da
+ *                 esquerda no bit 7
+ */
+void glifo_rotaciona(struct glifo_fonte *fonte, uint8_t *colunas, const uint8_t *linhas,
+		uint8_t largura, uint8_t altura, uint8_t primeiro, uint8_t ultimo)
+{
+	uint8_t bytes_linha = (uint8_t)((largura + 7) / 8);
+	uint16_t c, total = (uint16_t)(ultimo - primeiro + 1);
+	uint8_t x, y, byte;
+
+	memset(colunas, 0, GLIFO_TAM_FONTE(largura, primeiro, ultimo));
+	for (c = 0; c < total; c++) {
+		for (y = 0; y < altura; y++) {
+			for (x = 0; x < largura; x++) {
+				byte = linhas[(c * altura + y) * bytes_linha + x / 8];
+				if (byte & (0x80 >> (x % 8))) {
+					colunas[c * largura + x] |= (uint8_t)(1 << y);
+				}
+			}
+		}
+	}
+
+	fonte->colunas = colunas;
+	fonte->largura = largura;
+	fonte->altura = altura;
+	fonte->primeiro = primeiro;
+	fonte->ultimo = ultimo;
+}
+
+//! Colunas do glifo de "c"; NULL fora da fonte (desenhado em branco)
+static const uint8_t *glifo(const struct glifo_fonte *fonte, char c)
+{
+	uint8_t u = (uint8_t)c;
+
+	if (u < fonte->primeiro || u > fonte->ultimo) {
+		return NULL;
+	}
+	return fonte->colunas + (uint16_t)(u - fonte->primeiro) * fonte->largura;
+}
+
+/**
+ * \brief Texto em uma linha de pagina, com o topo dos glifos no bit 0
+ *
+ * Caminho rapido para linhas alinhadas: cada coluna do glifo e um byte. Depois do texto a
+ * linha e apagada ate "largura", como a linha do terminal do gfx_mono.
+ *
+ * \param pagina  Bytes da pagina (um por coluna), lidos e escritos
+ * \param largura Colunas da pagina
+ *
+ * \return Colunas ocupadas pelo texto
+ */
+uint16_t glifo_linha(const struct glifo_fonte *fonte, const char *texto, uint8_t *pagina,
+		uint16_t largura)
+{
+	uint8_t mascara = (uint8_t)((1u << fonte->altura) - 1);
+	uint8_t manter = (uint8_t)~mascara;
+	const uint8_t *g;
+	uint16_t x = 0;
+	uint8_t i;
+
+	while (*texto != '\0' && x + fonte->largura <= largura) {
+		g = glifo(fonte, *texto++);
+		for (i = 0; i < fonte->largura; i++, x++) {
+			pagina[x] = (uint8_t)((pagina[x] & manter) | (g ? g[i] : 0));
+		}
+	}
+	for (i = 0; x + i < largura; i++) {
+		pagina[x + i] &= manter;
+	}
+	return x;
+}
+
+/**
+ * \brief Um glifo em qualquer linha: deslocado dentro da pagina e, se passar dela, na seguinte
+ *
+ * \param deslocamento Linha do topo do glifo dentro da pagina superior (0 a 7)
+ * \param superior     largura bytes da pagina do topo, a partir da coluna do glifo
+ * \param inferior     Mesmas colunas na pagina de baixo (ignorada se o glifo cabe na de cima)
+ */
+void glifo_desenha(const struct glifo_fonte *fonte, char c, uint8_t deslocamento,
+		uint8_t *superior, uint8_t *inferior)
+{
+	const uint8_t *g = glifo(fonte, c);
+	uint16_t mascara = (uint16_t)(((1u << fonte->altura) - 1) << deslocamento);
+	uint16_t coluna;
+	uint8_t i;
+
+	for (i = 0; i < fonte->largura; i++) {
+		coluna = (uint16_t)((g ? g[i] : 0) << deslocamento);
+		superior[i] = (uint8_t)((superior[i] & ~mascara) | coluna);
+		if (mascara > 0xFF) {
+			inferior[i] = (uint8_t)((inferior[i] & ~(mascara >> 8)) | (coluna >> 8));
+		}
+	}
+}
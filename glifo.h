@@ -0,0 +1,51 @@
+/**
+ * \file
+ * \brief Desenho de texto direto no formato de paginas do SSD1306
+ *
+ * A memoria do SSD1306 e organizada em paginas: cada byte e uma coluna de 8 linhas, com a
+ * linha de cima no bit 0. O gfx_mono desenha um caractere apagando o retangulo e acendendo
+ * pixel a pixel, cada um com leitura e escrita de um byte. Aqui a fonte e girada uma vez
+ * para o mesmo formato (um byte por coluna do glifo) e o texto vira copia de bytes:
+ *
+ *  - glifo_linha(): texto em uma linha alinhada a pagina, a coluna inteira de uma vez;
+ *  - glifo_desenha(): um glifo em qualquer y, deslocado para as duas paginas que ocupa.
+ *
+ * Os glifos sao opacos como no gfx_mono_draw_char (a celula largura x altura e apagada) e
+ * os bits fora da celula sao preservados. O modulo nao depende do ASF, para que o benchmark
+ * do host (tools/bench_glifo.cpp) use o mesmo codigo.
+ */
+
+#ifndef GLIFO_H
+#define GLIFO_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Fonte no formato de paginas (altura ate 8)
+struct glifo_fonte {
+	const uint8_t *colunas; // largura bytes por caractere, de "primeiro" a "ultimo"
+	uint8_t largura;
+	uint8_t altura;
+	uint8_t primeiro;
+	uint8_t ultimo;
+};
+
+//! Bytes de "colunas" para uma fonte
+#define GLIFO_TAM_FONTE(largura, primeiro, ultimo) \
+	((uint16_t)(largura) * ((uint16_t)(ultimo) - (primeiro) + 1))
+
+void glifo_rotaciona(struct glifo_fonte *fonte, uint8_t *colunas, const uint8_t *linhas,
+		uint8_t largura, uint8_t altura, uint8_t primeiro, uint8_t ultimo);
+uint16_t glifo_linha(const struct glifo_fonte *fonte, const char *texto, uint8_t *pagina,
+		uint16_t largura);
+void glifo_desenha(const struct glifo_fonte *fonte, char c, uint8_t deslocamento,
+		uint8_t *superior, uint8_t *inferior);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GLIFO_H
@@ -0,0 +1,342 @@
+/**
+ * \file
+ * \brief Gravacao e reproducao das linhas recebidas pela serial
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "gravacao.h"
+#include "comandos.h"
+#include "console.h"
+#include "estatisticas.h"
+
+#if (configUSE_TIMERS != 1)
+#  error "gravacao.c usa um software timer: defina configUSE_TIMERS 1 no FreeRTOSConfig.h"
+#endif
+
+#define GRAVACAO_MAGICO     "REC\x01" // Marca a primeira pagina da gravacao
+#define GRAVACAO_CABECALHO  8         // Magico, bytes usados (16 bits) e quantidade de linhas (16 bits)
+#define GRAVACAO_TAM        (CONF_GRAVACAO_PAGINAS * EEPROM_PAGE_SIZE)
+
+// Imagem das paginas da EEPROM: cabecalho seguido dos registros (varint ms, tamanho, texto)
+static uint8_t gravacao_dados[GRAVACAO_TAM];
+static uint16_t gravacao_usado = GRAVACAO_CABECALHO;
+static uint16_t gravacao_linhas;
+static uint8_t gravacao_pagina;          // Primeira pagina na EEPROM; 0 enquanto nao carregada
+static bool gravacao_ativa;
+static bool gravacao_cheia;              // Linhas descartadas por falta de espaco
+static uint32_t gravacao_anterior;       // Contador de estatisticas da ultima linha gravada
+
+// Reproducao
+static bool gravacao_reproduzindo;
+static uint16_t gravacao_pos;            // Proximo registro a enviar
+static uint16_t gravacao_enviadas;
+static uint32_t gravacao_velocidade;
+
+static gravacao_enfileira_t gravacao_enfileira;
+static struct trava *gravacao_flash;
+static struct trava gravacao_trava;
+static TimerHandle_t gravacao_timer;
+static StaticTimer_t gravacao_timer_buffer;
+
+static int gravacao_codifica_varint(uint32_t valor, uint8_t *dados)
+{
+	int n = 0;
+
+	while (valor >= 0x80) {
+		dados[n++] = (uint8_t)(valor | 0x80);
+		valor >>= 7;
+	}
+	dados[n++] = (uint8_t)valor;
+	return n;
+}
+
+/**
+ * \brief Le o registro em "pos"
+ *
+ * \return Posicao do registro seguinte, ou 0 se o registro esta incompleto
+ */
+static uint16_t gravacao_le(uint16_t pos, uint32_t *ms, char *texto)
+{
+	uint32_t valor = 0;
+	int desloc = 0;
+	uint8_t tam;
+
+	do {
+		if (pos >= gravacao_usado || desloc > 28) {
+			return 0;
+		}
+		valor |= (uint32_t)(gravacao_dados[pos] & 0x7F) << desloc;
+		desloc += 7;
+	} while (gravacao_dados[pos++] & 0x80);
+
+	if (pos >= gravacao_usado) {
+		return 0;
+	}
+	tam = gravacao_dados[pos++];
+	if (tam >= COMANDO_TAM || pos + tam > gravacao_usado) {
+		return 0;
+	}
+	memcpy(texto, &gravacao_dados[pos], tam);
+	texto[tam] = '\0';
+	*ms = valor;
+	return (uint16_t)(pos + tam);
+}
+
+//! Ticks ate a proxima linha na velocidade da reproducao (0: enviar ja)
+static TickType_t gravacao_intervalo(uint32_t ms)
+{
+	if (gravacao_velocidade == 0) {
+		return 0;
+	}
+	return pdMS_TO_TICKS((uint32_t)(((uint64_t)ms * GRAVACAO_VELOCIDADE_NORMAL) / gravacao_velocidade));
+}
+
+/**
+ * \brief Envia as linhas vencidas e agenda a seguinte (tarefa dos timers)
+ */
+static void gravacao_dispara(TimerHandle_t timer)
+{
+	char texto[COMANDO_TAM];
+	uint32_t ms;
+	uint16_t seguinte;
+	TickType_t espera;
+
+	trava_toma(&gravacao_trava);
+
+	while (gravacao_reproduzindo) {
+		seguinte = gravacao_le(gravacao_pos, &ms, texto);
+		if (seguinte == 0) {
+			gravacao_reproduzindo = false;
+			break;
+		}
+
+		// Fila cheia: tenta de novo no proximo tick
+		if (!gravacao_enfileira(texto)) {
+			xTimerChangePeriod(timer, 1, 0);
+			break;
+		}
+		gravacao_pos = seguinte;
+		gravacao_enviadas++;
+
+		// Espera o intervalo gravado antes da proxima; sem intervalo, segue no mesmo disparo
+		if (gravacao_pos >= gravacao_usado || gravacao_le(gravacao_pos, &ms, texto) == 0) {
+			gravacao_reproduzindo = false;
+			break;
+		}
+		espera = gravacao_intervalo(ms);
+		if (espera == 0 && gravacao_velocidade == 0) {
+			espera = 1; // Sem esperas, mas uma linha por tick para o host de teste e o eco acompanharem
+		}
+		if (espera != 0) {
+			xTimerChangePeriod(timer, espera, 0);
+			break;
+		}
+	}
+
+	trava_libera(&gravacao_trava);
+}
+
+/**
+ * \brief Cria o timer da reproducao
+ *
+ * \param flash_trava Trava da EEPROM emulada, tomada para ler e gravar as paginas
+ * \param enfileira   Recebe cada linha reproduzida
+ */
+void gravacao_init(struct trava *flash_trava, gravacao_enfileira_t enfileira)
+{
+	gravacao_flash = flash_trava;
+	gravacao_enfileira = enfileira;
+	trava_init(&gravacao_trava, "gravacao");
+	gravacao_timer = xTimerCreateStatic("gravacao", 1, pdFALSE, NULL, gravacao_dispara,
+			&gravacao_timer_buffer);
+}
+
+/**
+ * \brief Le da EEPROM emulada a ultima gravacao (chamar com a EEPROM pronta)
+ *
+ * \param primeira_pagina Primeira das CONF_GRAVACAO_PAGINAS paginas reservadas
+ */
+void gravacao_carrega(uint8_t primeira_pagina)
+{
+	uint16_t usado;
+	int i;
+
+	gravacao_pagina = primeira_pagina;
+
+	trava_toma(gravacao_flash);
+	for (i = 0; i < CONF_GRAVACAO_PAGINAS; i++) {
+		eeprom_emulator_read_page(gravacao_pagina + i, &gravacao_dados[i * EEPROM_PAGE_SIZE]);
+	}
+	trava_libera(gravacao_flash);
+
+	usado = (uint16_t)(gravacao_dados[4] | (gravacao_dados[5] << 8));
+	if (memcmp(gravacao_dados, GRAVACAO_MAGICO, 4) != 0 || usado < GRAVACAO_CABECALHO || usado > GRAVACAO_TAM) {
+		gravacao_usado = GRAVACAO_CABECALHO;
+		gravacao_linhas = 0;
+		return;
+	}
+	gravacao_usado = usado;
+	gravacao_linhas = (uint16_t)(gravacao_dados[6] | (gravacao_dados[7] << 8));
+}
+
+/**
+ * \brief Descarta a gravacao anterior e passa a gravar as linhas da serial
+ *
+ * \param contador Contador de estatisticas do inicio; a primeira linha guarda o tempo desde ele
+ *
+ * \return false durante uma reproducao
+ */
+bool gravacao_inicia(uint32_t contador)
+{
+	trava_toma(&gravacao_trava);
+	if (gravacao_reproduzindo) {
+		trava_libera(&gravacao_trava);
+		return false;
+	}
+	gravacao_ativa = true;
+	gravacao_cheia = false;
+	gravacao_usado = GRAVACAO_CABECALHO;
+	gravacao_linhas = 0;
+	gravacao_anterior = contador;
+	trava_libera(&gravacao_trava);
+	return true;
+}
+
+/**
+ * \brief Termina a gravacao e a grava na EEPROM emulada
+ */
+void gravacao_para(void)
+{
+	int i;
+
+	if (!gravacao_ativa) {
+		return;
+	}
+	gravacao_ativa = false;
+
+	memcpy(gravacao_dados, GRAVACAO_MAGICO, 4);
+	gravacao_dados[4] = (uint8_t)gravacao_usado;
+	gravacao_dados[5] = (uint8_t)(gravacao_usado >> 8);
+	gravacao_dados[6] = (uint8_t)gravacao_linhas;
+	gravacao_dados[7] = (uint8_t)(gravacao_linhas >> 8);
+
+	// Sem paginas reservadas a gravacao fica so na RAM
+	if (gravacao_pagina == 0) {
+		return;
+	}
+
+	// So as paginas com registros; o resto da area antiga fica alem de "usado"
+	trava_toma(gravacao_flash);
+	for (i = 0; i * EEPROM_PAGE_SIZE < gravacao_usado; i++) {
+		eeprom_emulator_write_page(gravacao_pagina + i, &gravacao_dados[i * EEPROM_PAGE_SIZE]);
+	}
+	eeprom_emulator_commit_page_buffer();
+	trava_libera(gravacao_flash);
+}
+
+bool gravacao_get_ativa(void)
+{
+	return gravacao_ativa;
+}
+
+/**
+ * \brief Grava uma linha recebida (chamada so por quem executa as linhas)
+ *
+ * \param texto    Linha como veio do host
+ * \param contador Contador de estatisticas na recepcao da linha
+ */
+void gravacao_registra(const char *texto, uint32_t contador)
+{
+	uint8_t varint[5];
+	uint32_t ms;
+	int n, tam;
+
+	if (!gravacao_ativa) {
+		return;
+	}
+
+	ms = (uint32_t)(((uint64_t)(contador - gravacao_anterior) * 1000) / estatisticas_get_freq_contador());
+	tam = (int)strnlen(texto, COMANDO_TAM - 1);
+	n = gravacao_codifica_varint(ms, varint);
+	if (gravacao_usado + n + 1 + tam > GRAVACAO_TAM) {
+		gravacao_cheia = true;
+		return;
+	}
+	gravacao_anterior = contador;
+
+	memcpy(&gravacao_dados[gravacao_usado], varint, n);
+	gravacao_usado += n;
+	gravacao_dados[gravacao_usado++] = (uint8_t)tam;
+	memcpy(&gravacao_dados[gravacao_usado], texto, tam);
+	gravacao_usado += tam;
+	gravacao_linhas++;
+}
+
+/**
+ * \brief Reproduz a gravacao
+ *
+ * \param velocidade Em centesimos (GRAVACAO_VELOCIDADE_NORMAL nos tempos gravados); 0 sem esperas
+ *
+ * \return false gravando ou sem linhas gravadas
+ */
+bool gravacao_reproduz(uint32_t velocidade)
+{
+	char texto[COMANDO_TAM];
+	uint32_t ms;
+	TickType_t espera;
+
+	trava_toma(&gravacao_trava);
+	if (gravacao_ativa || gravacao_le(GRAVACAO_CABECALHO, &ms, texto) == 0) {
+		trava_libera(&gravacao_trava);
+		return false;
+	}
+	gravacao_velocidade = velocidade;
+	gravacao_pos = GRAVACAO_CABECALHO;
+	gravacao_enviadas = 0;
+	gravacao_reproduzindo = true;
+
+	espera = gravacao_intervalo(ms);
+	xTimerChangePeriod(gravacao_timer, espera ? espera : 1, 0);
+	trava_libera(&gravacao_trava);
+	return true;
+}
+
+/**
+ * \brief Interrompe a reproducao; linhas ja enfileiradas ainda sao executadas
+ */
+void gravacao_interrompe(void)
+{
+	trava_toma(&gravacao_trava);
+	gravacao_reproduzindo = false;
+	xTimerStop(gravacao_timer, 0);
+	trava_libera(&gravacao_trava);
+}
+
+/**
+ * \brief Exibe o estado da gravacao e, se pedido, as linhas
+ *
+ *   record <gravando|reproduzindo|parada> linhas <n> bytes <usados>/<total> [cheia]
+ *   replay <enviadas>/<n>
+ *   <ms desde a anterior> <linha>    (uma por linha gravada, com "linhas")
+ */
+void gravacao_imprime(bool linhas)
+{
+	char texto[COMANDO_TAM];
+	uint32_t ms;
+	uint16_t pos;
+	const char *estado;
+
+	estado = gravacao_ativa ? "gravando" : (gravacao_reproduzindo ? "reproduzindo" : "parada");
+	console_printf("record %s linhas %u bytes %u/%u%s\n", estado, gravacao_linhas, gravacao_usado,
+			GRAVACAO_TAM, gravacao_cheia ? " cheia" : "");
+	console_printf("replay %u/%u\n", gravacao_enviadas, gravacao_linhas);
+
+	if (!linhas) {
+		return;
+	}
+	pos = GRAVACAO_CABECALHO;
+	while ((pos = gravacao_le(pos, &ms, texto)) != 0) {
+		console_printf("%lu %s\n", ms, texto);
+	}
+}
@@ -0,0 +1,42 @@
+/**
+ * \file
+ * \brief Gravacao e reproducao das linhas recebidas pela serial ("record" / "replay")
+ *
+ * Com a gravacao ligada, cada linha do host e guardada com o tempo desde a linha anterior
+ * (ms em varint, tamanho e texto, sem preenchimento). No "record stop" a gravacao vai para
+ * CONF_GRAVACAO_PAGINAS paginas da EEPROM emulada, e volta para a RAM no boot.
+ *
+ * A reproducao devolve as linhas, na ordem e com os intervalos gravados (divididos pela
+ * velocidade), para a funcao passada para gravacao_init(), que as poe na mesma fila das
+ * linhas da serial. Os intervalos sao contados por um software timer de disparo unico;
+ * com a fila cheia a linha espera um tick e e enviada de novo, sem se perder.
+ * Precisa de configUSE_TIMERS 1 no FreeRTOSConfig.h.
+ */
+
+#ifndef GRAVACAO_H
+#define GRAVACAO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "travas.h"
+
+#ifndef CONF_GRAVACAO_PAGINAS
+#  define CONF_GRAVACAO_PAGINAS 8 // Paginas da EEPROM emulada (e bytes de RAM / EEPROM_PAGE_SIZE)
+#endif
+
+#define GRAVACAO_VELOCIDADE_NORMAL 100 // Velocidade em centesimos: 100 = tempos gravados, 0 = sem esperas
+
+//! Entrega uma linha reproduzida; retorna false se ela nao coube na fila (sera tentada de novo)
+typedef bool (*gravacao_enfileira_t)(const char *texto);
+
+void gravacao_init(struct trava *flash_trava, gravacao_enfileira_t enfileira);
+void gravacao_carrega(uint8_t primeira_pagina);
+bool gravacao_inicia(uint32_t contador);
+void gravacao_para(void);
+bool gravacao_get_ativa(void);
+void gravacao_registra(const char *texto, uint32_t contador);
+bool gravacao_reproduz(uint32_t velocidade);
+void gravacao_interrompe(void);
+void gravacao_imprime(bool linhas);
+
+#endif // GRAVACAO_H
@@ -0,0 +1,211 @@
+/**
+ * \file
+ * \brief Log de comandos em um anel de paginas, com sequencias e consulta indexada
+ */
+
+#include <string.h>
+#include "historico.h"
+
+//! Proxima pagina do anel de registros
+static uint8_t historico_seguinte(const struct historico *h, uint8_t pagina)
+{
+	return (pagina >= h->indice.paginas) ? 1 : pagina + 1;
+}
+
+//! Pagina do anel na posicao "pos" a partir da pagina mais antiga
+static uint8_t historico_pagina(const struct historico_indice *indice, uint32_t pos)
+{
+	return (uint8_t)(1 + (indice->pagina_inicio - 1 + pos) % indice->paginas);
+}
+
+//! Prepara a pagina atual para receber registros a partir da proxima sequencia
+static void historico_nova_pagina(struct historico *h)
+{
+	memset(h->pagina, COMANDO_COD_FIM, HISTORICO_PAGINA_TAM);
+	memcpy(h->pagina, &h->indice.proximo, 4);
+	h->usado = HISTORICO_DADOS;
+}
+
+//! Escreve o cabecalho na pagina 0. So muda quando o log troca de pagina
+static void historico_salva_cabecalho(struct historico *h)
+{
+	uint8_t cabecalho[HISTORICO_PAGINA_TAM];
+
+	memset(cabecalho, 0, HISTORICO_PAGINA_TAM);
+	memcpy(cabecalho, HISTORICO_MAGICO, 4);
+	memcpy(&cabecalho[4], &h->indice.inicio, 4);
+	cabecalho[8] = h->indice.pagina_inicio;
+	cabecalho[9] = h->indice.pagina_atual;
+	h->escreve(0, cabecalho);
+}
+
+/**
+ * \brief Codifica um registro com a hora absoluta (em segundos) ou com os ms desde o registro anterior
+ *
+ * A absoluta tambem e usada se a hora voltou (relogio acertado) ou se o intervalo nao cabe em 32 bits.
+ */
+static int historico_codifica(struct historico *h, const Comando *cmd, uint64_t tempo, uint8_t *dados)
+{
+	if (h->absoluto || tempo < h->ultimo_tempo || tempo - h->ultimo_tempo > UINT32_MAX) {
+		h->absoluto = true;
+		return CodificaComando(cmd, (uint32_t)(tempo / 1000), 1, dados);
+	}
+	return CodificaComando(cmd, (uint32_t)(tempo - h->ultimo_tempo), 0, dados);
+}
+
+void historico_init(struct historico *h, uint8_t paginas, historico_le_t le, historico_escreve_t escreve)
+{
+	memset(h, 0, sizeof(*h));
+	h->indice.paginas = paginas;
+	h->absoluto = true;
+	h->le = le;
+	h->escreve = escreve;
+}
+
+/**
+ * \brief Le o cabecalho e conta os registros da pagina atual
+ *
+ * \return false se o log era invalido ou de formato antigo e foi reiniciado (quem chama confirma as paginas)
+ */
+bool historico_carrega(struct historico *h)
+{
+	uint8_t cabecalho[HISTORICO_PAGINA_TAM];
+	Comando cmd;
+	uint32_t tempo;
+	int absoluto, n;
+
+	h->le(0, cabecalho);
+	if (memcmp(cabecalho, HISTORICO_MAGICO, 4) != 0 || cabecalho[8] < 1 || cabecalho[8] > h->indice.paginas
+			|| cabecalho[9] < 1 || cabecalho[9] > h->indice.paginas) {
+		historico_inicia(h, 0);
+		return false;
+	}
+
+	memcpy(&h->indice.inicio, &cabecalho[4], 4);
+	h->indice.pagina_inicio = cabecalho[8];
+	h->indice.pagina_atual = cabecalho[9];
+
+	// A sequencia do proximo registro vem da pagina atual: primeira sequencia mais os registros ja gravados
+	h->le(h->indice.pagina_atual, h->pagina);
+	memcpy(&h->indice.proximo, h->pagina, 4);
+	h->usado = HISTORICO_DADOS;
+	while ((n = DecodificaComando(&h->pagina[h->usado], HISTORICO_PAGINA_TAM - h->usado, &cmd, &tempo,
+			&absoluto)) > 0) {
+		h->usado += n;
+		h->indice.proximo++;
+	}
+	return true;
+}
+
+//! Esvazia o log; os registros seguintes comecam na sequencia "seq"
+void historico_inicia(struct historico *h, uint32_t seq)
+{
+	h->indice.inicio = seq;
+	h->indice.proximo = seq;
+	h->indice.pagina_inicio = 1;
+	h->indice.pagina_atual = 1;
+	historico_nova_pagina(h);
+	h->escreve(h->indice.pagina_atual, h->pagina);
+	historico_salva_cabecalho(h);
+}
+
+//! Grava um registro com a hora "tempo" (ms), descartando a pagina mais antiga se o anel estiver cheio
+void historico_grava(struct historico *h, const Comando *cmd, uint64_t tempo)
+{
+	uint8_t dados[COMANDO_COD_MAX];
+	uint8_t primeira[HISTORICO_PAGINA_TAM];
+	int n;
+
+	n = historico_codifica(h, cmd, tempo, dados);
+
+	// Pagina cheia: passa para a seguinte. Cada pagina comeca com a hora absoluta, para que seus
+	// registros possam ser lidos sem as anteriores
+	if (h->usado + n > HISTORICO_PAGINA_TAM) {
+		h->indice.pagina_atual = historico_seguinte(h, h->indice.pagina_atual);
+		if (h->indice.pagina_atual == h->indice.pagina_inicio) {
+			h->indice.pagina_inicio = historico_seguinte(h, h->indice.pagina_inicio);
+			h->le(h->indice.pagina_inicio, primeira);
+			memcpy(&h->indice.inicio, primeira, 4);
+		}
+		historico_nova_pagina(h);
+		historico_salva_cabecalho(h);
+		h->absoluto = true;
+		n = historico_codifica(h, cmd, tempo, dados);
+	}
+
+	memcpy(&h->pagina[h->usado], dados, n);
+	h->usado += n;
+	h->indice.proximo++;
+	h->escreve(h->indice.pagina_atual, h->pagina);
+
+	// Hora como sera reconstruida na leitura (a absoluta so guarda os segundos)
+	h->ultimo_tempo = h->absoluto ? (tempo / 1000) * 1000 : tempo;
+	h->absoluto = false;
+}
+
+/**
+ * \brief Entrega a \a emite os registros pedidos (enum consulta_log), do mais antigo ao mais novo
+ *
+ * A primeira pagina e achada por busca binaria nas sequencias do inicio das paginas; depois as
+ * paginas sao lidas uma a uma com \a le. Registros gravados depois da copia do indice nao saem.
+ *
+ * \return Paginas lidas
+ */
+uint32_t historico_consulta(const struct historico_indice *indice, int consulta, uint32_t arg,
+		historico_le_t le, historico_emite_t emite, void *contexto)
+{
+	uint8_t pagina[HISTORICO_PAGINA_TAM];
+	Comando registro;
+	uint32_t seq, fim, primeira, valor;
+	uint32_t baixo, alto, meio, paginas, lidas = 0;
+	uint64_t tempo;
+	int pos, n, absoluto;
+
+	fim = indice->proximo;
+	if (consulta == LOG_CONSULTA_ULTIMOS && fim - indice->inicio > arg) {
+		seq = fim - arg;
+	} else if (consulta == LOG_CONSULTA_DESDE && (int32_t)(arg - indice->inicio) > 0) {
+		seq = ((int32_t)(arg - fim) > 0) ? fim : arg;
+	} else {
+		seq = indice->inicio;
+	}
+	if (seq == fim) {
+		return 0;
+	}
+	paginas = (indice->pagina_atual + indice->paginas - indice->pagina_inicio) % indice->paginas + 1;
+
+	// Ultima pagina que comeca em uma sequencia <= seq (a mais antiga dispensa a busca)
+	baixo = 0;
+	alto = (seq == indice->inicio) ? 0 : paginas - 1;
+	while (baixo < alto) {
+		meio = (baixo + alto + 1) / 2;
+		le(historico_pagina(indice, meio), pagina);
+		lidas++;
+		memcpy(&primeira, pagina, 4);
+		if ((int32_t)(primeira - seq) <= 0) {
+			baixo = meio;
+		} else {
+			alto = meio - 1;
+		}
+	}
+
+	for ( ; baixo < paginas && seq != fim; baixo++) {
+		le(historico_pagina(indice, baixo), pagina);
+		lidas++;
+
+		// Registros anteriores a "seq" sao pulados; os posteriores a "fim" foram gravados depois da copia do indice
+		memcpy(&primeira, pagina, 4);
+		pos = HISTORICO_DADOS;
+		tempo = 0;
+		while ((n = DecodificaComando(&pagina[pos], HISTORICO_PAGINA_TAM - pos, &registro, &valor, &absoluto)) > 0) {
+			tempo = absoluto ? (uint64_t)valor * 1000 : tempo + valor;
+			if ((int32_t)(primeira - seq) >= 0 && (int32_t)(primeira - fim) < 0) {
+				emite(contexto, primeira, tempo, &registro);
+				seq = primeira + 1;
+			}
+			pos += n;
+			primeira++;
+		}
+	}
+	return lidas;
+}
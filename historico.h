@@ -0,0 +1,71 @@
+/**
+ * \file
+ * \brief Log de comandos em um anel de paginas da EEPROM emulada, com sequencias e consulta indexada
+ *
+ * A pagina 0 e o cabecalho (marca, sequencia do registro mais antigo, pagina mais antiga e
+ * pagina atual); as paginas 1 a "paginas" formam o anel de registros. Cada pagina comeca com a
+ * sequencia (32 bits) do seu primeiro registro, seguida dos registros codificados por
+ * CodificaComando, o primeiro deles sempre com a hora absoluta. Com a pagina cheia o log passa
+ * para a seguinte e, se ela guarda os registros mais antigos, eles sao descartados.
+ *
+ * Uma consulta (tudo, ultimos N ou desde uma sequencia) acha a primeira pagina por busca binaria
+ * nas sequencias do inicio das paginas e entrega os registros um a um, lendo uma pagina por vez.
+ *
+ * Nao depende do ASF: as paginas sao lidas e escritas por funcoes de quem usa o log, para que o
+ * teste do host (tools/teste_historico.cpp) use o mesmo codigo sobre um vetor de paginas. Quem
+ * chama cuida da exclusao (travaLog em main.c) e da confirmacao das paginas na flash.
+ */
+
+#ifndef HISTORICO_H
+#define HISTORICO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "comandos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HISTORICO_PAGINA_TAM 60     // EEPROM_PAGE_SIZE da EEPROM emulada (conferido em main.c)
+#define HISTORICO_DADOS      4      // Os registros de uma pagina vem depois da sequencia do primeiro deles
+#define HISTORICO_MAGICO     "LOG\x05" // Marca o cabecalho no formato com registros codificados e hora
+
+typedef void (*historico_le_t)(uint8_t pagina, uint8_t *dados);
+typedef void (*historico_escreve_t)(uint8_t pagina, const uint8_t *dados);
+
+//! Recebe cada registro de uma consulta: sequencia, hora (ms) e comando
+typedef void (*historico_emite_t)(void *contexto, uint32_t seq, uint64_t tempo, const Comando *cmd);
+
+//! Indice do anel: o que uma consulta precisa para achar os registros
+struct historico_indice {
+	uint32_t inicio;        // Sequencia do registro mais antigo ainda no log
+	uint32_t proximo;       // Sequencia do proximo registro
+	uint8_t pagina_inicio;  // Pagina com o registro mais antigo
+	uint8_t pagina_atual;   // Pagina sendo preenchida
+	uint8_t paginas;        // Paginas do anel, de 1 a "paginas"
+};
+
+//! Log e a copia da pagina sendo preenchida
+struct historico {
+	struct historico_indice indice;
+	uint8_t pagina[HISTORICO_PAGINA_TAM];
+	int usado;              // Bytes ja usados em "pagina"
+	uint64_t ultimo_tempo;  // Hora do ultimo registro gravado, como sera lida do log
+	bool absoluto;          // O proximo registro leva a hora absoluta (boot, pagina nova ou "time set")
+	historico_le_t le;
+	historico_escreve_t escreve;
+};
+
+void historico_init(struct historico *h, uint8_t paginas, historico_le_t le, historico_escreve_t escreve);
+bool historico_carrega(struct historico *h);
+void historico_inicia(struct historico *h, uint32_t seq);
+void historico_grava(struct historico *h, const Comando *cmd, uint64_t tempo);
+uint32_t historico_consulta(const struct historico_indice *indice, int consulta, uint32_t arg,
+		historico_le_t le, historico_emite_t emite, void *contexto);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HISTORICO_H
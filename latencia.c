@@ -0,0 +1,133 @@
+/**
+ * \file
+ * \brief Histogramas de latencia dos comandos, da recepcao da linha ate cada estagio
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "console.h"
+#include "latencia.h"
+#include "estatisticas.h"
+#include "energia.h"
+#include "relogio.h"
+
+struct latencia_hist {
+	uint32_t baldes[LATENCIA_BALDES];
+	uint32_t amostras;
+	uint32_t max;
+	uint32_t ultima; // RTC na ultima amostra (convertido para hora so na impressao)
+};
+
+static struct latencia_hist latencia_hist[NUM_LAT];
+
+static const char *const latencia_nomes[NUM_LAT] = { "interpreta", "log", "pwm" };
+
+/**
+ * \brief Registra a latencia de um estagio
+ *
+ * \param estagio Estagio que acabou de ser concluido
+ * \param inicio  Contador de estatisticas no momento em que a linha foi recebida
+ */
+void latencia_registra(enum estagio_latencia estagio, uint32_t inicio)
+{
+	uint32_t latencia = estatisticas_get_contador() - inicio;
+	uint32_t rtc = energia_get_rtc();
+	uint8_t balde = latencia ? (uint8_t)(32 - __builtin_clz(latencia)) : 0;
+	struct latencia_hist *h = &latencia_hist[estagio];
+
+	// Brilha e Pisca registram no mesmo estagio com prioridades diferentes
+	taskENTER_CRITICAL();
+	h->baldes[balde]++;
+	h->amostras++;
+	if (latencia > h->max) {
+		h->max = latencia;
+	}
+	h->ultima = rtc;
+	taskEXIT_CRITICAL();
+}
+
+//! Converte contagens do contador de estatisticas para microssegundos
+static uint32_t latencia_us(uint32_t contagens, uint32_t hz)
+{
+	return (uint32_t)(((uint64_t)contagens * 1000000) / hz);
+}
+
+/**
+ * \brief Limite superior (em contagens) do balde que contem o percentil pedido
+ *
+ * O resultado e limitado pelo maximo observado, que costuma ser menor que o limite do
+ * ultimo balde.
+ */
+static uint32_t latencia_percentil(const struct latencia_hist *h, uint32_t permil)
+{
+	uint32_t alvo;
+	uint32_t acumulado = 0;
+	uint32_t limite;
+	uint8_t b;
+
+	if (h->amostras == 0) {
+		return 0;
+	}
+
+	alvo = (uint32_t)(((uint64_t)h->amostras * permil + 999) / 1000);
+	for (b = 0; b < LATENCIA_BALDES; b++) {
+		acumulado += h->baldes[b];
+		if (acumulado >= alvo) {
+			break;
+		}
+	}
+
+	limite = (b >= 32) ? UINT32_MAX : ((1UL << b) - 1);
+	return (limite < h->max) ? limite : h->max;
+}
+
+/**
+ * \brief Imprime p50, p99 e maximo de cada estagio, seguidos dos baldes nao vazios
+ *
+ *   estagio amostras p50_us p99_us max_us ultima
+ *   <estagio> <amostras> <p50> <p99> <max> <hora da ultima amostra, segundos.ms>
+ *   balde <estagio> <limite_us> <amostras>
+ */
+void latencia_imprime(void)
+{
+	struct latencia_hist copia;
+	uint32_t hz = estatisticas_get_freq_contador();
+	char hora[RELOGIO_TEXTO_TAM];
+	uint8_t e, b;
+
+	console_puts("estagio amostras p50_us p99_us max_us ultima\n");
+	for (e = 0; e < NUM_LAT; e++) {
+		taskENTER_CRITICAL();
+		copia = latencia_hist[e];
+		taskEXIT_CRITICAL();
+
+		if (copia.amostras != 0) {
+			relogio_texto(relogio_ms_de_rtc(copia.ultima), hora, sizeof(hora));
+		} else {
+			hora[0] = '-';
+			hora[1] = '\0';
+		}
+		console_printf("%s %lu %lu %lu %lu %s\n", latencia_nomes[e], copia.amostras,
+				latencia_us(latencia_percentil(&copia, 500), hz),
+				latencia_us(latencia_percentil(&copia, 990), hz),
+				latencia_us(copia.max, hz), hora);
+	}
+
+	for (e = 0; e < NUM_LAT; e++) {
+		for (b = 0; b < LATENCIA_BALDES; b++) {
+			if (latencia_hist[e].baldes[b] != 0) {
+				console_printf("balde %s %lu %lu\n", latencia_nomes[e],
+						latencia_us((b >= 32) ? UINT32_MAX : ((1UL << b) - 1), hz),
+						latencia_hist[e].baldes[b]);
+			}
+		}
+	}
+}
+
+//! Zera os histogramas
+void latencia_zera(void)
+{
+	taskENTER_CRITICAL();
+	memset(latencia_hist, 0, sizeof(latencia_hist));
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,29 @@
+/**
+ * \file
+ * \brief Histogramas de latencia dos comandos, da recepcao da linha ate cada estagio
+ *
+ * Cada estagio guarda um histograma com baldes de potencias de 2 do contador de
+ * estatisticas (TC): o balde b conta latencias entre 2^(b-1) e 2^b - 1 contagens.
+ * Registrar uma amostra custa um CLZ e um incremento, sem depender da quantidade de amostras.
+ */
+
+#ifndef LATENCIA_H
+#define LATENCIA_H
+
+#include <stdint.h>
+
+// Estagios medidos, todos a partir do '\n' recebido por RecebeComando
+enum estagio_latencia {
+	LAT_INTERPRETA, // Comando interpretado por SetaComando
+	LAT_LOG,        // Log confirmado na flash
+	LAT_PWM,        // Set-point aplicado no PWM por Brilha/Pisca
+	NUM_LAT
+};
+
+#define LATENCIA_BALDES 33 // Balde 0 para latencia zero e um por bit do contador de 32 bits
+
+void latencia_registra(enum estagio_latencia estagio, uint32_t inicio);
+void latencia_imprime(void);
+void latencia_zera(void);
+
+#endif // LATENCIA_H
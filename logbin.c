@@ -0,0 +1,194 @@
+/**
+ * \file
+ * \brief Log binario diferido
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "logbin.h"
+#include "console.h"
+
+// Tamanho maximo de um registro: id, tick e argumentos
+#define LOGBIN_REGISTRO_TAM  (1 + 4 + 4 * LOGBIN_MAX_ARGS)
+
+//! Registros ainda nao enviados
+static MessageBufferHandle_t logbin_buffer;
+
+//! Trava do console, para que os quadros nao se misturem com o texto
+static struct trava *logbin_console_trava;
+
+//! Registros sao descartados na origem quando o log esta desligado
+static volatile bool logbin_ativo = true;
+
+//! Registros descartados por buffer cheio
+static volatile uint32_t logbin_perdidos;
+
+static void logbin_task(void *params);
+
+// Buffer e tarefa alocados estaticamente
+static StaticMessageBuffer_t logbin_buffer_estatico;
+static uint8_t logbin_area[LOGBIN_BUFFER_TAM + 1];
+static StackType_t logbin_pilha[LOGBIN_TASK_PILHA];
+static StaticTask_t logbin_tcb;
+
+/**
+ * \brief Cria o buffer de registros e a tarefa que os envia
+ *
+ * \param console_trava Trava que agrupa as mensagens do console
+ */
+void logbin_init(struct trava *console_trava)
+{
+	logbin_console_trava = console_trava;
+	logbin_buffer = xMessageBufferCreateStatic(LOGBIN_BUFFER_TAM, logbin_area,
+			&logbin_buffer_estatico);
+
+	xTaskCreateStatic(logbin_task,
+			(const char *) "LogBin",
+			LOGBIN_TASK_PILHA,
+			NULL,
+			LOGBIN_TASK_PRIORITY,
+			logbin_pilha,
+			&logbin_tcb);
+}
+
+void logbin_set_ativo(bool ativo)
+{
+	logbin_ativo = ativo;
+}
+
+bool logbin_get_ativo(void)
+{
+	return logbin_ativo;
+}
+
+uint32_t logbin_get_perdidos(void)
+{
+	return logbin_perdidos;
+}
+
+//! Monta o registro cru: id, tick e argumentos, little-endian como na memoria do Cortex-M0+
+static size_t logbin_monta(uint8_t *registro, uint8_t id, uint32_t tick,
+		uint8_t nargs, const int32_t *args)
+{
+	if (nargs > LOGBIN_MAX_ARGS) {
+		nargs = LOGBIN_MAX_ARGS;
+	}
+
+	registro[0] = id;
+	memcpy(&registro[1], &tick, sizeof(tick));
+	memcpy(&registro[5], args, nargs * sizeof(int32_t));
+
+	return 5 + nargs * sizeof(int32_t);
+}
+
+/**
+ * \brief Registra uma mensagem a partir de uma tarefa
+ *
+ * Nunca bloqueia: se o buffer estiver cheio o registro e descartado e contado.
+ * O message buffer admite um unico escritor por vez, por isso a escrita e feita
+ * em secao critica (tarefas e interrupcoes escrevem no mesmo buffer).
+ */
+void logbin_registra(uint8_t id, uint8_t nargs, const int32_t *args)
+{
+	uint8_t registro[LOGBIN_REGISTRO_TAM];
+	size_t tam;
+	size_t enviado;
+	BaseType_t acordou_tarefa = pdFALSE;
+
+	if (!logbin_ativo || logbin_buffer == NULL) {
+		return;
+	}
+
+	tam = logbin_monta(registro, id, xTaskGetTickCount(), nargs, args);
+
+	taskENTER_CRITICAL();
+	enviado = xMessageBufferSendFromISR(logbin_buffer, registro, tam,
+			&acordou_tarefa);
+	if (enviado == 0) {
+		logbin_perdidos++;
+	}
+	taskEXIT_CRITICAL();
+
+	if (acordou_tarefa) {
+		taskYIELD();
+	}
+}
+
+//! Registra uma mensagem a partir de uma interrupcao
+void logbin_registra_isr(uint8_t id, uint8_t nargs, const int32_t *args)
+{
+	uint8_t registro[LOGBIN_REGISTRO_TAM];
+	size_t tam;
+	UBaseType_t mascara;
+	BaseType_t acordou_tarefa = pdFALSE;
+
+	if (!logbin_ativo || logbin_buffer == NULL) {
+		return;
+	}
+
+	tam = logbin_monta(registro, id, xTaskGetTickCountFromISR(), nargs, args);
+
+	mascara = taskENTER_CRITICAL_FROM_ISR();
+	if (xMessageBufferSendFromISR(logbin_buffer, registro, tam,
+			&acordou_tarefa) == 0) {
+		logbin_perdidos++;
+	}
+	taskEXIT_CRITICAL_FROM_ISR(mascara);
+
+	portYIELD_FROM_ISR(acordou_tarefa);
+}
+
+//! Acrescenta um byte ao quadro, com escape dos bytes reservados; devolve a nova posicao
+static size_t logbin_quadro_byte(uint8_t *quadro, size_t pos, uint8_t c)
+{
+	if (c == LOGBIN_INICIO || c == LOGBIN_ESCAPE || c == 0x11 || c == 0x13) {
+		quadro[pos++] = LOGBIN_ESCAPE;
+		c ^= LOGBIN_ESCAPE_XOR;
+	}
+	quadro[pos++] = c;
+	return pos;
+}
+
+/**
+ * \brief Tarefa de envio do log binario
+ *
+ * Roda com a menor prioridade, entao so consome tempo de CPU e banda do console quando
+ * nenhuma outra tarefa precisa deles. Perdas de registros sao informadas com um
+ * registro proprio assim que houver espaco.
+ *
+ * \param params Parameters for the task. (Not used.)
+ */
+static void logbin_task(void *params)
+{
+	uint8_t registro[LOGBIN_REGISTRO_TAM];
+	uint8_t quadro[1 + 2 * (1 + LOGBIN_REGISTRO_TAM)]; // Inicio e, no pior caso, todo byte escapado
+	size_t tam, i, pos;
+	uint32_t perdidos_informados = 0;
+	uint32_t perdidos;
+
+	for (;;) {
+		tam = xMessageBufferReceive(logbin_buffer, registro, sizeof(registro),
+				portMAX_DELAY);
+		// Registros de antes do "logbin off" (ou do endereco no barramento) nao saem mais
+		if (tam == 0 || !logbin_ativo) {
+			continue;
+		}
+
+		quadro[0] = LOGBIN_INICIO;
+		pos = logbin_quadro_byte(quadro, 1, (uint8_t)tam);
+		for (i = 0; i < tam; i++) {
+			pos = logbin_quadro_byte(quadro, pos, registro[i]);
+		}
+
+		// Quadro montado fora da trava e enviado de uma vez
+		trava_toma(logbin_console_trava);
+		console_escreve(quadro, pos);
+		trava_libera(logbin_console_trava);
+
+		perdidos = logbin_perdidos;
+		if (perdidos != perdidos_informados) {
+			perdidos_informados = perdidos;
+			LOGBIN1(LOG_REGISTROS_PERDIDOS, perdidos);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+/**
+ * \file
+ * \brief Log binario diferido
+ *
+ * Tarefas e interrupcoes registram apenas o identificador da mensagem (\ref logbin_msgs.h),
+ * o tick e os argumentos crus em um message buffer. A formatacao nao acontece no firmware:
+ * uma tarefa de baixa prioridade envia os registros pelo console, em quadros delimitados
+ * que o decodificador do host separa do texto normal.
+ *
+ * Formato do quadro no console:
+ * LOGBIN_INICIO, tamanho, payload (id, tick de 32 bits e argumentos de 32 bits, little-endian).
+ * Tamanho e payload passam por escape: bytes LOGBIN_INICIO, LOGBIN_ESCAPE, XON e XOFF sao
+ * enviados como LOGBIN_ESCAPE seguido do byte XOR LOGBIN_ESCAPE_XOR, para nao
+ * interferirem no controle de fluxo nem na sincronizacao.
+ */
+
+#ifndef LOGBIN_H
+#define LOGBIN_H
+
+#include <stdint.h>
+
+// Identificadores das mensagens, gerados a partir da tabela
+#define LOGBIN_MSG(id, formato) id,
+enum logbin_id {
+#include "logbin_msgs.h"
+	LOGBIN_NUM_MSGS
+};
+#undef LOGBIN_MSG
+
+#define LOGBIN_MAX_ARGS     4
+#define LOGBIN_INICIO       0x1E
+#define LOGBIN_ESCAPE       0x1D
+#define LOGBIN_ESCAPE_XOR   0x20
+
+#define LOGBIN_BUFFER_TAM   512  // Bytes do message buffer
+
+#ifndef __cplusplus
+
+#include <asf.h>
+#include "travas.h"
+
+#define LOGBIN_TASK_PRIORITY   (tskIDLE_PRIORITY)
+#define LOGBIN_TASK_PILHA      (configMINIMAL_STACK_SIZE)
+
+void logbin_init(struct trava *console_trava);
+void logbin_set_ativo(bool ativo);
+bool logbin_get_ativo(void);
+uint32_t logbin_get_perdidos(void);
+void logbin_registra(uint8_t id, uint8_t nargs, const int32_t *args);
+void logbin_registra_isr(uint8_t id, uint8_t nargs, const int32_t *args);
+
+// Atalhos para registrar de tarefas
+#define LOGBIN0(id) \
+	logbin_registra((id), 0, NULL)
+#define LOGBIN1(id, a) \
+	do { int32_t _a[1] = { (int32_t)(a) }; logbin_registra((id), 1, _a); } while (0)
+#define LOGBIN2(id, a, b) \
+	do { int32_t _a[2] = { (int32_t)(a), (int32_t)(b) }; logbin_registra((id), 2, _a); } while (0)
+
+// Atalhos para registrar de interrupcoes
+#define LOGBIN1_ISR(id, a) \
+	do { int32_t _a[1] = { (int32_t)(a) }; logbin_registra_isr((id), 1, _a); } while (0)
+
+#endif // __cplusplus
+
+#endif // LOGBIN_H
@@ -0,0 +1,24 @@
+/**
+ * \file
+ * \brief Tabela de mensagens do log binario
+ *
+ * Cada entrada associa um identificador ao texto de formato da mensagem. O firmware envia
+ * apenas o identificador e os argumentos; o decodificador do host (tools/logdecode.cpp)
+ * inclui esta mesma tabela para reconstruir o texto. Novas mensagens devem ser adicionadas
+ * sempre no final, para nao mudar os identificadores dos logs ja gravados.
+ *
+ * Formatos aceitam apenas conversoes de inteiros (%d, %u, %x) e no maximo LOGBIN_MAX_ARGS argumentos.
+ */
+
+// LOGBIN_MSG(identificador, formato)
+LOGBIN_MSG(LOG_RECEBE_INICIADA,    "RecebeComando inicializada")
+LOGBIN_MSG(LOG_SETA_INICIADA,      "SetaComando inicializada")
+LOGBIN_MSG(LOG_PISCA_INICIADA,     "Pisca inicializada")
+LOGBIN_MSG(LOG_BRILHA_INICIADA,    "Brilha inicializada")
+LOGBIN_MSG(LOG_PISCA,              "LED piscando com frequencia de %d Hz, %d vezes")
+LOGBIN_MSG(LOG_PISCA_CANCELADO,    "Pisca substituido apos %d de %d piscadas")
+LOGBIN_MSG(LOG_BRILHA,             "LED brilhando com instensidade de %d %%")
+LOGBIN_MSG(LOG_COMANDO_INVALIDO,   "Comando invalido (erro %d)")
+LOGBIN_MSG(LOG_CONSOLE_PERDIDO,    "Console: buffer de recepcao cheio, %u bytes perdidos")
+LOGBIN_MSG(LOG_CONSOLE_OVERFLOW,   "Console: overflow na USART, %u no total")
+LOGBIN_MSG(LOG_REGISTROS_PERDIDOS, "Log binario: %u registros perdidos")
@@ -28,25 +28,148 @@
 #include <asf.h>
 #include <ctype.h>
 #include <string.h>
+#include "comandos.h"
+#include "console.h"
+#include "logbin.h"
+#include "estatisticas.h"
+#include "trace.h"
+#include "latencia.h"
+#include "energia.h"
+#include "travas.h"
+#include "relogio.h"
+#include "agenda.h"
+#include "gravacao.h"
+#include "barramento.h"
+#include "sincronia.h"
+#include "cdc.h"
+#include "publicacao.h"
+#include "historico.h"
 
 // Prototipo do inicializador
 void CriaTarefas(void);
 
+// Canais de set-point do LED. Cada canal tem uma caixa de correio de uma posicao (last-writer-wins)
+enum {
+	CANAL_BRILHO,
+	CANAL_PISCA,
+	NUM_CANAIS
+};
+
+// Aviso de set-point de um canal do LED, posto por SetaComando na caixa de correio de Brilha/Pisca. O valor
+// nao vai no aviso: a tarefa le o estado publicado (LeEstadoLed), que sempre esta inteiro e e o mais recente
+typedef struct {
+	TickType_t tick; // Instante em que o comando foi interpretado, para medir o atraso ate ser aplicado
+	uint32_t recebido; // Contador de estatisticas quando a linha do comando chegou, para o histograma de latencia
+} SetPoint;
+
+// Configuracao do LED, publicada inteira por SetaComando (ver PublicaEstadoLed/LeEstadoLed)
+typedef struct {
+	int brilho;     // Valor de intensidade do brilho do LED (0 a 100)%
+	int frequencia; // Frequencia a qual o LED deve piscar
+	int brilhaFlag; // Sinaliza que o LED deve brilhar a uma determinada intensidade
+	int piscaFlag;  // Sinaliza que o LED deve piscar a uma determinada frequencia
+	int piscaQtd;   // Quantidade de vezes por qual o LED deve piscar
+} EstadoLed;
+
+// Comando esperando para ser gravado no log
+typedef struct {
+	Comando cmd;
+	uint64_t tempo;  // Hora da execucao (relogio_ms)
+	int valido;
+} RegistroLog;
+
+// Origem de uma linha na fila de comandos
+enum {
+	LINHA_SERIAL,  // Recebida do host por RecebeComando
+	LINHA_AGENDA,  // Comando at/every que disparou
+	LINHA_REPLAY,  // Reproduzida de uma gravacao
+};
+
+// Linha recebida por RecebeComando, enfileirada para SetaComando
+typedef struct {
+	char texto[55];
+	uint32_t recebida; // Contador de estatisticas no '\n' da linha
+	uint8_t origem;
+	uint8_t difusao;   // Linha "@*" do barramento: resposta so na janela deste no
+} Linha;
+
+// Ack de uma difusao, enviado por RespondeBarramento na janela deste no
+typedef struct {
+	uint32_t recebida; // Contador de estatisticas no '\n' da linha: a janela conta dele
+	unsigned long id;
+	enum erro_comando resultado;
+} RespostaBarramento;
+
+// Etapas do boot, marcadas com o contador de estatisticas (zero logo apos o system_init)
+enum {
+	BOOT_SISTEMA,  // Clocks configurados e contador iniciado
+	BOOT_PWM,      // TCC configurado
+	BOOT_LED,      // Ultimo brilho restaurado no PWM (primeira saida de PWM)
+	BOOT_CONSOLE,  // USART e recepcao por interrupcao
+	BOOT_BOD,      // Brown-out detector
+	BOOT_RTC,      // RTC do sono entre comandos
+	BOOT_TAREFAS,  // Tarefas, filas e travas criadas
+	BOOT_EEPROM,   // EEPROM emulada pronta (recuperada na tarefa Inicializa, se preciso)
+	BOOT_PRONTO,   // Mensagens iniciais enviadas e prompt exibido
+	NUM_BOOT
+};
+
+#define ESTADO_MAGICO 0xB1 // Marca a pagina de estado do LED como valida
+#define GRAVACAO_PAGINA ((uint8_t)(estadoPagina - CONF_GRAVACAO_PAGINAS)) // Paginas do "record": logo antes da pagina de estado
+#define LOG_PAGINAS ((uint8_t)(GRAVACAO_PAGINA - 1))      // Paginas de registros do log (historico.h): entre o cabecalho e a gravacao
+
+#if EEPROM_PAGE_SIZE != HISTORICO_PAGINA_TAM
+#  error "HISTORICO_PAGINA_TAM deve ser o EEPROM_PAGE_SIZE da EEPROM emulada"
+#endif
+
+#define COMANDO_FILA_TAM 16 // Quantidade de linhas que RecebeComando pode enfileirar a frente de SetaComando (janela maxima do host)
+#define RESPOSTA_FILA_TAM 4 // Acks de difusao esperando a janela deste no
+#define BATCH_MAX 32       // Quantidade maxima de comandos em um lote (begin ... commit)
+#define CONSOLE_INTERATIVO() (modoAck == 0 && console_get_endereco() == 0) // Eco, prompt e mensagens de erro (fora do modo ack e do barramento)
+
 // Prototipos das tarefas
+void Inicializa(void);
 void RecebeComando(void);
 void SetaComando(void);
+void RespondeBarramento(void);
 void Pisca(void);
 void Brilha(void);
 
 // Prototipos das funes de setup
 void configure_tcc(void);
 void configure_usart(void);
-void configure_eeprom(void);
+enum status_code configure_eeprom(void);
 void configure_bod(void);
+void configure_sincronia(void);
+void RecuperaEeprom(enum status_code error_code);
+void ConfiguraPaginaEstado(void);
+void RestauraLed(void);
+void SalvaEstadoLed(void);
+void PublicaEstadoLed(void);
+void LeEstadoLed(EstadoLed *estado);
+void MarcaBoot(int etapa);
 
 // Prototipos das funoes auxiliares das tarefas
 long Alema1map(long x, long in_min, long in_max, long out_min, long out_max);
 int CalculaPeriodo(int freq);
+void PublicaSetPoint(int canal);
+void RegistraAplicado(int canal, const SetPoint *sp);
+enum erro_comando ProcessaComando(const Comando *cmd);
+void ExecutaComando(const Comando *cmd);
+void ImprimeErro(enum erro_comando erro, const Comando *cmd);
+void PublicaEstado(void);
+void RegistraLog(const Comando *cmd);
+void CarregaLog(void);
+void ImprimeLog(const Comando *cmd);
+void GravaLog(const RegistroLog *registro);
+void DescarregaLogPendente(void);
+void ConfirmaLog(void);
+bool EnfileiraAgendado(const Comando *cmd);
+bool EnfileiraReproduzida(const char *texto);
+void EsperaJanelaBarramento(uint32_t recebida);
+void SincroniaPulso(void);
+bool LeTempoMestre(uint32_t *ms);
+TickType_t TicksAteMestre(uint32_t ms);
 
 // Configurao do PWM
 #define CONF_PWM_MODULE   TCC0
@@ -56,6 +179,11 @@ int CalculaPeriodo(int freq);
 #define PWM_PERIOD 1000
 #define DUTY_CYCLE 1 // Porcentagem de aumento/decremento
 #define PWM_STEP (PWM_PERIOD *DUTY_CYCLE) / 100
+
+// Pulso de sincronia (opcional): uma borda de subida a cada CONF_SINCRONIA_PULSO_MS, vinda do mestre
+//#define CONF_SINCRONIA_PINO   PIN_PA28A_EIC_EXTINT8
+//#define CONF_SINCRONIA_MUX    MUX_PA28A_EIC_EXTINT8
+//#define CONF_SINCRONIA_CANAL  8
 
 struct usart_module usart_instance;
 struct usart_config usart_conf;
@@ -73,6 +201,7 @@ void configure_tcc() {
 	config_tcc.pins.enable_wave_out_pin[CONF_PWM_OUTPUT] = true;
 	config_tcc.pins.wave_out_pin[CONF_PWM_OUTPUT]        = CONF_PWM_OUT_PIN;
 	config_tcc.pins.wave_out_pin_mux[CONF_PWM_OUTPUT]    = CONF_PWM_OUT_MUX;
+	config_tcc.run_in_standby = true; // Mantem o brilho do LED com o nucleo em standby ("power standby on")
 	
 	tcc_init(&tcc_instance, CONF_PWM_MODULE, &config_tcc);
 	tcc_enable(&tcc_instance);
@@ -80,8 +209,12 @@ void configure_tcc() {
 }
 
 // Setup USART
-void configure_usart(){
-	
+void configure_usart(){
+	
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	// Console na USB nativa (CDC-ACM): a USART do EDBG nao e configurada
+	console_init(NULL);
+#else
 	usart_get_config_defaults(&usart_conf);
 	usart_conf.baudrate    = 9600;
 	usart_conf.mux_setting = EDBG_CDC_SERCOM_MUX_SETTING;
@@ -89,22 +222,37 @@ void configure_usart(){
 	usart_conf.pinmux_pad1 = EDBG_CDC_SERCOM_PINMUX_PAD1;
 	usart_conf.pinmux_pad2 = EDBG_CDC_SERCOM_PINMUX_PAD2;
 	usart_conf.pinmux_pad3 = EDBG_CDC_SERCOM_PINMUX_PAD3;
-	stdio_serial_init(&usart_instance, EDBG_CDC_MODULE, &usart_conf);
+	usart_conf.run_in_standby = true;               // Recebe com o nucleo em standby
+	usart_conf.start_frame_detection_enable = true; // O inicio de um byte acorda o nucleo
+	// A saida usa console_printf()/console_puts(), entao o stdio da newlib (stdio_serial_init) nao e necessario
+	usart_init(&usart_instance, EDBG_CDC_MODULE, &usart_conf);
 		
-	usart_enable(&usart_instance);
+	usart_enable(&usart_instance);
+	
+	// Recepcao por interrupcao com controle de fluxo (XON/XOFF ou RTS/CTS)
+	console_init(&usart_instance);
+#endif
 }
 
 // Setup MVN
-void configure_eeprom(void){
+// Apenas inicializa: com a EEPROM emulada integra isso so le os cabecalhos das paginas. A recuperacao
+// (que pode apagar toda a EEPROM emulada) e lenta e fica para RecuperaEeprom(), na tarefa Inicializa
+enum status_code configure_eeprom(void){
 	
 	// Setup EEPROM emulator service
-	enum status_code error_code = eeprom_emulator_init();
+	return eeprom_emulator_init();
+}
+
+// Recupera a EEPROM emulada quando configure_eeprom() falhou (chamar com o escalonador rodando)
+void RecuperaEeprom(enum status_code error_code){
 
 //! [check_init_ok]
 	if (error_code == STATUS_ERR_NO_MEMORY) {
-		while (true) {
-			/* No EEPROM section has been set in the device's fuses */
+		/* No EEPROM section has been set in the device's fuses */
+		if(console_get_endereco() == 0){
+			console_puts("EEPROM emulada sem secao reservada nos fuses: comandos desativados\n");
 		}
+		vTaskSuspend(NULL);
 	}
 //! [check_init_ok]
 //! [check_re-init]
@@ -143,50 +291,117 @@ int CalculaPeriodo(int freq){
 }
 
 // Variaveis globais a serem usadas pelas threads
-int brilho;                          // Valor de intensidade do brilho do LED (0 a 100)%
-int frequencia;                      // Frequencia a qual o LED deve piscar
-int brilhaFlag;                      // Sinaliza que o LED deve brilhar a uma determinada intensidade
-int piscaFlag;                       // Sinaliza que o LED deve piscar a uma determinada frequencia
-int piscaQtd;                        // Quantidade de vezes por qual o LED deve piscar
-int newBufferAvailable = 0;          // Sinaliza novo comando a ser interpretado
-char buffer[55];                     // Buffer compartilhado por onde os comandos so passados
-char buffer2[55];
-static xSemaphoreHandle mutex;       // Mutex para sincronizacao
-uint8_t page_data[EEPROM_PAGE_SIZE]; // Buffer para leitura de EEPROM emulada
-
-// Handles das tarefas
-xTaskHandle SetaComandoHandle;
-xTaskHandle RecebeComandoHandle;
-xTaskHandle PiscaHandle;
-xTaskHandle BrilhaHandle;
+static EstadoLed led;                // Configuracao do LED em edicao pelos comandos (so quem tem travaComando)
+static EstadoLed ledCopias[2];       // Duas copias da ultima configuracao publicada, lidas sem trava
+static struct publicacao ledPublicado = PUBLICACAO_INICIO(ledCopias);
+uint8_t page_data[EEPROM_PAGE_SIZE]; // Buffer para leitura de EEPROM emulada
+static xQueueHandle comandoQueue;    // Fila de linhas recebidas por RecebeComando, consumida por SetaComando
+static xQueueHandle respostaQueue;   // Acks de difusao, enviados por RespondeBarramento
+static xQueueHandle ledMailbox[NUM_CANAIS];        // Caixas de correio de set-points, uma posicao por canal
+static RegistroLog logPendente[NUM_CANAIS];        // Ultimo comando de cada canal ainda nao gravado no log
+static uint32_t logOrdem[NUM_CANAIS];              // Ordem de chegada dos comandos pendentes, para grava-los em sequencia
+static uint32_t logContador;
+volatile uint32_t ledAplicados[NUM_CANAIS];        // Set-points efetivamente aplicados ao LED
+volatile uint32_t ledDescartados[NUM_CANAIS];      // Set-points sobrescritos antes de serem aplicados
+volatile uint32_t ledLagMax[NUM_CANAIS];           // Maior atraso (em ticks) entre interpretar e aplicar um set-point
+uint32_t logDescartados;                           // Comandos de set-point que nao chegaram a ser gravados no log
+static int logSujo;                                // Ha paginas do log escritas mas ainda nao confirmadas na flash
+static int canaisAlterados;                        // Canais (bits) alterados por comandos ainda nao publicados
+static int emBatch;                                // Sinaliza que os comandos estao sendo agrupados em um lote
+static int batchErro;                              // Lote atual contem comando invalido e sera descartado
+static int batchQtd;                               // Quantidade de comandos no lote atual
+static Comando batch[BATCH_MAX];                   // Comandos do lote atual, ja interpretados
+volatile int modoAck;                              // Modo de acks compactos: sem eco, sem prompt e sem mensagens de erro
+static uint8_t enderecoNo;                         // Endereco no barramento (0: console comum), guardado na pagina de estado
+static int enderecoSalvo = -1;                     // Ultimo endereco gravado na pagina de estado
+static uint32_t barramentoAtrasadas;               // Respostas a difusao que perderam o inicio da janela do no
+static uint32_t barramentoPerdidas;                // Respostas a difusao descartadas com a fila de respostas cheia
+static struct sincronia sincronia;                 // Tempo do mestre para o pisca em fase (escrito tambem pela interrupcao do pulso)
+static uint32_t linhaRecebida;                     // Instante de recepcao da linha em execucao por SetaComando
+static uint8_t linhaOrigem;                        // Origem da linha em execucao (LINHA_SERIAL, ...)
+static uint32_t logRecebida;                       // Instante de recepcao da linha mais antiga com log ainda nao confirmado
+static enum status_code eepromStatus;              // Resultado da inicializacao rapida da EEPROM emulada
+static uint8_t estadoPagina;                       // Pagina da EEPROM com o ultimo brilho (a ultima); gravacao e log usam as anteriores
+static int estadoSalvo = -1;                       // Ultimo brilho gravado na pagina de estado
+static struct historico logHistorico;              // Anel de paginas do log na EEPROM emulada (so com travaLog)
+static uint32_t bootTempo[NUM_BOOT]; // Contador de estatisticas ao fim de cada etapa do boot
+static const char *const bootNomes[NUM_BOOT] = { "sistema", "pwm", "led", "console", "bod", "rtc", "tarefas", "eeprom", "pronto" };
+
+// Travas, cada uma dona de um recurso. Ordem para tomar mais de uma: travaComando -> travaConsole -> travaLog
+//  - travaComando: lote e a copia de edicao do estado do LED ("led"), escritos so por quem a tem.
+//                  Os demais leem o estado publicado (LeEstadoLed) ou recebem set-points e nao a tomam
+//  - travaConsole: mensagens de varias partes (eco, saida de um comando, quadros do logbin) saem inteiras
+//  - travaLog:     EEPROM emulada (log, pagina de estado, "page_data") e set-points pendentes de gravacao
+static struct trava travaComando;
+static struct trava travaConsole;
+static struct trava travaLog;
+
+#if (configSUPPORT_STATIC_ALLOCATION != 1)
+#  error "main.c aloca tarefas, filas e mutex estaticamente: defina configSUPPORT_STATIC_ALLOCATION 1 no FreeRTOSConfig.h"
+#endif
+
+// Tabela das tarefas: nome (funcao), pilha (em palavras) e prioridade. Pilhas e TCBs sao alocados
+// estaticamente a partir dela, entao a RAM usada pelas tarefas e conhecida na ligacao
+#define TAREFAS \
+	TAREFA(Inicializa,         configMINIMAL_STACK_SIZE + 100,  tskIDLE_PRIORITY + 1) \
+	TAREFA(RecebeComando,      configMINIMAL_STACK_SIZE + 1000, tskIDLE_PRIORITY + 1) \
+	TAREFA(SetaComando,        configMINIMAL_STACK_SIZE + 500,  tskIDLE_PRIORITY + 1) \
+	TAREFA(RespondeBarramento, configMINIMAL_STACK_SIZE + 100,  tskIDLE_PRIORITY + 2) \
+	TAREFA(Brilha,             configMINIMAL_STACK_SIZE + 100,  tskIDLE_PRIORITY + 1) \
+	TAREFA(Pisca,              configMINIMAL_STACK_SIZE + 100,  tskIDLE_PRIORITY + 2)
+
+// Handles, pilhas e TCBs das tarefas
+#define TAREFA(nome, pilha, prioridade) \
+	xTaskHandle nome##Handle; \
+	static StackType_t nome##Pilha[pilha]; \
+	static StaticTask_t nome##Tcb;
+TAREFAS
+#undef TAREFA
+
+// Armazenamento das filas
+static StaticQueue_t comandoQueueBuffer;
+static uint8_t comandoQueueArea[COMANDO_FILA_TAM * sizeof(Linha)];
+static StaticQueue_t respostaQueueBuffer;
+static uint8_t respostaQueueArea[RESPOSTA_FILA_TAM * sizeof(RespostaBarramento)];
+static StaticQueue_t ledMailboxBuffer[NUM_CANAIS];
+static uint8_t ledMailboxArea[NUM_CANAIS][sizeof(SetPoint)];
 
 int main(){
 	
-	// Setup da placa
-	system_init();
-	configure_tcc();
-	configure_usart();
-	configure_eeprom();
-	configure_bod();
+	// Setup da placa. O contador de estatisticas e iniciado logo apos os clocks para medir cada etapa
+	system_init();
+	estatisticas_init_contador();
+	MarcaBoot(BOOT_SISTEMA);
 	
 	// Inicializa variaveis globais
-	brilho = 0;
-	frequencia = 0;
-	brilhaFlag = 0;
-	piscaFlag = 0;
-
-	printf("Criando tarefas\n");
+	memset(&led, 0, sizeof(led));
+	
+	// Caminho rapido: o LED volta ao ultimo brilho antes do console e das tarefas
+	configure_tcc();
+	MarcaBoot(BOOT_PWM);
+	eepromStatus = configure_eeprom();
+	RestauraLed();
+	MarcaBoot(BOOT_LED);
+	
+	configure_usart();
+	console_set_endereco(enderecoNo); // Endereco no barramento, lido da pagina de estado por RestauraLed
+	if(enderecoNo != 0){
+		logbin_set_ativo(false);      // No barramento o no so fala quando perguntado: sem quadros do logbin
+	}
+	MarcaBoot(BOOT_CONSOLE);
+	configure_bod();
+	MarcaBoot(BOOT_BOD);
+	energia_init();
+	configure_sincronia();
+	MarcaBoot(BOOT_RTC);
 
-	// Cria tarefas e inicializa suas variaveis
+	// Cria tarefas e inicializa suas variaveis. Mensagens iniciais e recuperacao da EEPROM ficam para a tarefa Inicializa
 	CriaTarefas();
-
-	printf("Inicializando escalonador do freeRTOS\n");
+	MarcaBoot(BOOT_TAREFAS);
 
 	// Inicia escalonador do freeRTOS
 	vTaskStartScheduler();
 
-	printf("Tarefas executando\n");
-
 	do {
 		// Executa tarefas concorrentemente
 	} while (true);
@@ -194,41 +409,98 @@ int main(){
 
 void CriaTarefas(){
 
-	int rc;
+	int canal;
 
-	// Inicializa mutex
-	mutex = xSemaphoreCreateMutex();
+	// Inicializa travas (ja nomeadas para o "trace dump")
+	trava_init(&travaComando, "comando");
+	trava_init(&travaConsole, "console");
+	trava_init(&travaLog, "log");
 	
-	// Cria tarefas
-	rc = xTaskCreate(RecebeComando, (const char *) "RecebeComando", configMINIMAL_STACK_SIZE + 1000, NULL, tskIDLE_PRIORITY + 1, &RecebeComandoHandle);
-	if(rc == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY){
-		printf("Nao foi possivel inicializar a tarefa RecebeComando\n");
-	}
+	// Log binario diferido, enviado pelo console com a mesma trava do texto
+	logbin_init(&travaConsole);
 	
-	rc = xTaskCreate(SetaComando, (const char *) "SetaComando", configMINIMAL_STACK_SIZE + 500, NULL, tskIDLE_PRIORITY + 1, &SetaComandoHandle);
-	if(rc == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY){
-		printf("Nao foi possivel inicializar a tarefa SetaComando\n");
-	}
+	// Comandos at/every: os que disparam voltam pela fila de comandos
+	agenda_init(EnfileiraAgendado);
 	
-	rc = xTaskCreate(Brilha, (const char *) "Brilha", configMINIMAL_STACK_SIZE + 100, NULL, tskIDLE_PRIORITY + 1, &BrilhaHandle);
-	if(rc == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY){
-		printf("Nao foi possivel inicializar a tarefa Brilha\n");
-	}
+	// Gravacao das linhas do host, guardada na EEPROM emulada e reproduzida pela fila de comandos
+	gravacao_init(&travaLog, EnfileiraReproduzida);
 	
-	rc = xTaskCreate(Pisca, (const char *) "Pisca", configMINIMAL_STACK_SIZE + 100, NULL, tskIDLE_PRIORITY + 2, &PiscaHandle);
-	if(rc == errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY){
-		printf("Nao foi possivel inicializar a tarefa Pisca\n");
+	// Inicializa fila de comandos e caixas de correio dos set-points
+	comandoQueue = xQueueCreateStatic(COMANDO_FILA_TAM, sizeof(Linha), comandoQueueArea, &comandoQueueBuffer);
+	respostaQueue = xQueueCreateStatic(RESPOSTA_FILA_TAM, sizeof(RespostaBarramento), respostaQueueArea, &respostaQueueBuffer);
+	for(canal = 0 ; canal < NUM_CANAIS ; canal++){
+		ledMailbox[canal] = xQueueCreateStatic(1, sizeof(SetPoint), ledMailboxArea[canal], &ledMailboxBuffer[canal]);
 	}
 	
-	printf("Tarefas criadas\nSuspendendo tarefas\n");
+	// Nomes usados pelo "trace dump"
+	trace_nomeia_fila(comandoQueue, "comandoQueue");
+	trace_nomeia_fila(respostaQueue, "respostaQueue");
+	trace_nomeia_fila(ledMailbox[CANAL_BRILHO], "mailboxBrilho");
+	trace_nomeia_fila(ledMailbox[CANAL_PISCA], "mailboxPisca");
+	
+	// Cria tarefas. Com pilha e TCB estaticos a criacao nao tem como falhar por falta de memoria
+#define TAREFA(nome, pilha, prioridade) \
+	nome##Handle = xTaskCreateStatic(nome, (const char *) #nome, pilha, NULL, prioridade, nome##Pilha, &nome##Tcb);
+	TAREFAS
+#undef TAREFA
+	
+	// SetaComando, Pisca e Brilha nao sao suspensas: ficam bloqueadas esperando comandos/set-points nas suas filas
 	
-	// Suspende tarefas at serem acordas
-	vTaskSuspend(SetaComandoHandle);
-	vTaskSuspend(BrilhaHandle);
-	vTaskSuspend(PiscaHandle);
+}
+
+// Pilha e TCB da tarefa IDLE; com configSUPPORT_STATIC_ALLOCATION o kernel pede essa memoria a aplicacao
+void vApplicationGetIdleTaskMemory(StaticTask_t **tcb, StackType_t **pilha, uint32_t *tamanho){
+	
+	static StaticTask_t idleTcb;
+	static StackType_t idlePilha[configMINIMAL_STACK_SIZE];
+	
+	*tcb = &idleTcb;
+	*pilha = idlePilha;
+	*tamanho = configMINIMAL_STACK_SIZE;
+}
+
+#if (configUSE_TIMERS == 1)
+// Pilha e TCB da tarefa dos software timers
+void vApplicationGetTimerTaskMemory(StaticTask_t **tcb, StackType_t **pilha, uint32_t *tamanho){
 	
-	printf("Programa pronto para ser inicializado\n");
+	static StaticTask_t timerTcb;
+	static StackType_t timerPilha[configTIMER_TASK_STACK_DEPTH];
 	
+	*tcb = &timerTcb;
+	*pilha = timerPilha;
+	*tamanho = configTIMER_TASK_STACK_DEPTH;
+}
+#endif
+
+// Trabalho de boot que nao precisa atrasar o LED: recuperacao da EEPROM emulada e mensagens iniciais
+void Inicializa(){
+	
+	uint32_t hz;
+	
+	if(eepromStatus != STATUS_OK){
+		RecuperaEeprom(eepromStatus);
+		ConfiguraPaginaEstado();
+	}
+	CarregaLog();
+	gravacao_carrega(GRAVACAO_PAGINA);
+	MarcaBoot(BOOT_EEPROM);
+	
+	// SetaComando grava o log e o estado do LED na EEPROM: so comeca depois dela pronta
+	xTaskNotifyGive(SetaComandoHandle);
+	
+	// No barramento nada sai sem ser perguntado: nem o aviso de pronto
+	hz = estatisticas_get_freq_contador();
+	trava_toma(&travaConsole);
+	if(console_get_endereco() == 0){
+		console_printf("Programa pronto (LED em %lu us)\n", (uint32_t)(((uint64_t)bootTempo[BOOT_LED] * 1000000) / hz));
+	}
+	if(CONSOLE_INTERATIVO()){
+		console_puts("\nComando>");
+	}
+	MarcaBoot(BOOT_PRONTO);
+	trava_libera(&travaConsole);
+	
+	vTaskDelete(NULL);
 }
 
 // Receives a string through UART containing the command to be executed and its arguments
@@ -236,332 +508,1155 @@ void RecebeComando(){
 
 	int i = 0;
 	char currentChar;
+	static Linha recebido; // Linha sendo recebida (SetaComando trabalha sobre uma copia)
 
-	xSemaphoreTake(mutex, portMAX_DELAY);
-	//printf("RecebeComando inicializada\n");
-	xSemaphoreGive(mutex);
+	// O primeiro prompt e exibido pela tarefa Inicializa, depois das mensagens iniciais
+	LOGBIN0(LOG_RECEBE_INICIADA);
 
 	while(1){
 		
-		// Get command from terminal through UART
-		xSemaphoreTake(mutex, portMAX_DELAY);
-		
-		// Atomically receives command
-		printf("%s", "\nComando>");
+		// Get command from terminal through UART. The console lock is only held to echo each char,
+		// so SetaComando keeps executing queued commands while the next line arrives
 		while(1){
-			currentChar = getchar();
-			printf("%c", currentChar);
+			currentChar = console_getc();
+			
+			// Broadcast marker from the bus address filter: not part of the command
+			if(currentChar == BARRAMENTO_DIFUSAO && i == 0){
+				recebido.difusao = 1;
+				continue;
+			}
+			
+			// No echo in ack mode (the host matches replies by sequence ID) nor on a shared bus
+			if(CONSOLE_INTERATIVO()){
+				trava_toma(&travaConsole);
+				console_putc(currentChar);
+				trava_libera(&travaConsole);
+			}
 			
 			if (currentChar == '\r'){ // Ignores \r
 				continue; 
 			} else if (currentChar == '\n'){ // Terminates buffer string
-				buffer[i] = '\0';
+				recebido.texto[i] = '\0';
 				break;
-			} else { 
-				buffer[i] = currentChar;
+			} else if (i < (int) sizeof(recebido.texto) - 1){ // Discards chars beyond buffer size
+				recebido.texto[i] = currentChar;
 				i++;
 			}
 		}
 		
-		i = 0;
-		newBufferAvailable = 1;
-		
-		// Gives up mutex
-		xSemaphoreGive(mutex);
+		// Marks the end of reception: every latency stage is measured from here
+		recebido.recebida = estatisticas_get_contador();
 		
-		// Wakes up SetaComando and waits until command is processed
-		vTaskResume(SetaComandoHandle);
-		vTaskDelay(1);
+		// Queues command for SetaComando, blocking only if the queue is full
+		xQueueSend(comandoQueue, &recebido, portMAX_DELAY);
 		
-		// Waits for command to be processed
-		while(1){
-			xSemaphoreTake(mutex, portMAX_DELAY);
-			if (newBufferAvailable == 0){
-				// Cleans buffer
-				for(i = 0 ; i < 55 ; i++){
-					buffer[i] = '\0';
-				}
-				i = 0;
-				xSemaphoreGive(mutex);
-				break;
-			}
-			xSemaphoreGive(mutex);
+		// Cleans buffer
+		for(i = 0 ; i < 55 ; i++){
+			recebido.texto[i] = '\0';
 		}
+		recebido.difusao = 0;
+		i = 0;
 		
-		//xSemaphoreTake(mutex, portMAX_DELAY);
-		//printf("\nEsperando SetaComando processar o comando\n");
-		//xSemaphoreGive(mutex);
-		//vTaskSuspend(RecebeComandoHandle);
-		
-		// Only reaches this point when task is woken up by SetaComando
+	}
+
+}
+
+// Devolve um comando agendado que disparou para a fila de comandos (chamada pela tarefa dos timers).
+// Nao bloqueia: com a fila cheia o disparo e perdido e contado pela agenda
+bool EnfileiraAgendado(const Comando *cmd){
+	
+	Linha linha;
+	
+	memset(&linha, 0, sizeof(linha));
+	FormataComando(cmd, linha.texto, sizeof(linha.texto));
+	linha.recebida = estatisticas_get_contador();
+	linha.origem = LINHA_AGENDA;
+	return xQueueSend(comandoQueue, &linha, 0) == pdTRUE;
+}
+
+// Devolve uma linha gravada para a fila de comandos (chamada pela tarefa dos timers, sem bloquear)
+bool EnfileiraReproduzida(const char *texto){
+	
+	Linha linha;
+	
+	memset(&linha, 0, sizeof(linha));
+	strncpy(linha.texto, texto, sizeof(linha.texto) - 1);
+	linha.recebida = estatisticas_get_contador();
+	linha.origem = LINHA_REPLAY;
+	return xQueueSend(comandoQueue, &linha, 0) == pdTRUE;
+}
+
+// Espera a janela de resposta deste no a uma difusao, contada da recepcao da linha (chamada por RespondeBarramento, sem travas)
+void EsperaJanelaBarramento(uint32_t recebida){
+	
+	uint32_t hz = estatisticas_get_freq_contador();
+	uint32_t janela = (uint32_t)(((uint64_t)BARRAMENTO_ATRASO_US(console_get_endereco()) * hz) / 1000000);
+	uint32_t passou = estatisticas_get_contador() - recebida;
+	TickType_t ticks;
+	
+	// Execucao mais longa que a janela: responde ja, com risco de colisao (CONF_BARRAMENTO_SLOT_US pequeno demais)
+	if(passou >= janela){
+		barramentoAtrasadas++;
+		return;
+	}
+	
+	// Dorme os ticks inteiros e completa no contador, para o inicio da janela nao depender do tick
+	ticks = (TickType_t)((((uint64_t)(janela - passou) * 1000) / hz) / portTICK_PERIOD_MS);
+	if(ticks > 1){
+		vTaskDelay(ticks - 1);
+	}
+	while(estatisticas_get_contador() - recebida < janela){
+	}
+}
+
+// Envia os acks das difusoes, cada um na janela deste no. SetaComando so os enfileira e segue com as
+// linhas seguintes, sem esperar a janela com travaComando; a travaConsole so e tomada para transmitir
+void RespondeBarramento(){
+	
+	RespostaBarramento resposta;
+	
+	while(1){
+		xQueueReceive(respostaQueue, &resposta, portMAX_DELAY);
+		EsperaJanelaBarramento(resposta.recebida);
 		
+		trava_toma(&travaConsole);
+		if(resposta.resultado == ERRO_OK){
+			console_printf("=%u ok %lu\n", console_get_endereco(), resposta.id);
+		} else {
+			console_printf("=%u err %lu %d\n", console_get_endereco(), resposta.id, resposta.resultado);
+		}
+		trava_libera(&travaConsole);
 	}
+}
+
+// Pulso de sincronia no pino: acerta o modelo com o RTC do instante do pulso (energia_get_rtc64 conta
+// a volta do RTC ainda pendente, entao a leitura vale nesta interrupcao)
+void SincroniaPulso(void){
+	
+	sincronia_pulso(&sincronia, energia_get_rtc64(), CONF_SINCRONIA_PULSO_MS);
+}
+
+// Modelo do tempo do mestre e, se houver pino, interrupcao do pulso de sincronia (depois do RTC)
+void configure_sincronia(void){
+	
+#ifdef CONF_SINCRONIA_PINO
+	struct extint_chan_conf config_extint;
+#endif
+	
+	sincronia_init(&sincronia);
+	
+#ifdef CONF_SINCRONIA_PINO
+	extint_chan_get_config_defaults(&config_extint);
+	config_extint.gpio_pin           = CONF_SINCRONIA_PINO;
+	config_extint.gpio_pin_mux       = CONF_SINCRONIA_MUX;
+	config_extint.gpio_pin_pull      = EXTINT_PULL_UP;
+	config_extint.detection_criteria = EXTINT_DETECT_RISING;
+	config_extint.wake_if_sleeping   = true;
+	extint_chan_set_config(CONF_SINCRONIA_CANAL, &config_extint);
+	extint_register_callback(SincroniaPulso, CONF_SINCRONIA_CANAL, EXTINT_CALLBACK_TYPE_DETECT);
+	extint_chan_enable_callback(CONF_SINCRONIA_CANAL, EXTINT_CALLBACK_TYPE_DETECT);
+#endif
+}
+
+// Tempo do mestre agora; false se a placa ainda nao recebeu sincronia. O RTC e lido com as interrupcoes
+// ligadas e so a copia do modelo (escrito tambem pela interrupcao do pulso) fica na secao critica
+bool LeTempoMestre(uint32_t *ms){
+	
+	struct sincronia copia;
+	uint64_t agora = energia_get_rtc64();
+	
+	system_interrupt_enter_critical_section();
+	copia = sincronia;
+	system_interrupt_leave_critical_section();
+	
+	*ms = sincronia_para_mestre(&copia, agora);
+	return copia.ativa;
+}
 
+// Ticks ate o instante "ms" do mestre, arredondados ao tick mais proximo (0 se ja passou)
+TickType_t TicksAteMestre(uint32_t ms){
+	
+	struct sincronia copia;
+	uint64_t alvo, agora;
+	
+	agora = energia_get_rtc64();
+	system_interrupt_enter_critical_section();
+	copia = sincronia;
+	system_interrupt_leave_critical_section();
+	alvo = sincronia_para_local(&copia, ms);
+	
+	if(alvo <= agora){
+		return 0;
+	}
+	return (TickType_t)(((alvo - agora) * configTICK_RATE_HZ + ENERGIA_RTC_HZ / 2) / ENERGIA_RTC_HZ);
 }
 
 // Executes the command received through UART by thread RecebeComando
 void SetaComando(){
 
-	int i, j = 0;
-	uint8_t page_line_counter;
-	char* args[3];
+	int i;
+	char *atual, *proximo;
+	enum erro_comando erro, resultado;
+	unsigned long id;
+	int temId;
+	int gravando;
+	Comando cmd;
+	Linha linha;
+	char texto[sizeof(linha.texto)]; // Copia da linha, picada por strchr() e passada a minusculas
+	RespostaBarramento resposta;
+	
+	LOGBIN0(LOG_SETA_INICIADA);
 	
-	xSemaphoreTake(mutex, portMAX_DELAY);
-	//printf("SetaComando inicializada\n");
-	xSemaphoreGive(mutex);
+	// Espera a tarefa Inicializa deixar a EEPROM emulada pronta
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
 	while(1){
 
-		// Waits for wake-up from RecebeComando
+		// Waits for the next command queued by RecebeComando
+		xQueueReceive(comandoQueue, &linha, portMAX_DELAY);
 		
-		// Begins interpreting given command
-		xSemaphoreTake(mutex, portMAX_DELAY);
-		vTaskSuspend(RecebeComandoHandle);
+		// Begins interpreting given command. The console is only locked while a command prints,
+		// so echo and logbin frames are not held back by parsing or by the flash commit
+		trava_toma(&travaComando);
+		memcpy(texto, linha.texto, sizeof(texto));
+		linhaRecebida = linha.recebida;
+		linhaOrigem = linha.origem;
 		
-			// Formata o buffer 
+		// Only host lines are recorded, and not the ones that start or stop the recording
+		gravando = (linha.origem == LINHA_SERIAL) && gravacao_get_ativa();
 		
-		// Convert all chars to lowercase
-		for(i = 0 ; i < 55 ; i++){
-			if(buffer[i] == '\n'){
-				buffer[i] = ' '; // If given command has no arguments, inserts ' ' separator so strtok() can do its thing
-			}
-			buffer[i] = tolower(buffer[i]);
-		}
-
-		// Set arguments (finds ' ' between command and its arguments)
-		args[0] = strtok(buffer, " ");
-		args[1] = strtok(NULL, " ");
-		args[2] = strtok(NULL, " ");
+		// Every node on the bus executes a broadcast: only the ack may be sent, in this node's slot.
+		// On the bus the node only speaks when asked, so fired jobs and replayed lines run muted too
+		if(linha.difusao || (console_get_endereco() != 0 && linha.origem != LINHA_SERIAL)){
+			console_set_mudo(true);
+		}
 		
-			// Interpreta comando
-
-		// Compare args[0] with specific command literals to determine which command to execute
-		if( strcmp(args[0], "blink") == 0 || strcmp(args[0], "pisca") == 0 ){
-			
-			if( atoi(args[1]) > 33){
-				printf("AVISO: FREQUENCIA DESEJADA MAIOR DO QUE A FREQUENCIA SUPORTADA\n");
+			// Formata o buffer 
+		
+		// Convert all chars to lowercase
+		for(i = 0 ; i < (int) sizeof(texto) ; i++){
+			if(texto[i] == '\n'){
+				texto[i] = ' '; // If given command has no arguments, inserts ' ' separator so strtok() can do its thing
 			}
-			
-			vTaskSuspend(BrilhaHandle);
-			frequencia = atoi(args[1]);
-			piscaQtd = atoi(args[2]);
-			brilhaFlag = 0;
-			piscaFlag = 1;
-			vTaskResume(PiscaHandle);
+			texto[i] = tolower(texto[i]);
 		}
-
-		else if( strcmp(args[0], "brightness") == 0 || strcmp(args[0], "brilho") == 0 || strcmp(args[0], "brilha") == 0){
-			
-			// If LED brightness value is between 0 and 100, sets it to that value, else, prints error msg
-			if(atoi(args[1]) <= 100 && atoi(args[1]) > 0){
-				vTaskSuspend(PiscaHandle);
-				brilho = atoi(args[1]);
-				piscaFlag = 0;
-				brilhaFlag = 1;
-				vTaskResume(BrilhaHandle);
-			} else {
-				printf("Insira um valor valido (entre 0 e 100) para o valor de brilho desejado\n");
-			}
+		
+			// Interpreta e executa cada comando da linha (separados por ';')
+		
+		// Optional sequence ID ("#<id> <commands>"): the line is answered with "ok <id>" or "err <id> <code>",
+		// so the host can keep several lines in flight instead of waiting for the prompt
+		proximo = texto;
+		temId = 0;
+		id = 0;
+		if(texto[0] == '#'){
+			id = strtoul(texto + 1, &proximo, 10);
+			temId = 1;
 		}
 		
-		else if( strcmp(args[0], "print") == 0 || strcmp(args[0], "mostrar") == 0 ){
+		resultado = ERRO_OK;
+		while(proximo != NULL){
+			atual = proximo;
+			proximo = strchr(atual, ';');
+			if(proximo != NULL){
+				*proximo = '\0';
+				proximo++;
+			}
 			
-			if( strcmp(args[1], "brightness") == 0 || strcmp(args[1], "brilho") == 0 ){
-				
-				// Prints LED brightness
-				if(brilhaFlag == 1){
-					printf("Brilho atual do LED: %d%%\n", brilho);
-				} else {
-					printf("LED nao esta programado para brilhar a uma instensidade fixa\n");
+			erro = InterpretaComando(atual, &cmd);
+			if(erro == ERRO_VAZIO){
+				continue; // Empty commands are ignored and not logged
+			} else if(erro == ERRO_OK){
+				latencia_registra(LAT_INTERPRETA, linhaRecebida);
+				trava_toma(&travaConsole);
+				erro = ProcessaComando(&cmd);
+				trava_libera(&travaConsole);
+			} else {
+				LOGBIN1(LOG_COMANDO_INVALIDO, erro);
+				if(CONSOLE_INTERATIVO()){
+					ImprimeErro(erro, &cmd);
+				}
+				if(emBatch){
+					batchErro = 1; // Batch com comando invalido sera descartado no commit
 				}
 			}
 			
-			else if( strcmp(args[1], "freq") == 0 ){
-				
-				// Prints LED frequency
-				if(piscaFlag == 1){
-					printf("Ultima frequencia do LED: %d\n", frequencia);
-				} else {
-					printf("LED nao foi programado para piscar\n");
-				}						
+			// The ack carries the first error of the line
+			if(erro != ERRO_OK && resultado == ERRO_OK){
+				resultado = erro;
 			}
-				
-			else if( strcmp(args[1], "log") == 0 ){
-				
-				// Prints log
-				eeprom_emulator_read_page(0, page_data);
-				page_line_counter = page_data[0];
-				for(i = 1 ; i < page_line_counter ; i++){
-					eeprom_emulator_read_page(i, page_data);
-					
-					for (j = 0 ; j < 56 ; j++){
-						printf("%c", page_data);
-					}
-					
-					printf("\n");
+		}
+		
+		if(gravando && gravacao_get_ativa()){
+			gravacao_registra(linha.texto, linha.recebida);
+		}
+		
+		// Ack and prompt are single console calls and need no console lock.
+		// On the bus the ack starts with "=<address>", so the host knows which node answered.
+		// A broadcast ack waits for this node's slot in RespondeBarramento, not here with travaComando
+		console_set_mudo(false);
+		if(linha.difusao){
+			if(temId){
+				resposta.recebida = linha.recebida;
+				resposta.id = id;
+				resposta.resultado = resultado;
+				if(xQueueSend(respostaQueue, &resposta, 0) != pdTRUE){
+					barramentoPerdidas++;
 				}
 			}
+		} else if(temId && console_get_endereco() != 0){
+			if(resultado == ERRO_OK){
+				console_printf("=%u ok %lu\n", console_get_endereco(), id);
+			} else {
+				console_printf("=%u err %lu %d\n", console_get_endereco(), id, resultado);
+			}
+		} else if(temId){
+			if(resultado == ERRO_OK){
+				console_printf("ok %lu\n", id);
+			} else {
+				console_printf("err %lu %d\n", id, resultado);
+			}
+		}
+		
+		// Nothing else queued: flush pending set-points, commit the log and show the prompt again
+		if(uxQueueMessagesWaiting(comandoQueue) == 0){
+			trava_toma(&travaLog);
+			DescarregaLogPendente();
+			ConfirmaLog();
+			trava_libera(&travaLog);
+			if(CONSOLE_INTERATIVO()){
+				console_puts("\nComando>");
+			}
 		}
 
-		else if( strcmp(args[0], "exit") == 0 || strcmp(args[0], "sair" ) == 0){
-			printf("Saindo do programa\n");
-			tcc_set_compare_value(&tcc_instance, 0, 1001);
-			exit(EXIT_SUCCESS);
+		trava_libera(&travaComando);
+	}
+
+}
+
+// Trata os comandos de lote e enfileira no lote ou executa imediatamente os demais (chamar com travaComando e travaConsole tomadas)
+enum erro_comando ProcessaComando(const Comando *cmd){
+	
+	int i;
+	
+	if(cmd->tipo == CMD_BEGIN){
+		if(emBatch){
+			console_puts("AVISO: lote anterior descartado\n");
 		}
+		emBatch = 1;
+		batchErro = 0;
+		batchQtd = 0;
+	}
+	
+	else if(cmd->tipo == CMD_ABORT){
+		emBatch = 0;
+		console_puts("Lote descartado\n");
+	}
+	
+	else if(cmd->tipo == CMD_COMMIT){
+		if(emBatch == 0){
+			console_puts("Nenhum lote iniciado (use begin)\n");
+			return ERRO_LOTE;
+		}
+		emBatch = 0;
+		
+		if(batchErro){
+			console_puts("Lote descartado: contem comandos invalidos\n");
+			return ERRO_LOTE;
+		}
+		
+		// Lote inteiro ja foi interpretado: executa, publica o estado final do LED uma unica vez e grava o log com um so commit
+		for(i = 0 ; i < batchQtd ; i++){
+			ExecutaComando(&batch[i]);
+		}
+		PublicaEstado();
+		trava_toma(&travaLog);
+		DescarregaLogPendente();
+		ConfirmaLog();
+		trava_libera(&travaLog);
+		console_printf("Lote aplicado (%d comandos)\n", batchQtd);
+	}
+	
+	else if(emBatch){
+		if(batchQtd < BATCH_MAX){
+			batch[batchQtd] = *cmd;
+			batchQtd++;
+		} else {
+			console_printf("Lote cheio (maximo de %d comandos)\n", BATCH_MAX);
+			batchErro = 1;
+			return ERRO_LOTE;
+		}
+	}
+	
+	else{
+		ExecutaComando(cmd);
+		PublicaEstado();
+	}
+	
+	return ERRO_OK;
+}
+
+// Executes a parsed command. Changed LED channels are only flagged in "canaisAlterados"; PublicaEstado() sends them to the LED tasks
+void ExecutaComando(const Comando *cmd){
 
-		else if( strcmp(args[0], "help") == 0 || strcmp(args[0], "ajuda" ) == 0){
-			printf("Comandos validos:");
-			printf("\n\tBlink/Pisca       : LED pisca com a frequencia desejada por uma quantidade de vezes (pisca <frequencia> <qtd>)");
-			printf("\n\tBrightness/Brilha : LED brilha com a intensidade desejada (0%% a 100%%) (brilha <instensidade>)");
-			printf("\n\tPrint             : Exibe valor desejado (print <freq, brilho, brightness, log>");
-			printf("\n\tExir/Sair         : Fecha o programa");
-			printf("\n\tHelp/Ajuda        : Exibe novamente esse menu\n");
+	int i;
+	struct console_estatisticas consoleEst;
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+	struct cdc_estatisticas cdcEst;
+#endif
+	uint32_t hz;
+	EstadoLed estado;
+	int job;
+	uint64_t rtc;
+	uint32_t mestre;
+	struct sincronia copiaSincronia;
+
+	// at/every: so agenda; o comando e executado (e registrado no log) quando disparar
+	if(cmd->agenda != AGENDA_NENHUMA){
+		job = agenda_insere(cmd, cmd->agenda_ms, cmd->agenda == AGENDA_PERIODICA);
+		if(job < 0){
+			console_printf("Agenda cheia (maximo de %d jobs)\n", CONF_AGENDA_MAX);
+		} else {
+			console_printf("job %d\n", job);
+		}
+		return;
+	}
+
+	if(cmd->tipo == CMD_PISCA){
+		
+		if(cmd->arg[0] > 33){
+			console_puts("AVISO: FREQUENCIA DESEJADA MAIOR DO QUE A FREQUENCIA SUPORTADA\n");
 		}
 		
-		else if( strcmp(args[0], "reset") == 0){
+		led.frequencia = cmd->arg[0];
+		led.piscaQtd = cmd->arg[1];
+		led.brilhaFlag = 0;
+		led.piscaFlag = 1;
+		
+		// Inicia novo job de pisca, substituindo o que estiver em andamento
+		canaisAlterados |= (1 << CANAL_PISCA);
+	}
+
+	else if(cmd->tipo == CMD_BRILHO){
+		
+		// Cancela pisca em andamento e publica o novo brilho; apenas o mais recente sera aplicado
+		if(led.piscaFlag == 1){
+			canaisAlterados |= (1 << CANAL_PISCA);
+		}
+		led.brilho = cmd->arg[0];
+		led.piscaFlag = 0;
+		led.brilhaFlag = 1;
+		canaisAlterados |= (1 << CANAL_BRILHO);
+	}
+	
+	else if(cmd->tipo == CMD_PRINT){
+		
+		// Prints what the LED is doing: the last published state (inside a batch, the state before it)
+		LeEstadoLed(&estado);
+		
+		if(cmd->alvo == ALVO_BRILHO){
 			
-			if(strcmp(args[1], "brilho") == 0){
-				
-				// Resets brightness
-				brilhaFlag = 0;
-				brilho = 0;
-				vTaskSuspend(BrilhaHandle);
-				tcc_set_compare_value(&tcc_instance, 0, 1001);
-				
-			} else if(strcmp(args[1], "freq") == 0){
-				
-				// Resets blinking frequency
-				piscaFlag = 0;
-				frequencia = 0;
-				vTaskSuspend(PiscaHandle);
-				tcc_set_compare_value(&tcc_instance, 0, 1001);
-				
-			} else if(strcmp(args[1], "log") == 0){
-				
-				// Resets log line counter
-				eeprom_emulator_read_page(0, page_data);
-				page_data[0] = 0;
-				eeprom_emulator_write_page(0, page_data);
-				eeprom_emulator_commit_page_buffer();
+			// Prints LED brightness
+			if(estado.brilhaFlag == 1){
+				console_printf("Brilho atual do LED: %d%%\n", estado.brilho);
+			} else {
+				console_puts("LED nao esta programado para brilhar a uma instensidade fixa\n");
 			}
+		}
+		
+		else if(cmd->alvo == ALVO_FREQ){
 			
+			// Prints LED frequency
+			if(estado.piscaFlag == 1){
+				console_printf("Ultima frequencia do LED: %d\n", estado.frequencia);
+			} else {
+				console_puts("LED nao foi programado para piscar\n");
+			}						
+		}
+			
+		else if(cmd->alvo == ALVO_MAILBOX){
+			
+			// Prints set-points applied/coalesced per channel
+			console_puts("canal aplicados descartados lag_max_ms\n");
+			console_printf("brilho %lu %lu %lu\n", ledAplicados[CANAL_BRILHO], ledDescartados[CANAL_BRILHO], ledLagMax[CANAL_BRILHO] * portTICK_PERIOD_MS);
+			console_printf("pisca %lu %lu %lu\n", ledAplicados[CANAL_PISCA], ledDescartados[CANAL_PISCA], ledLagMax[CANAL_PISCA] * portTICK_PERIOD_MS);
+			console_printf("log_descartados %lu\n", logDescartados);
+		}
+			
+		else if(cmd->alvo == ALVO_CONSOLE){
+			
+			// Prints console reception statistics
+			console_get_estatisticas(&consoleEst);
+			console_printf("fluxo %d\n", console_get_fluxo());
+			console_printf("recebidos %lu\n", consoleEst.recebidos);
+			console_printf("perdidos %lu\n", consoleEst.perdidos);
+			console_printf("overflows %lu\n", consoleEst.overflows);
+			console_printf("pausas %lu expiradas %lu\n", consoleEst.pausas, consoleEst.pausas_expiradas);
+			console_printf("ocupacao_max %u/%u\n", consoleEst.ocupacao_max, CONSOLE_RX_TAM);
+			console_printf("endereco %u quadros %lu descartados %lu atrasadas %lu perdidas %lu\n", console_get_endereco(),
+					consoleEst.quadros_aceitos, consoleEst.quadros_descartados, barramentoAtrasadas, barramentoPerdidas);
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+			system_interrupt_enter_critical_section();
+			cdc_get_estatisticas(&cdcEst);
+			system_interrupt_leave_critical_section();
+			console_printf("usb %s pacotes_rx %lu pacotes_tx %lu zlps %lu retencoes %lu resets %lu\n",
+					cdc_get_conectado() ? "conectado" : "desconectado", cdcEst.pacotes_rx, cdcEst.pacotes_tx,
+					cdcEst.zlps, cdcEst.retencoes, cdcEst.resets);
+#endif
+			console_printf("logbin %d perdidos %lu\n", logbin_get_ativo(), logbin_get_perdidos());
+		}
+			
+		else if(cmd->alvo == ALVO_BOOT){
+			
+			// Prints the end of each boot stage, from the counter start right after system_init()
+			hz = estatisticas_get_freq_contador();
+			console_puts("etapa us\n");
+			for(i = 0 ; i < NUM_BOOT ; i++){
+				console_printf("%s %lu\n", bootNomes[i], (uint32_t)(((uint64_t)bootTempo[i] * 1000000) / hz));
+			}
 		}
+			
+		else if(cmd->alvo == ALVO_LOG){
+			
+			// Prints log (all, last N or since a sequence number)
+			ImprimeLog(cmd);
+		}
+	}
+
+	else if(cmd->tipo == CMD_SAIR){
+		console_puts("Saindo do programa\n");
+		tcc_set_compare_value(&tcc_instance, 0, 1001);
+		exit(EXIT_SUCCESS);
+	}
 
-		else{
-			printf("Insira um comando vlido (Insira \"Help/Ajuda\" para saber mais)\n");
+	else if(cmd->tipo == CMD_AJUDA){
+		console_puts("Comandos validos:");
+		console_puts("\n\tBlink/Pisca       : LED pisca com a frequencia desejada por uma quantidade de vezes (pisca <frequencia> <qtd>)");
+		console_puts("\n\tBrightness/Brilha : LED brilha com a intensidade desejada (0% a 100%) (brilha <instensidade>)");
+		console_puts("\n\tPrint             : Exibe valor desejado (print <freq, brilho, brightness, log, mailbox, console, boot>");
+		console_puts("\n\t                    O log pode ser filtrado: print log last <n> ou print log since <sequencia>");
+		console_puts("\n\tReset             : Desliga o LED ou apaga o log (reset <freq, brilho, log>)");
+		console_puts("\n\tExir/Sair         : Fecha o programa");
+		console_puts("\n\tHelp/Ajuda        : Exibe novamente esse menu");
+		console_puts("\n\tBegin/Commit/Abort: Agrupa comandos em um lote, aplicado de uma so vez no commit");
+		console_puts("\n\tAck               : Liga/desliga o modo de acks compactos, sem eco nem prompt (ack <on, off>)");
+		console_puts("\n\tFlow/Fluxo        : Controle de fluxo do console (flow <none, xonxoff, rtscts>)");
+		console_puts("\n\tLogbin            : Liga/desliga o log binario no console (logbin <on, off>)");
+		console_puts("\n\tStats             : Exibe tempo de CPU e pilha livre de cada tarefa e o uso do heap");
+		console_puts("\n\tTrace             : Grava trocas de tarefa e uso de mutex/filas, ou envia o que foi gravado (trace <on, off, dump>)");
+		console_puts("\n\tLatency/Latencia  : Exibe p50/p99/max do atraso de cada estagio desde a recepcao da linha (latency [reset])");
+		console_puts("\n\tLocks/Travas      : Exibe, por trava e tarefa, quantas vezes houve espera e quanto tempo (locks [reset])");
+		console_puts("\n\tTime/Hora         : Exibe a hora do RTC ou a acerta com a hora Unix do host (time [set <epoch>])");
+		console_puts("\n\tPower/Energia     : Exibe acordadas por segundo e tempo dormindo, ou liga o standby (power [standby <on, off>])");
+		console_puts("\n\tAt/Every          : Executa um comando daqui a <ms>, ou a cada <ms> (at <ms> <comando>, every <ms> <comando>)");
+		console_puts("\n\tJobs              : Exibe os comandos agendados; cancel <id> cancela um deles");
+		console_puts("\n\tSync/Sincronia    : Marca o tempo do mestre (ms) para piscar em fase com outras placas (sync [<ms>, off])");
+		console_puts("\n\tAddress/Endereco  : Endereco no barramento; so aceita \"@<endereco> <cmd>\" e \"@* <cmd>\" (address [<1-247>, off])");
+		console_puts("\n\tRecord/Grava      : Grava as linhas recebidas e seus intervalos na EEPROM (record [start, stop, dump])");
+		console_puts("\n\tReplay/Reproduz   : Reenvia a gravacao nos tempos gravados, mais rapido ou sem esperas (replay [<velocidade>, max, stop])");
+		console_puts("\n\tVarios comandos podem ser enviados na mesma linha, separados por ';'");
+		console_puts("\n\tUma linha iniciada por #<id> e respondida com \"ok <id>\" ou \"err <id> <codigo>\"\n");
+	}
+	
+	else if(cmd->tipo == CMD_ACK){
+		
+		// Console setting, not logged
+		modoAck = cmd->arg[0];
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_STATS){
+		
+		// Diagnostic only, not logged
+		estatisticas_imprime();
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_TRACE){
+		
+		// Diagnostic only, not logged
+		if(cmd->arg[0] == TRACE_OP_DUMP){
+			trace_descarrega();
+		} else {
+			trace_set_ativo(cmd->arg[0] == TRACE_OP_LIGA);
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_LATENCIA){
+		
+		// Diagnostic only, not logged
+		if(cmd->arg[0]){
+			latencia_zera();
+		} else {
+			latencia_imprime();
 		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_TRAVAS){
 		
-		//eeprom_emulator_read_page(0, page_data);
-		//printf("Page_data[0]: %d\n", page_data[0]);
-		//page_data[0]++;
-		//eeprom_emulator_write_page(0, page_data);
-		//eeprom_emulator_commit_page_buffer();
-		//
+		// Diagnostic only, not logged
+		if(cmd->arg[0]){
+			travas_zera();
+		} else {
+			travas_imprime();
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_RELOGIO){
 		
-			// Salva na memoria EEPROM o buffer
+		if(cmd->arg[0] == RELOGIO_OP_MOSTRA){
+			relogio_imprime(); // Diagnostic only, not logged
+			return;
+		}
 		
-		// Le primeira pagina da memoria EEPROM emulada e armazena no buffer "page_data"
-		eeprom_emulator_read_page(0, page_data);
-		page_line_counter = page_data[0];
+		// Acerto do relogio: o proximo registro do log (este comando) leva a hora nova completa
+		relogio_set((uint32_t) cmd->arg[1]);
+		trava_toma(&travaLog);
+		logHistorico.absoluto = true;
+		trava_libera(&travaLog);
+	}
+	
+	else if(cmd->tipo == CMD_JOBS){
 		
-		// Se contador de paginas == 255 (valor maximo para inteiro de 8 bits), printa aviso
-		//if(page_line_counter == 255){
-			//printf("AVISO: ULTIMA LINHA DO LOG, PROXIMO COMANDO SOBREESCREVERA PRIMEIRA LINHA\n");
-		//}
+		// Diagnostic only, not logged
+		agenda_imprime();
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_CANCELA){
 		
-		// Primeira pagina aponta para a proxima pagina a ser escrita
-		page_data[0]++;
-		if(page_data[0] == 0){
-			page_data[0] = 1; // Nao sobreescreve contador
+		// Job cancellation, not logged
+		if(!agenda_cancela(cmd->arg[0])){
+			console_printf("Nenhum job %d\n", cmd->arg[0]);
 		}
-		page_line_counter = page_data;
-		eeprom_emulator_write_page(0, page_data);
-
-		// Limpa dados anteriores da pagina
-		eeprom_emulator_read_page(page_line_counter, buffer);
-		for(i = 0 ; i < 56 ; i++){
-			page_data[i] = '\0';
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_SINCRONIA){
+		
+		// Timing only, not logged
+		if(cmd->arg[0] == SINCRONIA_OP_QUADRO){
+			
+			// The frame marks the master time at the end of its line: back-date the RTC to that instant
+			hz = estatisticas_get_freq_contador();
+			rtc = energia_get_rtc64() - ((uint64_t)(estatisticas_get_contador() - linhaRecebida) * ENERGIA_RTC_HZ) / hz;
+			system_interrupt_enter_critical_section();
+			sincronia_quadro(&sincronia, rtc, (uint32_t) cmd->arg[1]);
+			system_interrupt_leave_critical_section();
+		} else if(cmd->arg[0] == SINCRONIA_OP_DESLIGA){
+			system_interrupt_enter_critical_section();
+			sincronia_init(&sincronia);
+			system_interrupt_leave_critical_section();
+		} else {
+			system_interrupt_enter_critical_section();
+			copiaSincronia = sincronia;
+			system_interrupt_leave_critical_section();
+			LeTempoMestre(&mestre);
+			console_printf("sync %s mestre_ms %lu quadros %lu pulsos %lu\n", copiaSincronia.ativa ? "on" : "off",
+					copiaSincronia.ativa ? mestre : 0, copiaSincronia.quadros, copiaSincronia.pulsos);
+			console_printf("erro_us %ld erro_max_us %ld ppm %ld\n",
+					(long)(((int64_t)copiaSincronia.erro * 1000000) / ENERGIA_RTC_HZ),
+					(long)(((int64_t)copiaSincronia.erro_max * 1000000) / ENERGIA_RTC_HZ),
+					(long)(copiaSincronia.taxa_medida ? sincronia_ppm(&copiaSincronia) : 0));
 		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_ENDERECO){
 		
-		// Copia buffer para memoria EEPROM, na posio determinada pelo primeiro elemento da pagina 0 (page_line_counter)
-		strncpy(page_data, buffer, 55);
-		eeprom_emulator_write_page(page_line_counter, page_data);
+		// Node setting, saved with the LED state instead of logged
+		if(cmd->arg[0] == ENDERECO_OP_MOSTRA){
+			console_printf("address %u\n", console_get_endereco());
+		} else {
+			enderecoNo = (uint8_t) cmd->arg[1];
+			SalvaEstadoLed();
+			console_set_endereco(enderecoNo);
+			if(enderecoNo != 0){
+				logbin_set_ativo(false); // Quadros do logbin colidiriam com as respostas de outros nos
+			}
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_GRAVACAO || cmd->tipo == CMD_REPRODUZ){
 		
-		// Escreve definitivamente na memoria EEPROM o contador de paginas e o comando atual
+		// Record/replay control, not logged. A replayed line cannot restart the replay
+		if(linhaOrigem == LINHA_REPLAY){
+			console_puts("record/replay ignorado durante a reproducao\n");
+		} else if(cmd->tipo == CMD_REPRODUZ && cmd->arg[0] == REPRODUZ_OP_PARA){
+			gravacao_interrompe();
+		} else if(cmd->tipo == CMD_REPRODUZ){
+			if(!gravacao_reproduz((uint32_t) cmd->arg[1])){
+				console_puts("Nada para reproduzir (ou gravacao em andamento)\n");
+			}
+		} else if(cmd->arg[0] == GRAVACAO_OP_INICIA){
+			if(!gravacao_inicia(linhaRecebida)){
+				console_puts("Reproducao em andamento (use replay stop)\n");
+			}
+		} else if(cmd->arg[0] == GRAVACAO_OP_PARA){
+			gravacao_para();
+			gravacao_imprime(false);
+		} else {
+			gravacao_imprime(cmd->arg[0] == GRAVACAO_OP_LISTA);
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_ENERGIA){
+		
+		// Diagnostic/power setting, not logged
+		if(cmd->arg[0] == ENERGIA_OP_RELATORIO){
+			energia_imprime();
+		} else {
+			energia_set_standby(cmd->arg[0] == ENERGIA_OP_STANDBY_LIGA);
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_LOGBIN){
+		
+		// Console setting, not logged. On the bus the node only speaks when asked
+		if(cmd->arg[0] && console_get_endereco() != 0){
+			console_puts("logbin indisponivel no barramento (address off antes)\n");
+		} else {
+			logbin_set_ativo(cmd->arg[0]);
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_FLUXO){
+		
+		// Console setting, not logged
+		if(!console_set_fluxo(cmd->arg[0])){
+			console_puts("RTS/CTS indisponivel: defina CONF_CONSOLE_RTS_PIN e CONF_CONSOLE_CTS_PIN\n");
+		}
+		return;
+	}
+	
+	else if(cmd->tipo == CMD_RESET){
+		
+		if(cmd->alvo == ALVO_BRILHO){
+			
+			// Resets brightness
+			led.brilhaFlag = 0;
+			led.brilho = 0;
+			canaisAlterados |= (1 << CANAL_BRILHO);
+			
+		} else if(cmd->alvo == ALVO_FREQ){
+			
+			// Resets blinking frequency (Pisca turns the LED off when its job is cancelled)
+			led.piscaFlag = 0;
+			led.frequencia = 0;
+			canaisAlterados |= (1 << CANAL_PISCA);
+			
+		} else if(cmd->alvo == ALVO_LOG){
+			
+			// Empties the log (pending entries are dropped). Sequence numbers keep growing
+			trava_toma(&travaLog);
+			memset(logPendente, 0, sizeof(logPendente));
+			historico_inicia(&logHistorico, logHistorico.indice.proximo);
+			eeprom_emulator_commit_page_buffer();
+			logSujo = 0;
+			trava_libera(&travaLog);
+			return;
+		}
+		
+	}
+	
+		// Salva na memoria EEPROM o comando
+	
+	RegistraLog(cmd);
+}
+
+// Imprime a mensagem correspondente a um erro de interpretacao
+void ImprimeErro(enum erro_comando erro, const Comando *cmd){
+	
+	if(erro == ERRO_DESCONHECIDO){
+		console_puts("Insira um comando vlido (Insira \"Help/Ajuda\" para saber mais)\n");
+	} else if(cmd->tipo == CMD_BRILHO){
+		console_puts("Insira um valor valido (entre 0 e 100) para o valor de brilho desejado\n");
+	} else {
+		console_puts("Argumentos invalidos (Insira \"Help/Ajuda\" para saber mais)\n");
+	}
+}
+
+// Publica para as tarefas do LED os canais alterados pelos ultimos comandos executados
+void PublicaEstado(void){
+	
+	// O estado vai antes dos avisos: a tarefa avisada ja encontra a configuracao nova
+	if(canaisAlterados != 0){
+		PublicaEstadoLed();
+	}
+	
+	// Pisca primeiro: ao ser cancelado ele apaga o LED, e o brilho publicado em seguida prevalece
+	if(canaisAlterados & (1 << CANAL_PISCA)){
+		PublicaSetPoint(CANAL_PISCA);
+	}
+	if(canaisAlterados & (1 << CANAL_BRILHO)){
+		PublicaSetPoint(CANAL_BRILHO);
+	}
+	if(canaisAlterados != 0){
+		SalvaEstadoLed();
+	}
+	canaisAlterados = 0;
+}
+
+// Publica a copia de edicao do estado do LED sem travar (chamar com travaComando tomada: um so escritor).
+// O escritor nunca espera e um leitor de prioridade maior nunca fica preso esperando o escritor (publicacao.h)
+void PublicaEstadoLed(void){
+	publicacao_escreve(&ledPublicado, &led);
+}
+
+// Le o ultimo estado publicado do LED, de qualquer tarefa e sem travar
+void LeEstadoLed(EstadoLed *estado){
+	publicacao_le(&ledPublicado, estado);
+}
+
+// Marca o fim de uma etapa do boot
+void MarcaBoot(int etapa){
+	bootTempo[etapa] = estatisticas_get_contador();
+}
+
+// Usa a ultima pagina da EEPROM emulada para o estado do LED (as paginas sao enderecadas com 8 bits)
+void ConfiguraPaginaEstado(void){
+	
+	struct eeprom_emulator_parameters params;
+	
+	eeprom_emulator_get_parameters(&params);
+	estadoPagina = (params.eeprom_number_of_pages > 256) ? 255 : params.eeprom_number_of_pages - 1;
+}
+
+// Caminho rapido do boot: aplica direto no PWM o ultimo brilho gravado, sem esperar o escalonador
+void RestauraLed(void){
+	
+	uint8_t estado[EEPROM_PAGE_SIZE];
+	
+	// EEPROM emulada precisa de recuperacao: o LED fica apagado ate o primeiro comando
+	if(eepromStatus != STATUS_OK){
+		return;
+	}
+	
+	ConfiguraPaginaEstado();
+	eeprom_emulator_read_page(estadoPagina, estado);
+	if(estado[0] == ESTADO_MAGICO && estado[1] >= 1 && estado[1] <= 100){
+		led.brilho = estado[1];
+		led.brilhaFlag = 1;
+		tcc_set_compare_value(&tcc_instance, 0, Alema1map(led.brilho,1,100,1000,1));
+		PublicaEstadoLed();
+	}
+	estadoSalvo = (estado[0] == ESTADO_MAGICO) ? estado[1] : -1;
+	if(estado[0] == ESTADO_MAGICO && estado[2] <= BARRAMENTO_ENDERECO_MAX){
+		enderecoNo = estado[2];
+		enderecoSalvo = enderecoNo;
+	}
+}
+
+// Grava o brilho atual e o endereco na pagina de estado; a confirmacao na flash vai junto com a do log (chamar com travaComando tomada)
+void SalvaEstadoLed(void){
+	
+	uint8_t estado[EEPROM_PAGE_SIZE];
+	int valor = led.brilhaFlag ? led.brilho : 0; // Pisca e um job finito: no boot o LED volta apagado
+	
+	if(valor == estadoSalvo && enderecoNo == enderecoSalvo){
+		return;
+	}
+	
+	trava_toma(&travaLog);
+	memset(estado, 0, sizeof(estado));
+	estado[0] = ESTADO_MAGICO;
+	estado[1] = (uint8_t) valor;
+	estado[2] = enderecoNo;
+	eeprom_emulator_write_page(estadoPagina, estado);
+	estadoSalvo = valor;
+	enderecoSalvo = enderecoNo;
+	if(logSujo == 0){
+		logRecebida = linhaRecebida;
+	}
+	logSujo = 1;
+	trava_libera(&travaLog);
+}
+
+// Registra um comando executado no log (chamar com travaComando tomada)
+void RegistraLog(const Comando *cmd){
+	
+	RegistroLog registro;
+	int canal = -1;
+	
+	registro.cmd = *cmd;
+	registro.tempo = relogio_ms();
+	registro.valido = 1;
+	
+	if(cmd->tipo == CMD_PISCA){
+		canal = CANAL_PISCA;
+	} else if(cmd->tipo == CMD_BRILHO){
+		canal = CANAL_BRILHO;
+	}
+	
+	// Set-points are only logged once the command queue drains, and only the newest one per channel,
+	// so a host streaming values does not pay one EEPROM commit per intermediate value
+	trava_toma(&travaLog);
+	if(canal >= 0){
+		if(logPendente[canal].valido){
+			logDescartados++;
+		}
+		logPendente[canal] = registro;
+		logOrdem[canal] = logContador++;
+	} else {
+		// Keeps log order: pending set-points are written before the current command
+		DescarregaLogPendente();
+		GravaLog(&registro);
+	}
+	trava_libera(&travaLog);
+}
+
+// Avisa o canal de um novo set-point pela caixa de correio. Se o aviso anterior ainda nao foi atendido, ele e descartado
+void PublicaSetPoint(int canal){
+	
+	SetPoint sp;
+	
+	sp.tick = xTaskGetTickCount();
+	sp.recebido = linhaRecebida;
+	
+	// Suspende o escalonador para que o consumidor nao retire o set-point entre o teste e a sobrescrita
+	vTaskSuspendAll();
+	if(uxQueueMessagesWaiting(ledMailbox[canal]) != 0){
+		ledDescartados[canal]++;
+	}
+	xQueueOverwrite(ledMailbox[canal], &sp);
+	xTaskResumeAll();
+}
+
+// Contabiliza um set-point aplicado por Brilha/Pisca e o atraso desde que foi interpretado
+void RegistraAplicado(int canal, const SetPoint *sp){
+	
+	TickType_t lag = xTaskGetTickCount() - sp->tick;
+	
+	ledAplicados[canal]++;
+	if(lag > ledLagMax[canal]){
+		ledLagMax[canal] = lag;
+	}
+}
+
+// Acesso do log (historico.c) as paginas da EEPROM emulada
+static void LePaginaLog(uint8_t pagina, uint8_t *dados){
+	eeprom_emulator_read_page(pagina, dados);
+}
+
+static void EscrevePaginaLog(uint8_t pagina, const uint8_t *dados){
+	eeprom_emulator_write_page(pagina, dados);
+}
+
+// Leitura de uma pagina pela consulta do log, que roda sem a travaLog entre uma pagina e outra
+static void LePaginaLogTravada(uint8_t pagina, uint8_t *dados){
+	trava_toma(&travaLog);
+	eeprom_emulator_read_page(pagina, dados);
+	trava_libera(&travaLog);
+}
+
+// Le o cabecalho do log (pagina 0) e conta os registros da pagina atual. Um log em formato antigo e descartado
+void CarregaLog(void){
+	
+	historico_init(&logHistorico, LOG_PAGINAS, LePaginaLog, EscrevePaginaLog);
+	if(!historico_carrega(&logHistorico)){
 		eeprom_emulator_commit_page_buffer();
+	}
+}
+
+// Grava um comando no log da EEPROM emulada (chamar com travaLog tomada). Os registros sao codificados
+// (ver CodificaComando) e cada pagina comeca com a sequencia do seu primeiro registro (historico.h)
+void GravaLog(const RegistroLog *registro){
+	
+	historico_grava(&logHistorico, &registro->cmd, registro->tempo);
+	
+	// A escrita definitiva na flash fica para ConfirmaLog(), uma vez por linha/lote
+	if(logSujo == 0){
+		logRecebida = linhaRecebida;
+	}
+	logSujo = 1;
+}
 
-		// Signals command has been executed
-		newBufferAvailable = 0;
-		vTaskResume(RecebeComandoHandle);
-		xSemaphoreGive(mutex);
-		vTaskDelay(1);
+// Escreve definitivamente na memoria EEPROM as paginas do log alteradas (chamar com travaLog tomada)
+void ConfirmaLog(void){
+	
+	if(logSujo){
+		eeprom_emulator_commit_page_buffer();
+		logSujo = 0;
+		latencia_registra(LAT_LOG, logRecebida);
 	}
+}
+
+// Imprime um registro da consulta do log, "<sequencia> <segundos>.<ms> <comando>"
+static void ImprimeRegistroLog(void *contexto, uint32_t seq, uint64_t tempo, const Comando *registro){
+	
+	char texto[COMANDO_TAM];
+	char hora[RELOGIO_TEXTO_TAM];
+	
+	(void) contexto;
+	FormataComando(registro, texto, sizeof(texto));
+	relogio_texto(tempo, hora, sizeof(hora));
+	console_printf("%lu %s %s\n", seq, hora, texto);
+}
 
+// Imprime os registros pedidos (tudo, last <n> ou since <seq>). O indice e copiado com a travaLog; depois cada
+// pagina e lida com a travaLog e impressa fora dela
+void ImprimeLog(const Comando *cmd){
+	
+	struct historico_indice indice;
+	
+	// Pending entries are committed first so they show up
+	trava_toma(&travaLog);
+	DescarregaLogPendente();
+	ConfirmaLog();
+	indice = logHistorico.indice;
+	trava_libera(&travaLog);
+	
+	historico_consulta(&indice, cmd->arg[0], (uint32_t) cmd->arg[1], LePaginaLogTravada, ImprimeRegistroLog, NULL);
+}
+
+// Grava no log os set-points pendentes, na ordem em que chegaram (chamar com travaLog tomada)
+void DescarregaLogPendente(void){
+	
+	int canal, proximo;
+	
+	while(1){
+		proximo = -1;
+		for(canal = 0 ; canal < NUM_CANAIS ; canal++){
+			if(logPendente[canal].valido && (proximo < 0 || logOrdem[canal] < logOrdem[proximo])){
+				proximo = canal;
+			}
+		}
+		
+		if(proximo < 0){
+			break;
+		}
+		
+		GravaLog(&logPendente[proximo]);
+		logPendente[proximo].valido = 0;
+	}
 }
 
 void Pisca(){
 	
-	// "piscaFlag"  variavel global declarada em main.c
+	// O aviso do job chega pela caixa de correio do canal; frequencia e quantidade vem do estado publicado
 	int i = 0;
+	int qtd;
+	int valor;
+	int novoJob = 0;
+	SetPoint sp;
+	EstadoLed estado;
+	TickType_t meioPeriodo;
+	TickType_t espera;
+	bool emFase;
+	uint32_t periodo = 0;
+	uint32_t borda = 0;
 	
-	xSemaphoreTake(mutex, portMAX_DELAY);
-	//printf("Pisca inicializada\n");
-	xSemaphoreGive(mutex);
+	LOGBIN0(LOG_PISCA_INICIADA);
 	
 	while(1){
 		
-		if(piscaFlag == 0){
-			vTaskSuspend(PiscaHandle);
+		// Espera SetaComando publicar um novo job (ou o cancelamento do atual, com frequencia 0).
+		// Nenhuma trava e usada, ficando livres para RecebeComando/SetaComando durante todo o pisca
+		if(novoJob == 0){
+			xQueueReceive(ledMailbox[CANAL_PISCA], &sp, portMAX_DELAY);
+		}
+		novoJob = 0;
+		RegistraAplicado(CANAL_PISCA, &sp);
+		LeEstadoLed(&estado);
+		valor = estado.piscaFlag ? estado.frequencia : 0;
+		
+		// Job cancelado: apaga o LED (um brilho publicado em seguida volta a acende-lo)
+		if(valor <= 0){
+			tcc_set_compare_value(&tcc_instance, 0, 1001);
+			latencia_registra(LAT_PWM, sp.recebido);
+			continue;
+		}
+		
+		qtd = estado.piscaQtd;
+		LOGBIN2(LOG_PISCA, valor, qtd);
+		meioPeriodo = 500/(valor*portTICK_PERIOD_MS);
+		if(meioPeriodo == 0){
+			meioPeriodo = 1;
 		}
 		
-		xSemaphoreTake(mutex, portMAX_DELAY);
-		//printf("LED piscando com frequencia de %d Hz", frequencia);
+		// Com tempo do mestre, as bordas de subida caem nos multiplos do periodo na grade do mestre:
+		// espera a proxima e recalcula cada borda pelo modelo, que segue os acertos de deriva
+		emFase = LeTempoMestre(&borda);
+		if(emFase){
+			periodo = 1000/valor;
+			if(periodo < 2){
+				periodo = 2;
+			}
+			borda = (borda/periodo + 1)*periodo;
+			if(xQueueReceive(ledMailbox[CANAL_PISCA], &sp, TicksAteMestre(borda)) == pdTRUE){
+				LOGBIN2(LOG_PISCA_CANCELADO, 0, qtd);
+				novoJob = 1;
+				continue;
+			}
+		}
 			
 		// Alterna entre brilho maximo e brilho minimo na frequencia desejada at a quantidade de vezes a piscar ser atingida
-		for(i = 0 ; i < piscaQtd ; i++){
+		for(i = 0 ; i < qtd ; i++){
 			
 			// Seta brilho para intensidade maxima
 			tcc_set_compare_value(&tcc_instance, 0, 0);
-			//delay_ms( (int) (1/frequencia)*500);
+			if(i == 0){
+				latencia_registra(LAT_PWM, sp.recebido);
+			}
 			
-			// Suspende tarefa por metade do periodo relativo a frequencia desejada
-			vTaskDelay( 1*500/(frequencia*portTICK_PERIOD_MS) );
+			// Espera metade do periodo; um set-point publicado nesse meio tempo substitui o job atual
+			espera = emFase ? TicksAteMestre(borda + periodo/2) : meioPeriodo;
+			if(xQueueReceive(ledMailbox[CANAL_PISCA], &sp, espera) == pdTRUE){
+				LOGBIN2(LOG_PISCA_CANCELADO, i, qtd);
+				novoJob = 1;
+				break;
+			}
 			
 			// Seta brilho para intensidade minima
 			tcc_set_compare_value(&tcc_instance, 0, 1001);
-			//delay_ms( (int) (1/frequencia)*500);
 			
-			// Suspende tarefa por metade do periodo relativo a frequencia desejada 
-			vTaskDelay( 1*500/(frequencia*portTICK_PERIOD_MS) );
+			// Espera metade do periodo; um set-point publicado nesse meio tempo substitui o job atual
+			borda += periodo;
+			espera = emFase ? TicksAteMestre(borda) : meioPeriodo;
+			if(xQueueReceive(ledMailbox[CANAL_PISCA], &sp, espera) == pdTRUE){
+				LOGBIN2(LOG_PISCA_CANCELADO, i + 1, qtd);
+				novoJob = 1;
+				break;
+			}
 			
 		}
-		
-		xSemaphoreGive(mutex);
-		vTaskSuspend(PiscaHandle);
 	}
 	
 }
 
 void Brilha(){
 	
-	// "Brilho" e "brilhaFlag" sao variaveis globais declaradas em main.c
-	xSemaphoreTake(mutex, portMAX_DELAY);
-	//printf("Brilha inicializada\n");
-	xSemaphoreGive(mutex);
+	// O aviso chega pela caixa de correio do canal; o brilho vem do estado publicado
+	SetPoint sp;
+	EstadoLed estado;
+	int valor;
+	
+	LOGBIN0(LOG_BRILHA_INICIADA);
 	
 	while(1){
 		
-		xSemaphoreTake(mutex, portMAX_DELAY);
-		//printf("LED brilhando com instensidade de %d %%", brilho);
+		// Espera SetaComando avisar de um novo brilho; valores publicados antes de chegar aqui nunca sao aplicados
+		xQueueReceive(ledMailbox[CANAL_BRILHO], &sp, portMAX_DELAY);
+		RegistraAplicado(CANAL_BRILHO, &sp);
+		LeEstadoLed(&estado);
+		valor = estado.brilhaFlag ? estado.brilho : 0;
+		LOGBIN1(LOG_BRILHA, valor);
 
-		// LED brilha a uma certa porcentagem de luminosidade
-		if(brilho == 0){
-			tcc_set_compare_value(&tcc_instance, 0, 1001);	//Brilho zero
-		} else {
-			tcc_set_compare_value(&tcc_instance, 0, Alema1map(brilho,1,100,1000,1));
+		// LED brilha a uma certa porcentagem de luminosidade. Com um pisca publicado depois do brilho
+		// (o mesmo lote com os dois, por exemplo) o LED e do Pisca, e apaga-lo aqui perderia a primeira metade acesa
+		if(!estado.piscaFlag){
+			if(valor == 0){
+				tcc_set_compare_value(&tcc_instance, 0, 1001);	//Brilho zero
+			} else {
+				tcc_set_compare_value(&tcc_instance, 0, Alema1map(valor,1,100,1000,1));
+			}
 		}
-		
-		xSemaphoreGive(mutex);
-		vTaskDelay(1);
+		latencia_registra(LAT_PWM, sp.recebido);
 	}
 }
\ No newline at end of file
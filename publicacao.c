@@ -0,0 +1,43 @@
+/**
+ * \file
+ * \brief Publicacao sem trava com duas copias e uma sequencia
+ */
+
+#include <string.h>
+#include "publicacao.h"
+
+//! Barreira de memoria e do compilador (DMB no Cortex-M0+)
+#define publicacao_barreira() __sync_synchronize()
+
+/**
+ * \brief Publica \a dados (p->tam bytes). Um so escritor por vez
+ */
+void publicacao_escreve(struct publicacao *p, const void *dados)
+{
+	char *copias = p->copias;
+
+	p->seq++;               // Impar: leitores passam para a copia 1
+	publicacao_barreira();
+	memcpy(copias, dados, p->tam);
+	publicacao_barreira();
+	p->seq++;               // Par: leitores voltam para a copia 0, ja atualizada
+	publicacao_barreira();
+	memcpy(copias + p->tam, dados, p->tam);
+	publicacao_barreira();
+}
+
+/**
+ * \brief Copia para \a dados a ultima publicacao, de qualquer tarefa e sem travar
+ */
+void publicacao_le(const struct publicacao *p, void *dados)
+{
+	const char *copias = p->copias;
+	uint32_t seq;
+
+	do {
+		seq = p->seq;
+		publicacao_barreira();
+		memcpy(dados, copias + (seq & 1) * p->tam, p->tam);
+		publicacao_barreira();
+	} while (seq != p->seq);
+}
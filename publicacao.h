@@ -0,0 +1,41 @@
+/**
+ * \file
+ * \brief Publicacao sem trava de uma estrutura com um so escritor e varios leitores
+ *
+ * Duas copias e uma sequencia: o bit 0 da sequencia indica a copia que os leitores usam.
+ * O escritor reescreve a copia que os leitores nao estao usando, troca de copia e reescreve
+ * a outra, entao nunca espera. O leitor copia a estrutura e repete so se uma publicacao
+ * trocou de copia no meio da leitura; nunca fica preso esperando o escritor terminar.
+ *
+ * Nao depende do ASF, para que o teste do host (tools/teste_publicacao.cpp) use o mesmo
+ * codigo com threads. Publicacoes de escritores diferentes precisam ser serializadas por quem chama.
+ */
+
+#ifndef PUBLICACAO_H
+#define PUBLICACAO_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//! Estrutura publicada: "copias" aponta para duas copias de "tam" bytes, uma apos a outra
+struct publicacao {
+	volatile uint32_t seq;
+	void *copias;
+	size_t tam;
+};
+
+//! Inicializador estatico para um vetor de duas copias: PUBLICACAO_INICIO(vetor)
+#define PUBLICACAO_INICIO(copias) { 0, (copias), sizeof((copias)[0]) }
+
+void publicacao_escreve(struct publicacao *p, const void *dados);
+void publicacao_le(const struct publicacao *p, void *dados);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUBLICACAO_H
@@ -0,0 +1,91 @@
+/**
+ * \file
+ * \brief Relogio de parede a partir do RTC, para marcar o log e a telemetria
+ */
+
+#include "console.h"
+#include "energia.h"
+#include "relogio.h"
+#include "formata.h"
+#include "publicacao.h"
+
+//! Hora de parede (ms) quando o RTC estava em zero; 0 ate o primeiro "time set". Publicada sem trava,
+//! pois o Cortex-M0+ nao escreve 64 bits de uma vez (so SetaComando acerta o relogio)
+static int64_t relogio_bases[2];
+static struct publicacao relogio_base = PUBLICACAO_INICIO(relogio_bases);
+static volatile bool relogio_acertado;
+
+//! Converte contagens do RTC em milissegundos
+static uint64_t relogio_rtc_ms(uint64_t rtc)
+{
+	return (rtc * 1000) / ENERGIA_RTC_HZ;
+}
+
+/**
+ * \brief Acerta o relogio
+ *
+ * \param epoch Segundos desde 1970-01-01 UTC
+ */
+void relogio_set(uint32_t epoch)
+{
+	int64_t base = (int64_t)epoch * 1000 - (int64_t)relogio_rtc_ms(energia_get_rtc64());
+
+	publicacao_escreve(&relogio_base, &base);
+	relogio_acertado = true;
+}
+
+bool relogio_get_acertado(void)
+{
+	return relogio_acertado;
+}
+
+//! Hora atual em ms desde 1970 (ou desde o boot, se o relogio nao foi acertado)
+uint64_t relogio_ms(void)
+{
+	int64_t base;
+
+	publicacao_le(&relogio_base, &base);
+	return (uint64_t)(base + (int64_t)relogio_rtc_ms(energia_get_rtc64()));
+}
+
+/**
+ * \brief Converte uma marca de 32 bits do RTC para a hora de parede
+ *
+ * A marca e estendida para 64 bits pela diferenca ate o contador atual, o que atravessa a
+ * volta do contador de 32 bits desde que a marca tenha menos de 2^32 contagens (~36 horas).
+ */
+uint64_t relogio_ms_de_rtc(uint32_t rtc)
+{
+	uint64_t agora = energia_get_rtc64();
+	uint64_t marca = agora - (uint32_t)((uint32_t)agora - rtc);
+	int64_t base;
+
+	publicacao_le(&relogio_base, &base);
+	return (uint64_t)(base + (int64_t)relogio_rtc_ms(marca));
+}
+
+/**
+ * \brief Escreve uma hora em ms como "<segundos>.<ms com 3 digitos>"
+ *
+ * \param tam Tamanho de "texto"; RELOGIO_TEXTO_TAM sempre basta
+ */
+void relogio_texto(uint64_t ms, char *texto, int tam)
+{
+	uint32_t resto = (uint32_t)(ms % 1000);
+
+	formata_snprintf(texto, tam, "%lu.%c%c%c", (unsigned long)(ms / 1000),
+			(char)('0' + resto / 100), (char)('0' + (resto / 10) % 10), (char)('0' + resto % 10));
+}
+
+/**
+ * \brief Imprime a hora atual
+ *
+ *   time <segundos>.<ms> <acertado|boot>
+ */
+void relogio_imprime(void)
+{
+	char texto[RELOGIO_TEXTO_TAM];
+
+	relogio_texto(relogio_ms(), texto, sizeof(texto));
+	console_printf("time %s %s\n", texto, relogio_acertado ? "acertado" : "boot");
+}
@@ -0,0 +1,40 @@
+/**
+ * \file
+ * \brief Relogio de parede a partir do RTC, para marcar o log e a telemetria
+ *
+ * O RTC do energia.c (32 bits, 32,768 kHz, continua contando em standby) e a base de tempo
+ * monotona; as voltas do contador sao contadas na interrupcao de overflow. O comando
+ * "time set <epoch>" informa a hora Unix atual e a partir dai relogio_ms() devolve
+ * milissegundos desde 1970. Sem acerto, o relogio conta a partir do boot.
+ *
+ * Para marcar eventos frequentes basta guardar energia_get_rtc() (uma leitura de registrador);
+ * relogio_ms_de_rtc() converte depois, desde que a marca tenha menos de ~36 horas.
+ *
+ * Nao depende do ASF: le o RTC por energia_get_rtc64(), que o teste do host
+ * (tools/teste_relogio.cpp) substitui por um contador que ele controla.
+ */
+
+#ifndef RELOGIO_H
+#define RELOGIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RELOGIO_TEXTO_TAM 16 // "<segundos>.<ms>" com ate 10 digitos nos segundos
+
+void relogio_set(uint32_t epoch);
+bool relogio_get_acertado(void);
+uint64_t relogio_ms(void);
+uint64_t relogio_ms_de_rtc(uint32_t rtc);
+void relogio_texto(uint64_t ms, char *texto, int tam);
+void relogio_imprime(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RELOGIO_H
@@ -0,0 +1,197 @@
+/**
+ * \file
+ * \brief Roda de tempo (hashed timer wheel) dos jobs da agenda
+ */
+
+#include <string.h>
+#include "roda.h"
+
+//! Passos da roda que cobrem "ms", arredondado para cima
+static uint32_t roda_passos(const struct roda *r, uint32_t ms)
+{
+	return ms / r->resolucao_ms + ((ms % r->resolucao_ms != 0) ? 1 : 0);
+}
+
+//! Poe o job na posicao a "passos" (1 ou mais) do avanco atual
+static void roda_encaixa(struct roda *r, int16_t j, uint32_t passos)
+{
+	struct roda_job *job = &r->jobs[j];
+	int16_t slot = (int16_t)((r->atual + passos) % CONF_AGENDA_SLOTS);
+
+	job->voltas = (passos - 1) / CONF_AGENDA_SLOTS;
+	job->slot = slot;
+	job->anterior = RODA_NENHUM;
+	job->proximo = r->slots[slot];
+	if (r->slots[slot] != RODA_NENHUM) {
+		r->jobs[r->slots[slot]].anterior = j;
+	}
+	r->slots[slot] = j;
+}
+
+//! Tira o job da lista da sua posicao
+static void roda_desencaixa(struct roda *r, int16_t j)
+{
+	struct roda_job *job = &r->jobs[j];
+
+	if (job->anterior != RODA_NENHUM) {
+		r->jobs[job->anterior].proximo = job->proximo;
+	} else {
+		r->slots[job->slot] = job->proximo;
+	}
+	if (job->proximo != RODA_NENHUM) {
+		r->jobs[job->proximo].anterior = job->anterior;
+	}
+}
+
+static void roda_libera(struct roda *r, int16_t j)
+{
+	r->jobs[j].id = 0;
+	r->livres[r->qtd_livres++] = j;
+}
+
+/**
+ * \brief Esvazia a roda
+ *
+ * \param resolucao_ms Tempo entre dois avancos
+ */
+void roda_init(struct roda *r, uint32_t resolucao_ms)
+{
+	int16_t j;
+
+	memset(r, 0, sizeof(*r));
+	r->resolucao_ms = resolucao_ms;
+	for (j = 0; j < CONF_AGENDA_SLOTS; j++) {
+		r->slots[j] = RODA_NENHUM;
+	}
+	for (j = 0; j < CONF_AGENDA_MAX; j++) {
+		r->livres[j] = (int16_t)(CONF_AGENDA_MAX - 1 - j);
+	}
+	r->qtd_livres = CONF_AGENDA_MAX;
+}
+
+/**
+ * \brief Poe um comando na roda
+ *
+ * O avanco em curso ja passou em parte, entao o job vai um passo alem dos que cobrem "ms": o
+ * primeiro disparo sai entre ms e ms + 2 resolucoes depois, nunca antes. Os seguintes de um
+ * periodico saem a cada ceil(ms / resolucao) passos, contados do disparo anterior.
+ *
+ * \param atrasados Avancos ja vencidos que a roda ainda nao fez; sem conta-los, o job ficaria
+ *                  perto demais da posicao atual e dispararia cedo quando eles fossem feitos
+ *
+ * \return Id do job, ou -1 se todos os jobs estao em uso
+ */
+int roda_insere(struct roda *r, const Comando *cmd, uint32_t ms, bool periodico, uint32_t atrasados)
+{
+	struct roda_job *job;
+	int16_t j;
+
+	if (r->qtd_livres == 0) {
+		return -1;
+	}
+
+	j = r->livres[--r->qtd_livres];
+	job = &r->jobs[j];
+	// id % CONF_AGENDA_MAX e o job; o resto muda a cada uso, e um id antigo nao cancela o job novo
+	if (++r->usos > INT32_MAX / CONF_AGENDA_MAX - 1) {
+		r->usos = 1;
+	}
+	job->id = (int)(r->usos * CONF_AGENDA_MAX + (uint32_t)j);
+	job->tipo = (uint8_t)cmd->tipo;
+	job->alvo = (uint8_t)cmd->alvo;
+	job->arg[0] = cmd->arg[0];
+	job->arg[1] = cmd->arg[1];
+	job->periodico = periodico;
+	job->ms = ms;
+	job->disparos = 0;
+	roda_encaixa(r, j, atrasados + roda_passos(r, ms) + 1);
+	return job->id;
+}
+
+/**
+ * \brief Tira um job da roda
+ *
+ * \return false se nao ha job com esse id (ja disparou ou foi cancelado)
+ */
+bool roda_cancela(struct roda *r, int id)
+{
+	int16_t j;
+
+	if (id <= 0) {
+		return false;
+	}
+	j = (int16_t)((uint32_t)id % CONF_AGENDA_MAX);
+	if (r->jobs[j].id != id) {
+		return false;
+	}
+	roda_desencaixa(r, j);
+	roda_libera(r, j);
+	return true;
+}
+
+/**
+ * \brief Avanca a roda uma posicao e entrega os jobs vencidos a \a executa
+ *
+ * \a executa nao pode mexer na roda (so enfileira o comando).
+ *
+ * \return Jobs disparados
+ */
+uint32_t roda_avanca(struct roda *r, roda_executa_t executa)
+{
+	struct roda_job *job;
+	Comando cmd;
+	int16_t j, proximo;
+	uint32_t disparados = 0;
+
+	r->atual = (uint16_t)((r->atual + 1) % CONF_AGENDA_SLOTS);
+	for (j = r->slots[r->atual]; j != RODA_NENHUM; j = proximo) {
+		job = &r->jobs[j];
+		proximo = job->proximo;
+
+		if (job->voltas != 0) {
+			job->voltas--;
+			continue;
+		}
+
+		roda_comando(job, &cmd);
+		if (!executa(&cmd)) {
+			r->perdidos++;
+		}
+		job->disparos++;
+		disparados++;
+
+		// Periodico volta para a roda a partir desta posicao, sem acumular atraso
+		roda_desencaixa(r, j);
+		if (job->periodico) {
+			roda_encaixa(r, j, job->ms ? roda_passos(r, job->ms) : 1);
+		} else {
+			roda_libera(r, j);
+		}
+	}
+	return disparados;
+}
+
+//! Sem jobs: quem avanca a roda pode parar
+bool roda_vazia(const struct roda *r)
+{
+	return r->qtd_livres == CONF_AGENDA_MAX;
+}
+
+//! Comando do job, como sera executado (sem o prefixo at/every)
+void roda_comando(const struct roda_job *job, Comando *cmd)
+{
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->tipo = (enum tipo_comando)job->tipo;
+	cmd->alvo = (enum alvo_comando)job->alvo;
+	cmd->arg[0] = job->arg[0];
+	cmd->arg[1] = job->arg[1];
+	cmd->agenda = AGENDA_NENHUMA;
+}
+
+//! Tempo ate o proximo disparo do job, contado do ultimo avanco
+uint32_t roda_faltam_ms(const struct roda *r, const struct roda_job *job)
+{
+	uint32_t passos = (uint32_t)(job->slot - r->atual + CONF_AGENDA_SLOTS - 1) % CONF_AGENDA_SLOTS + 1;
+
+	return (passos + job->voltas * CONF_AGENDA_SLOTS) * r->resolucao_ms;
+}
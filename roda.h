@@ -0,0 +1,83 @@
+/**
+ * \file
+ * \brief Roda de tempo (hashed timer wheel) dos jobs da agenda, sem dependencia do ASF
+ *
+ * CONF_AGENDA_SLOTS posicoes, avancadas uma a uma por roda_avanca(). Um job com atraso maior que
+ * uma volta fica na posicao (agora + atraso) % slots e conta as voltas que faltam. Inserir e
+ * cancelar sao O(1): as posicoes sao listas duplamente ligadas e o id do job diz onde ele esta.
+ * Um avanco so percorre os jobs da posicao atual.
+ *
+ * Quem chama cuida da exclusao (agenda_trava em agenda.c) e de chamar roda_avanca() a cada
+ * "resolucao_ms"; o teste do host (tools/sim_agenda.cpp) usa o mesmo codigo sem o timer.
+ *
+ * RAM: 36 bytes por job, 2 por job na pilha de livres e 2 por posicao. Os padroes (16 jobs,
+ * 32 posicoes) ocupam 688 bytes; centenas de jobs cabem com -DCONF_AGENDA_MAX=256
+ * -DCONF_AGENDA_SLOTS=128, como no sim_agenda, mas custam 10000 bytes, um terco da SRAM do SAMD21J18.
+ */
+
+#ifndef RODA_H
+#define RODA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "comandos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONF_AGENDA_MAX
+#  define CONF_AGENDA_MAX 16          // Jobs ao mesmo tempo (ate 32767)
+#endif
+#ifndef CONF_AGENDA_SLOTS
+#  define CONF_AGENDA_SLOTS 32        // Posicoes da roda (ate 32767)
+#endif
+
+#if (CONF_AGENDA_MAX > INT16_MAX) || (CONF_AGENDA_SLOTS > INT16_MAX)
+#  error "Os indices da roda sao de 16 bits: CONF_AGENDA_MAX e CONF_AGENDA_SLOTS ate 32767"
+#endif
+
+#define RODA_NENHUM (-1)
+
+//! Recebe um job que disparou; retorna false se ele nao pode ser executado agora (fila cheia)
+typedef bool (*roda_executa_t)(const Comando *cmd);
+
+//! Um job; livre quando id == 0. O comando fica sem os campos do at/every para ocupar menos
+struct roda_job {
+	int id;
+	int32_t arg[2];
+	uint8_t tipo;       // enum tipo_comando
+	uint8_t alvo;       // enum alvo_comando
+	bool periodico;
+	int16_t slot;
+	int16_t anterior;   // Lista da posicao
+	int16_t proximo;
+	uint32_t ms;        // Atraso ou periodo pedido
+	uint32_t voltas;    // Voltas completas da roda que faltam
+	uint32_t disparos;
+};
+
+struct roda {
+	struct roda_job jobs[CONF_AGENDA_MAX];
+	int16_t slots[CONF_AGENDA_SLOTS];    // Primeiro job de cada posicao
+	int16_t livres[CONF_AGENDA_MAX];     // Pilha de jobs livres
+	uint16_t qtd_livres;
+	uint16_t atual;                      // Posicao do ultimo avanco
+	uint32_t usos;                       // Gera ids diferentes para o mesmo job reaproveitado
+	uint32_t perdidos;                   // Disparos que "executa" recusou
+	uint32_t resolucao_ms;
+};
+
+void roda_init(struct roda *r, uint32_t resolucao_ms);
+int roda_insere(struct roda *r, const Comando *cmd, uint32_t ms, bool periodico, uint32_t atrasados);
+bool roda_cancela(struct roda *r, int id);
+uint32_t roda_avanca(struct roda *r, roda_executa_t executa);
+bool roda_vazia(const struct roda *r);
+void roda_comando(const struct roda_job *job, Comando *cmd);
+uint32_t roda_faltam_ms(const struct roda *r, const struct roda_job *job);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RODA_H
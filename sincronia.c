@@ -0,0 +1,121 @@
+/**
+ * \file
+ * \brief Modelo do tempo do mestre para piscar em fase
+ */
+
+#include "sincronia.h"
+
+void sincronia_init(struct sincronia *s)
+{
+	s->ativa = false;
+	s->taxa_medida = false;
+	s->taxa_rtc = SINCRONIA_RTC_HZ;
+	s->taxa_ms = 1000;
+	s->quadros = 0;
+	s->pulsos = 0;
+	s->erro = 0;
+	s->erro_max = 0;
+}
+
+//! RTC local previsto para o instante "ms" do mestre
+uint64_t sincronia_para_local(const struct sincronia *s, uint32_t ms)
+{
+	int32_t delta = (int32_t)(ms - s->ms);
+
+	if (delta >= 0) {
+		return s->rtc + ((uint64_t)delta * s->taxa_rtc) / s->taxa_ms;
+	}
+	return s->rtc - ((uint64_t)(-(int64_t)delta) * s->taxa_rtc) / s->taxa_ms;
+}
+
+//! Instante do mestre (ms) correspondente ao RTC local
+uint32_t sincronia_para_mestre(const struct sincronia *s, uint64_t rtc)
+{
+	if (rtc >= s->rtc) {
+		return s->ms + (uint32_t)(((rtc - s->rtc) * s->taxa_ms) / s->taxa_rtc);
+	}
+	return s->ms - (uint32_t)(((s->rtc - rtc) * s->taxa_ms) / s->taxa_rtc);
+}
+
+//! Diferenca de taxa do RTC local para o mestre, em partes por milhao
+int32_t sincronia_ppm(const struct sincronia *s)
+{
+	int64_t nominal = (int64_t)s->taxa_ms * SINCRONIA_RTC_HZ;
+
+	return (int32_t)((((int64_t)s->taxa_rtc * 1000 - nominal) * 1000000) / nominal);
+}
+
+/**
+ * \brief Acerta o modelo com um instante conhecido do mestre
+ *
+ * \param rtc RTC local na recepcao do quadro (ou no pulso)
+ * \param ms  Tempo do mestre nesse instante
+ */
+void sincronia_quadro(struct sincronia *s, uint64_t rtc, uint32_t ms)
+{
+	int64_t erro;
+	uint32_t base;
+
+	if (s->ativa) {
+		erro = (int64_t)(rtc - sincronia_para_local(s, ms));
+		if (erro > (int64_t)SINCRONIA_SALTO_MAX_MS * SINCRONIA_RTC_HZ / 1000
+				|| erro < -(int64_t)SINCRONIA_SALTO_MAX_MS * SINCRONIA_RTC_HZ / 1000) {
+			s->ativa = false; // Mestre reiniciado ou trocado
+		}
+	}
+
+	s->quadros++;
+	if (!s->ativa) {
+		s->ativa = true;
+		s->taxa_medida = false;
+		s->rtc = rtc;
+		s->ms = ms;
+		s->base_rtc = rtc;
+		s->base_ms = ms;
+		s->taxa_rtc = SINCRONIA_RTC_HZ;
+		s->taxa_ms = 1000;
+		s->erro = 0;
+		s->erro_max = 0;
+		return;
+	}
+
+	s->erro = (int32_t)erro;
+	if (s->taxa_medida && (s->erro < 0 ? -s->erro : s->erro) > s->erro_max) {
+		s->erro_max = (s->erro < 0) ? -s->erro : s->erro;
+	}
+
+	// Fase: metade do erro, para o jitter de recepcao nao passar inteiro para as bordas
+	s->rtc = sincronia_para_local(s, ms) + erro / 2;
+	s->ms = ms;
+
+	// Taxa: ticks do RTC sobre uma base longa; depois de SINCRONIA_BASE_MAX_MS a base recomeca
+	base = ms - s->base_ms;
+	if (base >= SINCRONIA_BASE_MIN_MS) {
+		s->taxa_rtc = (uint32_t)(rtc - s->base_rtc);
+		s->taxa_ms = base;
+		s->taxa_medida = true;
+		if (base >= SINCRONIA_BASE_MAX_MS) {
+			s->base_rtc = rtc;
+			s->base_ms = ms;
+		}
+	}
+}
+
+/**
+ * \brief Acerta o modelo com um pulso no pino, dado a cada "periodo_ms" do mestre
+ *
+ * O pulso nao diz o tempo: vale o multiplo do periodo mais proximo do previsto. O primeiro
+ * pulso define o tempo zero.
+ */
+void sincronia_pulso(struct sincronia *s, uint64_t rtc, uint32_t periodo_ms)
+{
+	uint32_t ms = 0;
+
+	if (s->ativa) {
+		ms = sincronia_para_mestre(s, rtc) + periodo_ms / 2;
+		ms -= ms % periodo_ms;
+	}
+	sincronia_quadro(s, rtc, ms);
+	s->quadros--;
+	s->pulsos++;
+}
@@ -0,0 +1,65 @@
+/**
+ * \file
+ * \brief Tempo comum entre placas para piscar em fase
+ *
+ * Cada placa mantem um modelo linear do tempo do mestre (ms) em funcao do seu RTC local:
+ * um ponto (rtc, ms) e a taxa do RTC medida contra o mestre. O modelo e acertado por
+ * quadros de sincronia ("sync <ms>", normalmente em difusao "@* sync <ms>") ou por pulsos
+ * em um pino, a cada CONF_SINCRONIA_PULSO_MS do mestre. A cada acerto a fase anda metade
+ * do erro medido (absorvendo o jitter da recepcao) e a taxa e medida sobre uma base de
+ * pelo menos SINCRONIA_BASE_MIN_MS, o que corrige a diferenca entre os cristais.
+ *
+ * O pisca marca suas bordas na grade de tempo do mestre (multiplos do periodo), entao
+ * placas com a mesma frequencia acendem juntas, seja qual for o instante do comando.
+ *
+ * O modelo nao depende do ASF, para que a simulacao do host (tools/sim_sincronia.cpp) use o
+ * mesmo codigo. Quem o compartilha com uma interrupcao cuida da exclusao.
+ */
+
+#ifndef SINCRONIA_H
+#define SINCRONIA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SINCRONIA_RTC_HZ       32768  // Relogio local (o RTC de energia.c)
+#define SINCRONIA_BASE_MIN_MS  5000   // Menor intervalo do mestre para medir a taxa
+#define SINCRONIA_BASE_MAX_MS  120000 // Acima disso a base de medida da taxa recomeca
+#define SINCRONIA_SALTO_MAX_MS 250    // Erro maior: o mestre mudou de tempo e o modelo recomeca
+
+#ifndef CONF_SINCRONIA_PULSO_MS
+#  define CONF_SINCRONIA_PULSO_MS 1000 // Periodo dos pulsos de sincronia no pino
+#endif
+
+//! Modelo do tempo do mestre
+struct sincronia {
+	bool ativa;
+	uint64_t rtc;        // Ponto do modelo: RTC local ...
+	uint32_t ms;         // ... no instante "ms" do mestre
+	uint32_t taxa_rtc;   // Taxa: "taxa_rtc" ticks do RTC a cada "taxa_ms" do mestre
+	uint32_t taxa_ms;
+	uint64_t base_rtc;   // Inicio da base de medida da taxa
+	uint32_t base_ms;
+	uint32_t quadros;
+	uint32_t pulsos;
+	int32_t erro;        // Ultimo erro medido (RTC recebido - previsto), em ticks do RTC
+	int32_t erro_max;    // Maior |erro| desde que a taxa foi medida pela primeira vez
+	bool taxa_medida;
+};
+
+void sincronia_init(struct sincronia *s);
+void sincronia_quadro(struct sincronia *s, uint64_t rtc, uint32_t ms);
+void sincronia_pulso(struct sincronia *s, uint64_t rtc, uint32_t periodo_ms);
+uint64_t sincronia_para_local(const struct sincronia *s, uint32_t ms);
+uint32_t sincronia_para_mestre(const struct sincronia *s, uint64_t rtc);
+int32_t sincronia_ppm(const struct sincronia *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SINCRONIA_H
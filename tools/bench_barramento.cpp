@@ -0,0 +1,155 @@
+/**
+ * \file
+ * \brief Simulacao (host) de muitos nos em um barramento compartilhado
+ *
+ * Gera o trafego de um host controlando N nos: comandos "@<endereco> #<id> <cmd>" para um
+ * no e "@* #<id> <cmd>" para todos, seguidos das respostas "=<endereco> ok <id>" que os
+ * outros nos tambem escutam. Cada byte do barramento passa pelo filtro de enderecos de todos
+ * os nos (o mesmo barramento.c da interrupcao), e cada no confere que recebeu exatamente os
+ * seus comandos e as difusoes.
+ *
+ * Mostra o custo do filtro por byte e por no (ns e ciclos no host, so para comparar versoes)
+ * e a vazao agregada em comandos executados por segundo, contada no tempo do barramento:
+ * bytes a 10 bits por baud, e cada difusao ocupa o barramento ate o fim da janela do ultimo
+ * no. A janela e a do firmware (CONF_BARRAMENTO_SLOT_US, que pode ser trocada com -D).
+ *
+ * Compilacao: gcc -O2 -c barramento.c -o barramento.o
+ *             g++ -std=c++11 -O2 -o bench_barramento tools/bench_barramento.cpp barramento.o
+ * Uso:        bench_barramento [nos] [baud] [comandos]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../barramento.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEM_RDTSC 1
+#endif
+
+static const unsigned DIFUSAO_A_CADA = 10; // Um comando em cada 10 vai para todos os nos
+
+// Um no simulado: filtro da interrupcao e linhas que chegariam ao interpretador
+struct No {
+	barramento_filtro filtro;
+	std::string linha;
+	std::vector<std::string> recebidas;
+	unsigned bytes_entregues;
+};
+
+int main(int argc, char **argv)
+{
+	unsigned nos = (argc > 1) ? (unsigned)std::atoi(argv[1]) : 50;
+	unsigned long baud = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 9600;
+	unsigned comandos = (argc > 3) ? (unsigned)std::atoi(argv[3]) : 20000;
+	static const char *const textos[] = { "brilho 40", "pisca 5 3", "print brilho", "reset freq" };
+
+	if (nos < 1 || nos > BARRAMENTO_ENDERECO_MAX || baud == 0) {
+		std::fprintf(stderr, "uso: %s [nos 1-%d] [baud] [comandos]\n", argv[0], BARRAMENTO_ENDERECO_MAX);
+		return 2;
+	}
+
+	// Trafego do barramento e o que cada no deve receber
+	std::string barramento;
+	std::vector<std::vector<std::string> > esperado(nos + 1);
+	double janelas_us = 0;
+	size_t bytes_fora_janelas = 0; // Comandos e respostas que nao caem nas janelas de difusao
+	unsigned long executados = 0;
+	std::srand(1);
+
+	for (unsigned i = 0; i < comandos; i++) {
+		char quadro[64], resposta[32];
+		const char *texto = textos[std::rand() % 4];
+		unsigned id = i + 1;
+
+		if (i % DIFUSAO_A_CADA == 0) {
+			std::snprintf(quadro, sizeof(quadro), "@* #%u %s\n", id, texto);
+			barramento += quadro;
+			bytes_fora_janelas += std::strlen(quadro);
+			for (unsigned n = 1; n <= nos; n++) {
+				esperado[n].push_back(std::string(1, (char)BARRAMENTO_DIFUSAO) + "#" + std::to_string(id) + " " + texto);
+				std::snprintf(resposta, sizeof(resposta), "=%u ok %u\n", n, id);
+				barramento += resposta;
+			}
+			// As respostas saem nas janelas; a difusao termina com a janela do ultimo no
+			janelas_us += BARRAMENTO_ATRASO_US(nos) + std::strlen(resposta) * 10 * 1e6 / baud;
+			executados += nos;
+		} else {
+			unsigned n = 1 + (unsigned)std::rand() % nos;
+			std::snprintf(quadro, sizeof(quadro), "@%u #%u %s\n", n, id, texto);
+			barramento += quadro;
+			esperado[n].push_back("#" + std::to_string(id) + " " + texto);
+			std::snprintf(resposta, sizeof(resposta), "=%u ok %u\n", n, id);
+			barramento += resposta;
+			bytes_fora_janelas += std::strlen(quadro) + std::strlen(resposta);
+			executados++;
+		}
+	}
+
+	// Todos os nos escutam todos os bytes
+	std::vector<No> rede(nos + 1);
+	for (unsigned n = 1; n <= nos; n++) {
+		barramento_filtro_init(&rede[n].filtro, (uint8_t)n);
+		rede[n].bytes_entregues = 0;
+	}
+
+	auto inicio = std::chrono::steady_clock::now();
+#ifdef TEM_RDTSC
+	unsigned long long c0 = __rdtsc();
+#endif
+	for (size_t i = 0; i < barramento.size(); i++) {
+		uint8_t c = (uint8_t)barramento[i];
+		for (unsigned n = 1; n <= nos; n++) {
+			uint8_t saida;
+			if (barramento_filtra(&rede[n].filtro, c, &saida)) {
+				No &no = rede[n];
+				no.bytes_entregues++;
+				if (saida == '\n') {
+					no.recebidas.push_back(no.linha);
+					no.linha.clear();
+				} else {
+					no.linha += (char)saida;
+				}
+			}
+		}
+	}
+#ifdef TEM_RDTSC
+	unsigned long long c1 = __rdtsc();
+#endif
+	auto fim = std::chrono::steady_clock::now();
+
+	int erros = 0;
+	unsigned long entregues = 0, descartados = 0;
+	for (unsigned n = 1; n <= nos; n++) {
+		if (rede[n].recebidas != esperado[n]) {
+			std::printf("no %u: %u linhas recebidas, %u esperadas\n", n,
+					(unsigned)rede[n].recebidas.size(), (unsigned)esperado[n].size());
+			erros++;
+		}
+		entregues += rede[n].bytes_entregues;
+		descartados += rede[n].filtro.descartados;
+	}
+
+	double filtragens = (double)barramento.size() * nos;
+	double ns = std::chrono::duration<double, std::nano>(fim - inicio).count() / filtragens;
+#ifdef TEM_RDTSC
+	double ciclos = (double)(c1 - c0) / filtragens;
+#else
+	double ciclos = 0;
+#endif
+	double barramento_s = (double)bytes_fora_janelas * 10 / baud + janelas_us / 1e6;
+
+	std::printf("nos %u baud %lu comandos %u bytes %u\n", nos, baud, comandos, (unsigned)barramento.size());
+	std::printf("filtro_ns_por_byte %.2f filtro_ciclos_por_byte %.1f\n", ns, ciclos);
+	std::printf("bytes_entregues_por_no %.1f%% quadros_descartados %lu\n",
+			100.0 * entregues / filtragens, descartados);
+	std::printf("tempo_barramento_s %.1f comandos_executados %lu vazao_agregada %.1f cmd/s\n",
+			barramento_s, executados, executados / barramento_s);
+
+	return erros ? 1 : 0;
+}
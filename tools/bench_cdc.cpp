@@ -0,0 +1,375 @@
+/**
+ * \file
+ * \brief Teste (host) da classe CDC sobre endpoints simulados e vazao bulk
+ *
+ * Liga o mesmo cdc.c do firmware a uma camada de endpoints simulada (as funcoes usbdev_*)
+ * e faz o papel do host:
+ *
+ *  - enumeracao: descritores de dispositivo, configuracao (em varios pacotes de controle) e
+ *    strings, SET_ADDRESS, SET_CONFIGURATION, line coding e DTR, conferindo as respostas;
+ *  - transmissao: o "console" escreve uma sequencia conhecida o mais rapido que o buffer
+ *    deixa e o host le o endpoint IN, conferindo ordem e conteudo;
+ *  - recepcao: o host manda pacotes OUT para um consumidor mais lento que o barramento,
+ *    conferindo que nada se perde quando os bancos ficam retidos (NAK).
+ *
+ * A vazao e contada no tempo do barramento full-speed: um pacote de 64 bytes ocupa
+ * pacote_us, um NAK (banco nao armado) nak_us, e o firmware rearma um banco isr_us depois
+ * da transferencia completar. O tempo de CPU do host so serve para comparar versoes.
+ *
+ * Compilacao: gcc -O2 -c cdc.c -o cdc.o
+ *             g++ -std=c++11 -O2 -o bench_cdc tools/bench_cdc.cpp cdc.o
+ * Uso:        bench_cdc [bytes] [isr_us] [consumo_bytes_por_pacote]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../cdc.h"
+
+static const double PACOTE_US = 53.0; // 64 bytes + tokens, handshake e bit stuffing a 12 Mbit/s
+static const double ZLP_US = 3.0;
+static const double NAK_US = 3.0;
+static const size_t RX_TAM = 256;     // CONSOLE_RX_TAM
+static const size_t RX_MARCA_BAIXA = 64;
+
+// Camada de endpoints simulada: o que o firmware armou em cada banco
+struct Banco {
+	bool armado;
+	uint8_t *area;
+	const uint8_t *dados;
+	uint16_t tam;
+};
+
+static Banco bancos[4][2];
+static int endereco = -1;
+static bool stall;
+static bool configurado;
+static int falhas;
+
+extern "C" {
+
+void usbdev_endereco(uint8_t e)
+{
+	endereco = e;
+}
+
+void usbdev_configura(void)
+{
+	configurado = true;
+	std::memset(bancos[CDC_EP_IN], 0, sizeof(bancos[CDC_EP_IN]));
+	std::memset(bancos[CDC_EP_OUT], 0, sizeof(bancos[CDC_EP_OUT]));
+}
+
+void usbdev_recebe(uint8_t ep, uint8_t banco, uint8_t *area, uint16_t tam)
+{
+	bancos[ep][banco].armado = true;
+	bancos[ep][banco].area = area;
+	bancos[ep][banco].tam = tam;
+}
+
+void usbdev_envia(uint8_t ep, uint8_t banco, const uint8_t *dados, uint16_t tam)
+{
+	bancos[ep][banco].armado = true;
+	bancos[ep][banco].dados = dados;
+	bancos[ep][banco].tam = tam;
+}
+
+void usbdev_stall(uint8_t ep)
+{
+	(void)ep;
+	stall = true;
+}
+
+} // extern "C"
+
+static void falha(const char *msg)
+{
+	std::printf("FALHA: %s\n", msg);
+	falhas++;
+}
+
+// Requisicao de controle com estagio de dados IN; devolve os bytes recebidos
+static std::vector<uint8_t> controle_le(uint8_t tipo, uint8_t req, uint16_t valor, uint16_t tam)
+{
+	uint8_t setup[8] = { tipo, req, (uint8_t)valor, (uint8_t)(valor >> 8), 0, 0,
+			(uint8_t)tam, (uint8_t)(tam >> 8) };
+	std::vector<uint8_t> r;
+
+	stall = false;
+	bancos[0][1].armado = false;
+	std::memcpy(bancos[0][0].area, setup, 8);
+	cdc_setup(bancos[0][0].area);
+	if (stall) {
+		return r;
+	}
+	// Le pacotes ate um curto (ou o tamanho pedido)
+	while (bancos[0][1].armado) {
+		Banco &b = bancos[0][1];
+		uint16_t n = b.tam;
+		b.armado = false;
+		r.insert(r.end(), b.dados, b.dados + n);
+		cdc_in_completo(0, 1);
+		if (n < CDC_EP0_TAM || r.size() >= tam) {
+			break;
+		}
+	}
+	if (bancos[0][1].armado) {
+		falha("pacote IN a mais no endpoint 0");
+	}
+	cdc_out_completo(0, 0, 0); // Status
+	return r;
+}
+
+// Requisicao sem dados ou com estagio de dados OUT; devolve false se o status nao veio
+static bool controle_escreve(uint8_t tipo, uint8_t req, uint16_t valor, const uint8_t *dados, uint16_t tam)
+{
+	uint8_t setup[8] = { tipo, req, (uint8_t)valor, (uint8_t)(valor >> 8), 0, 0,
+			(uint8_t)tam, (uint8_t)(tam >> 8) };
+
+	stall = false;
+	bancos[0][1].armado = false;
+	std::memcpy(bancos[0][0].area, setup, 8);
+	cdc_setup(bancos[0][0].area);
+	if (stall) {
+		return false;
+	}
+	if (tam > 0) {
+		if (!bancos[0][0].armado) {
+			return false;
+		}
+		std::memcpy(bancos[0][0].area, dados, tam);
+		cdc_out_completo(0, 0, tam);
+	}
+	if (!bancos[0][1].armado || bancos[0][1].tam != 0) {
+		return false;
+	}
+	bancos[0][1].armado = false;
+	cdc_in_completo(0, 1);
+	return true;
+}
+
+static void enumera()
+{
+	std::vector<uint8_t> d;
+	uint8_t linha[7] = { 0x00, 0xC2, 0x01, 0x00, 0, 0, 8 }; // 115200 8N1
+	struct cdc_linha l;
+
+	d = controle_le(0x80, 0x06, 0x0100, 64);
+	if (d.size() != 18 || d[0] != 18 || d[1] != 1 || d[4] != 0x02 || d[7] != CDC_EP0_TAM) {
+		falha("descritor de dispositivo");
+	}
+
+	if (!controle_escreve(0x00, 0x05, 7, NULL, 0) || endereco != 7) {
+		falha("SET_ADDRESS (o endereco deve valer depois do status)");
+	}
+
+	d = controle_le(0x80, 0x06, 0x0200, 9);
+	if (d.size() != 9 || d[1] != 2) {
+		falha("descritor de configuracao (cabecalho)");
+	}
+	uint16_t total = (d.size() >= 4) ? (uint16_t)(d[2] | (d[3] << 8)) : 0;
+	d = controle_le(0x80, 0x06, 0x0200, 255);
+	if (d.size() != total || total <= CDC_EP0_TAM) {
+		falha("descritor de configuracao completo (mais de um pacote)");
+	}
+	// Percorre os descritores: cada um tem o proprio tamanho e os endpoints sao os da classe
+	unsigned eps = 0;
+	for (size_t i = 0; i + 1 < d.size() && d[i] > 0; i += d[i]) {
+		if (d[i + 1] == 5 && i + 6 < d.size()) {
+			uint8_t ep = d[i + 2] & 0x0F;
+			if (ep != CDC_EP_IN && ep != CDC_EP_OUT && ep != CDC_EP_NOTIF) {
+				falha("endpoint desconhecido no descritor");
+			}
+			eps++;
+		}
+	}
+	if (eps != 3) {
+		falha("descritor de configuracao deve ter 3 endpoints");
+	}
+
+	d = controle_le(0x80, 0x06, 0x0300, 255);
+	if (d.size() != 4 || d[2] != 0x09 || d[3] != 0x04) {
+		falha("string de idiomas");
+	}
+	d = controle_le(0x80, 0x06, 0x0302, 255);
+	if (d.size() < 4 || d[0] != d.size() || d[1] != 3) {
+		falha("string do produto");
+	}
+	d = controle_le(0x80, 0x06, 0x0600, 10);
+	if (!stall) {
+		falha("device qualifier deve receber STALL (so full-speed)");
+	}
+
+	if (!controle_escreve(0x00, 0x09, 1, NULL, 0) || !configurado) {
+		falha("SET_CONFIGURATION");
+	}
+	if (!bancos[CDC_EP_OUT][0].armado || !bancos[CDC_EP_OUT][1].armado) {
+		falha("os dois bancos OUT devem ficar armados depois da configuracao");
+	}
+	if (!controle_escreve(0x21, 0x20, 0, linha, sizeof(linha))) {
+		falha("SET_LINE_CODING");
+	}
+	cdc_get_linha(&l);
+	if (l.baud != 115200 || l.bits != 8) {
+		falha("line coding recebido");
+	}
+	d = controle_le(0xA1, 0x21, 0, 7);
+	if (d.size() != 7 || d[1] != 0xC2 || d[2] != 0x01) {
+		falha("GET_LINE_CODING");
+	}
+	if (cdc_get_conectado()) {
+		falha("sem DTR a porta nao esta aberta");
+	}
+	if (!controle_escreve(0x21, 0x22, 0x0001, NULL, 0) || !cdc_get_conectado()) {
+		falha("SET_CONTROL_LINE_STATE (DTR)");
+	}
+}
+
+// Transmissao: o console enche o buffer e o host le o endpoint IN
+static void transmissao(size_t total, double isr_us)
+{
+	size_t escritos = 0, lidos = 0;
+	unsigned pacotes = 0, zlps = 0, naks = 0;
+	uint8_t banco_host = 0;
+	double t = 0;
+	double pronto[2] = { 0, 0 };  // Instante em que o firmware rearma cada banco
+	bool pendente[2] = { false, false };
+	bool ultimo_cheio = false;
+	uint8_t c;
+
+	auto inicio = std::chrono::steady_clock::now();
+	while (lidos < total || ultimo_cheio) {
+		// Interrupcoes de transferencia completa que ja aconteceram, depois a tarefa do console
+		for (int b = 0; b < 2; b++) {
+			if (pendente[b] && pronto[b] <= t) {
+				pendente[b] = false;
+				cdc_in_completo(CDC_EP_IN, (uint8_t)b);
+			}
+		}
+		while (escritos < total) {
+			c = (uint8_t)(escritos * 7);
+			if (cdc_escreve(&c, 1) != 1) {
+				break;
+			}
+			escritos++;
+		}
+		cdc_descarrega();
+
+		// Host: o proximo banco na ordem, ou NAK
+		Banco &b = bancos[CDC_EP_IN][banco_host];
+		if (!b.armado || pendente[banco_host]) {
+			naks++;
+			t += NAK_US;
+			continue;
+		}
+		for (uint16_t i = 0; i < b.tam; i++) {
+			if (b.dados[i] != (uint8_t)((lidos + i) * 7)) {
+				falha("byte fora de ordem na transmissao");
+				return;
+			}
+		}
+		lidos += b.tam;
+		if (b.tam == 0) {
+			zlps++;
+			t += ZLP_US;
+		} else {
+			pacotes++;
+			t += PACOTE_US * b.tam / CDC_EP_TAM;
+		}
+		ultimo_cheio = (b.tam == CDC_EP_TAM) && lidos == total;
+		b.armado = false;
+		pendente[banco_host] = true;
+		pronto[banco_host] = t + isr_us;
+		banco_host ^= 1;
+	}
+	auto fim = std::chrono::steady_clock::now();
+
+	std::printf("tx %lu bytes pacotes %u zlps %u naks %u tempo_us %.0f vazao_kBps %.0f cpu_ns_pacote %.0f\n",
+			(unsigned long)total, pacotes, zlps, naks, t, total / t * 1000,
+			std::chrono::duration<double, std::nano>(fim - inicio).count() / (pacotes ? pacotes : 1));
+	if (zlps == 0 && total % CDC_EP_TAM == 0) {
+		falha("transmissao terminada em pacote cheio precisa de ZLP");
+	}
+}
+
+// Recepcao: consumidor com buffer de RX_TAM, que drena "consumo" bytes por pacote do barramento
+static std::vector<uint8_t> rx_buffer;
+static size_t rx_esperado;
+
+static size_t recebe(const uint8_t *dados, size_t tam)
+{
+	size_t i;
+
+	for (i = 0; i < tam && rx_buffer.size() < RX_TAM; i++) {
+		rx_buffer.push_back(dados[i]);
+	}
+	return i;
+}
+
+static void recepcao(size_t total, size_t consumo)
+{
+	size_t enviados = 0;
+	unsigned naks = 0;
+	uint8_t banco_host = 0;
+	double t = 0;
+	struct cdc_estatisticas est;
+
+	while (rx_esperado < total) {
+		Banco &b = bancos[CDC_EP_OUT][banco_host];
+		if (enviados < total && b.armado) {
+			uint16_t n = (uint16_t)((total - enviados < CDC_EP_TAM) ? total - enviados : CDC_EP_TAM);
+			for (uint16_t i = 0; i < n; i++) {
+				b.area[i] = (uint8_t)((enviados + i) * 13);
+			}
+			b.armado = false;
+			enviados += n;
+			t += PACOTE_US * n / CDC_EP_TAM;
+			uint8_t completo = banco_host;
+			banco_host ^= 1;
+			cdc_out_completo(CDC_EP_OUT, completo, n);
+		} else {
+			naks++;
+			t += NAK_US;
+		}
+
+		// Tarefa do console: drena e, abaixo da marca baixa, retoma um banco retido
+		for (size_t i = 0; i < consumo && !rx_buffer.empty(); i++) {
+			if (rx_buffer.front() != (uint8_t)(rx_esperado * 13)) {
+				falha("byte perdido ou fora de ordem na recepcao");
+				return;
+			}
+			rx_buffer.erase(rx_buffer.begin());
+			rx_esperado++;
+		}
+		if (rx_buffer.size() <= RX_MARCA_BAIXA) {
+			cdc_retoma_rx();
+		}
+	}
+
+	cdc_get_estatisticas(&est);
+	std::printf("rx %lu bytes naks %u retencoes %lu tempo_us %.0f vazao_kBps %.0f\n",
+			(unsigned long)total, naks, (unsigned long)est.retencoes, t, total / t * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	size_t total = (argc > 1) ? (size_t)std::atol(argv[1]) : 1 << 20;
+	double isr_us = (argc > 2) ? std::atof(argv[2]) : 20;
+	size_t consumo = (argc > 3) ? (size_t)std::atol(argv[3]) : 48;
+
+	cdc_init(recebe);
+	cdc_reset(); // Primeiro reset do barramento: arma o endpoint 0
+	enumera();
+	if (falhas == 0) {
+		transmissao(total, isr_us);
+		recepcao(total / 16, consumo);
+	}
+
+	std::printf("uart 9600 baud: 0.96 kBps\n");
+	std::printf("%s\n", falhas ? "FALHOU" : "ok");
+	return falhas ? 1 : 0;
+}
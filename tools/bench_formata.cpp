@@ -0,0 +1,121 @@
+/**
+ * \file
+ * \brief Comparacao (host) do formatador do firmware com o snprintf da biblioteca C
+ *
+ * Formata as mensagens mais comuns do console com formata_snprintf() e com snprintf(),
+ * confere que o texto e o mesmo e mostra o tempo medio por mensagem. No host os numeros
+ * servem para comparar os dois formatadores entre si, nao para prever ciclos no Cortex-M0+.
+ *
+ * Compilacao: gcc -O2 -c formata.c -o formata.o
+ *             g++ -std=c++11 -O2 -o bench_formata tools/bench_formata.cpp formata.o
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "../formata.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEM_RDTSC 1
+#endif
+
+static const int REPETICOES = 200000;
+
+// Evita que o compilador descarte as formatacoes
+static volatile unsigned soma;
+
+struct Mensagem {
+	const char *nome;
+	int (*formata)(char *, size_t, bool);
+};
+
+static int msg_ack(char *b, size_t t, bool nosso)
+{
+	unsigned long id = 123456;
+	return nosso ? formata_snprintf(b, t, "ok %lu\n", id) : std::snprintf(b, t, "ok %lu\n", id);
+}
+
+static int msg_erro(char *b, size_t t, bool nosso)
+{
+	unsigned long id = 42;
+	int erro = 3;
+	return nosso ? formata_snprintf(b, t, "err %lu %d\n", id, erro)
+			: std::snprintf(b, t, "err %lu %d\n", id, erro);
+}
+
+static int msg_brilho(char *b, size_t t, bool nosso)
+{
+	int brilho = 75;
+	return nosso ? formata_snprintf(b, t, "Brilho atual do LED: %d%%\n", brilho)
+			: std::snprintf(b, t, "Brilho atual do LED: %d%%\n", brilho);
+}
+
+static int msg_stats(char *b, size_t t, bool nosso)
+{
+	const char *nome = "RecebeComando";
+	unsigned long a = 1234567, c = 250, prio = 1;
+	unsigned pilha = 812;
+	return nosso ? formata_snprintf(b, t, "%s %c %lu %lu %lu %u\n", nome, 'B', prio, a, c, pilha)
+			: std::snprintf(b, t, "%s %c %lu %lu %lu %u\n", nome, 'B', prio, a, c, pilha);
+}
+
+static int msg_ajuda(char *b, size_t t, bool nosso)
+{
+	const char *texto = "\n\tHelp/Ajuda        : Exibe novamente esse menu";
+	return nosso ? formata_snprintf(b, t, "%s", texto) : std::snprintf(b, t, "%s", texto);
+}
+
+static const Mensagem mensagens[] = {
+	{ "ack", msg_ack },
+	{ "erro", msg_erro },
+	{ "brilho", msg_brilho },
+	{ "stats", msg_stats },
+	{ "ajuda", msg_ajuda },
+};
+
+static void mede(const Mensagem &m, bool nosso, double *ns, double *ciclos)
+{
+	char buffer[128];
+
+	auto inicio = std::chrono::steady_clock::now();
+#ifdef TEM_RDTSC
+	unsigned long long c0 = __rdtsc();
+#endif
+	for (int i = 0; i < REPETICOES; i++) {
+		soma += (unsigned)m.formata(buffer, sizeof(buffer), nosso) + (unsigned char)buffer[0];
+	}
+#ifdef TEM_RDTSC
+	unsigned long long c1 = __rdtsc();
+	*ciclos = (double)(c1 - c0) / REPETICOES;
+#else
+	*ciclos = 0;
+#endif
+	auto fim = std::chrono::steady_clock::now();
+	*ns = std::chrono::duration<double, std::nano>(fim - inicio).count() / REPETICOES;
+}
+
+int main()
+{
+	int erros = 0;
+
+	std::printf("mensagem formata_ns snprintf_ns formata_ciclos snprintf_ciclos\n");
+	for (const Mensagem &m : mensagens) {
+		char a[128], b[128];
+		double ns_nosso, ns_libc, c_nosso, c_libc;
+
+		m.formata(a, sizeof(a), true);
+		m.formata(b, sizeof(b), false);
+		if (std::strcmp(a, b) != 0) {
+			std::printf("%s: saida diferente\n  formata:  \"%s\"\n  snprintf: \"%s\"\n", m.nome, a, b);
+			erros++;
+		}
+
+		mede(m, true, &ns_nosso, &c_nosso);
+		mede(m, false, &ns_libc, &c_libc);
+		std::printf("%s %.1f %.1f %.0f %.0f\n", m.nome, ns_nosso, ns_libc, c_nosso, c_libc);
+	}
+
+	return erros ? 1 : 0;
+}
@@ -0,0 +1,298 @@
+/**
+ * \file
+ * \brief Comparacao (host) do texto pelo gfx_mono com o desenho por paginas (glifo.c)
+ *
+ * Simula o SSD1306 do OLED1 com o framebuffer em RAM do driver do ASF: cada escrita de byte
+ * (put_byte) manda pagina, coluna e o dado pela SPI, e uma escrita de pagina (put_page) manda
+ * o endereco uma vez e os bytes em sequencia. Sobre ele roda:
+ *
+ *  - o caminho atual: gfx_mono_draw_char() (retangulo apagado linha a linha e pixels acesos
+ *    um a um, cada um com leitura e escrita do byte), como no gfx_mono do ASF;
+ *  - o caminho novo: a fonte girada para paginas (glifo.c), linhas do terminal inteiras e
+ *    a animacao do "about" com as posicoes em tabela, como em demotasks.c.
+ *
+ * Mede, por redesenho da tela inteira do terminal e por animacao completa do "about", os
+ * ciclos de CPU no host (so para comparar os dois caminhos entre si), os bytes na SPI e o
+ * tempo deles no clock da SPI, e confere que os dois caminhos deixam o mesmo framebuffer.
+ * A fonte e sintetica: o custo nao depende do desenho dos glifos, so do formato.
+ *
+ * Compilacao: gcc -O2 -c glifo.c -o glifo.o
+ *             g++ -std=c++11 -O2 -o bench_glifo tools/bench_glifo.cpp glifo.o
+ * Uso:        bench_glifo [spi_hz] [repeticoes]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../glifo.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TEM_RDTSC 1
+#endif
+
+// Tela e fonte como na demo
+#define LARGURA       128
+#define PAGINAS       8
+#define FONTE_LARGURA 6
+#define FONTE_ALTURA  7
+#define PRIMEIRO      0x20
+#define ULTIMO        0x7D
+#define CANVAS_HEIGHT (32 - 9)
+#define COLUNAS       (LARGURA / FONTE_LARGURA)
+#define LINHAS_TERM   3
+#define PASSOS        8
+
+static uint8_t tela[PAGINAS][LARGURA];
+static unsigned long spi_bytes;
+
+static uint8_t fonte_linhas[(ULTIMO - PRIMEIRO + 1) * FONTE_ALTURA];
+static uint8_t fonte_colunas[GLIFO_TAM_FONTE(FONTE_LARGURA, PRIMEIRO, ULTIMO)];
+static struct glifo_fonte fonte;
+
+static char terminal[LINHAS_TERM][COLUNAS + 1];
+static const char about[] =
+	"FreeRTOS 10.0.0 demo."
+	"                     "
+	"Use CDC at 9.6 kBaud.";
+
+// Driver do SSD1306 com framebuffer (gfx_mono_ssd1306_*)
+static uint8_t get_byte(int pagina, int coluna)
+{
+	return tela[pagina][coluna];
+}
+
+static void put_byte(int pagina, int coluna, uint8_t dado)
+{
+	if (tela[pagina][coluna] == dado) {
+		return; // Sem "force", byte igual nao vai para a SPI
+	}
+	tela[pagina][coluna] = dado;
+	spi_bytes += 4; // Pagina, coluna (2 comandos) e o dado
+}
+
+static void put_page(const uint8_t *dados, int pagina, int coluna, int largura)
+{
+	std::memcpy(&tela[pagina][coluna], dados, largura);
+	spi_bytes += 3 + largura;
+}
+
+// Caminho atual: primitivas genericas do gfx_mono
+static void draw_pixel(int x, int y, bool acende)
+{
+	uint8_t byte = get_byte(y / 8, x);
+	uint8_t mascara = (uint8_t)(1 << (y % 8));
+	put_byte(y / 8, x, acende ? (byte | mascara) : (byte & ~mascara));
+}
+
+static void draw_horizontal_line(int x, int y, int largura, bool acende)
+{
+	uint8_t mascara = (uint8_t)(1 << (y % 8));
+	for (int i = 0; i < largura; i++) {
+		uint8_t byte = get_byte(y / 8, x + i);
+		put_byte(y / 8, x + i, acende ? (byte | mascara) : (byte & ~mascara));
+	}
+}
+
+static void draw_filled_rect(int x, int y, int largura, int altura, bool acende)
+{
+	for (; altura > 0; altura--) {
+		draw_horizontal_line(x, y + altura - 1, largura, acende);
+	}
+}
+
+static void draw_char(char c, int x, int y)
+{
+	const uint8_t *g = &fonte_linhas[((uint8_t)c - PRIMEIRO) * FONTE_ALTURA];
+
+	draw_filled_rect(x, y, FONTE_LARGURA, FONTE_ALTURA, false);
+	for (int linha = 0; linha < FONTE_ALTURA; linha++) {
+		uint8_t byte = g[linha];
+		for (int i = 0; i < FONTE_LARGURA; i++) {
+			if (byte & 0x80) {
+				draw_pixel(x + i, y + linha, true);
+			}
+			byte <<= 1;
+		}
+	}
+}
+
+static void terminal_atual()
+{
+	int y = (LINHAS_TERM - 1) * (FONTE_ALTURA + 1);
+
+	for (int l = LINHAS_TERM - 1; l >= 0; l--) {
+		int x = 0, coluna = 0;
+		while (terminal[l][coluna] != '\0') {
+			draw_char(terminal[l][coluna], x, y);
+			x += FONTE_LARGURA;
+			coluna++;
+		}
+		if (coluna < COLUNAS) {
+			draw_filled_rect(x, y, LARGURA - coluna * FONTE_LARGURA, FONTE_ALTURA, false);
+		}
+		y -= 1 + FONTE_ALTURA;
+	}
+}
+
+static void about_atual()
+{
+	for (int passo = 1; passo <= PASSOS; passo++) {
+		for (unsigned i = 0; i < sizeof(about) - 1; i++) {
+			int x = (((i % COLUNAS) * FONTE_LARGURA) * passo + (LARGURA / 2) * (PASSOS - passo)) / PASSOS;
+			int y = (((i / COLUNAS) * FONTE_ALTURA) * passo + (CANVAS_HEIGHT / 2) * (PASSOS - passo)) / PASSOS;
+			draw_char(about[i], x, y);
+		}
+	}
+}
+
+// Caminho novo, como em demotasks.c
+static void terminal_novo()
+{
+	uint8_t pagina[LARGURA];
+
+	for (int l = LINHAS_TERM - 1; l >= 0; l--) {
+		for (int x = 0; x < LARGURA; x++) {
+			pagina[x] = get_byte(l, x);
+		}
+		glifo_linha(&fonte, terminal[l], pagina, LARGURA);
+		put_page(pagina, l, 0, LARGURA);
+	}
+}
+
+static uint8_t about_x[PASSOS + 1][COLUNAS];
+static uint8_t about_y[PASSOS + 1][(sizeof(about) - 1 + COLUNAS - 1) / COLUNAS];
+
+static void text_draw_char(char c, int x, int y)
+{
+	uint8_t sup[FONTE_LARGURA], inf[FONTE_LARGURA];
+	int pagina = y / 8;
+	uint8_t desloc = y % 8;
+	bool duas = desloc + FONTE_ALTURA > 8;
+
+	for (int i = 0; i < FONTE_LARGURA; i++) {
+		sup[i] = get_byte(pagina, x + i);
+		if (duas) {
+			inf[i] = get_byte(pagina + 1, x + i);
+		}
+	}
+	glifo_desenha(&fonte, c, desloc, sup, inf);
+	put_page(sup, pagina, x, FONTE_LARGURA);
+	if (duas) {
+		put_page(inf, pagina + 1, x, FONTE_LARGURA);
+	}
+}
+
+static void about_novo()
+{
+	for (int passo = 1; passo <= PASSOS; passo++) {
+		int coluna = 0, linha = 0;
+		for (unsigned i = 0; i < sizeof(about) - 1; i++) {
+			text_draw_char(about[i], about_x[passo][coluna], about_y[passo][linha]);
+			if (++coluna == COLUNAS) {
+				coluna = 0;
+				linha++;
+			}
+		}
+	}
+}
+
+// Tela inicial: linha do menu logo abaixo do canvas, que o texto nao pode apagar
+static void tela_inicial()
+{
+	std::memset(tela, 0, sizeof(tela));
+	for (int x = 0; x < LARGURA; x++) {
+		tela[CANVAS_HEIGHT / 8][x] |= 1 << (CANVAS_HEIGHT % 8);
+	}
+}
+
+struct Medida {
+	double ciclos;
+	double ns;
+	unsigned long spi;
+};
+
+static Medida mede(void (*desenha)(), int repeticoes, uint8_t copia[PAGINAS][LARGURA])
+{
+	Medida m = { 0, 0, 0 };
+
+	for (int r = 0; r < repeticoes; r++) {
+		tela_inicial();
+		// Texto diferente do anterior na tela, para toda coluna mudar. As duas colunas depois
+		// da ultima letra ficam apagadas, como na demo (o gfx_mono nao as apaga em linha cheia)
+		for (int p = 0; p < CANVAS_HEIGHT / 8; p++) {
+			std::memset(tela[p], r & 1 ? 0x55 : 0xAA, COLUNAS * FONTE_LARGURA);
+		}
+		spi_bytes = 0;
+		auto inicio = std::chrono::steady_clock::now();
+#ifdef TEM_RDTSC
+		unsigned long long c0 = __rdtsc();
+#endif
+		desenha();
+#ifdef TEM_RDTSC
+		m.ciclos += (double)(__rdtsc() - c0);
+#endif
+		m.ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - inicio).count();
+		m.spi += spi_bytes;
+	}
+	m.ciclos /= repeticoes;
+	m.ns /= repeticoes;
+	m.spi /= repeticoes;
+	std::memcpy(copia, tela, sizeof(tela));
+	return m;
+}
+
+static void mostra(const char *nome, const Medida &m, double spi_hz)
+{
+	std::printf("%s %.0f %.0f %lu %.2f\n", nome, m.ciclos, m.ns, m.spi, m.spi * 8.0 / spi_hz * 1000);
+}
+
+int main(int argc, char **argv)
+{
+	double spi_hz = (argc > 1) ? std::atof(argv[1]) : 1000000;
+	int repeticoes = (argc > 2) ? std::atoi(argv[2]) : 2000;
+	static uint8_t antes[PAGINAS][LARGURA], depois[PAGINAS][LARGURA];
+	int erros = 0;
+
+	for (unsigned i = 0; i < sizeof(fonte_linhas); i++) {
+		fonte_linhas[i] = (uint8_t)(((i * 37) ^ (i >> 3) * 11) & 0xFC);
+	}
+	glifo_rotaciona(&fonte, fonte_colunas, fonte_linhas, FONTE_LARGURA, FONTE_ALTURA, PRIMEIRO, ULTIMO);
+
+	for (int l = 0; l < LINHAS_TERM; l++) {
+		int n = (l == 0) ? COLUNAS : 8 + 5 * l; // Uma linha cheia e as outras pela metade
+		for (int c = 0; c < n; c++) {
+			terminal[l][c] = (char)(PRIMEIRO + (l * 31 + c * 7) % (ULTIMO - PRIMEIRO + 1));
+		}
+		terminal[l][n] = '\0';
+	}
+	for (int passo = 0; passo <= PASSOS; passo++) {
+		for (int c = 0; c < COLUNAS; c++) {
+			about_x[passo][c] = (uint8_t)(((c * FONTE_LARGURA) * passo + (LARGURA / 2) * (PASSOS - passo)) / PASSOS);
+		}
+		for (unsigned l = 0; l < sizeof(about_y[0]); l++) {
+			about_y[passo][l] = (uint8_t)(((l * FONTE_ALTURA) * passo + (CANVAS_HEIGHT / 2) * (PASSOS - passo)) / PASSOS);
+		}
+	}
+
+	std::printf("desenho ciclos ns spi_bytes spi_ms (SPI a %.0f Hz)\n", spi_hz);
+
+	mostra("terminal_gfx_mono", mede(terminal_atual, repeticoes, antes), spi_hz);
+	mostra("terminal_glifo", mede(terminal_novo, repeticoes, depois), spi_hz);
+	if (std::memcmp(antes, depois, sizeof(antes)) != 0) {
+		std::printf("terminal: framebuffers diferentes\n");
+		erros++;
+	}
+
+	mostra("about_gfx_mono", mede(about_atual, repeticoes / 10 + 1, antes), spi_hz);
+	mostra("about_glifo", mede(about_novo, repeticoes / 10 + 1, depois), spi_hz);
+	if (std::memcmp(antes, depois, sizeof(antes)) != 0) {
+		std::printf("about: framebuffers diferentes\n");
+		erros++;
+	}
+
+	return erros ? 1 : 0;
+}
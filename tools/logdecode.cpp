@@ -0,0 +1,131 @@
+/**
+ * \file
+ * \brief Decodificador do log binario (host)
+ *
+ * Le a saida do console (arquivo ou entrada padrao), repassa o texto normal e substitui
+ * os quadros do log binario pelas mensagens formatadas, usando a mesma tabela de
+ * mensagens do firmware (logbin_msgs.h).
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o logdecode tools/logdecode.cpp
+ * Uso:        logdecode [captura.bin]   (sem argumento le da entrada padrao)
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../logbin.h"
+
+// Textos de formato, na mesma ordem dos identificadores do firmware
+#define LOGBIN_MSG(id, formato) formato,
+static const char *const formatos[] = {
+#include "../logbin_msgs.h"
+};
+#undef LOGBIN_MSG
+
+static const unsigned num_formatos = sizeof(formatos) / sizeof(formatos[0]);
+
+static uint32_t le_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16)
+			| ((uint32_t)p[3] << 24);
+}
+
+// Imprime um registro decodificado
+static void imprime_registro(const std::vector<uint8_t> &registro)
+{
+	int32_t args[LOGBIN_MAX_ARGS] = { 0 };
+	char texto[256];
+
+	if (registro.size() < 5) {
+		std::printf("[logbin] registro truncado (%u bytes)\n", (unsigned)registro.size());
+		return;
+	}
+
+	unsigned id = registro[0];
+	uint32_t tick = le_u32(&registro[1]);
+	unsigned nargs = (unsigned)(registro.size() - 5) / 4;
+
+	if (nargs > LOGBIN_MAX_ARGS) {
+		nargs = LOGBIN_MAX_ARGS;
+	}
+	for (unsigned i = 0; i < nargs; i++) {
+		args[i] = (int32_t)le_u32(&registro[5 + 4 * i]);
+	}
+
+	if (id >= num_formatos) {
+		std::printf("[%10u] mensagem desconhecida %u\n", tick, id);
+		return;
+	}
+
+	// Os formatos so tem conversoes de inteiros, entao argumentos extras sao ignorados
+	std::snprintf(texto, sizeof(texto), formatos[id], args[0], args[1], args[2], args[3]);
+	std::printf("[%10u] %s\n", tick, texto);
+}
+
+int main(int argc, char **argv)
+{
+	FILE *entrada = stdin;
+	std::vector<uint8_t> registro;
+	bool em_quadro = false;
+	bool escape = false;
+	int tamanho = -1;
+	int c;
+
+	if (argc > 1) {
+		entrada = std::fopen(argv[1], "rb");
+		if (entrada == NULL) {
+			std::perror(argv[1]);
+			return 1;
+		}
+	}
+
+	while ((c = std::fgetc(entrada)) != EOF) {
+		if (!em_quadro) {
+			if (c == LOGBIN_INICIO) {
+				em_quadro = true;
+				escape = false;
+				tamanho = -1;
+				registro.clear();
+			} else if (c != 0x11 && c != 0x13) {
+				std::putchar(c);
+			}
+			continue;
+		}
+
+		// Inicio de outro quadro no meio deste: o anterior foi truncado
+		if (c == LOGBIN_INICIO) {
+			std::printf("[logbin] quadro truncado\n");
+			tamanho = -1;
+			registro.clear();
+			continue;
+		}
+
+		if (c == LOGBIN_ESCAPE) {
+			escape = true;
+			continue;
+		}
+		if (escape) {
+			c ^= LOGBIN_ESCAPE_XOR;
+			escape = false;
+		}
+
+		if (tamanho < 0) {
+			tamanho = c;
+		} else {
+			registro.push_back((uint8_t)c);
+		}
+
+		if (tamanho >= 0 && (int)registro.size() == tamanho) {
+			imprime_registro(registro);
+			em_quadro = false;
+		}
+	}
+
+	if (entrada != stdin) {
+		std::fclose(entrada);
+	}
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * \file
+ * \brief Resumo da RAM estatica do firmware (pilhas, TCBs, filas e buffers) a partir da tabela de simbolos
+ *
+ * Le a saida de "arm-none-eabi-nm -S -t d" do ELF e soma os objetos em RAM (tipos b, B, d, D)
+ * por classe, pelo nome dado nas alocacoes estaticas: pilhas das tarefas (TAREFAS em main.c,
+ * idle, timers e LogBin), TCBs, estruturas e areas das filas, stream/message buffers e
+ * semaforos, e o heap do FreeRTOS (ucHeap). Os numeros saem da ligacao, nao de estimativas.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o ram_estatica tools/ram_estatica.cpp
+ * Uso:        arm-none-eabi-nm -S -t d firmware.elf | ram_estatica [-v]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Simbolo {
+	std::string nome;
+	unsigned long tam;
+};
+
+static bool termina_com(const std::string &s, const char *fim)
+{
+	size_t n = std::strlen(fim);
+	return s.size() >= n && s.compare(s.size() - n, n, fim) == 0;
+}
+
+static bool contem(const std::string &s, const char *parte)
+{
+	return s.find(parte) != std::string::npos;
+}
+
+// Classe de um simbolo pelo nome (variaveis estaticas de funcao ganham um sufixo ".<n>")
+static const char *classe(std::string nome)
+{
+	size_t ponto = nome.find('.');
+	if (ponto != std::string::npos) {
+		nome = nome.substr(0, ponto);
+	}
+	if (nome == "ucHeap") {
+		return "heap";
+	}
+	if (termina_com(nome, "Pilha") || termina_com(nome, "_pilha")) {
+		return "pilhas";
+	}
+	if (termina_com(nome, "Tcb") || termina_com(nome, "_tcb")) {
+		return "tcbs";
+	}
+	if (contem(nome, "Buffer") || contem(nome, "_buffer") || termina_com(nome, "_area")
+			|| termina_com(nome, "Area")) {
+		return "filas_e_buffers";
+	}
+	return "outros";
+}
+
+int main(int argc, char **argv)
+{
+	bool detalhe = (argc > 1 && std::strcmp(argv[1], "-v") == 0);
+	std::map<std::string, std::vector<Simbolo>> classes;
+	std::map<std::string, unsigned long> totais;
+	unsigned long total = 0;
+	std::string linha;
+
+	// "<endereco> <tamanho> <tipo> <nome>"; simbolos sem tamanho tem so tres campos
+	while (std::getline(std::cin, linha)) {
+		std::istringstream in(linha);
+		std::string endereco, tam, tipo, nome;
+		if (!(in >> endereco >> tam >> tipo >> nome)) {
+			continue;
+		}
+		if (tipo != "b" && tipo != "B" && tipo != "d" && tipo != "D") {
+			continue;
+		}
+		Simbolo s = { nome, std::strtoul(tam.c_str(), nullptr, 10) };
+		const char *c = classe(nome);
+		classes[c].push_back(s);
+		totais[c] += s.tam;
+		total += s.tam;
+	}
+
+	if (total == 0) {
+		std::fprintf(stderr, "nenhum simbolo em RAM na entrada (use arm-none-eabi-nm -S -t d)\n");
+		return 1;
+	}
+
+	std::printf("classe bytes simbolos\n");
+	for (const auto &c : classes) {
+		std::printf("%s %lu %zu\n", c.first.c_str(), totais[c.first], c.second.size());
+		if (detalhe) {
+			for (const Simbolo &s : c.second) {
+				std::printf("  %s %lu\n", s.nome.c_str(), s.tam);
+			}
+		}
+	}
+	std::printf("total %lu\n", total);
+	return 0;
+}
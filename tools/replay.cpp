@@ -0,0 +1,247 @@
+/**
+ * \file
+ * \brief Reproducao (host) de uma gravacao do "record dump" contra a placa ou um simulador
+ *
+ * Le a saida do "record dump" (linhas "<ms desde a anterior> <comando>"; as demais sao
+ * ignoradas) e reenvia cada comando no mesmo instante relativo da gravacao, dividido pela
+ * velocidade. O destino e uma porta serial (configurada em modo raw) ou "-" para a saida
+ * padrao, para alimentar um simulador por um pipe.
+ *
+ * Na porta serial as respostas sao repassadas para a saida padrao. Linhas com "#<id>" sao
+ * casadas com o "ok <id>"/"err <id> <codigo>" da resposta, e no fim sao exibidos o atraso
+ * de envio e a latencia dos acks (p50/p99/max), para comparar versoes do firmware com a
+ * mesma carga.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o replay tools/replay.cpp
+ * Uso:        replay [-v velocidade] [-b baud] captura.txt </dev/ttyACM0 | ->
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Relogio;
+
+struct Linha {
+	double instante; // ms desde o inicio, ja na velocidade pedida
+	std::string texto;
+};
+
+static Relogio::time_point inicio;
+
+static double agora_ms()
+{
+	return std::chrono::duration<double, std::milli>(Relogio::now() - inicio).count();
+}
+
+static speed_t baud_termios(long baud)
+{
+	switch (baud) {
+	case 9600:   return B9600;
+	case 19200:  return B19200;
+	case 38400:  return B38400;
+	case 57600:  return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	}
+	return 0;
+}
+
+static int abre_serial(const char *caminho, long baud)
+{
+	struct termios tio;
+	speed_t velocidade = baud_termios(baud);
+	int fd;
+
+	if (velocidade == 0) {
+		std::fprintf(stderr, "baud %ld nao suportado\n", baud);
+		return -1;
+	}
+	fd = open(caminho, O_RDWR | O_NOCTTY);
+	if (fd < 0) {
+		std::perror(caminho);
+		return -1;
+	}
+	// Pipes e arquivos ficam como estao; so terminais sao configurados
+	if (tcgetattr(fd, &tio) == 0) {
+		cfmakeraw(&tio);
+		cfsetispeed(&tio, velocidade);
+		cfsetospeed(&tio, velocidade);
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+	return fd;
+}
+
+// Respostas recebidas ate agora; casa os acks com os envios
+struct Respostas {
+	std::string parcial;
+	std::map<unsigned long, double> enviados; // id -> instante do envio
+	std::vector<double> latencias;
+	unsigned long erros;
+
+	Respostas() : erros(0) {}
+
+	void recebe(const char *dados, size_t tam)
+	{
+		std::fwrite(dados, 1, tam, stdout);
+		for (size_t i = 0; i < tam; i++) {
+			if (dados[i] == '\n') {
+				linha(parcial.c_str());
+				parcial.clear();
+			} else if (dados[i] != '\r') {
+				parcial += dados[i];
+			}
+		}
+	}
+
+	void linha(const char *texto)
+	{
+		unsigned long id;
+		int codigo;
+		bool ok = std::sscanf(texto, "ok %lu", &id) == 1;
+
+		if (!ok && std::sscanf(texto, "err %lu %d", &id, &codigo) != 2) {
+			return;
+		}
+		std::map<unsigned long, double>::iterator it = enviados.find(id);
+		if (it == enviados.end()) {
+			return;
+		}
+		latencias.push_back(agora_ms() - it->second);
+		enviados.erase(it);
+		if (!ok) {
+			erros++;
+		}
+	}
+};
+
+// Le o que chegou ate o instante "ate" (ms)
+static void espera(int fd, bool le, double ate, Respostas &respostas)
+{
+	char dados[256];
+	double falta;
+
+	while ((falta = ate - agora_ms()) > 0) {
+		if (!le) {
+			usleep((useconds_t)(falta * 1000));
+			return;
+		}
+		struct pollfd p = { fd, POLLIN, 0 };
+		if (poll(&p, 1, (int)falta + 1) > 0 && (p.revents & POLLIN)) {
+			ssize_t n = read(fd, dados, sizeof(dados));
+			if (n > 0) {
+				respostas.recebe(dados, (size_t)n);
+			}
+		}
+	}
+}
+
+static double percentil(std::vector<double> v, double p)
+{
+	if (v.empty()) {
+		return 0;
+	}
+	std::sort(v.begin(), v.end());
+	return v[(size_t)(p * (v.size() - 1))];
+}
+
+int main(int argc, char **argv)
+{
+	double velocidade = 1.0;
+	long baud = 115200;
+	std::vector<Linha> linhas;
+	Respostas respostas;
+	char texto[256];
+	double instante = 0;
+	double atraso_max = 0;
+	int opcao;
+	int fd;
+	bool le;
+
+	while ((opcao = getopt(argc, argv, "v:b:")) != -1) {
+		if (opcao == 'v') {
+			velocidade = std::atof(optarg); // 0: sem esperas
+		} else if (opcao == 'b') {
+			baud = std::atol(optarg);
+		} else {
+			return 2;
+		}
+	}
+	if (argc - optind != 2 || velocidade < 0) {
+		std::fprintf(stderr, "uso: %s [-v velocidade] [-b baud] captura.txt <porta | ->\n", argv[0]);
+		return 2;
+	}
+
+	FILE *entrada = std::fopen(argv[optind], "r");
+	if (entrada == NULL) {
+		std::perror(argv[optind]);
+		return 1;
+	}
+	while (std::fgets(texto, sizeof(texto), entrada) != NULL) {
+		unsigned long ms;
+		int pos;
+
+		if (std::sscanf(texto, "%lu %n", &ms, &pos) != 1) {
+			continue; // Cabecalho "record ..."/"replay ..." ou outra saida do console
+		}
+		texto[std::strcspn(texto, "\r\n")] = '\0';
+		instante += (velocidade > 0) ? ms / velocidade : 0;
+		Linha l = { instante, texto + pos };
+		linhas.push_back(l);
+	}
+	std::fclose(entrada);
+
+	if (std::strcmp(argv[optind + 1], "-") == 0) {
+		fd = STDOUT_FILENO;
+		le = false;
+	} else {
+		fd = abre_serial(argv[optind + 1], baud);
+		if (fd < 0) {
+			return 1;
+		}
+		le = true;
+	}
+
+	inicio = Relogio::now();
+	for (size_t i = 0; i < linhas.size(); i++) {
+		unsigned long id;
+
+		espera(fd, le, linhas[i].instante, respostas);
+		atraso_max = std::max(atraso_max, agora_ms() - linhas[i].instante);
+
+		if (std::sscanf(linhas[i].texto.c_str(), "#%lu", &id) == 1) {
+			respostas.enviados[id] = agora_ms();
+		}
+		std::string envio = linhas[i].texto + "\n";
+		if (write(fd, envio.data(), envio.size()) != (ssize_t)envio.size()) {
+			std::perror("write");
+			return 1;
+		}
+	}
+
+	// Acks que ainda faltam: ate 2 s depois do ultimo envio
+	double fim = agora_ms();
+	if (le) {
+		espera(fd, le, fim + 2000, respostas);
+	}
+
+	std::fprintf(stderr, "linhas %u planejado_ms %.1f real_ms %.1f atraso_envio_max_ms %.2f\n",
+			(unsigned)linhas.size(), instante, fim, atraso_max);
+	if (le) {
+		std::fprintf(stderr, "acks %u erros %lu sem_resposta %u p50_ms %.2f p99_ms %.2f max_ms %.2f\n",
+				(unsigned)respostas.latencias.size(), respostas.erros,
+				(unsigned)respostas.enviados.size(), percentil(respostas.latencias, 0.50),
+				percentil(respostas.latencias, 0.99), percentil(respostas.latencias, 1.0));
+	}
+	return (le && !respostas.enviados.empty()) ? 1 : 0;
+}
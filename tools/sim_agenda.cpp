@@ -0,0 +1,273 @@
+/**
+ * \file
+ * \brief Simulacao (host) da agenda com centenas de jobs at/every na roda de tempo de roda.c
+ *
+ * Avanca a roda a cada CONF_AGENDA_RESOLUCAO_MS, como o timer de agenda.c, e entre os avancos
+ * insere jobs at e every com atrasos de 0 a varias voltas da roda, cancela jobs vivos e tenta
+ * cancelar ids velhos, mantendo a agenda perto de cheia e de vez em quando esvaziando-a. Parte
+ * dos disparos do timer acha a trava ocupada e deixa o avanco para o seguinte, que avanca a roda
+ * ate o tempo atual, como em agenda_avanca(); parte dos jobs acha a fila de comandos cheia. O
+ * timer para com a roda vazia e volta com a fase do primeiro job inserido. Confere, contra um
+ * modelo:
+ *  - nenhum job dispara antes do atraso pedido, contado do momento da insercao;
+ *  - o atraso passa do pedido em menos de 2 resolucoes, mais os avancos adiados;
+ *  - um every dispara a cada ceil(ms / resolucao) passos, sem acumular atraso;
+ *  - um job cancelado nao dispara, e um id velho nao cancela o job que reaproveitou o lugar;
+ *  - cada at dispara uma vez, e os perdidos batem com os disparos recusados.
+ *
+ * Compilacao: gcc -O2 -DCONF_AGENDA_MAX=256 -DCONF_AGENDA_SLOTS=128 -c roda.c
+ *             g++ -std=c++11 -O2 -DCONF_AGENDA_MAX=256 -DCONF_AGENDA_SLOTS=128 -o sim_agenda tools/sim_agenda.cpp roda.o
+ * Uso:        sim_agenda [segundos] [semente]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../roda.h"
+
+static const uint32_t RESOLUCAO_MS = 10;   // CONF_AGENDA_RESOLUCAO_MS
+
+// Modelo de um job: o arg[0] do comando e a chave
+struct Job {
+	int id;
+	uint32_t ms;
+	bool periodico;
+	uint64_t inserido;     // ms
+	uint64_t primeiro;     // ms do primeiro disparo (0: ainda nao)
+	uint32_t disparos;
+	bool vivo;
+};
+
+static std::map<int32_t, Job> jobs;
+static std::mt19937 gerador;
+static uint64_t agora;
+static uint64_t atraso_max;
+static uint64_t adiados_max;   // Maior sequencia de avancos adiados, em ms
+static unsigned long disparos, recusados, erros;
+
+static void erro(const char *texto, int32_t chave)
+{
+	if (erros < 10) {
+		const Job &j = jobs[chave];
+		std::printf("erro: %s (job %d ms %lu %s inserido %llu agora %llu disparos %lu)\n", texto, j.id,
+				(unsigned long)j.ms, j.periodico ? "every" : "at", (unsigned long long)j.inserido,
+				(unsigned long long)agora, (unsigned long)j.disparos);
+	}
+	erros++;
+}
+
+static uint32_t passos(uint32_t ms)
+{
+	uint32_t p = (ms + RESOLUCAO_MS - 1) / RESOLUCAO_MS;
+	return p ? p : 1;
+}
+
+// Faz o papel de EnfileiraAgendado: confere o disparo e as vezes acha a fila cheia
+static bool executa(const Comando *cmd)
+{
+	auto it = jobs.find(cmd->arg[0]);
+	if (it == jobs.end() || !it->second.vivo) {
+		erro("disparo de job cancelado ou desconhecido", cmd->arg[0]);
+		return true;
+	}
+	Job &j = it->second;
+	uint64_t atraso = agora - j.inserido;
+
+	if (j.disparos == 0) {
+		if (atraso < j.ms) {
+			erro("disparou antes do atraso", cmd->arg[0]);
+		}
+		if (atraso - j.ms > atraso_max) {
+			atraso_max = atraso - j.ms;
+		}
+		if (atraso >= j.ms + 2 * RESOLUCAO_MS + adiados_max) {
+			erro("atraso alem de 2 resolucoes", cmd->arg[0]);
+		}
+		j.primeiro = agora;
+	} else {
+		// Disparo n: n periodos depois do primeiro, a menos do que os avancos adiados atrasaram um ou outro
+		uint64_t nominal = j.primeiro + (uint64_t)j.disparos * passos(j.ms) * RESOLUCAO_MS;
+		if (agora + adiados_max < nominal || agora > nominal + adiados_max) {
+			erro("every fora do periodo", cmd->arg[0]);
+		}
+		if (!j.periodico) {
+			erro("at disparou de novo", cmd->arg[0]);
+		}
+	}
+	j.disparos++;
+	disparos++;
+	if (!j.periodico) {
+		j.vivo = false;
+	}
+
+	if (gerador() % 100 == 0) {
+		recusados++;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t segundos = (argc > 1) ? (uint32_t)std::atoi(argv[1]) : 600;
+	gerador.seed((argc > 2) ? (uint32_t)std::atoi(argv[2]) : 1);
+
+	static struct roda roda;
+	roda_init(&roda, RESOLUCAO_MS);
+	const uint32_t volta_ms = CONF_AGENDA_SLOTS * RESOLUCAO_MS;
+	std::vector<int32_t> vivos;
+	std::vector<int> velhos;
+	uint64_t base = 0;            // agenda_base: ms do ultimo avanco feito
+	bool ligado = false;          // Timer da agenda
+	uint32_t adiados = 0, seguidos = 0;
+	unsigned long inseridos = 0, cheia = 0, cancelados = 0, velhos_recusados = 0, avancos = 0;
+	unsigned long pico = 0, esvaziada = 0;
+	int32_t chave = 0;
+	int ok = 0;
+
+	// 10 ms: avanco da roda ou trava ocupada; entre avancos, algumas operacoes em instantes quaisquer
+	for (agora = 1; agora <= (uint64_t)segundos * 1000; agora++) {
+		// Disparo do timer, na fase em que foi ligado
+		if (ligado && (agora - base) % RESOLUCAO_MS == 0) {
+			if (gerador() % 20 == 0 && seguidos < 3) {
+				adiados++;
+				seguidos++;
+				if (seguidos * RESOLUCAO_MS > adiados_max) {
+					adiados_max = seguidos * RESOLUCAO_MS;
+				}
+			} else {
+				seguidos = 0;
+				while (agora - base >= RESOLUCAO_MS) {
+					base += RESOLUCAO_MS;
+					roda_avanca(&roda, executa);
+					avancos++;
+				}
+				if (roda_vazia(&roda)) {
+					ligado = false;
+				}
+			}
+		}
+
+		if (gerador() % 4 != 0) {
+			continue;
+		}
+
+		// Tira da lista os at que ja dispararam
+		for (size_t i = 0; i < vivos.size();) {
+			if (!jobs[vivos[i]].vivo) {
+				vivos[i] = vivos.back();
+				vivos.pop_back();
+			} else {
+				i++;
+			}
+		}
+		if (vivos.size() > pico) {
+			pico = vivos.size();
+		}
+
+		// De vez em quando cancela tudo: o timer para e volta com o proximo job
+		uint32_t op = gerador() % 100000;
+		if (op == 0) {
+			for (int32_t c : vivos) {
+				if (!roda_cancela(&roda, jobs[c].id)) {
+					erro("cancela de job vivo falhou", c);
+				}
+				jobs[c].vivo = false;
+				cancelados++;
+			}
+			vivos.clear();
+			if (!roda_vazia(&roda)) {
+				std::printf("erro: roda nao ficou vazia\n");
+				erros++;
+			}
+			esvaziada++;
+			continue;
+		}
+		op %= 100;
+		if (op < 70 || vivos.empty()) {
+			Comando cmd = Comando();
+			Job j = Job();
+			cmd.tipo = CMD_BRILHO;
+			cmd.arg[0] = ++chave;
+			j.periodico = (gerador() % 3 == 0);
+			// Atrasos de 0 a 3 voltas da roda, com muitos nao multiplos da resolucao
+			j.ms = gerador() % (3 * volta_ms + 1);
+			if (j.periodico && j.ms < RESOLUCAO_MS && gerador() % 2) {
+				j.ms = RESOLUCAO_MS;
+			}
+			j.inserido = agora;
+			j.vivo = true;
+			jobs[chave] = j;
+			bool primeiro = roda_vazia(&roda);
+			if (primeiro) {
+				base = agora;
+			}
+			int id = roda_insere(&roda, &cmd, j.ms, j.periodico, (uint32_t)((agora - base) / RESOLUCAO_MS));
+			if (id > 0 && primeiro) {
+				ligado = true;
+			}
+			if (id < 0) {
+				if (vivos.size() != CONF_AGENDA_MAX) {
+					std::printf("erro: agenda recusou com %zu jobs vivos\n", vivos.size());
+					erros++;
+				}
+				jobs.erase(chave);
+				cheia++;
+				continue;
+			}
+			jobs[chave].id = id;
+			vivos.push_back(chave);
+			inseridos++;
+		} else if (op < 95) {
+			size_t i = gerador() % vivos.size();
+			Job &j = jobs[vivos[i]];
+			if (!roda_cancela(&roda, j.id)) {
+				erro("cancela de job vivo falhou", vivos[i]);
+			}
+			j.vivo = false;
+			velhos.push_back(j.id);
+			vivos[i] = vivos.back();
+			vivos.pop_back();
+			cancelados++;
+		} else if (!velhos.empty()) {
+			// O lugar do job velho pode ja estar com outro: nao pode ser cancelado por esse id
+			int id = velhos[gerador() % velhos.size()];
+			if (roda_cancela(&roda, id)) {
+				std::printf("erro: id velho %d cancelou um job\n", id);
+				erros++;
+			} else {
+				velhos_recusados++;
+			}
+		}
+	}
+
+	// Todo at vivo tem de estar dentro do prazo
+	for (const auto &par : jobs) {
+		const Job &j = par.second;
+		if (j.vivo && !j.periodico && j.disparos == 0
+				&& agora > j.inserido + j.ms + 2 * RESOLUCAO_MS + adiados_max + RESOLUCAO_MS) {
+			erro("at nao disparou", par.first);
+		}
+		if (j.vivo) {
+			ok++;
+		}
+	}
+	if (roda.perdidos != recusados) {
+		std::printf("erro: perdidos %lu, recusados %lu\n", (unsigned long)roda.perdidos, recusados);
+		erros++;
+	}
+
+	std::printf("jobs_max %d slots %d resolucao_ms %lu\n", CONF_AGENDA_MAX, CONF_AGENDA_SLOTS,
+			(unsigned long)RESOLUCAO_MS);
+	std::printf("inseridos %lu pico_vivos %lu cheia %lu cancelados %lu ids_velhos_recusados %lu esvaziada %lu\n",
+			inseridos, pico, cheia, cancelados, velhos_recusados, esvaziada);
+	std::printf("avancos %lu adiados %lu disparos %lu perdidos %lu vivos_no_fim %d\n", avancos,
+			(unsigned long)adiados, disparos, (unsigned long)roda.perdidos, ok);
+	std::printf("atraso_max_ms %llu (limite %llu) erros %lu\n", (unsigned long long)atraso_max,
+			(unsigned long long)(2 * RESOLUCAO_MS + adiados_max), erros);
+	return erros ? 1 : 0;
+}
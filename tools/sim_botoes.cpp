@@ -0,0 +1,241 @@
+/**
+ * \file
+ * \brief Simulacao (host) dos botoes do OLED1 na tarefa principal da demo
+ *
+ * Compara a leitura antiga dos botoes em main_task() (demotasks.c), por varredura a cada
+ * 100 ms, com a atual: interrupcao nas duas bordas, temporizador de debounce reiniciado a
+ * cada borda e notificacao da tarefa. Os botoes sao apertados com repique (varias bordas
+ * nos primeiros ms do aperto e da soltura) e seguros por um tempo aleatorio; cada aperto
+ * pede uma tela diferente da atual, que leva desenho_ms para ser desenhada.
+ *
+ * Mostra, para os dois esquemas, a latencia do aperto ate a tela trocada, os apertos
+ * perdidos (soltos antes de uma varredura ou lidos no meio do repique) e os despertares
+ * por segundo das tarefas, no total e com os botoes parados.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o sim_botoes tools/sim_botoes.cpp
+ * Uso:        sim_botoes [apertos] [repique_ms] [desenho_ms] [debounce_ms]
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const double PASSO_MS = 0.1;       // Resolucao da simulacao
+static const double VARREDURA_MS = 100.0; // MAIN_TASK_DELAY antigo
+static const double OCIOSO_MS = 10000.0;  // Botoes parados no fim, para contar despertares ociosos
+static const int BOTOES = 3;
+
+struct Borda {
+	double t;
+	int botao;
+	bool apertado;
+};
+
+struct Aperto {
+	double t;
+	int botao;
+};
+
+struct Resultado {
+	std::vector<double> latencias;
+	unsigned perdidos;
+	unsigned long despertares;
+	unsigned long despertares_ociosos;
+};
+
+// Nivel dos botoes (bit por botao apertado) avancando no tempo pelas bordas
+class Botoes {
+public:
+	explicit Botoes(const std::vector<Borda> &b) : bordas(b), proxima(0), estado(0) {}
+
+	// Aplica as bordas ate t; devolve true se houve alguma
+	bool avanca(double t)
+	{
+		bool houve = false;
+		while (proxima < bordas.size() && bordas[proxima].t <= t) {
+			if (bordas[proxima].apertado) {
+				estado |= 1u << bordas[proxima].botao;
+			} else {
+				estado &= ~(1u << bordas[proxima].botao);
+			}
+			proxima++;
+			houve = true;
+		}
+		return houve;
+	}
+
+	unsigned nivel() const
+	{
+		return estado;
+	}
+
+private:
+	const std::vector<Borda> &bordas;
+	size_t proxima;
+	unsigned estado;
+};
+
+// Selecao como em main_task(): o primeiro botao apertado que muda a tela
+static int seleciona(unsigned apertados, int atual)
+{
+	for (int b = 0; b < BOTOES; b++) {
+		if ((apertados & (1u << b)) && b != atual) {
+			return b;
+		}
+	}
+	return -1;
+}
+
+// Registra a troca de tela para "botao" concluida em t: atende o aperto pendente desse botao
+static void conclui(const std::vector<Aperto> &apertos, std::vector<bool> &atendido, int botao,
+		double t, Resultado &r)
+{
+	for (size_t j = apertos.size(); j-- > 0;) {
+		if (apertos[j].t <= t && apertos[j].botao == botao && !atendido[j]) {
+			atendido[j] = true;
+			r.latencias.push_back(t - apertos[j].t);
+			return;
+		}
+	}
+}
+
+static void conta_perdidos(const std::vector<bool> &atendido, Resultado &r)
+{
+	r.perdidos = (unsigned)std::count(atendido.begin(), atendido.end(), false);
+}
+
+static Resultado varredura(const std::vector<Borda> &bordas, const std::vector<Aperto> &apertos,
+		double fim, double desenho)
+{
+	Resultado r = Resultado();
+	std::vector<bool> atendido(apertos.size(), false);
+	Botoes botoes(bordas);
+	int atual = 0;
+	double proximo = 0;
+
+	for (double t = 0; t <= fim; t += PASSO_MS) {
+		botoes.avanca(t);
+		if (t < proximo) {
+			continue;
+		}
+		r.despertares++;
+		if (t > fim - OCIOSO_MS) {
+			r.despertares_ociosos++;
+		}
+		int nova = seleciona(botoes.nivel(), atual);
+		proximo = t + VARREDURA_MS;
+		if (nova >= 0) {
+			atual = nova;
+			conclui(apertos, atendido, atual, t + desenho, r);
+			proximo += desenho; // vTaskDelay() so comeca depois do desenho
+		}
+	}
+	conta_perdidos(atendido, r);
+	return r;
+}
+
+static Resultado interrupcao(const std::vector<Borda> &bordas, const std::vector<Aperto> &apertos,
+		double fim, double desenho, double debounce)
+{
+	Resultado r = Resultado();
+	std::vector<bool> atendido(apertos.size(), false);
+	Botoes botoes(bordas);
+	int atual = 0;
+	double expira = -1;        // Temporizador de debounce (-1: parado)
+	unsigned estavel = 0;      // button_state
+	unsigned notificados = 0;  // Bits pendentes na notificacao da tarefa
+	double livre = 0;          // Fim do desenho em andamento
+
+	for (double t = 0; t <= fim; t += PASSO_MS) {
+		// Borda: xTimerResetFromISR() conta o periodo a partir do tick atual
+		if (botoes.avanca(t)) {
+			expira = (double)(long)t + debounce;
+		}
+		if (expira >= 0 && t >= expira) {
+			expira = -1;
+			r.despertares++; // Tarefa do temporizador
+			if (t > fim - OCIOSO_MS) {
+				r.despertares_ociosos++;
+			}
+			unsigned nivel = botoes.nivel();
+			notificados |= nivel & ~estavel;
+			estavel = nivel;
+		}
+		if (notificados && t >= livre) {
+			r.despertares++; // main_task
+			if (t > fim - OCIOSO_MS) {
+				r.despertares_ociosos++;
+			}
+			int nova = seleciona(notificados, atual);
+			notificados = 0;
+			if (nova >= 0) {
+				atual = nova;
+				livre = t + desenho;
+				conclui(apertos, atendido, atual, livre, r);
+			}
+		}
+	}
+	conta_perdidos(atendido, r);
+	return r;
+}
+
+static void mostra(const char *nome, Resultado r, double fim)
+{
+	double soma = 0;
+
+	std::sort(r.latencias.begin(), r.latencias.end());
+	for (double l : r.latencias) {
+		soma += l;
+	}
+	size_t n = r.latencias.size();
+	std::printf("%s %lu %u %.1f %.1f %.1f %.2f %.2f\n", nome, (unsigned long)n, r.perdidos,
+			n ? soma / n : 0.0, n ? r.latencias[(n * 95) / 100 < n ? (n * 95) / 100 : n - 1] : 0.0,
+			n ? r.latencias[n - 1] : 0.0, r.despertares * 1000.0 / fim,
+			r.despertares_ociosos * 1000.0 / OCIOSO_MS);
+}
+
+int main(int argc, char **argv)
+{
+	int total = (argc > 1) ? std::atoi(argv[1]) : 200;
+	double repique = (argc > 2) ? std::atof(argv[2]) : 5;
+	double desenho = (argc > 3) ? std::atof(argv[3]) : 15;
+	double debounce = (argc > 4) ? std::atof(argv[4]) : 20;
+	std::mt19937 gerador(1);
+	std::uniform_real_distribution<double> uniforme(0.0, 1.0);
+	std::vector<Borda> bordas;
+	std::vector<Aperto> apertos;
+	double t = 500;
+	int atual = 0;
+
+	// Apertos em botoes diferentes da tela atual, seguros de 40 a 400 ms
+	for (int i = 0; i < total; i++) {
+		int botao = (atual + 1 + (int)(uniforme(gerador) * 2)) % BOTOES;
+		double segura = 40 + uniforme(gerador) * 360;
+		apertos.push_back(Aperto{ t, botao });
+		for (int fase = 0; fase < 2; fase++) {
+			double inicio = t + fase * segura;
+			bool nivel = (fase == 0);
+			// Repique: bordas alternadas nos primeiros ms, terminando no nivel final
+			int extras = (repique > 0) ? 2 * (int)(uniforme(gerador) * 4) : 0;
+			double tb = inicio;
+			for (int k = 0; k < extras; k++) {
+				bordas.push_back(Borda{ tb, botao, (k % 2 == 0) ? nivel : !nivel });
+				tb += uniforme(gerador) * repique / (extras ? extras : 1);
+			}
+			bordas.push_back(Borda{ tb, botao, nivel });
+		}
+		atual = botao;
+		t += segura + 300 + uniforme(gerador) * 2000;
+	}
+	std::sort(bordas.begin(), bordas.end(), [](const Borda &a, const Borda &b) { return a.t < b.t; });
+	double fim = t + OCIOSO_MS;
+
+	std::printf("%d apertos, repique ate %.1f ms, desenho %.1f ms, debounce %.1f ms\n",
+			total, repique, desenho, debounce);
+	std::printf("esquema trocas perdidos lat_media_ms lat_p95_ms lat_max_ms despertares_s ociosos_s\n");
+	mostra("varredura", varredura(bordas, apertos, fim, desenho), fim);
+	mostra("interrupcao", interrupcao(bordas, apertos, fim, desenho, debounce), fim);
+	return 0;
+}
@@ -0,0 +1,1723 @@
+/**
+ * \file
+ * \brief Simulacao (host) do caminho dos comandos no firmware: serial, tarefas, travas e EEPROM
+ *
+ * Modelo de eventos discretos de um nucleo com o escalonador do FreeRTOS (preempcao por
+ * prioridade, rodizio entre tarefas de mesma prioridade a cada tick e heranca de prioridade
+ * nos mutex), com as tarefas de main.c como trechos de execucao com custo fixo:
+ * RecebeComando tira as linhas do buffer de recepcao para a comandoQueue, SetaComando
+ * interpreta, executa, publica os set-points nas caixas de correio e grava o log quando a
+ * fila esvazia, e Brilha/Pisca aplicam os set-points. O host manda as linhas no baud do enlace
+ * e para com XOFF quando o buffer de recepcao passa da marca alta; respostas e prompt ocupam
+ * SetaComando enquanto saem, pois console_envia_byte espera o DRE.
+ *
+ * Os custos sao estimativas para o Cortex-M0+ a 48 MHz (ver Custos); a simulacao serve para
+ * comparar esquemas entre si, nao para prever tempos exatos.
+ *
+ * Cenarios:
+ *  - coalescencia [comandos]: o host manda "brilho <n>" sem parar em varios enlaces e mostra
+ *    quantos set-points foram aplicados e quantos foram sobrescritos na caixa de correio, os
+ *    registros e confirmacoes do log e o atraso do '\n' ate o PWM. Confere que o ultimo
+ *    brilho e o aplicado e o gravado no log.
+ *  - lote [comandos]: os mesmos comandos (brilho e pisca alternados) mandados um por linha, em lote
+ *    (begin ... commit) e varios por linha com ';', com o host esperando o prompt a cada linha ou
+ *    mandando seguido. Mostra a duracao ate o ultimo prompt, a CPU de SetaComando, as paginas
+ *    escritas na EEPROM emulada e as confirmacoes (escritas na flash). Confere o estado final e que
+ *    um lote com "brilho" e "pisca 2 10" pisca 10 vezes, acendendo ja na primeira metade.
+ *  - pisca [brilho]: o host manda "pisca 1 100" e, 10 ms depois de o LED acender, "brilho <n>".
+ *    Mostra quando o compare do brilho chega ao PWM e confere que chega antes do fim da primeira
+ *    metade do periodo (500 ms), com o pisca cancelado.
+ *  - janela [comandos]: cliente em modo ack ("#<id> brilho <n>", sem eco e sem prompt) com
+ *    janelas de 1, 4 e 16 linhas sem resposta. Mostra comandos por segundo e o tempo do envio
+ *    ate o "ok <id>" chegar ao host. Confere que todas as linhas foram respondidas.
+ *  - cpu: fases de 2 s ociosa, com brilhos seguidos, com consultas seguidas e ociosa de novo, a
+ *    115200 (cada fase vai ate a fila esvaziar). Mostra a parte da CPU de cada tarefa em cada
+ *    fase, como o comando "stats" (contagens do contador de run-time e permil), e confere que os
+ *    contadores andam so nas tarefas com trabalho e que a soma com o ocioso fecha em 1000.
+ *  - latencia [linhas] [enlace]: percorre todos os comandos (set-points, lote, resets, consultas
+ *    e ajustes) com o host esperando o prompt e mostra os histogramas log2 de cada estagio como o
+ *    comando "latency", no contador de estatisticas (GCLK0/256, 187,5 kHz).
+ *  - travas [linhas]: carga mista (brilhos e consultas seguidos a 115200, com Pisca a 10 Hz) com o
+ *    mutex global de antes, que tambem guardava o estado do LED, e com as travas por recurso e o
+ *    LED sem trava. Mostra por trava e tarefa as tomadas, disputas e o tempo de espera, como o
+ *    comando "locks", e o maior atraso de uma inversao do LED. Confere que a divisao reduz os dois e
+ *    que, como em trava_slot(), cada tarefa que toma uma trava fica na sua linha do "locks".
+ *  - boot [meta_ms]: etapas do boot de main() e da tarefa Inicializa, como o "print boot", com a
+ *    EEPROM emulada integra (com e sem brilho salvo) e precisando de recuperacao (apaga a secao
+ *    inteira). Confere que o LED (primeira saida de PWM) sai antes da meta (5 ms) nos tres casos,
+ *    pois a recuperacao e as mensagens ficam para depois do escalonador.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o sim_comandos tools/sim_comandos.cpp
+ * Uso:        sim_comandos <cenario> [argumentos]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+typedef int64_t us_t;
+
+static const us_t TICK_US = 1000; // configTICK_RATE_HZ 1000
+static const int TRAVAS_MAX_TAREFAS = 5; // CONF_TRAVAS_MAX_TAREFAS
+
+// Custos estimados (us) de cada trecho do firmware
+struct Custos {
+	us_t isr_byte = 3;      // Interrupcao de recepcao por byte (cobrada junto com RecebeComando)
+	us_t recebe = 20;       // RecebeComando: linha do stream buffer para a comandoQueue
+	us_t interpreta = 60;   // InterpretaComando por comando
+	us_t executa = 40;      // ProcessaComando + ExecutaComando
+	us_t registra = 5;      // RegistraLog de um set-point (fica pendente)
+	us_t publica = 10;      // PublicaSetPoint (xQueueOverwrite com o escalonador suspenso)
+	us_t grava_pagina = 120; // eeprom_emulator_write_page (copia para o cache da pagina)
+	us_t confirma = 2500;   // eeprom_emulator_commit_page_buffer (escrita de uma pagina na flash)
+	us_t recebe_caixa = 5;  // xQueueReceive da caixa de correio
+	us_t brilha = 15;       // tcc_set_compare_value e registro de latencia
+};
+
+// Nucleo com o escalonador do FreeRTOS
+class Simulador {
+public:
+	// Trecho de execucao: toma "toma" antes (bloqueando), solta "solta" depois e chama "fim".
+	// Se "calcula" existir, o custo so e conhecido quando o trecho comeca (espera pelo TX, por exemplo)
+	struct Passo {
+		us_t custo;
+		std::function<us_t()> calcula;
+		int toma;
+		int solta;
+		std::function<void()> fim;
+	};
+
+	struct Tarefa {
+		std::string nome;
+		int prioridade;
+		std::deque<Passo> passos;
+		bool iniciado;
+		us_t restante;
+		int bloqueada_em;    // Trava esperada (-1: nenhuma)
+		us_t espera_desde;
+		us_t cpu;
+	};
+
+	// Linha do "locks": como em travas.c, cada trava tem TRAVAS_MAX_TAREFAS linhas achadas pelo handle
+	// da tarefa (aqui o indice), e a ultima acumula as que nao couberam
+	struct UsoTrava {
+		int tarefa = -1;     // -1: linha livre ou "outras"
+		unsigned long tomadas = 0;
+		unsigned long disputadas = 0;
+		us_t espera = 0;
+		us_t espera_max = 0;
+	};
+
+	struct Trava {
+		std::string nome;
+		int dona;
+		int profundidade;    // Tomadas aninhadas pela dona (uma trava so fazendo o papel de varias)
+		std::vector<int> fila;
+		UsoTrava uso[TRAVAS_MAX_TAREFAS];
+		std::vector<unsigned long> tomadas; // Por tarefa, para conferir as linhas do "locks"
+	};
+
+	us_t agora = 0;
+	us_t ocioso = 0;
+	unsigned long trocas = 0;
+
+	int nova_tarefa(const char *nome, int prioridade)
+	{
+		Tarefa t;
+		t.nome = nome;
+		t.prioridade = prioridade;
+		t.iniciado = false;
+		t.restante = 0;
+		t.bloqueada_em = -1;
+		t.espera_desde = 0;
+		t.cpu = 0;
+		tarefas.push_back(t);
+		for (Trava &tr : travas) {
+			tr.tomadas.resize(tarefas.size());
+		}
+		return (int)tarefas.size() - 1;
+	}
+
+	int nova_trava(const char *nome)
+	{
+		Trava tr;
+		tr.nome = nome;
+		tr.dona = -1;
+		tr.profundidade = 0;
+		tr.tomadas.resize(tarefas.size());
+		travas.push_back(tr);
+		return (int)travas.size() - 1;
+	}
+
+	void executa(int tarefa, us_t custo, std::function<void()> fim = nullptr, int toma = -1, int solta = -1)
+	{
+		Passo p;
+		p.custo = custo;
+		p.toma = toma;
+		p.solta = solta;
+		p.fim = fim;
+		if (tarefa == chamando) {
+			novos.push_back(p);
+		} else {
+			tarefas[tarefa].passos.push_back(p);
+		}
+	}
+
+	void executa_dinamico(int tarefa, std::function<us_t()> calcula, std::function<void()> fim = nullptr,
+			int toma = -1, int solta = -1)
+	{
+		executa(tarefa, 0, fim, toma, solta);
+		((tarefa == chamando) ? novos : tarefas[tarefa].passos).back().calcula = calcula;
+	}
+
+	bool ocupada(int tarefa) const
+	{
+		return !tarefas[tarefa].passos.empty() || (tarefa == chamando && !novos.empty());
+	}
+
+	void em(us_t quando, std::function<void()> acao)
+	{
+		eventos.push(Evento{ std::max(quando, agora), seq++, acao });
+	}
+
+	// Roda ate "limite" ou, sem limite (INT64_MAX), ate nao haver mais nada a fazer
+	void roda(us_t limite)
+	{
+		while (agora < limite) {
+			while (!eventos.empty() && eventos.top().quando <= agora) {
+				Evento e = eventos.top();
+				eventos.pop();
+				e.acao();
+			}
+
+			int t = escolhe();
+			us_t tick = (agora / TICK_US + 1) * TICK_US;
+			us_t proximo = std::min(limite, tick);
+			if (!eventos.empty()) {
+				proximo = std::min(proximo, eventos.top().quando);
+			}
+
+			if (t < 0) {
+				if (eventos.empty()) {
+					// Nada mais a fazer: com limite definido o nucleo fica ocioso ate ele
+					if (limite != INT64_MAX) {
+						ocioso += limite - agora;
+						agora = limite;
+					}
+					return;
+				}
+				ocioso += proximo - agora;
+				agora = proximo;
+				gira |= (agora == tick);
+				continue;
+			}
+
+			Tarefa &x = tarefas[t];
+			Passo &p = x.passos.front();
+			if (!x.iniciado) {
+				if (p.toma >= 0 && !toma(t, p.toma)) {
+					continue; // Bloqueou na trava: escolhe outra
+				}
+				x.iniciado = true;
+				x.restante = custo(p);
+			}
+
+			us_t dt = std::min(x.restante, proximo - agora);
+			agora += dt;
+			x.restante -= dt;
+			x.cpu += dt;
+			if (x.restante == 0) {
+				std::function<void()> fim = p.fim;
+				int solta = p.solta;
+				x.passos.pop_front();
+				x.iniciado = false;
+				if (solta >= 0) {
+					libera(t, solta);
+				}
+				// O que o "fim" programar para a propria tarefa roda antes dos passos ja programados,
+				// como uma chamada de funcao no firmware
+				if (fim) {
+					chamando = t;
+					fim();
+					chamando = -1;
+					x.passos.insert(x.passos.begin(), novos.begin(), novos.end());
+					novos.clear();
+				}
+			}
+			gira |= (agora == tick);
+		}
+	}
+
+	const Tarefa &tarefa(int t) const
+	{
+		return tarefas[t];
+	}
+
+	const Trava &trava(int t) const
+	{
+		return travas[t];
+	}
+
+	size_t num_tarefas() const
+	{
+		return tarefas.size();
+	}
+
+	size_t num_travas() const
+	{
+		return travas.size();
+	}
+
+private:
+	struct Evento {
+		us_t quando;
+		unsigned long seq;
+		std::function<void()> acao;
+		bool operator<(const Evento &o) const
+		{
+			return (quando != o.quando) ? quando > o.quando : seq > o.seq;
+		}
+	};
+
+	std::vector<Tarefa> tarefas;
+	std::vector<Trava> travas;
+	std::priority_queue<Evento> eventos;
+	unsigned long seq = 0;
+	int atual = -1;
+	bool gira = false;
+	int chamando = -1;        // Tarefa cujo "fim" esta rodando
+	std::deque<Passo> novos;  // Passos programados por esse "fim"
+
+
+	bool pronta(int t) const
+	{
+		return !tarefas[t].passos.empty() && tarefas[t].bloqueada_em < 0;
+	}
+
+	// Prioridade com a heranca das tarefas que esperam travas desta
+	int efetiva(int t) const
+	{
+		int p = tarefas[t].prioridade;
+		for (const Trava &tr : travas) {
+			if (tr.dona == t) {
+				for (int w : tr.fila) {
+					p = std::max(p, efetiva(w));
+				}
+			}
+		}
+		return p;
+	}
+
+	int escolhe()
+	{
+		int n = (int)tarefas.size();
+		int maior = -1;
+
+		for (int i = 0; i < n; i++) {
+			if (pronta(i)) {
+				maior = std::max(maior, efetiva(i));
+			}
+		}
+		if (maior < 0) {
+			return -1;
+		}
+		if (atual >= 0 && pronta(atual) && efetiva(atual) == maior && !gira) {
+			return atual;
+		}
+		for (int k = 1; k <= n; k++) {
+			int i = (atual + k + n) % n;
+			if (pronta(i) && efetiva(i) == maior) {
+				if (i != atual) {
+					trocas++;
+				}
+				atual = i;
+				gira = false;
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	// trava_slot(): linha da tarefa, ou a primeira livre, ou a ultima ("outras")
+	static UsoTrava &slot(Trava &x, int t)
+	{
+		for (int i = 0; i < TRAVAS_MAX_TAREFAS - 1; i++) {
+			if (x.uso[i].tarefa == t) {
+				return x.uso[i];
+			}
+			if (x.uso[i].tarefa < 0) {
+				x.uso[i].tarefa = t;
+				return x.uso[i];
+			}
+		}
+		return x.uso[TRAVAS_MAX_TAREFAS - 1];
+	}
+
+	bool toma(int t, int tr)
+	{
+		Trava &x = travas[tr];
+		UsoTrava &u = slot(x, t);
+
+		u.tomadas++;
+		x.tomadas[t]++;
+		if (x.dona < 0 || x.dona == t) {
+			x.dona = t;
+			x.profundidade++;
+			return true;
+		}
+		u.disputadas++;
+		x.fila.push_back(t);
+		tarefas[t].bloqueada_em = tr;
+		tarefas[t].espera_desde = agora;
+		return false;
+	}
+
+	// Passa a trava para quem espera com maior prioridade (a primeira a chegar entre iguais)
+	void libera(int t, int tr)
+	{
+		Trava &x = travas[tr];
+		size_t melhor = 0;
+
+		(void)t;
+		if (--x.profundidade > 0) {
+			return;
+		}
+		x.dona = -1;
+		if (x.fila.empty()) {
+			return;
+		}
+		for (size_t i = 1; i < x.fila.size(); i++) {
+			if (tarefas[x.fila[i]].prioridade > tarefas[x.fila[melhor]].prioridade) {
+				melhor = i;
+			}
+		}
+		int w = x.fila[melhor];
+		x.fila.erase(x.fila.begin() + melhor);
+		Tarefa &y = tarefas[w];
+		us_t espera = agora - y.espera_desde;
+		UsoTrava &u = slot(x, w);
+		u.espera += espera;
+		u.espera_max = std::max(u.espera_max, espera);
+		x.dona = w;
+		x.profundidade = 1;
+		y.bloqueada_em = -1;
+		y.iniciado = true;
+		y.restante = custo(y.passos.front());
+	}
+
+	static us_t custo(const Passo &p)
+	{
+		return p.calcula ? p.calcula() : p.custo;
+	}
+};
+
+// Percentil (0 a 100) de uma lista de amostras
+static us_t percentil(std::vector<us_t> v, double p)
+{
+	if (v.empty()) {
+		return 0;
+	}
+	std::sort(v.begin(), v.end());
+	size_t i = (size_t)(p / 100.0 * (double)(v.size() - 1) + 0.5);
+	return v[i];
+}
+
+// Comandos que o modelo distingue; o resto ("print ...", "stats", ajustes) e uma consulta que so responde
+enum TipoCmd { CMD_BRILHO, CMD_PISCA, CMD_RESET, CMD_BEGIN, CMD_COMMIT, CMD_CONSULTA };
+
+struct Cmd {
+	TipoCmd tipo;
+	int valor;      // Set-point, canal do reset ou bytes da resposta da consulta
+	int qtd;        // Vezes a piscar ("pisca <freq> <qtd>"; sem ela o pisca so ocupa o canal)
+};
+
+// Tamanho aproximado da resposta de cada consulta
+struct Resposta {
+	const char *prefixo;
+	int bytes;
+};
+
+static const Resposta respostas[] = {
+	{ "help", 1400 }, { "stats", 400 }, { "locks", 400 }, { "latency", 400 }, { "print log", 600 },
+	{ "print", 80 }, { "jobs", 200 }, { "power", 120 }, { "time", 30 }, { "record", 60 },
+	{ "sync", 40 }, { "address", 20 },
+};
+
+// Estagios de latencia, como em latencia.h
+enum { LAT_INTERPRETA, LAT_LOG, LAT_PWM, NUM_LAT };
+static const char *const nomes_lat[NUM_LAT] = { "interpreta", "log", "pwm" };
+
+// Linha em transito do host ate SetaComando
+struct Linha {
+	std::string texto;
+	std::vector<Cmd> cmds;
+	long id;        // "#<id>" (-1: sem id)
+	us_t enviada;   // Host comecou a mandar a linha
+	us_t recebida;  // '\n' no buffer de recepcao
+};
+
+// Interpreta o texto como o firmware: "#<id>" opcional e comandos separados por ';'
+static Linha nova_linha(const std::string &texto)
+{
+	Linha l;
+	size_t pos = 0;
+
+	l.texto = texto;
+	l.id = -1;
+	l.enviada = 0;
+	l.recebida = 0;
+	if (!texto.empty() && texto[0] == '#') {
+		l.id = std::strtol(texto.c_str() + 1, nullptr, 10);
+		pos = texto.find(' ');
+		pos = (pos == std::string::npos) ? texto.size() : pos + 1;
+	}
+	while (pos < texto.size()) {
+		size_t fim = texto.find(';', pos);
+		if (fim == std::string::npos) {
+			fim = texto.size();
+		}
+		std::string c = texto.substr(pos, fim - pos);
+		Cmd cmd = { CMD_CONSULTA, 0, 0 };
+		if (c.compare(0, 7, "brilho ") == 0) {
+			cmd.tipo = CMD_BRILHO;
+			cmd.valor = std::atoi(c.c_str() + 7);
+		} else if (c.compare(0, 6, "pisca ") == 0) {
+			char *resto;
+			cmd.tipo = CMD_PISCA;
+			cmd.valor = (int)std::strtol(c.c_str() + 6, &resto, 10);
+			cmd.qtd = (int)std::strtol(resto, nullptr, 10);
+		} else if (c == "begin") {
+			cmd.tipo = CMD_BEGIN;
+		} else if (c == "commit") {
+			cmd.tipo = CMD_COMMIT;
+		} else if (c == "reset brilho" || c == "reset freq") {
+			cmd.tipo = CMD_RESET;
+			cmd.valor = (c == "reset brilho") ? 0 : 1;
+		} else {
+			for (const Resposta &r : respostas) {
+				if (c.compare(0, std::strlen(r.prefixo), r.prefixo) == 0) {
+					cmd.valor = r.bytes;
+					break;
+				}
+			}
+		}
+		if (!c.empty()) {
+			l.cmds.push_back(cmd);
+		}
+		pos = fim + 1;
+	}
+	return l;
+}
+
+// Compare do TCC para um brilho de 1 a 100 (Alema1map(valor, 1, 100, 1000, 1)); 1001 apaga e 0 acende
+static int compare_brilho(int valor)
+{
+	return (valor - 1) * (1 - 1000) / (100 - 1) + 1000;
+}
+
+// Firmware: tarefas de main.c, comandoQueue, caixas de correio do LED e log
+class Firmware {
+public:
+	static const int FILA_TAM = 16;     // COMANDO_FILA_TAM
+	static const int RX_TAM = 256;      // CONSOLE_RX_TAM
+	static const int RX_MARCA_ALTA = 192;
+	static const int RX_MARCA_BAIXA = 64;
+	static const int CANAIS = 2;        // CANAL_BRILHO, CANAL_PISCA
+
+	Simulador sim;
+	Custos custos;
+	int t_recebe, t_seta, t_brilha, t_pisca;
+	int trava_comando, trava_console, trava_log;
+	int trava_led;         // Estado do LED (-1: sem trava, caixas de correio)
+
+	// Estatisticas
+	unsigned long aplicados = 0;
+	unsigned long descartados = 0;     // Set-points sobrescritos nas caixas de correio
+	unsigned long gravados = 0;        // Registros escritos no log
+	unsigned long log_descartados = 0; // Set-points pendentes substituidos antes de gravar
+	unsigned long paginas = 0;         // eeprom_emulator_write_page (estado e log)
+	unsigned long confirmacoes = 0;    // Escritas na flash (commit do cache da EEPROM emulada)
+	std::vector<us_t> latencias[NUM_LAT]; // Do '\n' ate cada estagio
+	int aplicado[CANAIS] = { -1, -1 }; // Ultimo valor aplicado por Brilha/Pisca
+	int logado[CANAIS] = { -1, -1 };   // Ultimo valor gravado no log
+	std::vector<us_t> atrasos_pisca;   // Atraso de cada inversao do LED de Pisca
+
+	// tcc_set_compare_value de Brilha e Pisca, na ordem
+	struct EscritaPwm {
+		us_t quando;
+		int valor;
+	};
+	std::vector<EscritaPwm> pwm;
+	std::function<void(const EscritaPwm &)> pwm_escrito; // Chamada a cada escrita (nulo: nada)
+
+	// Host e enlace
+	us_t byte_us = 1042;     // Tempo de um byte no enlace
+	us_t volta_us = 1000;    // Da resposta no fio ate o programa do host reagir (driver, adaptador USB)
+	bool modo_ack = false;   // "ack on": sem eco e sem prompt
+	std::function<bool(Linha &)> proxima_linha;     // Proxima linha do host; false se acabou
+	std::function<bool()> pode_enviar;              // Host so manda se devolver true (nulo: sempre)
+	std::function<void(const Linha &)> resposta;    // Ack ou prompt da linha chegou ao host
+
+	// Com "global", um so mutex faz o papel de todas as travas e protege tambem o estado do LED,
+	// como no firmware antes da divisao por recurso
+	explicit Firmware(bool global = false)
+	{
+		t_recebe = sim.nova_tarefa("RecebeComando", 1);
+		t_seta = sim.nova_tarefa("SetaComando", 1);
+		t_brilha = sim.nova_tarefa("Brilha", 1);
+		t_pisca = sim.nova_tarefa("Pisca", 2);
+		if (global) {
+			trava_comando = trava_console = trava_log = trava_led = sim.nova_trava("mutex");
+		} else {
+			trava_comando = sim.nova_trava("comando");
+			trava_console = sim.nova_trava("console");
+			trava_log = sim.nova_trava("log");
+			trava_led = -1;
+		}
+	}
+
+	// Pisca inverte o LED a cada "periodo" enquanto o host tiver linhas, com a trava do LED se
+	// houver; guarda o atraso de cada inversao em relacao ao instante programado
+	void pisca(us_t periodo)
+	{
+		us_t quando = sim.agora + periodo;
+		sim.em(quando, [this, periodo, quando]() {
+			if (terminou()) {
+				return;
+			}
+			sim.executa(t_pisca, custos.brilha, [this, quando]() {
+				atrasos_pisca.push_back(sim.agora - custos.brilha - quando);
+			}, trava_led, trava_led);
+			pisca(periodo);
+		});
+	}
+
+	// Host manda a proxima linha no baud do enlace, enquanto nao recebe XOFF
+	void envia()
+	{
+		Linha l;
+
+		if (enviando || pausado || host_acabou || (pode_enviar && !pode_enviar())) {
+			return;
+		}
+		if (!proxima_linha(l)) {
+			host_acabou = true;
+			return;
+		}
+		enviando = true;
+		us_t inicio = std::max(sim.agora, enlace_livre);
+		l.enviada = inicio;
+		enlace_livre = inicio + (us_t)(l.texto.size() + 1) * byte_us;
+		sim.em(enlace_livre, [this, l]() {
+			Linha chegou = l;
+			int n = (int)chegou.texto.size() + 1;
+			enviando = false;
+			chegou.recebida = sim.agora;
+			rx.push_back(chegou);
+			rx_bytes += n;
+			if (rx_bytes >= RX_MARCA_ALTA) {
+				pausado = true;
+			}
+			recebe();
+			envia();
+		});
+	}
+
+	// Host volta a mandar linhas depois de proxima_linha ter devolvido false
+	void retoma_host()
+	{
+		host_acabou = false;
+		envia();
+	}
+
+	bool terminou() const
+	{
+		return host_acabou && rx.empty() && fila.empty() && !sim.ocupada(t_recebe)
+				&& !sim.ocupada(t_seta) && !sim.ocupada(t_brilha) && !sim.ocupada(t_pisca);
+	}
+
+private:
+	std::deque<Linha> rx;  // Linhas completas no buffer de recepcao
+	int rx_bytes = 0;
+	bool pausado = false;  // XOFF enviado ao host
+	bool enviando = false;
+	bool host_acabou = false;
+	us_t enlace_livre = 0;
+	us_t tx_livre = 0;     // Fim do ultimo byte de resposta no fio
+	std::deque<Linha> fila; // comandoQueue
+
+	struct Caixa {
+		bool cheia = false;
+		int valor = 0;
+		us_t recebida = 0;
+	};
+	Caixa caixas[CANAIS];
+
+	// EstadoLed: copia de edicao de SetaComando e a publicada, que Brilha e Pisca leem (LeEstadoLed)
+	struct EstadoLed {
+		int brilho = 0;
+		int frequencia = 0;
+		int qtd = 0;
+		bool brilha = false;
+		bool pisca = false;
+	};
+	EstadoLed edicao;
+	EstadoLed publicado;
+	unsigned long pisca_job = 0; // Muda a cada aviso do canal de Pisca: as esperas do job anterior param
+
+	// Estado de SetaComando, atualizado quando a linha e programada (so SetaComando o usa)
+	int led[CANAIS] = { 0, 0 };
+	int salvo = -1;        // estadoSalvo
+	bool em_lote = false;
+	std::vector<Cmd> lote;
+	bool pendente[CANAIS] = { false, false };
+	int pendente_valor[CANAIS] = { 0, 0 };
+	bool sujo = false;     // logSujo
+	us_t log_recebida = 0; // logRecebida
+
+	// RecebeComando: passa a proxima linha completa para a comandoQueue, se houver espaco
+	void recebe()
+	{
+		if (sim.ocupada(t_recebe) || rx.empty() || (int)fila.size() >= FILA_TAM) {
+			return;
+		}
+		us_t custo = custos.recebe + custos.isr_byte * (us_t)(rx.front().texto.size() + 1);
+		sim.executa(t_recebe, custo, [this]() {
+			Linha l = rx.front();
+			rx.pop_front();
+			rx_bytes -= (int)l.texto.size() + 1;
+			if (pausado && rx_bytes <= RX_MARCA_BAIXA) {
+				pausado = false;
+				envia();
+			}
+			fila.push_back(l);
+			seta();
+			recebe();
+		});
+	}
+
+	// Envio de "n" bytes pelo console: console_envia_byte espera o DRE, entao a tarefa gira ate o
+	// penultimo byte sair (o ultimo fica no registrador). "fim" roda quando o ultimo byte sai do fio
+	void transmite(int n, std::function<void()> fim = nullptr)
+	{
+		sim.executa_dinamico(t_seta, [this, n, fim]() {
+			us_t inicio = std::max(sim.agora, tx_livre);
+			tx_livre = inicio + (us_t)n * byte_us;
+			if (fim) {
+				sim.em(tx_livre, fim);
+			}
+			return std::max<us_t>(0, tx_livre - byte_us - sim.agora);
+		});
+	}
+
+	// SetaComando: uma linha por vez, com a travaComando durante toda a linha
+	void seta()
+	{
+		if (sim.ocupada(t_seta) || fila.empty()) {
+			return;
+		}
+		Linha l = fila.front();
+		fila.pop_front();
+		recebe();
+
+		sim.executa(t_seta, 0, nullptr, trava_comando);
+		for (const Cmd &c : l.cmds) {
+			sim.executa(t_seta, custos.interpreta, [this, l]() {
+				latencias[LAT_INTERPRETA].push_back(sim.agora - l.recebida);
+			});
+			processa(l, c);
+		}
+		if (l.id >= 0) {
+			transmite(4 + (int)std::to_string(l.id).size(), [this, l]() {
+				sim.em(sim.agora + volta_us, [this, l]() {
+					if (resposta) {
+						resposta(l);
+					}
+				});
+			});
+		}
+		sim.executa(t_seta, 0, [this, l]() {
+			fim_da_linha(l);
+		});
+	}
+
+	// ProcessaComando, com a travaConsole
+	void processa(const Linha &l, const Cmd &c)
+	{
+		sim.executa(t_seta, 0, nullptr, trava_console);
+		if (c.tipo == CMD_BEGIN) {
+			em_lote = true;
+			lote.clear();
+		} else if (c.tipo == CMD_COMMIT) {
+			// Executa o lote, publica o estado final uma vez e grava o log com um so commit
+			bool alterado[CANAIS] = { false, false };
+			for (const Cmd &x : lote) {
+				sim.executa(t_seta, custos.executa);
+				executa(l, x, alterado);
+			}
+			publica(l, alterado);
+			descarrega(l);
+			confirma();
+			transmite(28); // "Lote aplicado (20 comandos)\n"
+			em_lote = false;
+			lote.clear();
+		} else if (em_lote && c.tipo != CMD_CONSULTA) {
+			lote.push_back(c);
+		} else if (c.tipo == CMD_CONSULTA) {
+			sim.executa(t_seta, custos.executa);
+			if (c.valor > 0) {
+				transmite(c.valor);
+			}
+		} else {
+			bool alterado[CANAIS] = { false, false };
+			sim.executa(t_seta, custos.executa);
+			executa(l, c, alterado);
+			publica(l, alterado);
+		}
+		sim.executa(t_seta, 0, nullptr, -1, trava_console);
+	}
+
+	// ExecutaComando: altera a copia de edicao do LED e deixa o set-point pendente para o log
+	void executa(const Linha &l, const Cmd &c, bool *alterado)
+	{
+		int canal = (c.tipo == CMD_BRILHO) ? 0 : 1;
+
+		if (c.tipo == CMD_RESET) {
+			// Reset e registrado na hora, depois dos set-points pendentes, para manter a ordem do log
+			if (c.valor == 0) {
+				edicao.brilha = false;
+				edicao.brilho = 0;
+			} else {
+				edicao.pisca = false;
+				edicao.frequencia = 0;
+			}
+			led[c.valor] = 0;
+			alterado[c.valor] = true;
+			descarrega(l);
+			grava(l, -1, 0);
+			return;
+		}
+		if (c.tipo == CMD_BRILHO) {
+			// Brilho cancela o pisca em andamento
+			alterado[1] = alterado[1] || edicao.pisca;
+			edicao.brilho = c.valor;
+			edicao.pisca = false;
+			edicao.brilha = true;
+		} else {
+			edicao.frequencia = c.valor;
+			edicao.qtd = c.qtd;
+			edicao.brilha = false;
+			edicao.pisca = true;
+		}
+		led[canal] = c.valor;
+		alterado[canal] = true;
+		bool substitui = pendente[canal];
+		pendente[canal] = true;
+		pendente_valor[canal] = c.valor;
+		sim.executa(t_seta, custos.registra, [this, substitui]() {
+			if (substitui) {
+				log_descartados++;
+			}
+		}, trava_log, trava_log);
+	}
+
+	// PublicaEstado: caixas de correio dos canais alterados e, se o brilho mudou, a pagina de estado
+	void publica(const Linha &l, const bool *alterado)
+	{
+		if (alterado[0] || alterado[1]) {
+			EstadoLed e = edicao;
+			sim.executa(t_seta, 0, [this, e]() {
+				publicado = e; // PublicaEstadoLed, antes dos avisos
+			});
+		}
+		for (int canal = CANAIS - 1; canal >= 0; canal--) {
+			if (alterado[canal]) {
+				int valor = led[canal];
+				us_t recebida = l.recebida;
+				sim.executa(t_seta, custos.publica, [this, canal, valor, recebida]() {
+					entrega(canal, valor, recebida);
+				});
+			}
+		}
+		if (alterado[0] && led[0] != salvo) {
+			salvo = led[0];
+			us_t recebida = l.recebida;
+			sim.executa(t_seta, custos.grava_pagina, [this, recebida]() {
+				paginas++;
+				suja(recebida);
+			}, trava_log, trava_log);
+		}
+	}
+
+	// Primeira escrita desde a ultima confirmacao: a latencia do log conta a partir desta linha
+	void suja(us_t recebida)
+	{
+		if (!sujo) {
+			log_recebida = recebida;
+		}
+		sujo = true;
+	}
+
+	// GravaLog de um registro do canal (-1: registro que nao e set-point)
+	void grava(const Linha &l, int canal, int valor)
+	{
+		us_t recebida = l.recebida;
+		sim.executa(t_seta, custos.grava_pagina, [this, canal, valor, recebida]() {
+			paginas++;
+			gravados++;
+			if (canal >= 0) {
+				logado[canal] = valor;
+			}
+			suja(recebida);
+		}, trava_log, trava_log);
+	}
+
+	// DescarregaLogPendente: um registro por canal pendente
+	void descarrega(const Linha &l)
+	{
+		for (int canal = 0; canal < CANAIS; canal++) {
+			if (pendente[canal]) {
+				pendente[canal] = false;
+				grava(l, canal, pendente_valor[canal]);
+			}
+		}
+	}
+
+	// ConfirmaLog: decide na hora, pois "sujo" so muda quando as paginas sao escritas
+	void confirma()
+	{
+		sim.executa(t_seta, 0, [this]() {
+			if (sujo) {
+				sim.executa(t_seta, custos.confirma, [this]() {
+					confirmacoes++;
+					sujo = false;
+					latencias[LAT_LOG].push_back(sim.agora - log_recebida);
+				}, trava_log, trava_log);
+			}
+		});
+	}
+
+	// Fila vazia: grava os set-points pendentes, confirma o log e mostra o prompt; depois solta a travaComando
+	void fim_da_linha(const Linha &l)
+	{
+		if (fila.empty()) {
+			descarrega(l);
+			confirma();
+			if (!modo_ack) {
+				transmite(9, [this, l]() { // "\nComando>"
+					sim.em(sim.agora + volta_us, [this, l]() {
+						if (resposta) {
+							resposta(l);
+						}
+					});
+				});
+			}
+		}
+		sim.executa(t_seta, 0, [this]() {
+			seta();
+		}, -1, trava_comando);
+	}
+
+	// xQueueOverwrite na caixa de correio do canal; a tarefa do canal aplica o que estiver nela quando rodar
+	void entrega(int canal, int valor, us_t recebida)
+	{
+		Caixa &cx = caixas[canal];
+		int t = (canal == 0) ? t_brilha : t_pisca;
+
+		if (cx.cheia) {
+			descartados++;
+		}
+		cx.cheia = true;
+		cx.valor = valor;
+		cx.recebida = recebida;
+		if (!sim.ocupada(t)) {
+			aplica(canal);
+		}
+	}
+
+	// Brilha e Pisca: tiram o aviso da caixa, leem o estado publicado e escrevem o PWM
+	void aplica(int canal)
+	{
+		int t = (canal == 0) ? t_brilha : t_pisca;
+
+		sim.executa(t, custos.recebe_caixa, [this, canal, t]() {
+			Caixa &cx = caixas[canal];
+			int valor = cx.valor;
+			us_t recebida = cx.recebida;
+			EstadoLed e = publicado;
+			cx.cheia = false;
+			if (canal == 1) {
+				pisca_job++;
+			}
+			sim.executa(t, custos.brilha, [this, canal, valor, recebida, e]() {
+				aplicados++;
+				aplicado[canal] = valor;
+				latencias[LAT_PWM].push_back(sim.agora - recebida);
+				if (canal == 0) {
+					// Com um pisca publicado depois do brilho o LED e do Pisca
+					if (!e.pisca) {
+						escreve_pwm(e.brilha ? compare_brilho(e.brilho) : 1001);
+					}
+				} else if (!e.pisca || e.frequencia <= 0) {
+					escreve_pwm(1001); // Job cancelado apaga o LED
+				} else if (e.qtd > 0) {
+					escreve_pwm(0);
+					pisca_espera(pisca_job, 1, 2 * e.qtd, std::max(1, 500 / e.frequencia) * TICK_US);
+				}
+				if (caixas[canal].cheia) {
+					aplica(canal);
+				}
+			}, trava_led, trava_led);
+		});
+	}
+
+	// Pisca espera meio periodo pela caixa (xQueueReceive com timeout) e faz a inversao "passo":
+	// pares acendem, impares apagam. Um aviso nesse meio tempo troca o job e a espera para
+	void pisca_espera(unsigned long job, int passo, int passos, us_t meio)
+	{
+		if (passo >= passos) {
+			return;
+		}
+		sim.em(sim.agora + meio, [this, job, passo, passos, meio]() {
+			if (job != pisca_job) {
+				return;
+			}
+			sim.executa(t_pisca, custos.brilha, [this, job, passo, passos, meio]() {
+				if (job != pisca_job) {
+					return;
+				}
+				escreve_pwm((passo % 2 == 0) ? 0 : 1001);
+				if (caixas[1].cheia) {
+					aplica(1);
+				} else {
+					pisca_espera(job, passo + 1, passos, meio);
+				}
+			}, trava_led, trava_led);
+		});
+	}
+
+	void escreve_pwm(int valor)
+	{
+		EscritaPwm w = { sim.agora, valor };
+		pwm.push_back(w);
+		if (pwm_escrito) {
+			pwm_escrito(w);
+		}
+	}
+};
+
+struct Enlace {
+	const char *nome;
+	us_t byte_us;
+	us_t volta_us;
+};
+
+// 10 bits por byte na USART; a USB full-speed entrega ~1 MB/s ao console (bench_cdc).
+// A volta do host e uma estimativa (adaptador USB-serial, driver e programa)
+static const Enlace enlaces[] = {
+	{ "9600", 1042, 1000 },
+	{ "115200", 87, 1000 },
+	{ "usb", 1, 1000 },
+};
+
+static int cenario_coalescencia(int argc, char **argv)
+{
+	int comandos = (argc > 0) ? std::atoi(argv[0]) : 10000;
+	int erros = 0;
+
+	std::printf("enlace linhas aplicados descartados log_gravados log_descartados confirmacoes"
+			" atraso_p50_ms atraso_p99_ms atraso_max_ms duracao_s\n");
+	for (const Enlace &e : enlaces) {
+		Firmware fw;
+		int enviados = 0;
+		int ultimo = 0;
+
+		fw.byte_us = e.byte_us;
+		fw.volta_us = e.volta_us;
+		fw.proxima_linha = [&](Linha &l) {
+			if (enviados == comandos) {
+				return false;
+			}
+			ultimo = 1 + (enviados * 37) % 100;
+			l = nova_linha("brilho " + std::to_string(ultimo));
+			enviados++;
+			return true;
+		};
+		fw.envia();
+		fw.sim.roda(INT64_MAX);
+
+		std::printf("%s %d %lu %lu %lu %lu %lu %.2f %.2f %.2f %.2f\n", e.nome, comandos, fw.aplicados,
+				fw.descartados, fw.gravados, fw.log_descartados, fw.confirmacoes,
+				percentil(fw.latencias[LAT_PWM], 50) / 1000.0, percentil(fw.latencias[LAT_PWM], 99) / 1000.0,
+				percentil(fw.latencias[LAT_PWM], 100) / 1000.0, fw.sim.agora / 1e6);
+
+		if (!fw.terminou() || fw.aplicado[0] != ultimo || fw.logado[0] != ultimo
+				|| fw.aplicados + fw.descartados != (unsigned long)comandos) {
+			std::printf("%s: brilho final pwm %d log %d, esperado %d\n", e.nome, fw.aplicado[0],
+					fw.logado[0], ultimo);
+			erros++;
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+// Linhas de um envio de "n" comandos: uma por comando, em lote (begin ... commit) ou varios por linha com ';'
+static std::vector<std::string> linhas_lote(const std::string &forma, int n)
+{
+	std::vector<std::string> cmds, linhas;
+
+	for (int i = 0; i < n; i++) {
+		if (i % 2 == 0) {
+			cmds.push_back("brilho " + std::to_string(1 + (i * 37) % 100));
+		} else {
+			cmds.push_back("pisca " + std::to_string(1 + i % 10));
+		}
+	}
+	if (forma == "lote") {
+		linhas.push_back("begin");
+	}
+	if (forma == "ponto_e_virgula") {
+		std::string atual;
+		for (const std::string &c : cmds) {
+			if (!atual.empty() && atual.size() + 1 + c.size() > 54) { // Linha.texto[55]
+				linhas.push_back(atual);
+				atual.clear();
+			}
+			atual += (atual.empty() ? "" : ";") + c;
+		}
+		linhas.push_back(atual);
+	} else {
+		linhas.insert(linhas.end(), cmds.begin(), cmds.end());
+	}
+	if (forma == "lote") {
+		linhas.push_back("commit");
+	}
+	return linhas;
+}
+
+static int cenario_lote(int argc, char **argv)
+{
+	int comandos = (argc > 0) ? std::atoi(argv[0]) : 20;
+	const char *formas[] = { "individual", "lote", "ponto_e_virgula" };
+	int erros = 0;
+
+	if (comandos < 2 || comandos > 32) {
+		std::fprintf(stderr, "lote: de 2 a 32 comandos (BATCH_MAX)\n");
+		return 2;
+	}
+
+	std::printf("enlace forma host linhas duracao_ms cpu_seta_ms paginas confirmacoes publicados aplicados\n");
+	for (const Enlace &e : enlaces) {
+		for (const char *forma : formas) {
+			for (int espera = 1; espera >= 0; espera--) {
+				std::vector<std::string> linhas = linhas_lote(forma, comandos);
+				Firmware fw;
+				size_t enviadas = 0;
+				bool aguardando = false;
+				us_t fim = 0;
+
+				fw.byte_us = e.byte_us;
+				fw.volta_us = e.volta_us;
+				fw.proxima_linha = [&](Linha &l) {
+					if (enviadas == linhas.size()) {
+						return false;
+					}
+					l = nova_linha(linhas[enviadas++]);
+					aguardando = espera;
+					return true;
+				};
+				fw.pode_enviar = [&]() {
+					return !aguardando;
+				};
+				fw.resposta = [&](const Linha &) {
+					aguardando = false;
+					fim = fw.sim.agora;
+					fw.envia();
+				};
+				fw.envia();
+				fw.sim.roda(INT64_MAX);
+
+				std::vector<std::string> ultimo = linhas_lote("individual", comandos);
+				int brilho = std::atoi(ultimo[(comandos - 1) & ~1].c_str() + 7);
+				int pisca = std::atoi(ultimo[comandos - 1 - (comandos % 2)].c_str() + 6);
+
+				std::printf("%s %s %s %zu %.2f %.2f %lu %lu %lu %lu\n", e.nome, forma,
+						espera ? "espera_prompt" : "seguido", linhas.size(), fim / 1000.0,
+						fw.sim.tarefa(fw.t_seta).cpu / 1000.0, fw.paginas, fw.confirmacoes,
+						fw.aplicados + fw.descartados, fw.aplicados);
+
+				if (!fw.terminou() || fw.aplicado[0] != brilho || fw.logado[0] != brilho
+						|| fw.aplicado[1] != pisca || fw.logado[1] != pisca) {
+					std::printf("%s %s: estado final brilho %d/%d pisca %d/%d, esperado %d %d\n", e.nome,
+							forma, fw.aplicado[0], fw.logado[0], fw.aplicado[1], fw.logado[1], brilho, pisca);
+					erros++;
+				}
+			}
+		}
+	}
+
+	// Brilho e pisca no mesmo lote: os dois canais sao avisados, e o Brilha, que roda depois do Pisca,
+	// nao pode apagar o LED que o pisca acabou de acender. Confere cada meio periodo de "pisca 2 10"
+	std::printf("enlace pwm_ms primeira_metade_ms inversoes\n");
+	for (const Enlace &e : enlaces) {
+		static const char *linhas[] = { "begin", "brilho 50", "pisca 2 10", "commit" };
+		const us_t meio = 250 * TICK_US;
+		Firmware fw;
+		size_t enviadas = 0;
+		bool aguardando = false;
+
+		fw.byte_us = e.byte_us;
+		fw.volta_us = e.volta_us;
+		fw.proxima_linha = [&](Linha &l) {
+			if (enviadas == sizeof(linhas) / sizeof(linhas[0])) {
+				return false;
+			}
+			l = nova_linha(linhas[enviadas++]);
+			aguardando = true;
+			return true;
+		};
+		fw.pode_enviar = [&]() {
+			return !aguardando;
+		};
+		fw.resposta = [&](const Linha &) {
+			aguardando = false;
+			fw.envia();
+		};
+		fw.envia();
+		fw.sim.roda(INT64_MAX);
+
+		bool certo = (fw.pwm.size() == 20 && fw.pwm[0].valor == 0);
+		for (size_t i = 1; certo && i < fw.pwm.size(); i++) {
+			us_t dt = fw.pwm[i].quando - fw.pwm[i - 1].quando;
+			certo = (fw.pwm[i].valor == ((i % 2) ? 1001 : 0)) && dt >= meio && dt < meio + TICK_US;
+		}
+		us_t primeira = (fw.pwm.size() > 1) ? fw.pwm[1].quando - fw.pwm[0].quando : 0;
+		std::printf("%s %.2f %.2f %zu\n", e.nome, fw.pwm.empty() ? 0.0 : fw.pwm[0].quando / 1000.0,
+				primeira / 1000.0, fw.pwm.size());
+		if (!certo) {
+			std::printf("%s: o pisca do lote nao acende por meio periodo a cada vez\n", e.nome);
+			erros++;
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+static int cenario_pisca(int argc, char **argv)
+{
+	int brilho = (argc > 0) ? std::atoi(argv[0]) : 30;
+	const us_t meio = 500 * TICK_US; // "pisca 1 100"
+	int erros = 0;
+
+	if (brilho < 1 || brilho > 100) {
+		std::fprintf(stderr, "pisca: brilho de 1 a 100\n");
+		return 2;
+	}
+
+	std::printf("enlace aceso_ms brilho_enviado_ms pwm_ms atraso_ms escritas\n");
+	for (const Enlace &e : enlaces) {
+		Firmware fw;
+		int enviadas = 0;
+		us_t aceso = -1;     // Primeira escrita do pisca (LED aceso)
+		us_t libera = INT64_MAX;
+		us_t enviado = 0;
+
+		fw.byte_us = e.byte_us;
+		fw.volta_us = e.volta_us;
+		fw.proxima_linha = [&](Linha &l) {
+			if (enviadas == 2) {
+				return false;
+			}
+			l = nova_linha(enviadas++ ? "brilho " + std::to_string(brilho) : "pisca 1 100");
+			enviado = fw.sim.agora;
+			return true;
+		};
+		fw.pode_enviar = [&]() {
+			return enviadas == 0 || fw.sim.agora >= libera;
+		};
+		// O host manda o brilho 10 ms depois de o LED acender, sem esperar o prompt
+		fw.pwm_escrito = [&](const Firmware::EscritaPwm &w) {
+			if (aceso < 0 && w.valor == 0) {
+				aceso = w.quando;
+				libera = aceso + 10000;
+				fw.sim.em(libera, [&]() {
+					fw.envia();
+				});
+			}
+		};
+		fw.envia();
+		fw.sim.roda(INT64_MAX);
+
+		const Firmware::EscritaPwm *ultima = fw.pwm.empty() ? nullptr : &fw.pwm.back();
+		std::printf("%s %.2f %.2f %.2f %.2f %zu\n", e.nome, aceso / 1000.0, enviado / 1000.0,
+				ultima ? ultima->quando / 1000.0 : 0.0, ultima ? (ultima->quando - enviado) / 1000.0 : 0.0,
+				fw.pwm.size());
+		// Acende, o brilho cancela o pisca (apaga) e o compare do brilho fica, antes da primeira metade acabar
+		if (aceso < 0 || fw.pwm.size() != 3 || ultima->valor != compare_brilho(brilho)
+				|| ultima->quando >= aceso + meio) {
+			std::printf("%s: o brilho nao substituiu o pisca antes do fim do meio periodo\n", e.nome);
+			erros++;
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+static int cenario_janela(int argc, char **argv)
+{
+	int comandos = (argc > 0) ? std::atoi(argv[0]) : 1000;
+	const int janelas[] = { 1, 4, 16 };
+	int erros = 0;
+
+	std::printf("enlace janela comandos cmd_por_s resposta_p50_ms resposta_p99_ms confirmacoes aplicados\n");
+	for (const Enlace &e : enlaces) {
+		for (int janela : janelas) {
+			Firmware fw;
+			int enviados = 0, respondidos = 0, pendentes = 0;
+			std::vector<us_t> respostas;
+			us_t fim = 0;
+
+			fw.byte_us = e.byte_us;
+			fw.volta_us = e.volta_us;
+			fw.modo_ack = true;
+			fw.proxima_linha = [&](Linha &l) {
+				if (enviados == comandos) {
+					return false;
+				}
+				l = nova_linha("#" + std::to_string(enviados) + " brilho "
+						+ std::to_string(1 + (enviados * 37) % 100));
+				enviados++;
+				pendentes++;
+				return true;
+			};
+			fw.pode_enviar = [&]() {
+				return pendentes < janela;
+			};
+			fw.resposta = [&](const Linha &l) {
+				respostas.push_back(fw.sim.agora - l.enviada);
+				respondidos++;
+				pendentes--;
+				fim = fw.sim.agora;
+				fw.envia();
+			};
+			fw.envia();
+			fw.sim.roda(INT64_MAX);
+
+			std::printf("%s %d %d %.0f %.2f %.2f %lu %lu\n", e.nome, janela, comandos,
+					fim ? comandos / (fim / 1e6) : 0.0, percentil(respostas, 50) / 1000.0,
+					percentil(respostas, 99) / 1000.0, fw.confirmacoes, fw.aplicados);
+
+			if (!fw.terminou() || respondidos != comandos) {
+				std::printf("%s janela %d: %d de %d respostas\n", e.nome, janela, respondidos, comandos);
+				erros++;
+			}
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+static int cenario_cpu(int argc, char **argv)
+{
+	us_t fase_us = ((argc > 0) ? std::atoi(argv[0]) : 2000) * (us_t)1000;
+	const char *fases[] = { "ociosa", "brilho", "consultas", "ociosa" };
+	const Enlace &e = enlaces[1];
+	Firmware fw;
+	const char *fase = fases[0];
+	us_t fim = 0;
+	int enviados = 0;
+	int erros = 0;
+
+	fw.byte_us = e.byte_us;
+	fw.volta_us = e.volta_us;
+	fw.proxima_linha = [&](Linha &l) {
+		if (fw.sim.agora >= fim || std::strcmp(fase, "ociosa") == 0) {
+			return false;
+		}
+		if (std::strcmp(fase, "brilho") == 0) {
+			l = nova_linha("brilho " + std::to_string(1 + (enviados * 37) % 100));
+		} else {
+			l = nova_linha("stats");
+		}
+		enviados++;
+		return true;
+	};
+
+	std::printf("fase tarefa contagens permil\n");
+	std::vector<us_t> antes(fw.sim.num_tarefas());
+	for (const char *f : fases) {
+		us_t inicio = fw.sim.agora;
+		us_t ocioso = fw.sim.ocioso;
+		long soma = 0;
+
+		for (size_t t = 0; t < fw.sim.num_tarefas(); t++) {
+			antes[t] = fw.sim.tarefa((int)t).cpu;
+		}
+		fase = f;
+		fim = inicio + fase_us;
+		fw.retoma_host();
+		fw.sim.roda(fim);
+		fw.sim.roda(INT64_MAX); // Termina o que ja chegou, para a fase seguinte comecar limpa
+
+		us_t total = fw.sim.agora - inicio;
+		bool carga = std::strcmp(f, "ociosa") != 0;
+		for (size_t t = 0; t < fw.sim.num_tarefas(); t++) {
+			us_t usado = fw.sim.tarefa((int)t).cpu - antes[t];
+			long permil = (long)(usado * 1000 / total);
+			soma += permil;
+			std::printf("%s %s %lld %ld\n", f, fw.sim.tarefa((int)t).nome.c_str(), (long long)usado, permil);
+
+			// Pisca so roda com "pisca" e as consultas nao publicam set-points
+			bool espera_uso = carga && !((int)t == fw.t_pisca || ((int)t == fw.t_brilha && std::strcmp(f, "consultas") == 0));
+			if ((usado > 0) != espera_uso) {
+				std::printf("%s: contador de %s %s\n", f, fw.sim.tarefa((int)t).nome.c_str(),
+						espera_uso ? "parado sob carga" : "andou sem trabalho");
+				erros++;
+			}
+		}
+		long ocioso_permil = (long)((fw.sim.ocioso - ocioso) * 1000 / total);
+		std::printf("%s IDLE %lld %ld\n", f, (long long)(fw.sim.ocioso - ocioso), ocioso_permil);
+		if (soma + ocioso_permil < 997 || soma + ocioso_permil > 1000) {
+			std::printf("%s: soma %ld permil\n", f, soma + ocioso_permil);
+			erros++;
+		}
+		if (!carga && ocioso_permil < 990) {
+			std::printf("%s: ocioso so %ld permil\n", f, ocioso_permil);
+			erros++;
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+// Histograma log2 em contagens do contador de estatisticas, como latencia.c
+struct Histograma {
+	static const int BALDES = 33;
+	unsigned long baldes[BALDES] = {};
+	unsigned long amostras = 0;
+	uint32_t max = 0;
+
+	static uint32_t contagens(us_t us)
+	{
+		return (uint32_t)(us * 187500 / 1000000);
+	}
+
+	static unsigned long us(uint32_t contagens)
+	{
+		return (unsigned long)((uint64_t)contagens * 1000000 / 187500);
+	}
+
+	void registra(us_t latencia)
+	{
+		uint32_t c = contagens(latencia);
+		baldes[c ? 32 - __builtin_clz(c) : 0]++;
+		amostras++;
+		max = std::max(max, c);
+	}
+
+	uint32_t percentil(uint32_t permil) const
+	{
+		unsigned long alvo = (amostras * permil + 999) / 1000;
+		unsigned long acumulado = 0;
+		int b;
+
+		if (amostras == 0) {
+			return 0;
+		}
+		for (b = 0; b < BALDES; b++) {
+			acumulado += baldes[b];
+			if (acumulado >= alvo) {
+				break;
+			}
+		}
+		uint32_t limite = (b >= 32) ? UINT32_MAX : ((1UL << b) - 1);
+		return std::min(limite, max);
+	}
+};
+
+static int cenario_latencia(int argc, char **argv)
+{
+	int linhas = (argc > 0) ? std::atoi(argv[0]) : 2000;
+	const char *nome = (argc > 1) ? argv[1] : "115200";
+	static const char *comandos[] = {
+		"brilho 50", "pisca 3", "print brilho", "print freq", "print log last 5", "print mailbox",
+		"print console", "print boot", "reset freq", "stats", "latency", "locks", "time", "power",
+		"every 1000 brilho 10", "jobs", "cancel 1", "help", "begin", "brilho 20", "pisca 2", "commit",
+		"reset brilho", "brilho 80;pisca 4", "record", "flow xonxoff", "logbin off", "sync", "address",
+	};
+	const int qtd = (int)(sizeof(comandos) / sizeof(comandos[0]));
+	const Enlace *e = nullptr;
+	Firmware fw;
+	int enviadas = 0;
+	bool aguardando = false;
+	Histograma h[NUM_LAT];
+	int erros = 0;
+
+	for (const Enlace &x : enlaces) {
+		if (std::strcmp(x.nome, nome) == 0) {
+			e = &x;
+		}
+	}
+	if (e == nullptr) {
+		std::fprintf(stderr, "enlace desconhecido: %s\n", nome);
+		return 2;
+	}
+
+	fw.byte_us = e->byte_us;
+	fw.volta_us = e->volta_us;
+	fw.proxima_linha = [&](Linha &l) {
+		if (enviadas == linhas) {
+			return false;
+		}
+		l = nova_linha(comandos[enviadas % qtd]);
+		enviadas++;
+		aguardando = true;
+		return true;
+	};
+	fw.pode_enviar = [&]() {
+		return !aguardando;
+	};
+	fw.resposta = [&](const Linha &) {
+		aguardando = false;
+		fw.envia();
+	};
+	fw.envia();
+	fw.sim.roda(INT64_MAX);
+
+	std::printf("estagio amostras p50_us p99_us max_us\n");
+	for (int i = 0; i < NUM_LAT; i++) {
+		for (us_t v : fw.latencias[i]) {
+			h[i].registra(v);
+		}
+		std::printf("%s %lu %lu %lu %lu\n", nomes_lat[i], h[i].amostras, Histograma::us(h[i].percentil(500)),
+				Histograma::us(h[i].percentil(990)), Histograma::us(h[i].max));
+		if (h[i].amostras == 0 || h[i].percentil(500) > h[i].percentil(990) || h[i].percentil(990) > h[i].max) {
+			std::printf("%s: histograma invalido\n", nomes_lat[i]);
+			erros++;
+		}
+	}
+	for (int i = 0; i < NUM_LAT; i++) {
+		for (int b = 0; b < Histograma::BALDES; b++) {
+			if (h[i].baldes[b] != 0) {
+				std::printf("balde %s %lu %lu\n", nomes_lat[i],
+						Histograma::us((b >= 32) ? UINT32_MAX : ((1UL << b) - 1)), h[i].baldes[b]);
+			}
+		}
+	}
+	if (!fw.terminou() || h[LAT_PWM].amostras != fw.aplicados || h[LAT_LOG].amostras != fw.confirmacoes) {
+		std::printf("amostras: pwm %lu de %lu aplicados, log %lu de %lu confirmacoes\n", h[LAT_PWM].amostras,
+				fw.aplicados, h[LAT_LOG].amostras, fw.confirmacoes);
+		erros++;
+	}
+	return erros ? 1 : 0;
+}
+
+static int cenario_travas(int argc, char **argv)
+{
+	int linhas = (argc > 0) ? std::atoi(argv[0]) : 2000;
+	static const char *comandos[] = { "brilho 30", "stats", "brilho 60", "print log last 5", "brilho 90", "locks" };
+	const int qtd = (int)(sizeof(comandos) / sizeof(comandos[0]));
+	const Enlace &e = enlaces[1];
+	us_t espera_total[2] = { 0, 0 };
+	us_t atraso_max[2] = { 0, 0 };
+	int separadas = 0;     // Travas tomadas por duas tarefas ou mais, cada uma na sua linha
+	int erros = 0;
+
+	std::printf("esquema trava tarefa tomadas disputadas espera_us espera_max_us\n");
+	for (int global = 1; global >= 0; global--) {
+		const char *esquema = global ? "global" : "dividida";
+		Firmware fw(global != 0);
+		int enviadas = 0;
+
+		fw.byte_us = e.byte_us;
+		fw.volta_us = e.volta_us;
+		fw.proxima_linha = [&](Linha &l) {
+			if (enviadas == linhas) {
+				return false;
+			}
+			l = nova_linha(comandos[enviadas % qtd]);
+			enviadas++;
+			return true;
+		};
+		// Pisca a 10 Hz durante toda a carga (inversao a cada 50 ms)
+		fw.pisca(50000);
+		fw.envia();
+		fw.sim.roda(INT64_MAX);
+
+		// Linhas como as do "locks"; cada tarefa que tomou a trava tem de ter a sua, com as suas tomadas
+		for (size_t tr = 0; tr < fw.sim.num_travas(); tr++) {
+			const Simulador::Trava &x = fw.sim.trava((int)tr);
+			int tarefas_com_uso = 0, linhas_com_uso = 0;
+			for (const Simulador::UsoTrava &u : x.uso) {
+				if (u.tomadas == 0) {
+					continue;
+				}
+				std::printf("%s %s %s %lu %lu %lld %lld\n", esquema, x.nome.c_str(),
+						u.tarefa < 0 ? "outras" : fw.sim.tarefa(u.tarefa).nome.c_str(), u.tomadas,
+						u.disputadas, (long long)u.espera, (long long)u.espera_max);
+				espera_total[global] += u.espera;
+				linhas_com_uso++;
+				if (u.tarefa < 0 || u.tomadas != x.tomadas[u.tarefa]) {
+					std::printf("%s %s: linha do locks mistura tarefas\n", esquema, x.nome.c_str());
+					erros++;
+				}
+			}
+			for (unsigned long n : x.tomadas) {
+				tarefas_com_uso += (n != 0);
+			}
+			if (linhas_com_uso != tarefas_com_uso) {
+				std::printf("%s %s: %d tarefas tomaram a trava, %d linhas no locks\n", esquema,
+						x.nome.c_str(), tarefas_com_uso, linhas_com_uso);
+				erros++;
+			}
+			if (tarefas_com_uso >= 2) {
+				separadas++;
+			}
+		}
+		for (us_t a : fw.atrasos_pisca) {
+			atraso_max[global] = std::max(atraso_max[global], a);
+		}
+		std::printf("%s pisca inversoes %zu atraso_max_us %lld\n", esquema, fw.atrasos_pisca.size(),
+				(long long)atraso_max[global]);
+		std::printf("%s espera_total_us %lld duracao_us %lld\n", esquema, (long long)espera_total[global],
+				(long long)fw.sim.agora);
+		if (!fw.terminou()) {
+			std::printf("%s: linhas nao terminaram\n", esquema);
+			erros++;
+		}
+	}
+
+	if (separadas == 0) {
+		std::printf("nenhuma trava foi tomada por duas tarefas: o locks nao foi conferido\n");
+		erros++;
+	}
+	if (espera_total[0] >= espera_total[1]) {
+		std::printf("travas divididas nao reduziram a espera\n");
+		erros++;
+	}
+	if (atraso_max[0] >= atraso_max[1]) {
+		std::printf("Pisca nao ficou menos atrasado sem o mutex global\n");
+		erros++;
+	}
+	return erros ? 1 : 0;
+}
+
+// Custos estimados (us) das etapas do boot em main() e na tarefa Inicializa
+struct CustosBoot {
+	us_t sistema = 1500;      // system_init: clocks (DFLL) e estados de espera da flash
+	us_t tcc = 20;            // configure_tcc
+	us_t eeprom_init = 400;   // eeprom_emulator_init: le os cabecalhos das paginas
+	us_t le_pagina = 10;      // eeprom_emulator_read_page da pagina de estado
+	us_t pwm = 5;             // tcc_set_compare_value
+	us_t usart = 50;          // configure_usart e console_init
+	us_t bod = 100;           // configure_bod
+	us_t rtc = 200;           // energia_init e configure_sincronia (sincronizacao do RTC a 32 kHz)
+	us_t tarefas = 150;       // CriaTarefas
+	us_t apaga_linha = 6000;  // Apagamento de uma linha da flash (RecuperaEeprom)
+	int linhas_eeprom = 32;   // Secao de 8 KB da EEPROM emulada nos fuses (linhas de 256 bytes)
+	us_t carrega_log = 500;   // CarregaLog e gravacao_carrega
+};
+
+static int cenario_boot(int argc, char **argv)
+{
+	static const char *const etapas[] = { "sistema", "pwm", "led", "console", "bod", "rtc", "tarefas", "eeprom",
+			"pronto" };
+	const us_t meta = (argc > 0) ? std::atoi(argv[0]) * TICK_US : 5 * TICK_US;
+	const us_t byte_us = 1042; // Mensagem de pronto e prompt a 9600
+	CustosBoot c;
+	int erros = 0;
+
+	std::printf("caminho");
+	for (const char *e : etapas) {
+		std::printf(" %s_us", e);
+	}
+	std::printf("\n");
+
+	// EEPROM integra com brilho salvo, integra sem estado e precisando de recuperacao (apaga tudo)
+	for (int caminho = 0; caminho < 3; caminho++) {
+		static const char *const nomes[] = { "brilho_salvo", "sem_estado", "recuperacao" };
+		std::vector<us_t> marca;
+		us_t t = 0;
+
+		// main(): caminho rapido ate o LED, antes do console e das tarefas
+		marca.push_back(t += c.sistema);
+		marca.push_back(t += c.tcc);
+		t += c.eeprom_init;
+		if (caminho != 2) {
+			t += c.le_pagina;                   // RestauraLed so le a pagina com a EEPROM pronta
+			t += (caminho == 0) ? c.pwm : 0;
+		}
+		marca.push_back(t);
+		marca.push_back(t += c.usart);
+		marca.push_back(t += c.bod);
+		marca.push_back(t += c.rtc);
+		marca.push_back(t += c.tarefas);
+
+		// Inicializa, com o escalonador rodando: recuperacao, log e a mensagem de pronto
+		if (caminho == 2) {
+			t += c.linhas_eeprom * c.apaga_linha + c.eeprom_init;
+		}
+		marca.push_back(t += c.carrega_log);
+		t += (us_t)std::strlen("Programa pronto (LED em 2000 us)\n\nComando>") * byte_us;
+		marca.push_back(t);
+
+		std::printf("%s", nomes[caminho]);
+		for (us_t m : marca) {
+			std::printf(" %lld", (long long)m);
+		}
+		std::printf("\n");
+
+		// O LED (primeira saida de PWM) nao espera o console, as tarefas nem a recuperacao da EEPROM
+		if (marca[2] > meta) {
+			std::printf("%s: LED em %lld us, meta %lld us\n", nomes[caminho], (long long)marca[2], (long long)meta);
+			erros++;
+		}
+		for (size_t i = 1; i < marca.size(); i++) {
+			if (marca[i] < marca[i - 1]) {
+				std::printf("%s: etapa %s antes de %s\n", nomes[caminho], etapas[i], etapas[i - 1]);
+				erros++;
+			}
+		}
+	}
+	return erros ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1 && std::strcmp(argv[1], "coalescencia") == 0) {
+		return cenario_coalescencia(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "lote") == 0) {
+		return cenario_lote(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "pisca") == 0) {
+		return cenario_pisca(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "janela") == 0) {
+		return cenario_janela(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "cpu") == 0) {
+		return cenario_cpu(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "latencia") == 0) {
+		return cenario_latencia(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "travas") == 0) {
+		return cenario_travas(argc - 2, argv + 2);
+	}
+	if (argc > 1 && std::strcmp(argv[1], "boot") == 0) {
+		return cenario_boot(argc - 2, argv + 2);
+	}
+	std::fprintf(stderr, "uso: sim_comandos coalescencia [comandos]\n"
+			"     sim_comandos lote [comandos]\n"
+			"     sim_comandos pisca [brilho]\n"
+			"     sim_comandos janela [comandos]\n"
+			"     sim_comandos cpu [fase_ms]\n"
+			"     sim_comandos latencia [linhas] [9600|115200|usb]\n"
+			"     sim_comandos travas [linhas]\n"
+			"     sim_comandos boot [meta_ms]\n");
+	return 2;
+}
@@ -0,0 +1,175 @@
+/**
+ * \file
+ * \brief Simulacao (host) dos despertares do nucleo em 10 s ociosos, com tick periodico e com tickless idle
+ *
+ * Conta quantas vezes o nucleo acorda e quanto tempo fica dormindo com o firmware parado entre
+ * comandos, em duas configuracoes: o SysTick de 1 ms de sempre (o nucleo acorda a cada tick) e
+ * o tickless idle de energia.c, em que o kernel dorme ate o proximo timeout (no maximo
+ * CONF_ENERGIA_MAX_TICKS) e so interrupcoes acordam antes. Cenarios de carga ociosa:
+ *  - parado: nenhuma tarefa com timeout (todas esperam com portMAX_DELAY);
+ *  - pisca <hz>: Pisca com um job em andamento, acordando a cada meio periodo;
+ *  - every <ms>: um job periodico na agenda, cuja roda avanca a cada CONF_AGENDA_RESOLUCAO_MS;
+ *  - sync <ms>: pulso de sincronia do mestre (interrupcao externa).
+ *
+ * No tickless a correcao do tick e feita com a mesma aritmetica de energia_dorme() (resto em
+ * contagens do RTC e fracao do SysTick ao dormir) e o tick do kernel e conferido contra o RTC
+ * no fim: nao pode ter derivado mais de um tick.
+ *
+ * Os custos de cada despertar sao estimativas para o Cortex-M0+ a 48 MHz.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o sim_energia tools/sim_energia.cpp
+ * Uso:        sim_energia [segundos]
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const uint32_t RTC_HZ = 32768;      // ENERGIA_RTC_HZ
+static const uint32_t TICK_HZ = 1000;      // configTICK_RATE_HZ
+static const uint32_t CPU_HZ = 48000000;
+static const uint32_t MAX_TICKS = 60000;   // CONF_ENERGIA_MAX_TICKS
+static const uint32_t AGENDA_RESOLUCAO_MS = 10;
+static const uint32_t MIN_CONTAGENS = 4;   // ENERGIA_MIN_CONTAGENS
+
+// Tempo acordado (us) por despertar, estimado
+static const double CUSTO_TICK_US = 3.0;     // xPortSysTickHandler sem troca de tarefa
+static const double CUSTO_SONO_US = 20.0;    // energia_dorme: entrada, WFI e correcao do tick
+static const double CUSTO_TAREFA_US = 15.0;  // Uma tarefa acorda, trabalha e volta a bloquear
+
+struct Cenario {
+	std::string nome;
+	uint32_t timeout_ms;   // Periodo de um timeout de tarefa/timer (0: nenhum)
+	uint32_t irq_ms;       // Periodo de uma interrupcao externa (0: nenhuma)
+};
+
+struct Resultado {
+	unsigned long acordadas;
+	double acordado_us;
+	long deriva_ticks;     // Tick do kernel menos o tempo do RTC, em ticks
+};
+
+// Tick periodico: um despertar por tick, mais as interrupcoes externas fora dos ticks
+static Resultado com_tick(const Cenario &c, uint32_t segundos)
+{
+	Resultado r = { 0, 0.0, 0 };
+	uint64_t ticks = (uint64_t)segundos * TICK_HZ;
+
+	r.acordadas = (unsigned long)ticks;
+	r.acordado_us = ticks * CUSTO_TICK_US;
+	if (c.timeout_ms) {
+		r.acordado_us += (ticks / c.timeout_ms) * CUSTO_TAREFA_US;
+	}
+	if (c.irq_ms) {
+		r.acordadas += (unsigned long)(ticks / c.irq_ms);
+		r.acordado_us += (ticks / c.irq_ms) * CUSTO_TAREFA_US;
+	}
+	return r;
+}
+
+// Tickless: cada sono vai ate o proximo timeout (limitado a MAX_TICKS) ou ate a interrupcao externa
+static Resultado tickless(const Cenario &c, uint32_t segundos)
+{
+	Resultado r = { 0, 0.0, 0 };
+	const uint64_t fim = (uint64_t)segundos * RTC_HZ;
+	const uint32_t carga = CPU_HZ / TICK_HZ - 1;   // SysTick->LOAD
+	uint64_t rtc = 0;          // Contagens do RTC desde o inicio
+	uint64_t tick = 0;         // xTickCount
+	uint32_t resto = 0;        // energia_resto (contagens x TICK_HZ)
+	uint32_t systick = 0;      // Ciclos do tick atual ja contados pelo SysTick
+	double acordado = 0.0;     // Fracao de contagem do RTC passada acordado, ainda nao somada a rtc
+	uint64_t proximo_timeout = c.timeout_ms ? c.timeout_ms : UINT64_MAX; // Em ticks
+	uint64_t proxima_irq = c.irq_ms ? (uint64_t)c.irq_ms * RTC_HZ / 1000 + 7 : UINT64_MAX; // Em contagens, fora da grade
+
+	while (rtc < fim) {
+		uint64_t esperado = (proximo_timeout == UINT64_MAX) ? UINT64_MAX : proximo_timeout - tick;
+		uint32_t dorme = (uint32_t)std::min<uint64_t>(esperado, MAX_TICKS);
+
+		// Parte do tick atual que ja passou fica no resto, como em energia_dorme()
+		resto += (uint32_t)(((uint64_t)systick * RTC_HZ) / (carga + 1));
+
+		// Acorda na comparacao do RTC ou antes, na interrupcao externa
+		uint32_t alvo = dorme * RTC_HZ;
+		uint32_t contagens = MIN_CONTAGENS;
+		if (resto + MIN_CONTAGENS * TICK_HZ < alvo) {
+			contagens = (alvo - resto + TICK_HZ - 1) / TICK_HZ;
+		}
+		uint64_t compara = rtc + contagens;
+		uint64_t acorda = std::min(compara, proxima_irq);
+		uint32_t decorrido = (uint32_t)(acorda - rtc);
+		rtc = acorda;
+		r.acordadas++;
+		r.acordado_us += CUSTO_SONO_US;
+
+		resto += decorrido * TICK_HZ;
+		uint32_t passos = resto / RTC_HZ;
+		if (passos > dorme) {
+			passos = dorme;
+		}
+		resto -= passos * RTC_HZ;
+		tick += passos;
+		systick = 0;
+
+		// Trabalho da tarefa ou da interrupcao que acordou o nucleo; o SysTick volta a contar
+		double trabalho = CUSTO_SONO_US;
+		if (acorda == proxima_irq) {
+			proxima_irq += (uint64_t)c.irq_ms * RTC_HZ / 1000;
+			trabalho += CUSTO_TAREFA_US;
+		}
+		if (tick >= proximo_timeout) {
+			proximo_timeout += c.timeout_ms;
+			trabalho += CUSTO_TAREFA_US;
+		}
+		r.acordado_us += trabalho - CUSTO_SONO_US;
+		systick = (uint32_t)(trabalho * (CPU_HZ / 1000000));
+		acordado += trabalho * RTC_HZ / 1e6;
+		rtc += (uint64_t)acordado;
+		acordado -= (uint64_t)acordado;
+		if (systick > carga) {
+			tick += systick / (carga + 1);
+			systick %= carga + 1;
+		}
+	}
+
+	r.deriva_ticks = (long)tick - (long)((rtc * TICK_HZ) / RTC_HZ);
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t segundos = (argc > 1) ? (uint32_t)std::atoi(argv[1]) : 10;
+	const Cenario cenarios[] = {
+		{ "parado", 0, 0 },
+		{ "pisca 1", 500, 0 },
+		{ "pisca 10", 50, 0 },
+		{ "every 1000", AGENDA_RESOLUCAO_MS, 0 },
+		{ "sync 1000", 0, 1000 },
+	};
+	int erros = 0;
+
+	std::printf("cenario modo acordadas acordadas_por_s residencia_permil deriva_ticks\n");
+	for (const Cenario &c : cenarios) {
+		Resultado a = com_tick(c, segundos);
+		Resultado b = tickless(c, segundos);
+		double total = segundos * 1e6;
+
+		std::printf("\"%s\" tick %lu %.1f %ld -\n", c.nome.c_str(), a.acordadas, (double)a.acordadas / segundos,
+				(long)(1000 * (1 - a.acordado_us / total)));
+		std::printf("\"%s\" tickless %lu %.1f %ld %ld\n", c.nome.c_str(), b.acordadas,
+				(double)b.acordadas / segundos, (long)(1000 * (1 - b.acordado_us / total)), b.deriva_ticks);
+
+		if (b.deriva_ticks < -1 || b.deriva_ticks > 1) {
+			std::printf("\"%s\": tick derivou %ld ticks do RTC\n", c.nome.c_str(), b.deriva_ticks);
+			erros++;
+		}
+		if (b.acordadas > a.acordadas) {
+			std::printf("\"%s\": tickless acordou mais que o tick periodico\n", c.nome.c_str());
+			erros++;
+		}
+	}
+	return erros ? 1 : 0;
+}
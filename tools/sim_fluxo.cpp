@@ -0,0 +1,161 @@
+/**
+ * \file
+ * \brief Simulacao (host) do controle de fluxo da recepcao do console com o host mandando sem parar
+ *
+ * O host inunda o console com linhas de comando na taxa da linha serial. A interrupcao de
+ * recepcao guarda cada byte no buffer (CONSOLE_RX_TAM) e, ao passar da marca alta, pausa o
+ * host: em XON/XOFF o XOFF fica pendente e sai pela interrupcao de DRE assim que o byte em
+ * transmissao (o eco) deixar o registrador de dados, e so pausa o host quando termina de
+ * chegar; em RTS/CTS o pino muda na hora. O host ainda manda "reacao" bytes depois de ver a
+ * pausa (FIFO do adaptador USB-serial, driver). As tarefas tiram uma linha do buffer a cada
+ * "processa_ms" (interpretacao, execucao e log) e liberam o host na marca baixa.
+ *
+ * Confere que nenhum byte e perdido enquanto a reacao do host cabe na folga acima da marca
+ * alta (CONSOLE_RX_TAM - CONSOLE_RX_MARCA_ALTA, menos o atraso do XOFF) e mostra a partir de
+ * quando passa a perder.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o sim_fluxo tools/sim_fluxo.cpp
+ * Uso:        sim_fluxo [linhas] [processa_ms]
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+
+#include "../console.h"
+
+struct Resultado {
+	unsigned long enviados;
+	unsigned long perdidos;
+	unsigned long pausas;
+	int ocupacao_max;
+	long bits;       // Duracao do envio
+};
+
+// Simula um envio de "linhas" linhas; tempo em unidades de um bit
+static Resultado simula(int modo, int reacao, int linhas, double processa_bits)
+{
+	static const char *linha = "brilho 37\r\n";
+	const int tam = (int)std::string(linha).size();
+	const long total = (long)linhas * tam;
+	Resultado r = { 0, 0, 0, 0, 0 };
+
+	std::deque<char> rx;       // Buffer de recepcao
+	int linhas_rx = 0;         // Linhas completas no buffer
+	bool pausado = false;      // console_rx_pausado
+	long pausa_em = -1;        // Bit em que a pausa chega ao host (-1: nenhuma a caminho)
+	long libera_em = -1;       // Bit em que a liberacao chega ao host
+	bool host_parado = false;
+	int depois_da_pausa = 0;   // Bytes mandados pelo host depois de ver a pausa
+	long proxima_linha = -1;   // Bit em que as tarefas terminam a linha atual
+	long t = 0;
+	long processados = 0;
+
+	// O host manda um byte a cada 10 bits; as tarefas e o enlace sao olhados a cada byte
+	while (processados < total) {
+		// Pausa e liberacao chegando ao host
+		if (pausa_em >= 0 && t >= pausa_em) {
+			host_parado = true;
+			depois_da_pausa = 0;
+			pausa_em = -1;
+		}
+		if (libera_em >= 0 && t >= libera_em) {
+			host_parado = false;
+			libera_em = -1;
+		}
+
+		// Byte do host (o que ja saiu do adaptador ainda chega depois da pausa)
+		if ((long)r.enviados < total && (!host_parado || depois_da_pausa < reacao)) {
+			char c = linha[r.enviados % tam];
+			r.enviados++;
+			if (host_parado) {
+				depois_da_pausa++;
+			}
+			if ((int)rx.size() < CONSOLE_RX_TAM) {
+				rx.push_back(c);
+				if (c == '\n') {
+					linhas_rx++;
+				}
+			} else {
+				r.perdidos++;
+				if (c == '\n') {
+					processados += tam; // Linha truncada: o firmware descarta e o host nao a reenviara
+				}
+			}
+			if ((int)rx.size() > r.ocupacao_max) {
+				r.ocupacao_max = (int)rx.size();
+			}
+
+			// Marca alta: XOFF pela interrupcao de DRE, atras do eco em transmissao (ate um byte)
+			// e com mais um byte ate chegar; RTS muda antes do proximo byte
+			if (!pausado && (int)rx.size() >= CONSOLE_RX_MARCA_ALTA) {
+				pausado = true;
+				r.pausas++;
+				pausa_em = t + ((modo == CONSOLE_FLUXO_XONXOFF) ? 20 : 1);
+				libera_em = -1;
+			}
+		}
+
+		// Tarefas: uma linha por vez, cada uma levando processa_bits
+		if (proxima_linha < 0 && linhas_rx > 0) {
+			proxima_linha = t + (long)processa_bits;
+		}
+		if (proxima_linha >= 0 && t >= proxima_linha) {
+			while (!rx.empty()) {
+				char c = rx.front();
+				rx.pop_front();
+				if (c == '\n') {
+					break;
+				}
+			}
+			linhas_rx--;
+			processados += tam;
+			proxima_linha = -1;
+
+			if (pausado && (int)rx.size() <= CONSOLE_RX_MARCA_BAIXA) {
+				pausado = false;
+				libera_em = t + ((modo == CONSOLE_FLUXO_XONXOFF) ? 20 : 1);
+				pausa_em = -1;
+			}
+		}
+
+		t += 10;
+	}
+	r.bits = t;
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	int linhas = (argc > 1) ? std::atoi(argv[1]) : 5000;
+	double processa_ms = (argc > 2) ? std::atof(argv[2]) : 20.0;
+	static const long bauds[] = { 9600, 115200 };
+	static const int modos[] = { CONSOLE_FLUXO_XONXOFF, CONSOLE_FLUXO_RTSCTS };
+	static const int reacoes[] = { 0, 4, 16, 32, 48, 60, 64, 96 };
+	const int folga = CONSOLE_RX_TAM - CONSOLE_RX_MARCA_ALTA - 2; // XOFF: ate dois bytes de atraso
+	int erros = 0;
+
+	std::printf("baud fluxo reacao enviados perdidos pausas ocupacao_max duracao_s linhas_por_s\n");
+	for (long baud : bauds) {
+		for (int modo : modos) {
+			for (int reacao : reacoes) {
+				Resultado r = simula(modo, reacao, linhas, processa_ms * baud / 1000.0);
+				double s = (double)r.bits / baud;
+				std::printf("%ld %s %d %lu %lu %lu %d/%d %.2f %.0f%s\n", baud,
+						(modo == CONSOLE_FLUXO_XONXOFF) ? "xonxoff" : "rtscts", reacao, r.enviados,
+						r.perdidos, r.pausas, r.ocupacao_max, CONSOLE_RX_TAM, s, linhas / s,
+						(reacao > folga) ? " (reacao maior que a folga)" : "");
+				if (r.perdidos != 0 && reacao <= folga) {
+					erros++;
+				}
+			}
+		}
+	}
+	if (erros) {
+		std::printf("%d casos perderam bytes dentro da folga de %d bytes\n", erros, folga);
+	}
+	return erros ? 1 : 0;
+}
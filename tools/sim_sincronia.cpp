@@ -0,0 +1,146 @@
+/**
+ * \file
+ * \brief Simulacao (host) do pisca em fase entre varias placas
+ *
+ * Simula N placas com cristais fora do nominal (ate +/-ppm_max) e RTCs em instantes
+ * diferentes, recebendo do mestre um quadro "sync <ms>" a cada intervalo_s segundos com
+ * jitter de recepcao de ate jitter_us. Cada placa usa o mesmo sincronia.c do firmware e
+ * marca as bordas de subida do pisca nos multiplos do periodo do mestre, arredondadas ao
+ * tick de 1 ms como em TicksAteMestre(). A cada janela o programa mostra o erro de fase
+ * (instante real da borda - instante ideal) das placas acertadas pelos quadros e, para
+ * comparacao, das mesmas placas acertadas so pelo primeiro quadro.
+ *
+ * Compilacao: gcc -O2 -c sincronia.c -o sincronia.o
+ *             g++ -std=c++11 -O2 -o sim_sincronia tools/sim_sincronia.cpp sincronia.o
+ * Uso:        sim_sincronia [nos] [ppm_max] [intervalo_s] [jitter_us] [duracao_s] [periodo_ms]
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "../sincronia.h"
+
+#define TICK_HZ 1000 // configTICK_RATE_HZ do firmware
+
+struct No {
+	double ppm;        // Desvio do cristal
+	double inicio;     // Tempo real (s) em que o RTC do no valia zero
+	struct sincronia acertado; // Acertado por todos os quadros
+	struct sincronia livre;    // So pelo primeiro quadro
+};
+
+// RTC do no no tempo real t (s)
+static uint64_t rtc_no(const No &no, double t)
+{
+	return (uint64_t)std::floor((t - no.inicio) * SINCRONIA_RTC_HZ * (1.0 + no.ppm * 1e-6));
+}
+
+// Tempo real (s) em que o RTC do no vale "rtc"
+static double tempo_real(const No &no, double rtc)
+{
+	return no.inicio + rtc / (SINCRONIA_RTC_HZ * (1.0 + no.ppm * 1e-6));
+}
+
+// Erro (us) da borda no instante "ms" do mestre: a espera termina no tick mais proximo do alvo
+static double erro_borda(const No &no, const struct sincronia *s, uint32_t ms)
+{
+	double alvo = (double)sincronia_para_local(s, ms);
+	double tick = (double)SINCRONIA_RTC_HZ / TICK_HZ;
+	double rtc = std::floor(alvo / tick + 0.5) * tick;
+
+	return (tempo_real(no, rtc) - ms / 1000.0) * 1e6;
+}
+
+struct Janela {
+	double max;
+	double soma2;
+	unsigned long n;
+};
+
+static void acumula(Janela &j, double erro)
+{
+	if (std::fabs(erro) > j.max) {
+		j.max = std::fabs(erro);
+	}
+	j.soma2 += erro * erro;
+	j.n++;
+}
+
+int main(int argc, char **argv)
+{
+	int nos = (argc > 1) ? std::atoi(argv[1]) : 8;
+	double ppm_max = (argc > 2) ? std::atof(argv[2]) : 100;
+	double intervalo = (argc > 3) ? std::atof(argv[3]) : 10;
+	double jitter_us = (argc > 4) ? std::atof(argv[4]) : 500;
+	double duracao = (argc > 5) ? std::atof(argv[5]) : 600;
+	uint32_t periodo = (argc > 6) ? (uint32_t)std::atoi(argv[6]) : 500;
+	double janela_s = 60;
+	std::mt19937 gerador(1);
+	std::uniform_real_distribution<double> uniforme(0.0, 1.0);
+	std::vector<No> placa((size_t)(nos > 0 ? nos : 1));
+	double proximo_quadro = 0;
+	double fim_janela = janela_s;
+	uint32_t borda = periodo;
+	Janela acertado = { 0, 0, 0 };
+	Janela livre = { 0, 0, 0 };
+	bool primeiro = true;
+
+	if (periodo == 0 || intervalo <= 0) {
+		std::fprintf(stderr, "periodo e intervalo devem ser positivos\n");
+		return 1;
+	}
+
+	for (No &no : placa) {
+		no.ppm = (uniforme(gerador) * 2 - 1) * ppm_max;
+		no.inicio = -uniforme(gerador) * 100;
+		sincronia_init(&no.acertado);
+		sincronia_init(&no.livre);
+	}
+
+	std::printf("%d nos, +/-%.0f ppm, quadro a cada %.1f s, jitter %.0f us, periodo %lu ms\n",
+			(int)placa.size(), ppm_max, intervalo, jitter_us, (unsigned long)periodo);
+	std::printf("tempo_s acertado_max_us acertado_rms_us livre_max_us livre_rms_us\n");
+
+	// Avanca em ordem de tempo do mestre: quadros e bordas do pisca
+	while (borda / 1000.0 <= duracao) {
+		if (proximo_quadro <= borda / 1000.0) {
+			uint32_t ms = (uint32_t)std::llround(proximo_quadro * 1000);
+			for (No &no : placa) {
+				double recebido = proximo_quadro + uniforme(gerador) * jitter_us * 1e-6;
+				sincronia_quadro(&no.acertado, rtc_no(no, recebido), ms);
+				if (primeiro) {
+					sincronia_quadro(&no.livre, rtc_no(no, recebido), ms);
+				}
+			}
+			primeiro = false;
+			proximo_quadro += intervalo;
+			continue;
+		}
+
+		for (const No &no : placa) {
+			acumula(acertado, erro_borda(no, &no.acertado, borda));
+			acumula(livre, erro_borda(no, &no.livre, borda));
+		}
+		borda += periodo;
+
+		if (borda / 1000.0 >= fim_janela) {
+			std::printf("%.0f %.0f %.0f %.0f %.0f\n", fim_janela, acertado.max,
+					std::sqrt(acertado.soma2 / (acertado.n ? acertado.n : 1)), livre.max,
+					std::sqrt(livre.soma2 / (livre.n ? livre.n : 1)));
+			acertado = Janela{ 0, 0, 0 };
+			livre = Janela{ 0, 0, 0 };
+			fim_janela += janela_s;
+		}
+	}
+
+	for (const No &no : placa) {
+		std::printf("no ppm %.1f medido %ld erro_max_us %.0f\n", no.ppm, (long)sincronia_ppm(&no.acertado),
+				no.acertado.erro_max * 1e6 / SINCRONIA_RTC_HZ);
+	}
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+/**
+ * \file
+ * \brief Teste (host) da codificacao dos comandos no log: CodificaComando -> DecodificaComando
+ *
+ * Para todo tipo de comando e todo alvo, codifica combinacoes de argumentos (zero, limites de
+ * cada tamanho de varint, negativos e os extremos de 32 bits), de tempos e da marca de tempo
+ * absoluto, e confere que a decodificacao devolve o mesmo comando, o mesmo tempo, a mesma marca
+ * e o mesmo numero de bytes; que a quantidade de campos no opcode e a minima (campos nulos no
+ * fim nao sao gravados); que o opcode nunca e COMANDO_COD_FIM e o registro cabe em
+ * COMANDO_COD_MAX; que qualquer registro truncado e recusado; e que registros seguidos numa
+ * pagina sao lidos um a um ate o COMANDO_COD_FIM.
+ *
+ * Compilacao: gcc -O2 -c comandos.c formata.c
+ *             g++ -std=c++11 -O2 -o teste_comandos tools/teste_comandos.cpp comandos.o formata.o
+ * Uso:        teste_comandos
+ */
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../comandos.h"
+
+static const int valores[] = {
+	0, 1, 50, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, INT_MAX,
+	-1, -2, -128, -16384, INT_MIN,
+};
+
+static const uint32_t tempos[] = {
+	0, 1, 127, 128, 16383, 16384, 2097151, 2097152, 268435455, 268435456, 1700000000, UINT32_MAX,
+};
+
+static int erros;
+
+static void falha(const char *o_que, const Comando &c, uint32_t tempo, int absoluto)
+{
+	if (erros < 20) {
+		std::printf("%s: tipo %d alvo %d arg %d %d tempo %lu absoluto %d\n", o_que, (int)c.tipo, (int)c.alvo,
+				c.arg[0], c.arg[1], (unsigned long)tempo, absoluto);
+	}
+	erros++;
+}
+
+int main()
+{
+	const int nv = (int)(sizeof(valores) / sizeof(valores[0]));
+	const int nt = (int)(sizeof(tempos) / sizeof(tempos[0]));
+	unsigned long registros = 0;
+	int maior = 0;
+	int qtd_vista[4] = { 0, 0, 0, 0 };
+
+	for (int tipo = 0; tipo < NUM_CMD; tipo++) {
+		for (int alvo = 0; alvo < NUM_ALVOS; alvo++) {
+			for (int a = 0; a < nv; a++) {
+				for (int b = 0; b < nv; b++) {
+					for (int t = 0; t < nt; t++) {
+						for (int absoluto = 0; absoluto <= 1; absoluto++) {
+							Comando c, d;
+							uint8_t dados[COMANDO_COD_MAX + 8];
+							uint32_t tempo = 0;
+							int abs_lido = -1;
+
+							std::memset(&c, 0, sizeof(c));
+							c.tipo = (enum tipo_comando)tipo;
+							c.alvo = (enum alvo_comando)alvo;
+							c.arg[0] = valores[a];
+							c.arg[1] = valores[b];
+							c.agenda = AGENDA_PERIODICA; // Nao vai para o log: volta como AGENDA_NENHUMA
+							c.agenda_ms = 1000;
+
+							std::memset(dados, 0xAA, sizeof(dados));
+							int n = CodificaComando(&c, tempos[t], absoluto, dados);
+							registros++;
+							if (n > maior) {
+								maior = n;
+							}
+							if (n < 2 || n > COMANDO_COD_MAX || dados[n] != 0xAA || dados[0] == COMANDO_COD_FIM) {
+								falha("tamanho ou opcode invalido", c, tempos[t], absoluto);
+								continue;
+							}
+							int qtd = (alvo != 0) ? 3 : (c.arg[1] != 0) ? 2 : (c.arg[0] != 0) ? 1 : 0;
+							qtd_vista[qtd]++;
+							if ((dados[0] & 0x1F) != tipo || ((dados[0] >> 5) & 0x03) != qtd
+									|| ((dados[0] & COMANDO_COD_ABSOLUTO) != 0) != (absoluto != 0)) {
+								falha("opcode", c, tempos[t], absoluto);
+							}
+
+							std::memset(&d, 0x55, sizeof(d));
+							int m = DecodificaComando(dados, n, &d, &tempo, &abs_lido);
+							if (m != n || d.tipo != c.tipo || d.alvo != c.alvo || d.arg[0] != c.arg[0]
+									|| d.arg[1] != c.arg[1] || tempo != tempos[t] || abs_lido != absoluto
+									|| d.agenda != AGENDA_NENHUMA || d.agenda_ms != 0) {
+								falha("ida e volta", c, tempos[t], absoluto);
+							}
+
+							// Truncado em qualquer ponto: recusado
+							for (int k = 0; k < n; k++) {
+								if (DecodificaComando(dados, k, &d, &tempo, &abs_lido) != 0) {
+									falha("registro truncado aceito", c, tempos[t], absoluto);
+									break;
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// Pagina com registros seguidos e o fim marcado: lidos em ordem ate o COMANDO_COD_FIM
+	std::vector<uint8_t> pagina(60, COMANDO_COD_FIM);
+	std::vector<Comando> gravados;
+	int usado = 0;
+	for (int i = 0;; i++) {
+		Comando c;
+		uint8_t dados[COMANDO_COD_MAX];
+		std::memset(&c, 0, sizeof(c));
+		c.tipo = (i % 2) ? CMD_PISCA : CMD_BRILHO;
+		c.arg[0] = valores[i % nv];
+		c.arg[1] = (i % 2) ? valores[(i * 7) % nv] : 0;
+		int n = CodificaComando(&c, tempos[i % nt], i == 0, dados);
+		if (usado + n > (int)pagina.size()) {
+			break;
+		}
+		std::memcpy(&pagina[usado], dados, n);
+		usado += n;
+		gravados.push_back(c);
+	}
+	int pos = 0;
+	size_t lidos = 0;
+	Comando d;
+	uint32_t tempo;
+	int absoluto, n;
+	while ((n = DecodificaComando(&pagina[pos], (int)pagina.size() - pos, &d, &tempo, &absoluto)) > 0) {
+		if (lidos >= gravados.size() || d.tipo != gravados[lidos].tipo || d.arg[0] != gravados[lidos].arg[0]
+				|| d.arg[1] != gravados[lidos].arg[1]) {
+			std::printf("pagina: registro %zu diferente\n", lidos);
+			erros++;
+			break;
+		}
+		pos += n;
+		lidos++;
+	}
+	if (lidos != gravados.size() || pos != usado) {
+		std::printf("pagina: %zu de %zu registros lidos\n", lidos, gravados.size());
+		erros++;
+	}
+
+	std::printf("registros %lu maior_bytes %d qtd0 %d qtd1 %d qtd2 %d qtd3 %d pagina %zu erros %d\n", registros, maior,
+			qtd_vista[0], qtd_vista[1], qtd_vista[2], qtd_vista[3], gravados.size(), erros);
+	return erros ? 1 : 0;
+}
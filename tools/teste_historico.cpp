@@ -0,0 +1,217 @@
+/**
+ * \file
+ * \brief Teste (host) das consultas do log ("print log", "last <n>", "since <seq>") sobre um anel que ja deu voltas
+ *
+ * Grava milhares de comandos com historico.c em um vetor de paginas que faz o papel da EEPROM
+ * emulada, com poucas paginas para o anel dar varias voltas, e confere cada consulta contra um
+ * modelo: os registros entregues (sequencia, hora e comando) devem ser exatamente os pedidos, e
+ * as paginas lidas nao podem passar da busca binaria mais as paginas que guardam esses registros.
+ * Inclui "since" com sequencias mais antigas que o registro mais antigo e alem do ultimo, e a
+ * releitura do log (historico_carrega) como no boot.
+ *
+ * Compilacao: gcc -O2 -c historico.c comandos.c formata.c
+ *             g++ -std=c++11 -O2 -o teste_historico tools/teste_historico.cpp historico.o comandos.o formata.o
+ * Uso:        teste_historico [paginas] [registros]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../historico.h"
+
+// EEPROM emulada: pagina 0 e o cabecalho, 1 a N o anel
+static std::vector<std::vector<uint8_t>> eeprom;
+static unsigned long lidas_eeprom;
+
+static void le(uint8_t pagina, uint8_t *dados)
+{
+	std::memcpy(dados, eeprom.at(pagina).data(), HISTORICO_PAGINA_TAM);
+	lidas_eeprom++;
+}
+
+static void escreve(uint8_t pagina, const uint8_t *dados)
+{
+	std::memcpy(eeprom.at(pagina).data(), dados, HISTORICO_PAGINA_TAM);
+}
+
+// Registro como deve sair da consulta
+struct Esperado {
+	uint32_t seq;
+	uint64_t tempo;
+	std::string texto;
+	uint8_t pagina;
+};
+
+static std::string texto_de(const Comando *cmd)
+{
+	char texto[COMANDO_TAM];
+	FormataComando(cmd, texto, sizeof(texto));
+	return texto;
+}
+
+struct Saida {
+	std::vector<Esperado> registros;
+};
+
+static void emite(void *contexto, uint32_t seq, uint64_t tempo, const Comando *cmd)
+{
+	Saida *s = static_cast<Saida *>(contexto);
+	s->registros.push_back(Esperado{ seq, tempo, texto_de(cmd), 0 });
+}
+
+static int teto_log2(uint32_t n)
+{
+	int b = 0;
+	while ((1UL << b) < n) {
+		b++;
+	}
+	return b;
+}
+
+int main(int argc, char **argv)
+{
+	int paginas = (argc > 1) ? std::atoi(argv[1]) : 12;
+	int registros = (argc > 2) ? std::atoi(argv[2]) : 3000;
+	std::mt19937 rng(7);
+	std::vector<Esperado> gravados;
+	struct historico h;
+	uint64_t agora = 1700000000000ULL; // ms
+	int erros = 0;
+
+	if (paginas < 2 || paginas > 254) {
+		std::fprintf(stderr, "paginas: 2 a 254\n");
+		return 2;
+	}
+	eeprom.assign(paginas + 1, std::vector<uint8_t>(HISTORICO_PAGINA_TAM, 0xFF));
+
+	// EEPROM apagada: o cabecalho nao e reconhecido e o log comeca vazio
+	historico_init(&h, (uint8_t)paginas, le, escreve);
+	if (historico_carrega(&h) || h.indice.inicio != 0 || h.indice.proximo != 0) {
+		std::printf("log apagado nao foi reiniciado\n");
+		erros++;
+	}
+
+	for (int i = 0; i < registros; i++) {
+		Comando cmd;
+		std::memset(&cmd, 0, sizeof(cmd));
+		switch (rng() % 3) {
+		case 0:
+			cmd.tipo = CMD_BRILHO;
+			cmd.arg[0] = (int)(rng() % 100) + 1;
+			break;
+		case 1:
+			cmd.tipo = CMD_PISCA;
+			cmd.arg[0] = (int)(rng() % 20) + 1;
+			cmd.arg[1] = (int)(rng() % 1000);
+			break;
+		default:
+			cmd.tipo = CMD_RESET;
+			cmd.alvo = (rng() % 2) ? ALVO_BRILHO : ALVO_FREQ;
+			break;
+		}
+
+		// Intervalos de ms a horas, um "time set" para tras e um salto maior que 32 bits de ms
+		if (i == registros / 3) {
+			agora -= 3600000;
+			h.absoluto = true;
+		} else if (i == registros / 2) {
+			agora += 5000000000ULL;
+		} else {
+			agora += (rng() % 4 == 0) ? rng() % 7200000 : rng() % 2000;
+		}
+
+		historico_grava(&h, &cmd, agora);
+		gravados.push_back(Esperado{ h.indice.proximo - 1, h.ultimo_tempo, texto_de(&cmd), h.indice.pagina_atual });
+	}
+
+	const struct historico_indice &ix = h.indice;
+	uint32_t guardados = ix.proximo - ix.inicio;
+	std::printf("paginas %d registros %d guardados %lu inicio %lu proximo %lu pagina_inicio %u pagina_atual %u\n",
+			paginas, registros, (unsigned long)guardados, (unsigned long)ix.inicio, (unsigned long)ix.proximo,
+			ix.pagina_inicio, ix.pagina_atual);
+	if (ix.inicio == 0 || ix.proximo != (uint32_t)registros) {
+		std::printf("o anel nao deu a volta ou perdeu sequencias\n");
+		erros++;
+	}
+
+	struct Consulta {
+		const char *nome;
+		int tipo;
+		uint32_t arg;
+	};
+	const Consulta consultas[] = {
+		{ "tudo", LOG_CONSULTA_TUDO, 0 },
+		{ "last 0", LOG_CONSULTA_ULTIMOS, 0 },
+		{ "last 1", LOG_CONSULTA_ULTIMOS, 1 },
+		{ "last 5", LOG_CONSULTA_ULTIMOS, 5 },
+		{ "last guardados", LOG_CONSULTA_ULTIMOS, guardados },
+		{ "last 1000000", LOG_CONSULTA_ULTIMOS, 1000000 },
+		{ "since 0", LOG_CONSULTA_DESDE, 0 },
+		{ "since inicio-1", LOG_CONSULTA_DESDE, ix.inicio - 1 },
+		{ "since inicio", LOG_CONSULTA_DESDE, ix.inicio },
+		{ "since inicio+1", LOG_CONSULTA_DESDE, ix.inicio + 1 },
+		{ "since meio", LOG_CONSULTA_DESDE, ix.inicio + guardados / 2 },
+		{ "since proximo-1", LOG_CONSULTA_DESDE, ix.proximo - 1 },
+		{ "since proximo", LOG_CONSULTA_DESDE, ix.proximo },
+		{ "since proximo+100", LOG_CONSULTA_DESDE, ix.proximo + 100 },
+	};
+
+	std::printf("consulta registros paginas_lidas limite\n");
+	for (const Consulta &c : consultas) {
+		// Modelo: primeira sequencia pedida
+		uint32_t de = ix.inicio;
+		if (c.tipo == LOG_CONSULTA_ULTIMOS && guardados > c.arg) {
+			de = ix.proximo - c.arg;
+		} else if (c.tipo == LOG_CONSULTA_DESDE && c.arg > ix.inicio) {
+			de = (c.arg > ix.proximo) ? ix.proximo : c.arg;
+		}
+
+		std::vector<Esperado> esperado;
+		for (const Esperado &e : gravados) {
+			if (e.seq >= de && e.seq < ix.proximo) {
+				esperado.push_back(e);
+			}
+		}
+		uint32_t paginas_registros = 0;
+		for (size_t i = 0; i < esperado.size(); i++) {
+			if (i == 0 || esperado[i].pagina != esperado[i - 1].pagina) {
+				paginas_registros++;
+			}
+		}
+		uint32_t limite = (esperado.empty() ? 0 : teto_log2(paginas)) + paginas_registros;
+
+		Saida s;
+		lidas_eeprom = 0;
+		uint32_t lidas = historico_consulta(&ix, c.tipo, c.arg, le, emite, &s);
+		std::printf("\"%s\" %zu %lu %lu\n", c.nome, s.registros.size(), (unsigned long)lidas, (unsigned long)limite);
+
+		bool igual = s.registros.size() == esperado.size();
+		for (size_t i = 0; igual && i < esperado.size(); i++) {
+			igual = s.registros[i].seq == esperado[i].seq && s.registros[i].tempo == esperado[i].tempo
+					&& s.registros[i].texto == esperado[i].texto;
+		}
+		if (!igual) {
+			std::printf("\"%s\": registros diferentes do esperado\n", c.nome);
+			erros++;
+		}
+		if (lidas != lidas_eeprom || lidas > limite) {
+			std::printf("\"%s\": %lu paginas lidas (%lu contadas), limite %lu\n", c.nome, (unsigned long)lidas,
+					lidas_eeprom, (unsigned long)limite);
+			erros++;
+		}
+	}
+
+	// Boot: relido da EEPROM, o log continua do mesmo ponto
+	struct historico r;
+	historico_init(&r, (uint8_t)paginas, le, escreve);
+	if (!historico_carrega(&r) || std::memcmp(&r.indice, &h.indice, sizeof(r.indice)) != 0 || r.usado != h.usado) {
+		std::printf("releitura: indice diferente do gravado\n");
+		erros++;
+	}
+	return erros ? 1 : 0;
+}
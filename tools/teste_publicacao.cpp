@@ -0,0 +1,165 @@
+/**
+ * \file
+ * \brief Teste (host) da publicacao sem trava do estado do LED com varias threads
+ *
+ * Uma thread escritora publica sem parar, com publicacao.c, uma estrutura do tamanho de
+ * EstadoLed cujos campos derivam todos de um contador; varias threads leitoras leem com
+ * publicacao_le e conferem que cada copia lida e inteira (todos os campos do mesmo contador)
+ * e que o contador nunca volta. Para mostrar que o teste pega leituras rasgadas, a mesma
+ * carga roda tambem contra uma copia unica escrita sem sequencia, onde elas devem aparecer.
+ *
+ * Compilacao: gcc -O2 -c publicacao.c -o publicacao.o
+ *             g++ -std=c++11 -O2 -pthread -o teste_publicacao tools/teste_publicacao.cpp publicacao.o
+ * Uso:        teste_publicacao [leitores] [segundos]
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../publicacao.h"
+
+// Mesmo formato de EstadoLed em main.c, com os campos derivados de "n"
+struct Estado {
+	int brilho;
+	int frequencia;
+	int brilhaFlag;
+	int piscaFlag;
+	int piscaQtd;
+};
+
+static Estado estado_de(uint32_t n)
+{
+	Estado e;
+	e.brilho = (int)(n % 101);
+	e.frequencia = (int)n;
+	e.brilhaFlag = (int)(n & 1);
+	e.piscaFlag = (int)((n >> 1) & 1);
+	e.piscaQtd = (int)~n;
+	return e;
+}
+
+static bool inteiro(const Estado &e)
+{
+	Estado esperado = estado_de((uint32_t)e.frequencia);
+	return std::memcmp(&e, &esperado, sizeof(e)) == 0;
+}
+
+struct Resultado {
+	unsigned long leituras = 0;
+	unsigned long rasgadas = 0;
+	unsigned long voltas = 0;   // Contador menor que o lido antes
+};
+
+// Copia unica sem sequencia, so para comparacao
+static void escreve_ingenuo(volatile Estado *destino, const Estado &e)
+{
+	destino->brilho = e.brilho;
+	destino->frequencia = e.frequencia;
+	destino->brilhaFlag = e.brilhaFlag;
+	destino->piscaFlag = e.piscaFlag;
+	destino->piscaQtd = e.piscaQtd;
+}
+
+static void le_ingenuo(const volatile Estado *origem, Estado *e)
+{
+	e->brilho = origem->brilho;
+	e->frequencia = origem->frequencia;
+	e->brilhaFlag = origem->brilhaFlag;
+	e->piscaFlag = origem->piscaFlag;
+	e->piscaQtd = origem->piscaQtd;
+}
+
+static Resultado roda(bool com_sequencia, int leitores, int segundos, unsigned long *publicacoes)
+{
+	static Estado copias[2];
+	static volatile Estado unica;
+	struct publicacao pub = PUBLICACAO_INICIO(copias);
+	std::atomic<bool> parar(false);
+	std::vector<Resultado> parciais(leitores);
+	std::vector<std::thread> threads;
+	Estado inicial = estado_de(0);
+
+	publicacao_escreve(&pub, &inicial);
+	escreve_ingenuo(&unica, inicial);
+
+	for (int i = 0; i < leitores; i++) {
+		threads.emplace_back([&, i]() {
+			Resultado &r = parciais[i];
+			uint32_t ultimo = 0;
+			Estado e;
+			while (!parar.load(std::memory_order_relaxed)) {
+				if (com_sequencia) {
+					publicacao_le(&pub, &e);
+				} else {
+					le_ingenuo(&unica, &e);
+				}
+				r.leituras++;
+				if (!inteiro(e)) {
+					r.rasgadas++;
+					continue;
+				}
+				if ((int32_t)((uint32_t)e.frequencia - ultimo) < 0) {
+					r.voltas++;
+				}
+				ultimo = (uint32_t)e.frequencia;
+			}
+		});
+	}
+
+	uint32_t n = 0;
+	auto fim = std::chrono::steady_clock::now() + std::chrono::seconds(segundos);
+	while (std::chrono::steady_clock::now() < fim) {
+		for (int k = 0; k < 1000; k++) {
+			Estado e = estado_de(++n);
+			if (com_sequencia) {
+				publicacao_escreve(&pub, &e);
+			} else {
+				escreve_ingenuo(&unica, e);
+			}
+		}
+	}
+	parar = true;
+	for (std::thread &t : threads) {
+		t.join();
+	}
+
+	Resultado total;
+	for (const Resultado &r : parciais) {
+		total.leituras += r.leituras;
+		total.rasgadas += r.rasgadas;
+		total.voltas += r.voltas;
+	}
+	*publicacoes = n;
+	return total;
+}
+
+int main(int argc, char **argv)
+{
+	int leitores = (argc > 1) ? std::atoi(argv[1]) : 3;
+	int segundos = (argc > 2) ? std::atoi(argv[2]) : 2;
+	int erros = 0;
+
+	std::printf("modo publicacoes leituras rasgadas voltas\n");
+	for (int com_sequencia = 1; com_sequencia >= 0; com_sequencia--) {
+		unsigned long publicacoes;
+		Resultado r = roda(com_sequencia != 0, leitores, segundos, &publicacoes);
+		const char *modo = com_sequencia ? "publicacao" : "copia_unica";
+
+		std::printf("%s %lu %lu %lu %lu\n", modo, publicacoes, r.leituras, r.rasgadas, r.voltas);
+		if (com_sequencia && (r.rasgadas != 0 || r.voltas != 0 || r.leituras == 0)) {
+			std::printf("%s: leituras inconsistentes\n", modo);
+			erros++;
+		}
+		if (!com_sequencia && r.rasgadas == 0) {
+			// Com um so nucleo no host as threads quase nao se intercalam: so avisa
+			std::printf("%s: nenhuma leitura rasgada (o teste nao conseguiu provocar a corrida)\n", modo);
+		}
+	}
+	return erros ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+/**
+ * \file
+ * \brief Teste (host) do relogio de parede atravessando a volta de 2^32 do RTC
+ *
+ * Liga relogio.c a um RTC simulado (energia_get_rtc64 deste programa, com a parte baixa de 32
+ * bits que o firmware guarda como marca) e confere:
+ *  - relogio_set perto da volta e relogio_ms avancando exatamente o tempo do RTC ao atravessa-la;
+ *  - relogio_ms_de_rtc de marcas de 32 bits tiradas antes da volta e lidas depois, ate quase
+ *    2^32 contagens (~36 horas) de idade;
+ *  - relogio_set depois da volta e um acerto para tras;
+ *  - relogio_texto ("<segundos>.<ms>") nos limites e truncado, e a linha do "time".
+ *
+ * Compilacao: gcc -O2 -c relogio.c formata.c publicacao.c
+ *             g++ -std=c++11 -O2 -o teste_relogio tools/teste_relogio.cpp relogio.o formata.o publicacao.o
+ * Uso:        teste_relogio
+ */
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../relogio.h"
+
+// RTC simulado, em contagens de 32,768 kHz desde o boot
+static uint64_t rtc;
+static std::string saida;
+
+extern "C" uint64_t energia_get_rtc64(void)
+{
+	return rtc;
+}
+
+extern "C" int console_printf(const char *formato, ...)
+{
+	char texto[128];
+	va_list args;
+
+	va_start(args, formato);
+	int n = std::vsnprintf(texto, sizeof(texto), formato, args);
+	va_end(args);
+	saida += texto;
+	return n;
+}
+
+static int erros;
+
+static void confere(bool ok, const char *o_que, unsigned long long obtido, unsigned long long esperado)
+{
+	if (!ok) {
+		std::printf("%s: %llu, esperado %llu\n", o_que, obtido, esperado);
+		erros++;
+	}
+}
+
+static void confere_igual(uint64_t obtido, uint64_t esperado, const char *o_que)
+{
+	confere(obtido == esperado, o_que, obtido, esperado);
+}
+
+static void confere_texto(uint64_t ms, int tam, const char *esperado)
+{
+	char texto[RELOGIO_TEXTO_TAM + 8];
+
+	std::memset(texto, '#', sizeof(texto));
+	relogio_texto(ms, texto, tam);
+	if (std::strcmp(texto, esperado) != 0 || texto[tam] != '#') {
+		std::printf("relogio_texto(%llu, %d): \"%s\", esperado \"%s\"\n", (unsigned long long)ms, tam, texto, esperado);
+		erros++;
+	}
+}
+
+// ms do RTC como o relogio calcula (contagens * 1000 / 32768, truncado)
+static uint64_t ms_de(uint64_t contagens)
+{
+	return contagens * 1000 / 32768;
+}
+
+int main()
+{
+	const uint64_t volta = 1ULL << 32;
+	const uint32_t epoch = 1700000000;
+
+	// Sem acerto o relogio conta do boot
+	rtc = 32768 * 5 + 16384;
+	confere(!relogio_get_acertado(), "acertado antes do time set", 1, 0);
+	confere_igual(relogio_ms(), 5500, "relogio_ms sem acerto");
+
+	// Acerto 10 s antes da volta (o RTC ja esta em ~36 horas de boot)
+	rtc = volta - 32768 * 10;
+	relogio_set(epoch);
+	confere_igual(relogio_ms(), (uint64_t)epoch * 1000, "relogio_ms logo apos o time set");
+	uint32_t marca_antes = (uint32_t)rtc;
+	uint64_t ms_antes = relogio_ms();
+
+	// Atravessa a volta: o tempo de parede anda o mesmo que o RTC de 64 bits
+	for (uint64_t passo : { 1ULL, 32767ULL, 32768ULL * 10 - 1, 32768ULL * 10, 32768ULL * 10 + 1, 32768ULL * 3600 }) {
+		rtc = volta - 32768 * 10 + passo;
+		uint64_t esperado = (uint64_t)epoch * 1000 + ms_de(volta - 32768 * 10 + passo) - ms_de(volta - 32768 * 10);
+		confere_igual(relogio_ms(), esperado, "relogio_ms atravessando a volta");
+		confere_igual(relogio_ms_de_rtc((uint32_t)rtc), relogio_ms(), "marca do instante atual");
+		confere_igual(relogio_ms_de_rtc(marca_antes), ms_antes, "marca de antes da volta");
+	}
+
+	// Marca com quase 2^32 contagens de idade ainda volta para o instante certo
+	rtc = volta - 32768 * 10 + volta - 1;
+	confere_igual(relogio_ms_de_rtc(marca_antes), ms_antes, "marca com 2^32 - 1 contagens de idade");
+
+	// Acerto depois da volta e acerto para tras (o relogio segue o ultimo time set)
+	rtc = volta + 12345;
+	relogio_set(epoch + 100);
+	confere_igual(relogio_ms(), (uint64_t)(epoch + 100) * 1000, "time set depois da volta");
+	rtc += 32768;
+	confere_igual(relogio_ms(), (uint64_t)(epoch + 101) * 1000, "um segundo depois do time set");
+	relogio_set(epoch - 3600);
+	confere_igual(relogio_ms(), (uint64_t)(epoch - 3600) * 1000, "time set para tras");
+	confere(relogio_get_acertado(), "acertado depois do time set", 0, 1);
+
+	// Formato "<segundos>.<ms>"
+	confere_texto(0, RELOGIO_TEXTO_TAM, "0.000");
+	confere_texto(7, RELOGIO_TEXTO_TAM, "0.007");
+	confere_texto(999, RELOGIO_TEXTO_TAM, "0.999");
+	confere_texto(1000, RELOGIO_TEXTO_TAM, "1.000");
+	confere_texto(1700000000123ULL, RELOGIO_TEXTO_TAM, "1700000000.123");
+	confere_texto(4294967295999ULL, RELOGIO_TEXTO_TAM, "4294967295.999");
+	confere_texto(1700000000123ULL, 8, "1700000");
+	confere_texto(1700000000123ULL, 1, "");
+
+	saida.clear();
+	relogio_imprime();
+	if (saida != "time 1699996400.000 acertado\n") {
+		std::printf("relogio_imprime: \"%s\"\n", saida.c_str());
+		erros++;
+	}
+
+	std::printf("erros %d\n", erros);
+	return erros ? 1 : 0;
+}
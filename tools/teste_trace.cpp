@@ -0,0 +1,271 @@
+/**
+ * \file
+ * \brief Teste (host) do trace: ganchos de trace.h, formato do "trace dump" e tools/trace2json.cpp
+ *
+ * Expande os ganchos do kernel de trace.h sobre TCBs e filas de mentira num padrao de disputa
+ * que se repete a cada rodada: RecebeComando toma a travaConsole, a interrupcao do console poe
+ * uma linha na comandoQueue, SetaComando (prioridade maior) entra, bloqueia no mutex e empresta
+ * a prioridade, RecebeComando devolve o mutex, SetaComando o toma, devolve e volta a esperar a
+ * fila, e a IDLE entra. Os intervalos entre eventos sao sorteados e o contador de 32 bits
+ * comeca perto da volta. Os eventos vao para um buffer circular como o de trace.c e saem no
+ * formato do trace_descarrega(); o dump passa pelo trace2json e o teste confere, no JSON, os
+ * pares B/E de cada periodo de tarefa, de cada espera pelo mutex e da interrupcao, nos tempos
+ * dos eventos.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o trace2json tools/trace2json.cpp
+ *             g++ -std=c++11 -O2 -o teste_trace tools/teste_trace.cpp
+ * Uso:        teste_trace [trace2json] [rodadas] [-v]
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../trace.h"
+
+static const unsigned long HZ = 187500; // Contador de estatisticas (GCLK0/256)
+
+// Campos do TCB e da fila que os ganchos usam
+struct Tcb {
+	unsigned uxTCBNumber;
+	const char *nome;
+};
+
+struct Fila {
+	unsigned uxQueueNumber;
+	uint8_t ucQueueType;  // 1 = mutex, como queueQUEUE_TYPE_MUTEX
+	const char *nome;
+};
+
+static Tcb *pxCurrentTCB;
+
+// Buffer circular e contador, como em trace.c
+struct Evento {
+	uint32_t tempo;
+	uint8_t evento;
+	uint8_t objeto;
+	uint8_t extra;
+};
+
+static Evento buffer[CONF_TRACE_TAM];
+static uint32_t total;
+static uint32_t contador = 0xFFFFC000u; // A volta do contador cai no meio das rodadas
+
+void trace_registra(uint8_t evento, uint8_t objeto, uint8_t extra)
+{
+	Evento &e = buffer[total % CONF_TRACE_TAM];
+	e.tempo = contador;
+	e.evento = evento;
+	e.objeto = objeto;
+	e.extra = extra;
+	total++;
+}
+
+// Intervalo esperado no JSON
+struct Intervalo {
+	std::string nome;
+	char ph;
+	int tid;
+	double ts;
+};
+
+static std::vector<Intervalo> esperados;
+static uint32_t primeiro_tempo;
+static const Tcb *rodando;
+
+static double us_agora()
+{
+	return (double)(uint32_t)(contador - primeiro_tempo) * 1e6 / (double)HZ;
+}
+
+static void espera(const Intervalo &i)
+{
+	esperados.push_back(i);
+}
+
+static void troca(Tcb *t)
+{
+	if (total == 0) {
+		primeiro_tempo = contador;
+	}
+	pxCurrentTCB = t;
+	traceTASK_SWITCHED_IN();
+	if (rodando != nullptr) {
+		espera(Intervalo{ rodando->nome, 'E', (int)rodando->uxTCBNumber, us_agora() });
+	}
+	rodando = t;
+	espera(Intervalo{ t->nome, 'B', (int)t->uxTCBNumber, us_agora() });
+}
+
+// Le "name", "ph", "tid" e "ts" de uma linha de evento do trace2json
+static bool le_evento(const char *linha, Intervalo &i)
+{
+	const char *n = std::strstr(linha, "\"name\": \"");
+	const char *p = std::strstr(linha, "\"ph\": \"");
+	const char *t = std::strstr(linha, "\"tid\": ");
+	const char *s = std::strstr(linha, "\"ts\": ");
+
+	if (n == nullptr || p == nullptr || t == nullptr || s == nullptr) {
+		return false;
+	}
+	n += 9;
+	i.nome.assign(n, std::strchr(n, '"') - n);
+	i.ph = p[7];
+	i.tid = std::atoi(t + 7);
+	i.ts = std::atof(s + 6);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace2json = (argc > 1) ? argv[1] : "./trace2json";
+	int rodadas = (argc > 2) ? std::atoi(argv[2]) : 15;
+	bool verboso = (argc > 3) && std::strcmp(argv[3], "-v") == 0;
+	Tcb recebe = { 1, "RecebeComando" }, seta = { 2, "SetaComando" }, idle = { 3, "IDLE" };
+	Fila fila = { 1, 0, "comandoQueue" }, trava = { 2, 1, "travaConsole" };
+	std::mt19937 sorteio(33);
+	std::uniform_int_distribution<uint32_t> passo(1, 400);
+	int erros = 0;
+
+	// Cada rodada grava 17 eventos; o dump tem de trazer todos para a conferencia
+	if (rodadas < 1 || rodadas * 17 > CONF_TRACE_TAM) {
+		std::fprintf(stderr, "rodadas: de 1 a %d (CONF_TRACE_TAM)\n", CONF_TRACE_TAM / 17);
+		return 2;
+	}
+
+	for (int r = 0; r < rodadas; r++) {
+		troca(&recebe);
+		contador += passo(sorteio);
+		traceQUEUE_RECEIVE(&trava);
+
+		contador += passo(sorteio);
+		TRACE_ISR_ENTRA_EM(TRACE_ISR_CONSOLE);
+		espera(Intervalo{ "isr1", 'B', 1000 + TRACE_ISR_CONSOLE, us_agora() });
+		contador += passo(sorteio);
+		traceQUEUE_SEND_FROM_ISR(&fila);
+		contador += passo(sorteio);
+		TRACE_ISR_SAI_DE(TRACE_ISR_CONSOLE);
+		espera(Intervalo{ "isr1", 'E', 1000 + TRACE_ISR_CONSOLE, us_agora() });
+
+		// SetaComando acorda com a linha e disputa a travaConsole
+		troca(&seta);
+		contador += passo(sorteio);
+		traceQUEUE_RECEIVE(&fila);
+		contador += passo(sorteio);
+		traceBLOCKING_ON_QUEUE_RECEIVE(&trava);
+		espera(Intervalo{ "espera travaConsole", 'B', 2000 + 2, us_agora() });
+		traceTASK_PRIORITY_INHERIT(&recebe, 2);
+		troca(&recebe);
+		contador += passo(sorteio);
+		traceQUEUE_SEND(&trava);
+		traceTASK_PRIORITY_DISINHERIT(&recebe, 1);
+		troca(&seta);
+		contador += passo(sorteio);
+		traceQUEUE_RECEIVE(&trava);
+		espera(Intervalo{ "espera travaConsole", 'E', 2000 + 2, us_agora() });
+		contador += passo(sorteio);
+		traceQUEUE_SEND(&trava);
+		contador += passo(sorteio);
+		traceBLOCKING_ON_QUEUE_RECEIVE(&fila);
+		troca(&idle);
+		contador += passo(sorteio);
+	}
+	// O ultimo periodo fecha no ultimo evento, no "trace fim"
+	espera(Intervalo{ "IDLE", 'E', 3, (double)(uint32_t)(buffer[(total - 1) % CONF_TRACE_TAM].tempo
+			- primeiro_tempo) * 1e6 / (double)HZ });
+
+	// Dump no formato do trace_descarrega()
+	char arquivo[] = "/tmp/teste_traceXXXXXX";
+	int fd = mkstemp(arquivo);
+	FILE *dump = (fd >= 0) ? fdopen(fd, "w") : nullptr;
+	if (dump == nullptr) {
+		std::perror("mkstemp");
+		return 1;
+	}
+	std::fprintf(dump, "trace inicio %lu %lu %lu\n", (unsigned long)total, 0UL, HZ);
+	std::fprintf(dump, "relogio 1000.000 %lu\n", (unsigned long)contador);
+	for (const Tcb *t : { &recebe, &seta, &idle }) {
+		std::fprintf(dump, "tarefa %u %s\n", t->uxTCBNumber, t->nome);
+	}
+	for (const Fila *f : { &fila, &trava }) {
+		std::fprintf(dump, "fila %u %s\n", f->uxQueueNumber, f->nome);
+	}
+	for (uint32_t i = 0; i < total; i++) {
+		const Evento &e = buffer[i % CONF_TRACE_TAM];
+		std::fprintf(dump, "e %lu %u %u %u\n", (unsigned long)e.tempo, e.evento, e.objeto, e.extra);
+	}
+	std::fprintf(dump, "trace fim\n");
+	std::fclose(dump);
+
+	if (verboso) {
+		FILE *f = std::fopen(arquivo, "r");
+		char linha[256];
+		while (f != nullptr && std::fgets(linha, sizeof(linha), f) != nullptr) {
+			std::fputs(linha, stdout);
+		}
+		if (f != nullptr) {
+			std::fclose(f);
+		}
+	}
+
+	// Converte e compara os intervalos B/E, na ordem
+	std::string comando = std::string(trace2json) + " " + arquivo;
+	FILE *json = popen(comando.c_str(), "r");
+	std::vector<Intervalo> lidos;
+	char linha[512];
+	unsigned long instantes = 0;
+	if (json == nullptr) {
+		std::perror(trace2json);
+		std::remove(arquivo);
+		return 1;
+	}
+	while (std::fgets(linha, sizeof(linha), json) != nullptr) {
+		Intervalo i;
+		if (!le_evento(linha, i)) {
+			continue;
+		}
+		if (i.ph == 'B' || i.ph == 'E') {
+			lidos.push_back(i);
+		} else if (i.ph == 'i') {
+			instantes++;
+		}
+	}
+	int rc = pclose(json);
+	std::remove(arquivo);
+	if (rc != 0) {
+		std::printf("%s terminou com %d\n", trace2json, rc);
+		return 1;
+	}
+
+	for (size_t k = 0; k < std::max(lidos.size(), esperados.size()); k++) {
+		if (k >= lidos.size() || k >= esperados.size()) {
+			std::printf("intervalo %zu: %s\n", k, (k >= lidos.size()) ? "faltando no JSON" : "sobrando no JSON");
+			erros++;
+			break;
+		}
+		const Intervalo &a = lidos[k], &b = esperados[k];
+		if (a.nome != b.nome || a.ph != b.ph || a.tid != b.tid || std::fabs(a.ts - b.ts) > 0.002) {
+			std::printf("intervalo %zu: %s %c tid %d ts %.3f, esperado %s %c tid %d ts %.3f\n", k,
+					a.nome.c_str(), a.ph, a.tid, a.ts, b.nome.c_str(), b.ph, b.tid, b.ts);
+			erros++;
+			break;
+		}
+	}
+
+	// Marcas: take e give do mutex (cinco por rodada), a fila (tres), a heranca (duas) e o relogio
+	if (instantes != (unsigned long)rodadas * 10 + 1) {
+		std::printf("marcas instantaneas: %lu, esperadas %lu\n", instantes, (unsigned long)rodadas * 10 + 1);
+		erros++;
+	}
+
+	std::printf("rodadas %d eventos %lu intervalos %zu marcas %lu erros %d\n", rodadas, (unsigned long)total,
+			lidos.size(), instantes, erros);
+	return erros ? 1 : 0;
+}
@@ -0,0 +1,269 @@
+/**
+ * \file
+ * \brief Conversor do "trace dump" para eventos do Chrome (host)
+ *
+ * Le a saida do console com um ou mais dumps do trace e gera o JSON de eventos aceito pelo
+ * chrome://tracing e pelo Perfetto: cada tarefa vira uma linha do tempo com os periodos em
+ * que esteve executando (pares B/E, um a cada troca de tarefa), operacoes em mutex/filas
+ * aparecem como marcas instantaneas, a espera de uma tarefa por um mutex vira um intervalo B/E
+ * numa linha "<tarefa> espera" e interrupcoes viram intervalos em linhas proprias. Linhas que
+ * nao sao do trace sao ignoradas. O tools/teste_trace.cpp confere a conversao.
+ *
+ * Compilacao: g++ -std=c++11 -O2 -o trace2json tools/trace2json.cpp
+ * Uso:        trace2json [captura.txt] > trace.json
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "../trace.h"
+
+#define TID_ISR_BASE    1000 // Linhas das interrupcoes, depois das tarefas
+#define TID_ESPERA_BASE 2000 // Linhas das esperas por mutex, uma por tarefa
+
+static std::map<unsigned, std::string> tarefas;
+static std::map<unsigned, std::string> filas;
+static std::map<int, unsigned> esperas; // Tarefa (tid) -> mutex pelo qual esta bloqueada
+static bool primeiro_evento = true;
+
+static void emite(const char *json)
+{
+	std::printf("%s\n  %s", primeiro_evento ? "" : ",", json);
+	primeiro_evento = false;
+}
+
+static std::string nome_fila(unsigned num)
+{
+	std::map<unsigned, std::string>::const_iterator it = filas.find(num);
+	if (it != filas.end()) {
+		return it->second;
+	}
+	return "fila" + std::to_string(num);
+}
+
+static std::string nome_tarefa(unsigned num)
+{
+	std::map<unsigned, std::string>::const_iterator it = tarefas.find(num);
+	if (it != tarefas.end()) {
+		return it->second;
+	}
+	return "tarefa" + std::to_string(num);
+}
+
+static void emite_intervalo(const char *nome, bool inicio, int tid, double us)
+{
+	char json[256];
+
+	std::snprintf(json, sizeof(json), "{\"name\": \"%s\", \"ph\": \"%s\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f}",
+			nome, inicio ? "B" : "E", tid, us);
+	emite(json);
+}
+
+static void termina_espera(int tid, double us)
+{
+	std::map<int, unsigned>::iterator it = esperas.find(tid);
+	if (it != esperas.end()) {
+		emite_intervalo(("espera " + nome_fila(it->second)).c_str(), false, TID_ESPERA_BASE + tid, us);
+		esperas.erase(it);
+	}
+}
+
+// Nome da operacao em uma fila; para mutex (tipo 1) usa take/give
+static const char *nome_operacao(unsigned evento, unsigned tipo)
+{
+	bool mutex = (tipo == 1);
+
+	switch (evento) {
+	case TRACE_FILA_ENVIA:        return mutex ? "give" : "envia";
+	case TRACE_FILA_RECEBE:       return mutex ? "take" : "recebe";
+	case TRACE_FILA_BLOQUEIA_ENV: return "bloqueia envio";
+	case TRACE_FILA_BLOQUEIA_REC: return mutex ? "espera" : "bloqueia recepcao";
+	case TRACE_FILA_FALHA_REC:    return "timeout";
+	case TRACE_FILA_ENVIA_ISR:    return mutex ? "give isr" : "envia isr";
+	case TRACE_FILA_RECEBE_ISR:   return mutex ? "take isr" : "recebe isr";
+	}
+	return "?";
+}
+
+int main(int argc, char **argv)
+{
+	FILE *entrada = stdin;
+	char linha[256];
+	char nome[128];
+	char json[512];
+	unsigned long hz = 1;
+	unsigned long num;
+	unsigned long tempo;
+	unsigned evento, objeto, extra;
+	uint32_t anterior = 0;
+	uint64_t acumulado = 0;
+	bool tem_anterior = false;
+	int rodando = -1;         // Tarefa em execucao (tid), -1 se nenhuma
+	double us = 0;            // Tempo do ultimo evento
+	int isr_atual = -1;       // Interrupcao em andamento (tid), -1 se nenhuma
+	unsigned long dumps = 0;
+	double relogio = 0;                // Hora do RTC (s) no fim do dump, da linha "relogio"
+	unsigned long relogio_contador = 0; // Contador lido junto com a hora
+	bool tem_relogio = false;
+
+	if (argc > 1) {
+		entrada = std::fopen(argv[1], "r");
+		if (entrada == NULL) {
+			std::perror(argv[1]);
+			return 1;
+		}
+	}
+
+	std::printf("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+	while (std::fgets(linha, sizeof(linha), entrada) != NULL) {
+		unsigned long eventos, perdidos;
+
+		// Intervalos abertos fecham no ultimo evento do dump, para os B/E ficarem casados
+		if (std::strncmp(linha, "trace fim", 9) == 0 || std::strncmp(linha, "trace inicio", 12) == 0) {
+			if (rodando >= 0) {
+				emite_intervalo(nome_tarefa(rodando).c_str(), false, rodando, us);
+				rodando = -1;
+			}
+			while (!esperas.empty()) {
+				termina_espera(esperas.begin()->first, us);
+			}
+			if (isr_atual >= 0) {
+				std::snprintf(nome, sizeof(nome), "isr%d", isr_atual - TID_ISR_BASE);
+				emite_intervalo(nome, false, isr_atual, us);
+				isr_atual = -1;
+			}
+		}
+
+		if (std::sscanf(linha, "trace inicio %lu %lu %lu", &eventos, &perdidos, &hz) == 3) {
+			if (hz == 0) {
+				hz = 1;
+			}
+			// Dumps seguidos nao tem relacao de tempo entre si: cada um comeca do zero
+			tem_anterior = false;
+			tem_relogio = false;
+			acumulado = 0;
+			rodando = -1;
+			isr_atual = -1;
+			dumps++;
+			if (perdidos > 0) {
+				std::fprintf(stderr, "dump %lu: %lu eventos mais antigos sobrescritos\n",
+						dumps, perdidos);
+			}
+			continue;
+		}
+
+		if (std::sscanf(linha, "relogio %lf %lu", &relogio, &relogio_contador) == 2) {
+			tem_relogio = true;
+			continue;
+		}
+
+		if (std::sscanf(linha, "tarefa %lu %127s", &num, nome) == 2) {
+			if (tarefas.find(num) == tarefas.end()) {
+				tarefas[num] = nome;
+				std::snprintf(json, sizeof(json),
+						"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, "
+						"\"args\": {\"name\": \"%s\"}}", num, nome);
+				emite(json);
+				std::snprintf(json, sizeof(json),
+						"{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lu, "
+						"\"args\": {\"name\": \"%s espera\"}}", TID_ESPERA_BASE + num, nome);
+				emite(json);
+			}
+			continue;
+		}
+
+		if (std::sscanf(linha, "fila %lu %127s", &num, nome) == 2) {
+			filas[num] = nome;
+			continue;
+		}
+
+		if (std::sscanf(linha, "e %lu %u %u %u", &tempo, &evento, &objeto, &extra) != 4) {
+			continue;
+		}
+
+		// O contador e de 32 bits: acumula as diferencas para atravessar a volta
+		if (tem_anterior) {
+			acumulado += (uint32_t)((uint32_t)tempo - anterior);
+		} else if (tem_relogio) {
+			// Marca no inicio do dump a hora do RTC correspondente ao primeiro evento
+			double hora = relogio - (double)(uint32_t)(relogio_contador - (uint32_t)tempo) / (double)hz;
+			std::snprintf(json, sizeof(json),
+					"{\"name\": \"relogio %.3f\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, "
+					"\"tid\": 0, \"ts\": 0}", hora);
+			emite(json);
+		}
+		anterior = (uint32_t)tempo;
+		tem_anterior = true;
+		us = (double)acumulado * 1e6 / (double)hz;
+
+		if (evento == TRACE_TAREFA_ENTRA) {
+			if (rodando >= 0) {
+				emite_intervalo(nome_tarefa(rodando).c_str(), false, rodando, us);
+			}
+			rodando = (int)objeto;
+			emite_intervalo(nome_tarefa(rodando).c_str(), true, rodando, us);
+		}
+
+		else if (evento == TRACE_ISR_ENTRA || evento == TRACE_ISR_SAI) {
+			int tid = TID_ISR_BASE + (int)objeto;
+			if (evento == TRACE_ISR_ENTRA) {
+				isr_atual = tid;
+			} else {
+				isr_atual = -1;
+			}
+			std::snprintf(json, sizeof(json),
+					"{\"name\": \"isr%u\", \"ph\": \"%s\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f}",
+					objeto, (evento == TRACE_ISR_ENTRA) ? "B" : "E", tid, us);
+			emite(json);
+		}
+
+		else if (evento == TRACE_HERDA_PRIO || evento == TRACE_DEVOLVE_PRIO) {
+			std::snprintf(json, sizeof(json),
+					"{\"name\": \"%s prio %u\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+					"\"tid\": %u, \"ts\": %.3f}",
+					(evento == TRACE_HERDA_PRIO) ? "herda" : "devolve", extra, objeto, us);
+			emite(json);
+		}
+
+		else {
+			int tid = (isr_atual >= 0) ? isr_atual : (rodando >= 0 ? rodando : 0);
+
+			// A espera por um mutex vai do bloqueio ate a tarefa toma-lo (ou desistir)
+			if (extra == 1 && isr_atual < 0 && rodando >= 0) {
+				if (evento == TRACE_FILA_RECEBE || evento == TRACE_FILA_FALHA_REC) {
+					termina_espera(rodando, us);
+				}
+			}
+			std::snprintf(json, sizeof(json),
+					"{\"name\": \"%s %s\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+					"\"tid\": %d, \"ts\": %.3f}",
+					nome_operacao(evento, extra), nome_fila(objeto).c_str(), tid, us);
+			emite(json);
+			if (extra == 1 && isr_atual < 0 && rodando >= 0 && evento == TRACE_FILA_BLOQUEIA_REC) {
+				termina_espera(rodando, us);
+				esperas[rodando] = objeto;
+				emite_intervalo(("espera " + nome_fila(objeto)).c_str(), true, TID_ESPERA_BASE + rodando, us);
+			}
+		}
+	}
+
+	// Captura cortada antes do "trace fim": fecha o que ficou aberto no ultimo evento
+	if (rodando >= 0) {
+		emite_intervalo(nome_tarefa(rodando).c_str(), false, rodando, us);
+	}
+	while (!esperas.empty()) {
+		termina_espera(esperas.begin()->first, us);
+	}
+
+	std::printf("\n]}\n");
+
+	if (entrada != stdin) {
+		std::fclose(entrada);
+	}
+
+	return 0;
+}
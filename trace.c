@@ -0,0 +1,149 @@
+/**
+ * \file
+ * \brief Gravador de trace do escalonador em um buffer circular na RAM
+ */
+
+#include <asf.h>
+#include "console.h"
+#include "trace.h"
+#include "estatisticas.h"
+#include "relogio.h"
+
+#if (configUSE_TRACE_FACILITY != 1)
+#  error "trace.c precisa de configUSE_TRACE_FACILITY e do trace.h no FreeRTOSConfig.h"
+#endif
+
+#define TRACE_MAX_FILAS 8
+
+//! Um evento gravado
+struct trace_evento {
+	uint32_t tempo;  // Contador de estatisticas (TC)
+	uint8_t evento;
+	uint8_t objeto;
+	uint8_t extra;
+	uint8_t reservado;
+};
+
+static struct trace_evento trace_buffer[CONF_TRACE_TAM];
+
+//! Total de eventos gravados desde que o trace foi ligado; o mais antigo guardado e
+//! trace_total - CONF_TRACE_TAM quando o buffer ja deu a volta
+static volatile uint32_t trace_total;
+
+//! Comeca desligado: o contador so existe depois que o escalonador e iniciado
+static volatile bool trace_ativo;
+
+//! Nomes das filas, indexados pelo numero atribuido em trace_nomeia_fila()
+static const char *trace_filas[TRACE_MAX_FILAS + 1];
+static uint8_t trace_num_filas;
+
+//! Listagem das tarefas para o cabecalho do dump
+static TaskStatus_t trace_tarefas[ESTATISTICAS_MAX_TAREFAS];
+
+/**
+ * \brief Grava um evento
+ *
+ * Pode ser chamada do kernel (com ou sem interrupcoes mascaradas) e de interrupcoes, por
+ * isso usa a mascara "FROM_ISR", que pode ser aninhada.
+ */
+void trace_registra(uint8_t evento, uint8_t objeto, uint8_t extra)
+{
+	UBaseType_t mascara;
+	struct trace_evento *e;
+
+	if (!trace_ativo) {
+		return;
+	}
+
+	mascara = portSET_INTERRUPT_MASK_FROM_ISR();
+	e = &trace_buffer[trace_total % CONF_TRACE_TAM];
+	e->tempo  = estatisticas_get_contador();
+	e->evento = evento;
+	e->objeto = objeto;
+	e->extra  = extra;
+	trace_total++;
+	portCLEAR_INTERRUPT_MASK_FROM_ISR(mascara);
+}
+
+//! Liga o trace recomecando o buffer, ou desliga mantendo o que foi gravado
+void trace_set_ativo(bool ativo)
+{
+	if (ativo && !trace_ativo) {
+		trace_total = 0;
+	}
+	trace_ativo = ativo;
+}
+
+bool trace_get_ativo(void)
+{
+	return trace_ativo;
+}
+
+/**
+ * \brief Numera uma fila (ou mutex) e guarda o nome para o dump
+ *
+ * Filas nao nomeadas ficam com o numero 0.
+ */
+void trace_nomeia_fila(void *fila, const char *nome)
+{
+	if (trace_num_filas >= TRACE_MAX_FILAS) {
+		return;
+	}
+	trace_num_filas++;
+	trace_filas[trace_num_filas] = nome;
+	vQueueSetQueueNumber((QueueHandle_t)fila, trace_num_filas);
+}
+
+/**
+ * \brief Envia o buffer pelo console, do evento mais antigo ao mais recente
+ *
+ * A gravacao e pausada durante o envio, para que o proprio dump nao apareca no trace, e
+ * volta ao estado anterior no fim. Formato, uma informacao por linha:
+ *   trace inicio <eventos> <perdidos> <hz do contador>
+ *   relogio <segundos>.<ms> <contador>   (hora do RTC e contador lidos juntos, para alinhar com o host)
+ *   tarefa <numero> <nome>
+ *   fila <numero> <nome>
+ *   e <tempo> <evento> <objeto> <extra>
+ *   trace fim
+ */
+void trace_descarrega(void)
+{
+	bool estava_ativo = trace_ativo;
+	uint32_t total;
+	uint32_t primeiro;
+	uint32_t i;
+	UBaseType_t qtd;
+	UBaseType_t t;
+	char hora[RELOGIO_TEXTO_TAM];
+
+	trace_ativo = false;
+
+	total = trace_total;
+	primeiro = (total > CONF_TRACE_TAM) ? total - CONF_TRACE_TAM : 0;
+
+	console_printf("trace inicio %lu %lu %lu\n", total - primeiro, primeiro,
+			estatisticas_get_freq_contador());
+
+	relogio_texto(relogio_ms(), hora, sizeof(hora));
+	console_printf("relogio %s %lu\n", hora, estatisticas_get_contador());
+
+	qtd = uxTaskGetSystemState(trace_tarefas, ESTATISTICAS_MAX_TAREFAS, NULL);
+	for (t = 0; t < qtd; t++) {
+		console_printf("tarefa %lu %s\n", (uint32_t)trace_tarefas[t].xTaskNumber,
+				trace_tarefas[t].pcTaskName);
+	}
+	for (t = 1; t <= trace_num_filas; t++) {
+		console_printf("fila %lu %s\n", (uint32_t)t, trace_filas[t]);
+	}
+
+	for (i = primeiro; i < total; i++) {
+		struct trace_evento *e = &trace_buffer[i % CONF_TRACE_TAM];
+		console_printf("e %lu %u %u %u\n", e->tempo, e->evento, e->objeto, e->extra);
+	}
+
+	console_puts("trace fim\n");
+
+	if (estava_ativo) {
+		trace_set_ativo(true);
+	}
+}
@@ -0,0 +1,78 @@
+/**
+ * \file
+ * \brief Gravador de trace do escalonador em um buffer circular na RAM
+ *
+ * Registra trocas de tarefa, operacoes em mutex/filas, heranca de prioridade e entrada/saida
+ * de interrupcoes, com o tempo do contador de estatisticas (TC). O buffer guarda sempre os
+ * eventos mais recentes; o comando "trace dump" envia tudo pelo console em texto e o
+ * tools/trace2json.cpp converte para o formato de eventos do Chrome (chrome://tracing).
+ *
+ * Os ganchos do kernel sao macros trace* e precisam ser vistos pelo tasks.c e queue.c, entao
+ * este arquivo deve ser incluido no fim do FreeRTOSConfig.h:
+ *
+ *   #define configUSE_TRACE_FACILITY 1
+ *   #include "trace.h"
+ *
+ * Por isso ele nao inclui o asf.h e so usa tipos basicos.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef CONF_TRACE_TAM
+#  define CONF_TRACE_TAM 256 // Eventos guardados (8 bytes cada)
+#endif
+
+// Eventos
+#define TRACE_TAREFA_ENTRA      1 // objeto = numero da tarefa
+#define TRACE_FILA_ENVIA        2 // objeto = numero da fila, extra = tipo (1 = mutex)
+#define TRACE_FILA_RECEBE       3
+#define TRACE_FILA_BLOQUEIA_ENV 4
+#define TRACE_FILA_BLOQUEIA_REC 5
+#define TRACE_FILA_FALHA_REC    6 // Timeout esperando na fila
+#define TRACE_FILA_ENVIA_ISR    7
+#define TRACE_FILA_RECEBE_ISR   8
+#define TRACE_HERDA_PRIO        9 // objeto = tarefa que herdou, extra = nova prioridade
+#define TRACE_DEVOLVE_PRIO     10 // objeto = tarefa, extra = prioridade original
+#define TRACE_ISR_ENTRA        11 // objeto = identificador da interrupcao
+#define TRACE_ISR_SAI          12
+
+// Identificadores das interrupcoes instrumentadas
+#define TRACE_ISR_CONSOLE 1
+
+#ifndef __ASSEMBLER__
+
+void trace_registra(uint8_t evento, uint8_t objeto, uint8_t extra);
+void trace_set_ativo(bool ativo);
+bool trace_get_ativo(void);
+void trace_nomeia_fila(void *fila, const char *nome);
+void trace_descarrega(void);
+
+// Ganchos do kernel (expandidos dentro de tasks.c e queue.c)
+#define traceTASK_SWITCHED_IN() \
+	trace_registra(TRACE_TAREFA_ENTRA, (uint8_t)pxCurrentTCB->uxTCBNumber, 0)
+#define traceTASK_PRIORITY_INHERIT(pxTCB, uxPriority) \
+	trace_registra(TRACE_HERDA_PRIO, (uint8_t)(pxTCB)->uxTCBNumber, (uint8_t)(uxPriority))
+#define traceTASK_PRIORITY_DISINHERIT(pxTCB, uxOriginalPriority) \
+	trace_registra(TRACE_DEVOLVE_PRIO, (uint8_t)(pxTCB)->uxTCBNumber, (uint8_t)(uxOriginalPriority))
+
+#define TRACE_FILA(evento, pxQueue) \
+	trace_registra((evento), (uint8_t)(pxQueue)->uxQueueNumber, (pxQueue)->ucQueueType)
+#define traceQUEUE_SEND(pxQueue)                   TRACE_FILA(TRACE_FILA_ENVIA, pxQueue)
+#define traceQUEUE_RECEIVE(pxQueue)                TRACE_FILA(TRACE_FILA_RECEBE, pxQueue)
+#define traceBLOCKING_ON_QUEUE_SEND(pxQueue)       TRACE_FILA(TRACE_FILA_BLOQUEIA_ENV, pxQueue)
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue)    TRACE_FILA(TRACE_FILA_BLOQUEIA_REC, pxQueue)
+#define traceQUEUE_RECEIVE_FAILED(pxQueue)         TRACE_FILA(TRACE_FILA_FALHA_REC, pxQueue)
+#define traceQUEUE_SEND_FROM_ISR(pxQueue)          TRACE_FILA(TRACE_FILA_ENVIA_ISR, pxQueue)
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue)       TRACE_FILA(TRACE_FILA_RECEBE_ISR, pxQueue)
+
+// O kernel nao tem ganchos de interrupcao; cada tratador instrumentado chama estas macros
+#define TRACE_ISR_ENTRA_EM(id) trace_registra(TRACE_ISR_ENTRA, (id), 0)
+#define TRACE_ISR_SAI_DE(id)   trace_registra(TRACE_ISR_SAI, (id), 0)
+
+#endif // __ASSEMBLER__
+
+#endif // TRACE_H
@@ -0,0 +1,177 @@
+/**
+ * \file
+ * \brief Mutexes da aplicacao com contagem de disputa por tarefa
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "console.h"
+#include "travas.h"
+#include "trace.h"
+#include "estatisticas.h"
+
+#if (configUSE_TRACE_FACILITY != 1)
+#  error "travas.c precisa de configUSE_TRACE_FACILITY 1 no FreeRTOSConfig.h (uxTaskGetSystemState)"
+#endif
+
+static struct trava *travas[TRAVAS_MAX];
+static uint8_t travas_qtd;
+
+//! Usado para mostrar o nome das tarefas no relatorio
+static TaskStatus_t travas_tarefas[ESTATISTICAS_MAX_TAREFAS];
+
+/**
+ * \brief Cria o mutex da trava e a registra para o comando locks e para o trace
+ *
+ * \param trava Trava a iniciar (normalmente estatica)
+ * \param nome  Nome mostrado no relatorio e no "trace dump"
+ */
+void trava_init(struct trava *trava, const char *nome)
+{
+	memset(trava->uso, 0, sizeof(trava->uso));
+	trava->nome = nome;
+	trava->mutex = xSemaphoreCreateMutexStatic(&trava->mutex_buffer);
+	trace_nomeia_fila(trava->mutex, nome);
+
+	if (travas_qtd < TRAVAS_MAX) {
+		travas[travas_qtd++] = trava;
+	}
+}
+
+//! Slot da tarefa atual; o ultimo slot acumula as tarefas que nao couberam
+static struct trava_uso *trava_slot(struct trava *trava)
+{
+	TaskHandle_t tarefa = xTaskGetCurrentTaskHandle();
+	uint8_t i;
+
+	for (i = 0; i < CONF_TRAVAS_MAX_TAREFAS - 1; i++) {
+		if (trava->uso[i].tarefa == tarefa) {
+			return &trava->uso[i];
+		}
+		if (trava->uso[i].tarefa == NULL) {
+			trava->uso[i].tarefa = tarefa;
+			return &trava->uso[i];
+		}
+	}
+	return &trava->uso[CONF_TRAVAS_MAX_TAREFAS - 1];
+}
+
+/**
+ * \brief Toma a trava, bloqueando ate ela ficar livre
+ *
+ * A tentativa sem espera vem primeiro, entao o caminho sem disputa nao le o contador.
+ * Os numeros sao atualizados ja com a trava tomada, o que os protege.
+ */
+void trava_toma(struct trava *trava)
+{
+	struct trava_uso *uso;
+	uint32_t inicio;
+	uint32_t espera = 0;
+	bool disputada = false;
+
+	if (xSemaphoreTake(trava->mutex, 0) != pdTRUE) {
+		disputada = true;
+		inicio = estatisticas_get_contador();
+		xSemaphoreTake(trava->mutex, portMAX_DELAY);
+		espera = estatisticas_get_contador() - inicio;
+	}
+
+	uso = trava_slot(trava);
+	uso->tomadas++;
+	if (disputada) {
+		uso->disputadas++;
+		uso->espera += espera;
+		if (espera > uso->espera_max) {
+			uso->espera_max = espera;
+		}
+	}
+}
+
+/**
+ * \brief Toma a trava so se ela estiver livre, sem esperar
+ *
+ * Para quem nao pode bloquear (callbacks da tarefa dos timers). Uma tentativa que falha nao
+ * entra nos numeros: eles so podem ser atualizados com a trava tomada.
+ *
+ * \return true se a trava foi tomada
+ */
+bool trava_tenta(struct trava *trava)
+{
+	if (xSemaphoreTake(trava->mutex, 0) != pdTRUE) {
+		return false;
+	}
+	trava_slot(trava)->tomadas++;
+	return true;
+}
+
+void trava_libera(struct trava *trava)
+{
+	xSemaphoreGive(trava->mutex);
+}
+
+//! Converte contagens do contador de estatisticas para microssegundos
+static uint32_t travas_us(uint32_t contagens, uint32_t hz)
+{
+	return (uint32_t)(((uint64_t)contagens * 1000000) / hz);
+}
+
+//! Nome da tarefa com o handle dado, a partir da lista obtida em travas_imprime
+static const char *travas_nome_tarefa(TaskHandle_t tarefa, UBaseType_t qtd)
+{
+	UBaseType_t t;
+
+	if (tarefa == NULL) {
+		return "outras";
+	}
+	for (t = 0; t < qtd; t++) {
+		if (travas_tarefas[t].xHandle == tarefa) {
+			return travas_tarefas[t].pcTaskName;
+		}
+	}
+	return "?"; // Tarefa ja apagada (Inicializa)
+}
+
+/**
+ * \brief Imprime o uso de cada trava por tarefa
+ *
+ *   trava tarefa tomadas disputadas espera_us espera_max_us
+ *   <trava> <tarefa> <tomadas> <disputadas> <espera> <espera_max>
+ */
+void travas_imprime(void)
+{
+	struct trava_uso copia[CONF_TRAVAS_MAX_TAREFAS];
+	uint32_t hz = estatisticas_get_freq_contador();
+	UBaseType_t qtd;
+	uint8_t i, u;
+
+	qtd = uxTaskGetSystemState(travas_tarefas, ESTATISTICAS_MAX_TAREFAS, NULL);
+
+	console_puts("trava tarefa tomadas disputadas espera_us espera_max_us\n");
+	for (i = 0; i < travas_qtd; i++) {
+		taskENTER_CRITICAL();
+		memcpy(copia, travas[i]->uso, sizeof(copia));
+		taskEXIT_CRITICAL();
+
+		for (u = 0; u < CONF_TRAVAS_MAX_TAREFAS; u++) {
+			if (copia[u].tomadas == 0) {
+				continue;
+			}
+			console_printf("%s %s %lu %lu %lu %lu\n", travas[i]->nome,
+					travas_nome_tarefa(copia[u].tarefa, qtd), copia[u].tomadas,
+					copia[u].disputadas, travas_us(copia[u].espera, hz),
+					travas_us(copia[u].espera_max, hz));
+		}
+	}
+}
+
+//! Zera os numeros de todas as travas
+void travas_zera(void)
+{
+	uint8_t i;
+
+	taskENTER_CRITICAL();
+	for (i = 0; i < travas_qtd; i++) {
+		memset(travas[i]->uso, 0, sizeof(travas[i]->uso));
+	}
+	taskEXIT_CRITICAL();
+}
@@ -0,0 +1,47 @@
+/**
+ * \file
+ * \brief Mutexes da aplicacao com contagem de disputa por tarefa
+ *
+ * Cada trava e um mutex estatico do FreeRTOS que registra, para cada tarefa que a toma,
+ * quantas vezes ela foi tomada, quantas vezes a tarefa precisou esperar e o tempo de espera
+ * (total e maximo) medido com o contador de estatisticas (TC). O comando "locks" imprime os
+ * numeros e "locks reset" os zera.
+ *
+ * As tarefas sao identificadas pelo handle; o relatorio acha os nomes com uxTaskGetSystemState,
+ * que exige configUSE_TRACE_FACILITY 1 no FreeRTOSConfig.h.
+ */
+
+#ifndef TRAVAS_H
+#define TRAVAS_H
+
+#include <asf.h>
+
+#ifndef CONF_TRAVAS_MAX_TAREFAS
+#  define CONF_TRAVAS_MAX_TAREFAS 5 // Tarefas contadas separadamente em cada trava; as demais vao para "outras"
+#endif
+#define TRAVAS_MAX 4                // Travas listadas pelo comando locks
+
+//! Uso de uma trava por uma tarefa (tempos em contagens do contador de estatisticas)
+struct trava_uso {
+	TaskHandle_t tarefa;  // Handle da tarefa (NULL = slot livre ou "outras")
+	uint32_t tomadas;
+	uint32_t disputadas;  // Vezes em que a trava estava com outra tarefa
+	uint32_t espera;
+	uint32_t espera_max;
+};
+
+struct trava {
+	SemaphoreHandle_t mutex;
+	StaticSemaphore_t mutex_buffer;
+	const char *nome;
+	struct trava_uso uso[CONF_TRAVAS_MAX_TAREFAS];
+};
+
+void trava_init(struct trava *trava, const char *nome);
+void trava_toma(struct trava *trava);
+bool trava_tenta(struct trava *trava);
+void trava_libera(struct trava *trava);
+void travas_imprime(void);
+void travas_zera(void);
+
+#endif // TRAVAS_H
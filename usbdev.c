@@ -0,0 +1,243 @@
+/**
+ * \file
+ * \brief Camada de endpoints da USB nativa do SAMD21
+ */
+
+#include <asf.h>
+#include <string.h>
+#include "console.h"
+#include "usbdev.h"
+#include "cdc.h"
+#include "trace.h"
+
+// So entra no firmware com o console na USB; com a USART a interrupcao da USB fica livre
+#if CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
+
+#define USBDEV_EPS 4 // Endpoint 0 e os tres da classe CDC
+
+// Tipos de banco em EPCFG. Em um endpoint com dois bancos, o tipo 5 no banco do outro
+// sentido o transforma no segundo banco do ping-pong
+#define EPTIPO_DESLIGADO 0
+#define EPTIPO_CONTROLE  1
+#define EPTIPO_BULK      3
+#define EPTIPO_INTERRUPT 4
+#define EPTIPO_DUPLO     5
+
+// Tamanho do pacote em PCKSIZE.SIZE
+#define PCKSIZE_8  0
+#define PCKSIZE_64 3
+
+//! Descritores dos bancos, lidos pelo DMA da USB (endereco em DESCADD)
+COMPILER_WORD_ALIGNED
+static UsbDeviceDescriptor usbdev_desc[USBDEV_EPS];
+
+//! Tamanho do pacote (codigo de PCKSIZE.SIZE) de cada endpoint
+static const uint8_t usbdev_pcksize[USBDEV_EPS] = { PCKSIZE_64, PCKSIZE_64, PCKSIZE_64, PCKSIZE_8 };
+
+//! Proximo banco a completar nos endpoints de dois bancos; o hardware os alterna em ordem
+static uint8_t usbdev_proximo[USBDEV_EPS];
+
+static void usbdev_trata(void);
+
+/**
+ * \brief Liga a USB nativa em modo device e conecta ao host
+ *
+ * cdc_init() deve ser chamada antes: o primeiro reset do barramento ja vai para a classe.
+ */
+void usbdev_init(void)
+{
+	struct system_pinmux_config config_pino;
+	struct system_gclk_chan_config config_gclk;
+	uint32_t transn, transp, trim;
+
+	// D-/D+ em PA24/PA25
+	system_pinmux_get_config_defaults(&config_pino);
+	config_pino.mux_position = MUX_PA24G_USB_DM;
+	system_pinmux_pin_set_config(PIN_PA24G_USB_DM, &config_pino);
+	config_pino.mux_position = MUX_PA25G_USB_DP;
+	system_pinmux_pin_set_config(PIN_PA25G_USB_DP, &config_pino);
+
+	system_apb_clock_set_mask(SYSTEM_CLOCK_APB_APBB, PM_APBBMASK_USB);
+	system_gclk_chan_get_config_defaults(&config_gclk);
+	config_gclk.source_generator = CONF_USB_GCLK;
+	system_gclk_chan_set_config(USB_GCLK_ID, &config_gclk);
+	system_gclk_chan_enable(USB_GCLK_ID);
+
+	USB->DEVICE.CTRLA.reg = USB_CTRLA_SWRST;
+	while (USB->DEVICE.SYNCBUSY.reg & USB_SYNCBUSY_SWRST) {
+	}
+
+	// Calibracao dos pads gravada na fabrica (valores padrao se a area estiver apagada)
+	transn = (*((uint32_t *)USB_FUSES_TRANSN_ADDR) & USB_FUSES_TRANSN_Msk) >> USB_FUSES_TRANSN_Pos;
+	transp = (*((uint32_t *)USB_FUSES_TRANSP_ADDR) & USB_FUSES_TRANSP_Msk) >> USB_FUSES_TRANSP_Pos;
+	trim = (*((uint32_t *)USB_FUSES_TRIM_ADDR) & USB_FUSES_TRIM_Msk) >> USB_FUSES_TRIM_Pos;
+	if (transn == 0x1F) {
+		transn = 5;
+	}
+	if (transp == 0x1F) {
+		transp = 29;
+	}
+	if (trim == 0x7) {
+		trim = 3;
+	}
+	USB->DEVICE.PADCAL.reg = USB_PADCAL_TRANSN(transn) | USB_PADCAL_TRANSP(transp) | USB_PADCAL_TRIM(trim);
+
+	memset(usbdev_desc, 0, sizeof(usbdev_desc));
+	USB->DEVICE.DESCADD.reg = (uint32_t)usbdev_desc;
+	USB->DEVICE.CTRLA.reg = USB_CTRLA_MODE_DEVICE | USB_CTRLA_RUNSTDBY | USB_CTRLA_ENABLE;
+	while (USB->DEVICE.SYNCBUSY.reg & USB_SYNCBUSY_ENABLE) {
+	}
+
+	// Full-speed; tirar DETACH liga o pull-up de D+ e o host enxerga o dispositivo
+	USB->DEVICE.CTRLB.reg = USB_DEVICE_CTRLB_SPDCONF_FS;
+	USB->DEVICE.INTENSET.reg = USB_DEVICE_INTENSET_EORST;
+	system_interrupt_enable(SYSTEM_INTERRUPT_MODULE_USB);
+}
+
+//! Configura um endpoint com os tipos dos dois bancos e habilita as interrupcoes de transferencia
+static void usbdev_ep_configura(uint8_t ep, uint8_t tipo0, uint8_t tipo1)
+{
+	UsbDeviceEndpoint *hw = &USB->DEVICE.DeviceEndpoint[ep];
+
+	hw->EPCFG.reg = USB_DEVICE_EPCFG_EPTYPE0(tipo0) | USB_DEVICE_EPCFG_EPTYPE1(tipo1);
+	hw->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUS_BK0RDY | USB_DEVICE_EPSTATUS_BK1RDY
+			| USB_DEVICE_EPSTATUS_STALLRQ0 | USB_DEVICE_EPSTATUS_STALLRQ1
+			| USB_DEVICE_EPSTATUS_DTGLOUT | USB_DEVICE_EPSTATUS_DTGLIN | USB_DEVICE_EPSTATUS_CURBK;
+	hw->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_MASK;
+	hw->EPINTENSET.reg = USB_DEVICE_EPINTFLAG_TRCPT0 | USB_DEVICE_EPINTFLAG_TRCPT1;
+	usbdev_proximo[ep] = 0;
+}
+
+//! Endpoints da classe, depois de SET_CONFIGURATION
+void usbdev_configura(void)
+{
+	usbdev_ep_configura(CDC_EP_IN, EPTIPO_DUPLO, EPTIPO_BULK);
+	usbdev_ep_configura(CDC_EP_OUT, EPTIPO_BULK, EPTIPO_DUPLO);
+	usbdev_ep_configura(CDC_EP_NOTIF, EPTIPO_DESLIGADO, EPTIPO_INTERRUPT);
+}
+
+//! Endereco dado pelo host, aplicado pela classe depois do estagio de status
+void usbdev_endereco(uint8_t endereco)
+{
+	USB->DEVICE.DADD.reg = USB_DEVICE_DADD_ADDEN | USB_DEVICE_DADD_DADD(endereco);
+}
+
+//! Arma um banco OUT para receber ate "tam" bytes em "area"
+void usbdev_recebe(uint8_t ep, uint8_t banco, uint8_t *area, uint16_t tam)
+{
+	usbdev_desc[ep].DeviceDescBank[banco].ADDR.reg = (uint32_t)area;
+	usbdev_desc[ep].DeviceDescBank[banco].PCKSIZE.reg = USB_DEVICE_PCKSIZE_SIZE(usbdev_pcksize[ep])
+			| USB_DEVICE_PCKSIZE_MULTI_PACKET_SIZE(tam) | USB_DEVICE_PCKSIZE_BYTE_COUNT(0);
+	USB->DEVICE.DeviceEndpoint[ep].EPSTATUSCLR.reg = USB_DEVICE_EPSTATUS_BK0RDY << banco;
+}
+
+//! Arma um banco IN com "tam" bytes (0 para um pacote de tamanho zero)
+void usbdev_envia(uint8_t ep, uint8_t banco, const uint8_t *dados, uint16_t tam)
+{
+	usbdev_desc[ep].DeviceDescBank[banco].ADDR.reg = (uint32_t)dados;
+	usbdev_desc[ep].DeviceDescBank[banco].PCKSIZE.reg = USB_DEVICE_PCKSIZE_SIZE(usbdev_pcksize[ep])
+			| USB_DEVICE_PCKSIZE_MULTI_PACKET_SIZE(0) | USB_DEVICE_PCKSIZE_BYTE_COUNT(tam);
+	USB->DEVICE.DeviceEndpoint[ep].EPSTATUSSET.reg = USB_DEVICE_EPSTATUS_BK0RDY << banco;
+}
+
+//! Recusa a requisicao: STALL nos dois sentidos, ate o proximo SETUP
+void usbdev_stall(uint8_t ep)
+{
+	USB->DEVICE.DeviceEndpoint[ep].EPSTATUSSET.reg = USB_DEVICE_EPSTATUS_STALLRQ0 | USB_DEVICE_EPSTATUS_STALLRQ1;
+}
+
+//! Reset do barramento: so o endpoint 0, de controle, fica ligado
+static void usbdev_reset(void)
+{
+	uint8_t ep;
+
+	for (ep = 1; ep < USBDEV_EPS; ep++) {
+		USB->DEVICE.DeviceEndpoint[ep].EPCFG.reg = 0;
+	}
+	usbdev_ep_configura(0, EPTIPO_CONTROLE, EPTIPO_CONTROLE);
+	USB->DEVICE.DeviceEndpoint[0].EPINTENSET.reg = USB_DEVICE_EPINTFLAG_RXSTP;
+	cdc_reset();
+}
+
+//! Bancos completos de um endpoint, na ordem em que o hardware os usou
+static void usbdev_ep_trata(uint8_t ep, bool entrada)
+{
+	UsbDeviceEndpoint *hw = &USB->DEVICE.DeviceEndpoint[ep];
+	uint8_t banco;
+	uint8_t i;
+
+	for (i = 0; i < 2; i++) {
+		banco = usbdev_proximo[ep];
+		if (!(hw->EPINTFLAG.reg & (USB_DEVICE_EPINTFLAG_TRCPT0 << banco))) {
+			return;
+		}
+		hw->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT0 << banco;
+		usbdev_proximo[ep] ^= 1;
+		if (entrada) {
+			cdc_in_completo(ep, banco);
+		} else {
+			cdc_out_completo(ep, banco, usbdev_desc[ep].DeviceDescBank[banco].PCKSIZE.bit.BYTE_COUNT);
+		}
+	}
+}
+
+//! Endpoint 0: SETUP, estagio de dados/status OUT (banco 0) e IN (banco 1)
+static void usbdev_ep0_trata(void)
+{
+	UsbDeviceEndpoint *hw = &USB->DEVICE.DeviceEndpoint[0];
+	uint8_t flags = hw->EPINTFLAG.reg;
+
+	if (flags & USB_DEVICE_EPINTFLAG_RXSTP) {
+		// Um SETUP novo cancela o STALL e qualquer estagio pendente da requisicao anterior
+		hw->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_RXSTP | USB_DEVICE_EPINTFLAG_TRCPT0 | USB_DEVICE_EPINTFLAG_TRCPT1;
+		hw->EPSTATUSCLR.reg = USB_DEVICE_EPSTATUS_STALLRQ0 | USB_DEVICE_EPSTATUS_STALLRQ1 | USB_DEVICE_EPSTATUS_BK1RDY;
+		cdc_setup((const uint8_t *)usbdev_desc[0].DeviceDescBank[0].ADDR.reg);
+		return;
+	}
+	if (flags & USB_DEVICE_EPINTFLAG_TRCPT0) {
+		hw->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT0;
+		cdc_out_completo(0, 0, usbdev_desc[0].DeviceDescBank[0].PCKSIZE.bit.BYTE_COUNT);
+	}
+	if (flags & USB_DEVICE_EPINTFLAG_TRCPT1) {
+		hw->EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_TRCPT1;
+		cdc_in_completo(0, 1);
+	}
+}
+
+/**
+ * \internal
+ * \brief Tratador de interrupcao da USB
+ */
+void USB_Handler(void)
+{
+	TRACE_ISR_ENTRA_EM(TRACE_ISR_CONSOLE);
+	usbdev_trata();
+	TRACE_ISR_SAI_DE(TRACE_ISR_CONSOLE);
+}
+
+static void usbdev_trata(void)
+{
+	uint16_t resumo;
+
+	if (USB->DEVICE.INTFLAG.reg & USB_DEVICE_INTFLAG_EORST) {
+		USB->DEVICE.INTFLAG.reg = USB_DEVICE_INTFLAG_EORST;
+		usbdev_reset();
+		return;
+	}
+
+	resumo = USB->DEVICE.EPINTSMRY.reg;
+	if (resumo & (1 << 0)) {
+		usbdev_ep0_trata();
+	}
+	if (resumo & (1 << CDC_EP_OUT)) {
+		usbdev_ep_trata(CDC_EP_OUT, false);
+	}
+	if (resumo & (1 << CDC_EP_IN)) {
+		usbdev_ep_trata(CDC_EP_IN, true);
+	}
+	if (resumo & (1 << CDC_EP_NOTIF)) {
+		USB->DEVICE.DeviceEndpoint[CDC_EP_NOTIF].EPINTFLAG.reg = USB_DEVICE_EPINTFLAG_MASK;
+	}
+}
+
+#endif // CONF_CONSOLE_BACKEND == CONSOLE_BACKEND_USB
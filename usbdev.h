@@ -0,0 +1,23 @@
+/**
+ * \file
+ * \brief Camada de endpoints da USB nativa do SAMD21 (modo device, full-speed)
+ *
+ * Liga o periferico USB em modo device e atende a sua interrupcao, repassando SETUP,
+ * transferencias completas e resets do barramento para a classe CDC (cdc.h), que chama de
+ * volta as funcoes usbdev_* declaradas la para armar bancos, mandar STALL e trocar o
+ * endereco. Os endpoints bulk usam os dois bancos (ping-pong) do hardware.
+ *
+ * A USB precisa de 48 MHz no gerador CONF_USB_GCLK: o DFLL em malha fechada sobre o SOF
+ * (USB clock recovery) ou sobre o cristal de 32 kHz, configurado em conf_clocks.h.
+ */
+
+#ifndef USBDEV_H
+#define USBDEV_H
+
+#ifndef CONF_USB_GCLK
+#  define CONF_USB_GCLK GCLK_GENERATOR_0 // Gerador de 48 MHz para a USB
+#endif
+
+void usbdev_init(void);
+
+#endif // USBDEV_H